@@ -60,6 +60,11 @@ namespace Dg
     //! Get a random value from the table.
     Real Get() const;
 
+    //! Get a random value from the table, drawing from the caller's generator.
+    //! Thread safe if each thread passes its own, for example a Dg::RNG.
+    template<typename Generator>
+    Real Get(Generator &) const;
+
   private:
 
     void _init(const BoundedSND&);
@@ -191,6 +196,22 @@ namespace Dg
     return m_values[index];
   }
 
+  //--------------------------------------------------------------------------------
+  //	@	BoundedSND<Real>::Get()
+  //--------------------------------------------------------------------------------
+  template<typename Real>
+  template<typename Generator>
+  Real BoundedSND<Real>::Get(Generator & a_rng) const
+  {
+    if (m_nValues == 0)
+    {
+      return static_cast<Real>(0.0);
+    }
+
+    unsigned int index = a_rng.GetUint(0, m_nValues - 1);
+    return m_values[index];
+  }
+
 }
 
 #endif
\ No newline at end of file
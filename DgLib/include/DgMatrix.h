@@ -9,9 +9,13 @@
 #define DGMATRIX_H
 
 #include "dgmath.h"
+#include "DgSIMD.h"
 
 namespace Dg
 {
+  //! Selects constructors that leave the elements uninitialized.
+  enum NoInitTag { NoInit };
+
   template<size_t M, size_t N, typename Real> class Matrix;
 
   template<size_t M, size_t N, typename Real>
@@ -26,22 +30,26 @@ namespace Dg
   //!
   //! @brief Generic M * N matrix class.
   //!
+  //! Matrix<1, 4, float> and Matrix<4, 4, float> are 16 byte aligned and
+  //! use SSE for the arithmetic operators when DG_USE_SSE is defined.
+  //!
   //! @author Frank B. Hart
   //! @date 4/10/2015
   template<size_t M, size_t N, typename Real>
-  class Matrix
+  class Matrix : public MatrixAlignment<M, N, Real>
   {
     static_assert(M > 0 && N > 0, "Matrix cannot have a zero dimension.");
 
     template<size_t _M, size_t _N, typename T> friend class Matrix;
 
   public:
-    //! Default constructor, initialized to identity matrix.
+    //! Default constructor. Elements are not initialized.
     Matrix();
-    ~Matrix() {}
 
-    Matrix(Matrix const &);
-    Matrix& operator=(Matrix const &);
+    //! Copies are trivial so that arrays of matrices, and of structs that
+    //! hold them, can be moved with memcpy and realloc.
+    Matrix(Matrix const &) = default;
+    Matrix& operator=(Matrix const &) = default;
 
     //! Accessor i: row, j:column.
     Real& operator()(size_t m, size_t n);
@@ -145,36 +153,6 @@ namespace Dg
   }	//End: Matrix::operator()
 
 
-  //--------------------------------------------------------------------------------
-  //	@	Matrix::operator=()
-  //--------------------------------------------------------------------------------
-  template<size_t M, size_t N, typename Real>
-  Matrix<M, N, Real>& Matrix<M, N, Real>::operator= (Matrix<M, N, Real>const & a_other)
-  {
-    for (size_t i = 0; i < M * N; ++i)
-    {
-      m_V[i] = a_other.m_V[i];
-    }
-
-    return *this;
-
-  }	//End: Matrix::operator=()
-
-
-  //--------------------------------------------------------------------------------
-  //	@	Matrix::Matrix()
-  //--------------------------------------------------------------------------------
-  template<size_t M, size_t N, typename Real>
-  Matrix<M, N, Real>::Matrix(Matrix<M, N, Real> const & a_other)
-  {
-    for (size_t i = 0; i < M * N; ++i)
-    {
-      m_V[i] = a_other.m_V[i];
-    }
-
-  }	//End: Matrix::Matrix()
-
-
   //--------------------------------------------------------------------------------
   //	@	Matrix::operator==()
   //--------------------------------------------------------------------------------
@@ -654,7 +632,241 @@ namespace Dg
 
   }  // End: Matrix::operator/=()
 
+
+#ifdef DG_SSE
+
+  //--------------------------------------------------------------------------------
+  //	@	Matrix<1, 4, float> SSE specializations
+  //--------------------------------------------------------------------------------
+  template<>
+  inline void Matrix<1, 4, float>::Zero()
+  {
+    SSE::Store(m_V, _mm_setzero_ps());
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float> Matrix<1, 4, float>::operator+(Matrix<1, 4, float> const & a_other) const
+  {
+    Matrix<1, 4, float> result;
+    SSE::Store(result.m_V, _mm_add_ps(SSE::Load(m_V), SSE::Load(a_other.m_V)));
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float>& Matrix<1, 4, float>::operator+=(Matrix<1, 4, float> const & a_other)
+  {
+    SSE::Store(m_V, _mm_add_ps(SSE::Load(m_V), SSE::Load(a_other.m_V)));
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float> Matrix<1, 4, float>::operator-(Matrix<1, 4, float> const & a_other) const
+  {
+    Matrix<1, 4, float> result;
+    SSE::Store(result.m_V, _mm_sub_ps(SSE::Load(m_V), SSE::Load(a_other.m_V)));
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float>& Matrix<1, 4, float>::operator-=(Matrix<1, 4, float> const & a_other)
+  {
+    SSE::Store(m_V, _mm_sub_ps(SSE::Load(m_V), SSE::Load(a_other.m_V)));
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float> Matrix<1, 4, float>::operator-() const
+  {
+    Matrix<1, 4, float> result;
+    SSE::Store(result.m_V, _mm_xor_ps(SSE::Load(m_V), _mm_set1_ps(-0.0f)));
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float>& Matrix<1, 4, float>::operator*=(float a_scalar)
+  {
+    SSE::Store(m_V, _mm_mul_ps(SSE::Load(m_V), _mm_set1_ps(a_scalar)));
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float> Matrix<1, 4, float>::operator*(float a_scalar) const
+  {
+    Matrix<1, 4, float> result;
+    SSE::Store(result.m_V, _mm_mul_ps(SSE::Load(m_V), _mm_set1_ps(a_scalar)));
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float>& Matrix<1, 4, float>::operator/=(float a_scalar)
+  {
+    SSE::Store(m_V, _mm_div_ps(SSE::Load(m_V), _mm_set1_ps(a_scalar)));
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<1, 4, float> Matrix<1, 4, float>::operator/(float a_scalar) const
+  {
+    Matrix<1, 4, float> result;
+    SSE::Store(result.m_V, _mm_div_ps(SSE::Load(m_V), _mm_set1_ps(a_scalar)));
+    return result;
+  }
+
+
+  //Row vector * matrix
+  template<>
+  template<>
+  inline Matrix<1, 4, float> Matrix<1, 4, float>::operator*<4>(Matrix<4, 4, float> const & a_other) const
+  {
+    Matrix<1, 4, float> result;
+    SSE::Store(result.m_V, SSE::MulRow(SSE::Load(m_V), a_other.m_V));
+    return result;
+  }
+
+
+  //--------------------------------------------------------------------------------
+  //	@	Matrix<4, 4, float> SSE specializations
+  //--------------------------------------------------------------------------------
+  template<>
+  inline void Matrix<4, 4, float>::Zero()
+  {
+    __m128 zero = _mm_setzero_ps();
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(m_V + i, zero);
+    }
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float> Matrix<4, 4, float>::operator+(Matrix<4, 4, float> const & a_other) const
+  {
+    Matrix<4, 4, float> result;
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(result.m_V + i, _mm_add_ps(SSE::Load(m_V + i), SSE::Load(a_other.m_V + i)));
+    }
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float>& Matrix<4, 4, float>::operator+=(Matrix<4, 4, float> const & a_other)
+  {
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(m_V + i, _mm_add_ps(SSE::Load(m_V + i), SSE::Load(a_other.m_V + i)));
+    }
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float> Matrix<4, 4, float>::operator-(Matrix<4, 4, float> const & a_other) const
+  {
+    Matrix<4, 4, float> result;
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(result.m_V + i, _mm_sub_ps(SSE::Load(m_V + i), SSE::Load(a_other.m_V + i)));
+    }
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float>& Matrix<4, 4, float>::operator-=(Matrix<4, 4, float> const & a_other)
+  {
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(m_V + i, _mm_sub_ps(SSE::Load(m_V + i), SSE::Load(a_other.m_V + i)));
+    }
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float> Matrix<4, 4, float>::operator-() const
+  {
+    Matrix<4, 4, float> result;
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(result.m_V + i, _mm_xor_ps(SSE::Load(m_V + i), sign));
+    }
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float>& Matrix<4, 4, float>::operator*=(float a_scalar)
+  {
+    __m128 s = _mm_set1_ps(a_scalar);
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(m_V + i, _mm_mul_ps(SSE::Load(m_V + i), s));
+    }
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float> Matrix<4, 4, float>::operator*(float a_scalar) const
+  {
+    Matrix<4, 4, float> result;
+    __m128 s = _mm_set1_ps(a_scalar);
+    for (int i = 0; i < 16; i += 4)
+    {
+      SSE::Store(result.m_V + i, _mm_mul_ps(SSE::Load(m_V + i), s));
+    }
+    return result;
+  }
+
+
+  template<>
+  template<>
+  inline Matrix<4, 4, float> Matrix<4, 4, float>::operator*<4>(Matrix<4, 4, float> const & a_other) const
+  {
+    Matrix<4, 4, float> result;
+    SSE::MulMatrix(result.m_V, m_V, a_other.m_V);
+    return result;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float>& Matrix<4, 4, float>::operator*=(Matrix<4, 4, float> const & a_other)
+  {
+    SSE::MulMatrix(m_V, m_V, a_other.m_V);
+    return *this;
+  }
+
+
+  template<>
+  inline Matrix<4, 4, float>& Matrix<4, 4, float>::Transpose()
+  {
+    __m128 r0 = SSE::Load(m_V);
+    __m128 r1 = SSE::Load(m_V + 4);
+    __m128 r2 = SSE::Load(m_V + 8);
+    __m128 r3 = SSE::Load(m_V + 12);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    SSE::Store(m_V, r0);
+    SSE::Store(m_V + 4, r1);
+    SSE::Store(m_V + 8, r2);
+    SSE::Store(m_V + 12, r3);
+    return *this;
+  }
+
+#endif
+
 }
 
 
-#endif
\ No newline at end of file
+#endif
@@ -1,9 +1,465 @@
-#ifdef DGRNG_H
+//! @file DgRNG.h
+//!
+//! @date 10/16/2026
+//!
+//! Class declaration: PCG32, Xoshiro128Plus, Xoshiro128PlusX8, RNG
+
+#ifndef DGRNG_H
 #define DGRNG_H
 
-class DgRNG
+#include <math.h>
+#include <stdint.h>
+
+#include "DgSIMD.h"
+
+namespace Dg
 {
-  virtual ~DgRNG{} = 0;
-};
+  //! SplitMix64 step. Used to expand seeds into generator state.
+  inline uint64_t SplitMix64(uint64_t & a_state)
+  {
+    uint64_t z = (a_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+
+  //! Maps 32 random bits to the open interval (0, 1).
+  template<typename Real> struct UniformFromBits;
+
+  template<> struct UniformFromBits<float>
+  {
+    //23 bits so the largest value, 1 - 2^-24, does not round up to 1
+    static float Get(uint32_t a_u) { return (float(a_u >> 9) + 0.5f) * (1.0f / 8388608.0f); }
+  };
+
+  template<> struct UniformFromBits<double>
+  {
+    static double Get(uint32_t a_u) { return (double(a_u) + 0.5) * (1.0 / 4294967296.0); }
+  };
+
+
+  //! @ingroup Math_classes
+  //!
+  //! @class PCG32
+  //!
+  //! @brief PCG-XSH-RR generator by Melissa O'Neill. 64 bits of state, 32 bit output.
+  //!
+  //! Each (seed, stream) pair is an independent sequence, so a generator can be
+  //! created per thread or per pixel without any shared state.
+  class PCG32
+  {
+  public:
+
+    PCG32() { Seed(0x853C49E6748FEA9BULL, 0xDA3E39CB94B95BDBULL); }
+    explicit PCG32(uint64_t a_seed, uint64_t a_stream = 0) { Seed(a_seed, a_stream); }
+
+    void Seed(uint64_t a_seed, uint64_t a_stream = 0)
+    {
+      m_state = 0;
+      m_inc = (a_stream << 1) | 1;
+      Next();
+      m_state += a_seed;
+      Next();
+    }
+
+    uint32_t Next()
+    {
+      uint64_t old = m_state;
+      m_state = old * 6364136223846793005ULL + m_inc;
+      uint32_t xorshifted = uint32_t(((old >> 18) ^ old) >> 27);
+      uint32_t rot = uint32_t(old >> 59);
+      return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+  private:
+
+    uint64_t m_state;
+    uint64_t m_inc;
+  };
+
+
+  //! @ingroup Math_classes
+  //!
+  //! @class Xoshiro128Plus
+  //!
+  //! @brief xoshiro128+ by David Blackman and Sebastiano Vigna. 128 bits of state.
+  //!
+  //! The state is expanded from (seed, stream) with SplitMix64. Jump() advances
+  //! 2^64 steps, for streams that are guaranteed not to overlap.
+  class Xoshiro128Plus
+  {
+  public:
+
+    Xoshiro128Plus() { Seed(0, 0); }
+    explicit Xoshiro128Plus(uint64_t a_seed, uint64_t a_stream = 0) { Seed(a_seed, a_stream); }
+
+    void Seed(uint64_t a_seed, uint64_t a_stream = 0)
+    {
+      uint64_t sm = a_seed ^ (a_stream * 0xD1342543DE82EF95ULL);
+      uint64_t a = SplitMix64(sm);
+      uint64_t b = SplitMix64(sm);
+      m_s[0] = uint32_t(a);
+      m_s[1] = uint32_t(a >> 32);
+      m_s[2] = uint32_t(b);
+      m_s[3] = uint32_t(b >> 32);
+    }
+
+    uint32_t Next()
+    {
+      uint32_t result = m_s[0] + m_s[3];
+      uint32_t t = m_s[1] << 9;
+
+      m_s[2] ^= m_s[0];
+      m_s[3] ^= m_s[1];
+      m_s[1] ^= m_s[2];
+      m_s[0] ^= m_s[3];
+      m_s[2] ^= t;
+      m_s[3] = (m_s[3] << 11) | (m_s[3] >> 21);
+
+      return result;
+    }
+
+    void Jump()
+    {
+      static uint32_t const s_jump[4] = {0x8764000B, 0xF542D2D3, 0x6FA035C3, 0x77F2DB5B};
+
+      uint32_t s[4] = {0, 0, 0, 0};
+      for (int i = 0; i < 4; i++)
+      {
+        for (int b = 0; b < 32; b++)
+        {
+          if (s_jump[i] & (1u << b))
+          {
+            s[0] ^= m_s[0];
+            s[1] ^= m_s[1];
+            s[2] ^= m_s[2];
+            s[3] ^= m_s[3];
+          }
+          Next();
+        }
+      }
+
+      m_s[0] = s[0];
+      m_s[1] = s[1];
+      m_s[2] = s[2];
+      m_s[3] = s[3];
+    }
+
+  private:
+
+    friend class Xoshiro128PlusX8;
+
+    uint32_t m_s[4];
+  };
+
+
+  //! @ingroup Math_classes
+  //!
+  //! @class Xoshiro128PlusX8
+  //!
+  //! @brief Eight xoshiro128+ generators stepped together.
+  //!
+  //! Lane i is the scalar generator for (seed, stream) jumped i times, so the
+  //! lanes never overlap. Uses AVX2 when DG_AVX2 is defined, two SSE2
+  //! registers when DG_SSE is defined, and plain arrays otherwise.
+  class Xoshiro128PlusX8
+  {
+  public:
+
+    Xoshiro128PlusX8() { Seed(0, 0); }
+    explicit Xoshiro128PlusX8(uint64_t a_seed, uint64_t a_stream = 0) { Seed(a_seed, a_stream); }
+
+    void Seed(uint64_t a_seed, uint64_t a_stream = 0)
+    {
+      Xoshiro128Plus lane(a_seed, a_stream);
+      for (int i = 0; i < 8; i++)
+      {
+        for (int j = 0; j < 4; j++)
+        {
+          m_s[j][i] = lane.m_s[j];
+        }
+        lane.Jump();
+      }
+    }
+
+    //! Eight 32 bit values, one per lane.
+    void Next(uint32_t a_out[8])
+    {
+#if defined(DG_AVX2)
+      __m256i s0 = _mm256_loadu_si256((__m256i const *)m_s[0]);
+      __m256i s1 = _mm256_loadu_si256((__m256i const *)m_s[1]);
+      __m256i s2 = _mm256_loadu_si256((__m256i const *)m_s[2]);
+      __m256i s3 = _mm256_loadu_si256((__m256i const *)m_s[3]);
+
+      _mm256_storeu_si256((__m256i *)a_out, _mm256_add_epi32(s0, s3));
+      __m256i t = _mm256_slli_epi32(s1, 9);
+      s2 = _mm256_xor_si256(s2, s0);
+      s3 = _mm256_xor_si256(s3, s1);
+      s1 = _mm256_xor_si256(s1, s2);
+      s0 = _mm256_xor_si256(s0, s3);
+      s2 = _mm256_xor_si256(s2, t);
+      s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+
+      _mm256_storeu_si256((__m256i *)m_s[0], s0);
+      _mm256_storeu_si256((__m256i *)m_s[1], s1);
+      _mm256_storeu_si256((__m256i *)m_s[2], s2);
+      _mm256_storeu_si256((__m256i *)m_s[3], s3);
+#elif defined(DG_SSE)
+      for (int h = 0; h < 8; h += 4)
+      {
+        __m128i s0 = _mm_loadu_si128((__m128i const *)(m_s[0] + h));
+        __m128i s1 = _mm_loadu_si128((__m128i const *)(m_s[1] + h));
+        __m128i s2 = _mm_loadu_si128((__m128i const *)(m_s[2] + h));
+        __m128i s3 = _mm_loadu_si128((__m128i const *)(m_s[3] + h));
+
+        _mm_storeu_si128((__m128i *)(a_out + h), _mm_add_epi32(s0, s3));
+        __m128i t = _mm_slli_epi32(s1, 9);
+        s2 = _mm_xor_si128(s2, s0);
+        s3 = _mm_xor_si128(s3, s1);
+        s1 = _mm_xor_si128(s1, s2);
+        s0 = _mm_xor_si128(s0, s3);
+        s2 = _mm_xor_si128(s2, t);
+        s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+        _mm_storeu_si128((__m128i *)(m_s[0] + h), s0);
+        _mm_storeu_si128((__m128i *)(m_s[1] + h), s1);
+        _mm_storeu_si128((__m128i *)(m_s[2] + h), s2);
+        _mm_storeu_si128((__m128i *)(m_s[3] + h), s3);
+      }
+#else
+      for (int i = 0; i < 8; i++)
+      {
+        a_out[i] = m_s[0][i] + m_s[3][i];
+        uint32_t t = m_s[1][i] << 9;
+        m_s[2][i] ^= m_s[0][i];
+        m_s[3][i] ^= m_s[1][i];
+        m_s[1][i] ^= m_s[2][i];
+        m_s[0][i] ^= m_s[3][i];
+        m_s[2][i] ^= t;
+        m_s[3][i] = (m_s[3][i] << 11) | (m_s[3][i] >> 21);
+      }
+#endif
+    }
+
+    //! Eight uniform samples from the open interval (0, 1).
+    void GetUniform(float a_out[8])
+    {
+      uint32_t u[8];
+      Next(u);
+#if defined(DG_AVX2)
+      __m256 f = _mm256_cvtepi32_ps(_mm256_srli_epi32(_mm256_loadu_si256((__m256i const *)u), 9));
+      f = _mm256_mul_ps(_mm256_add_ps(f, _mm256_set1_ps(0.5f)), _mm256_set1_ps(1.0f / 8388608.0f));
+      _mm256_storeu_ps(a_out, f);
+#elif defined(DG_SSE)
+      for (int h = 0; h < 8; h += 4)
+      {
+        __m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(_mm_loadu_si128((__m128i const *)(u + h)), 9));
+        f = _mm_mul_ps(_mm_add_ps(f, _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f / 8388608.0f));
+        _mm_storeu_ps(a_out + h, f);
+      }
+#else
+      for (int i = 0; i < 8; i++)
+      {
+        a_out[i] = UniformFromBits<float>::Get(u[i]);
+      }
+#endif
+    }
+
+  private:
+
+    //m_s[j][i]: word j of lane i
+    uint32_t m_s[4][8];
+  };
+
+
+  //! @ingroup Math_classes
+  //!
+  //! @class RNG
+  //!
+  //! @brief The SimpleRNG interface on top of a generator with per object state.
+  //!
+  //! Engine must provide Seed(uint64_t, uint64_t) and uint32_t Next(). Unlike
+  //! SimpleRNG nothing is static: give each thread, or each pixel, its own
+  //! object and a different stream.
+  template<typename Engine>
+  class RNG
+  {
+  public:
+
+    RNG() {}
+    explicit RNG(uint64_t a_seed, uint64_t a_stream = 0) : m_engine(a_seed, a_stream) {}
+
+    void SetSeed(uint64_t a_seed, uint64_t a_stream = 0) { m_engine.Seed(a_seed, a_stream); }
+
+    Engine & GetEngine() { return m_engine; }
+
+    //! Get random unsigned integer.
+    uint32_t GetUint() { return m_engine.Next(); }
+
+    //! Get random unsigned integer within the interval [a, b]. Unbiased.
+    uint32_t GetUint(uint32_t a, uint32_t b);
+
+    //! Produce a uniform random sample from the open interval (0, 1).
+    template<class Real>
+    Real GetUniform() { return UniformFromBits<Real>::Get(m_engine.Next()); }
+
+    //! Produce a uniform random sample from the open interval (a, b).
+    template<class Real>
+    Real GetUniform(Real a, Real b);
+
+    //! Get a Gaussian random sample with mean 0 and std 1.
+    template<class Real>
+    Real GetNormal();
+
+    //! Get a Gaussian random sample with specified mean and standard deviation.
+    template<class Real>
+    Real GetNormal(Real mean, Real std);
+
+    //! Get a Gamma random sample with specified shape and scale.
+    template<class Real>
+    Real GetGamma(Real shape, Real scale);
+
+  private:
+
+    Engine m_engine;
+  };
+
+
+  //--------------------------------------------------------------------------------
+  //	@	RNG::GetUint()
+  //--------------------------------------------------------------------------------
+  //		Lemire's multiply and reject, no division in the common case.
+  //--------------------------------------------------------------------------------
+  template<typename Engine>
+  uint32_t RNG<Engine>::GetUint(uint32_t a_a, uint32_t a_b)
+  {
+    if (a_b <= a_a)
+    {
+      return a_a;
+    }
+
+    uint32_t range = a_b - a_a + 1;
+    if (range == 0)
+    {
+      return m_engine.Next();
+    }
+
+    uint64_t m = uint64_t(m_engine.Next()) * range;
+    uint32_t low = uint32_t(m);
+    if (low < range)
+    {
+      uint32_t threshold = (0u - range) % range;
+      while (low < threshold)
+      {
+        m = uint64_t(m_engine.Next()) * range;
+        low = uint32_t(m);
+      }
+    }
+
+    return a_a + uint32_t(m >> 32);
+
+  }	//End: RNG::GetUint()
+
+
+  //--------------------------------------------------------------------------------
+  //	@	RNG::GetUniform()
+  //--------------------------------------------------------------------------------
+  template<typename Engine>
+  template<class Real>
+  Real RNG<Engine>::GetUniform(Real a_a, Real a_b)
+  {
+    if (a_b < a_a)
+    {
+      return a_a;
+    }
+
+    return GetUniform<Real>() * (a_b - a_a) + a_a;
+
+  }	//End: RNG::GetUniform()
+
+
+  //--------------------------------------------------------------------------------
+  //	@	RNG::GetNormal()
+  //--------------------------------------------------------------------------------
+  template<typename Engine>
+  template<class Real>
+  Real RNG<Engine>::GetNormal()
+  {
+    // Use Box-Muller algorithm
+    Real u1 = GetUniform<Real>();
+    Real u2 = GetUniform<Real>();
+    Real r = sqrt(Real(-2.0) * log(u1));
+    Real theta = Real(6.283185307179586476925286766559) * u2;
+    return r * sin(theta);
+
+  }	//End: RNG::GetNormal()
+
+
+  //--------------------------------------------------------------------------------
+  //	@	RNG::GetNormal()
+  //--------------------------------------------------------------------------------
+  template<typename Engine>
+  template<class Real>
+  Real RNG<Engine>::GetNormal(Real a_mean, Real a_std)
+  {
+    if (a_std <= Real(0.0))
+    {
+      return a_mean;
+    }
+    return a_mean + a_std * GetNormal<Real>();
+
+  }	//End: RNG::GetNormal()
+
+
+  //--------------------------------------------------------------------------------
+  //	@	RNG::GetGamma()
+  //--------------------------------------------------------------------------------
+  template<typename Engine>
+  template<class Real>
+  Real RNG<Engine>::GetGamma(Real a_shape, Real a_scale)
+  {
+    // Implementation based on "A Simple Method for Generating Gamma Variables"
+    // by George Marsaglia and Wai Wan Tsang.  ACM Transactions on Mathematical Software
+    // Vol 26, No 3, September 2000, pages 363-372.
+
+    if (a_shape <= Real(0.0))
+    {
+      return Real(-1.0);
+    }
+
+    if (a_shape < Real(1.0))
+    {
+      Real g = GetGamma(a_shape + Real(1.0), Real(1.0));
+      Real w = GetUniform<Real>();
+      return a_scale * g * pow(w, Real(1.0) / a_shape);
+    }
+
+    Real d = a_shape - Real(0.33333333333333333333333333333333);
+    Real c = Real(1.0) / sqrt(Real(9.0) * d);
+    for (;;)
+    {
+      Real x, v;
+      do
+      {
+        x = GetNormal<Real>();
+        v = Real(1.0) + c * x;
+      } while (v <= Real(0.0));
+      v = v * v * v;
+      Real u = GetUniform<Real>();
+      Real xsquared = x * x;
+      if (u < Real(1.0) - Real(0.0331) * xsquared * xsquared
+        || log(u) < Real(0.5) * xsquared + d * (Real(1.0) - v + log(v)))
+      {
+        return a_scale * d * v;
+      }
+    }
+
+  }	//End: RNG::GetGamma()
+
+
+  typedef RNG<PCG32>           RNG_PCG32;
+  typedef RNG<Xoshiro128Plus>  RNG_Xoshiro128Plus;
+}
 
-#endif
\ No newline at end of file
+#endif
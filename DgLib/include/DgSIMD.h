@@ -0,0 +1,131 @@
+//! @file DgSIMD.h
+//!
+//! @date 10/16/2026
+//!
+//! SSE helpers shared by the float specializations of Matrix, Vector4 and
+//! Matrix44. DG_SSE is only defined if DG_USE_SSE is set in config.h and the
+//! target supports SSE2. DG_AVX is additionally defined when compiling with
+//! /arch:AVX (or -mavx), and DG_AVX2 with /arch:AVX2 (or -mavx2).
+
+#ifndef DGSIMD_H
+#define DGSIMD_H
+
+#include <stddef.h>
+
+#include "config.h"
+
+#if defined(DG_USE_SSE) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define DG_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(DG_SSE) && defined(__AVX__)
+#define DG_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(DG_AVX) && defined(__AVX2__)
+#define DG_AVX2
+#endif
+
+#if defined(_MSC_VER)
+#define DG_ALIGN(x) __declspec(align(x))
+#else
+#define DG_ALIGN(x) __attribute__((aligned(x)))
+#endif
+
+namespace Dg
+{
+  //! Empty base of Matrix. Specialized below to raise the alignment of the
+  //! types that have SIMD code paths without changing the m_V member.
+  template<size_t M, size_t N, typename Real>
+  struct MatrixAlignment {};
+
+#ifdef DG_SSE
+
+  template<> struct DG_ALIGN(16) MatrixAlignment<1, 4, float> {};
+  template<> struct DG_ALIGN(16) MatrixAlignment<4, 4, float> {};
+
+  namespace SSE
+  {
+    //Storage is aligned, but elements of containers that only guarantee
+    //8 byte alignment (32 bit heaps, realloc) are still valid matrices,
+    //so loads and stores are unaligned. On aligned data they cost the same.
+    inline __m128 Load(float const * a_p)         { return _mm_loadu_ps(a_p); }
+    inline void Store(float * a_p, __m128 a_v)    { _mm_storeu_ps(a_p, a_v); }
+
+    //! Horizontal sum, broadcast to all lanes.
+    inline __m128 Sum(__m128 a_v)
+    {
+      __m128 s = _mm_add_ps(a_v, _mm_shuffle_ps(a_v, a_v, _MM_SHUFFLE(2, 3, 0, 1)));
+      return _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    //! 4 component dot product, broadcast to all lanes.
+    inline __m128 Dot(__m128 a_v0, __m128 a_v1)
+    {
+      return Sum(_mm_mul_ps(a_v0, a_v1));
+    }
+
+    //! Cross product of the xyz components, w is 0.
+    inline __m128 Cross(__m128 a_v0, __m128 a_v1)
+    {
+      __m128 v0_yzx = _mm_shuffle_ps(a_v0, a_v0, _MM_SHUFFLE(3, 0, 2, 1));
+      __m128 v1_yzx = _mm_shuffle_ps(a_v1, a_v1, _MM_SHUFFLE(3, 0, 2, 1));
+      __m128 c = _mm_sub_ps(_mm_mul_ps(a_v0, v1_yzx), _mm_mul_ps(v0_yzx, a_v1));
+      c = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+      return _mm_and_ps(c, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+    }
+
+    //! Row vector times the 4x4 row major matrix at a_m.
+    inline __m128 MulRow(__m128 a_v, float const * a_m)
+    {
+      __m128 r = _mm_mul_ps(_mm_shuffle_ps(a_v, a_v, _MM_SHUFFLE(0, 0, 0, 0)), Load(a_m));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a_v, a_v, _MM_SHUFFLE(1, 1, 1, 1)), Load(a_m + 4)));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a_v, a_v, _MM_SHUFFLE(2, 2, 2, 2)), Load(a_m + 8)));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a_v, a_v, _MM_SHUFFLE(3, 3, 3, 3)), Load(a_m + 12)));
+      return r;
+    }
+
+    //! a_out = a_m0 * a_m1 for 4x4 row major matrices. a_out may alias either input.
+    inline void MulMatrix(float * a_out, float const * a_m0, float const * a_m1)
+    {
+#ifdef DG_AVX
+      //Two rows of a_m0 per 256 bit register, each lane against all of a_m1
+      __m256 b0 = _mm256_broadcast_ps((__m128 const *)(a_m1));
+      __m256 b1 = _mm256_broadcast_ps((__m128 const *)(a_m1 + 4));
+      __m256 b2 = _mm256_broadcast_ps((__m128 const *)(a_m1 + 8));
+      __m256 b3 = _mm256_broadcast_ps((__m128 const *)(a_m1 + 12));
+      __m256 a01 = _mm256_loadu_ps(a_m0);
+      __m256 a23 = _mm256_loadu_ps(a_m0 + 8);
+
+      __m256 r01 = _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+      r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+      r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+      r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+
+      __m256 r23 = _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+      r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+      r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+      r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+
+      _mm256_storeu_ps(a_out, r01);
+      _mm256_storeu_ps(a_out + 8, r23);
+#else
+      __m128 r0 = MulRow(Load(a_m0), a_m1);
+      __m128 r1 = MulRow(Load(a_m0 + 4), a_m1);
+      __m128 r2 = MulRow(Load(a_m0 + 8), a_m1);
+      __m128 r3 = MulRow(Load(a_m0 + 12), a_m1);
+      Store(a_out, r0);
+      Store(a_out + 4, r1);
+      Store(a_out + 8, r2);
+      Store(a_out + 12, r3);
+#endif
+    }
+  }
+
+#endif
+
+}
+
+#endif
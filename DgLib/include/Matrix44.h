@@ -53,8 +53,10 @@ namespace Dg
     friend class Quaternion < Real > ;
   public:
     //! Default constructor, initialized to identity matrix.
-    Matrix44() { Identity(); }
-    ~Matrix44() {}
+    Matrix44() { this->Identity(); }
+
+    //! Elements are not initialized. For temporaries that are written in full.
+    explicit Matrix44(NoInitTag) {}
 
     Matrix44(Matrix < 4, 4, Real > const & a_other) : Matrix<4, 4, Real>(a_other){}
     Matrix44& operator=(Matrix < 4, 4, Real > const &);
@@ -196,33 +198,33 @@ namespace Dg
     Quaternion<Real> q;
 
     //Get trace
-    Real tr = m_V[0] + m_V[5] + m_V[10];
+    Real tr = this->m_V[0] + this->m_V[5] + this->m_V[10];
     if (tr > static_cast<Real>(0.0)) {
       Real S = sqrt(tr + static_cast<Real>(1.0)) * static_cast<Real>(2.0); // S=4*q.m_w 
       q.m_w = static_cast<Real>(0.25) * S;
-      q.m_x = (m_V[6] - m_V[9]) / S;
-      q.m_y = (m_V[8] - m_V[2]) / S;
-      q.m_z = (m_V[1] - m_V[4]) / S;
+      q.m_x = (this->m_V[6] - this->m_V[9]) / S;
+      q.m_y = (this->m_V[8] - this->m_V[2]) / S;
+      q.m_z = (this->m_V[1] - this->m_V[4]) / S;
     }
-    else if ((m_V[0] > m_V[5])&(m_V[0] > m_V[10])) {
-      Real S = sqrt(static_cast<Real>(1.0) + m_V[0] - m_V[5] - m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_x 
-      q.m_w = (m_V[6] - m_V[9]) / S;
+    else if ((this->m_V[0] > this->m_V[5])&(this->m_V[0] > this->m_V[10])) {
+      Real S = sqrt(static_cast<Real>(1.0) + this->m_V[0] - this->m_V[5] - this->m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_x 
+      q.m_w = (this->m_V[6] - this->m_V[9]) / S;
       q.m_x = static_cast<Real>(0.25) * S;
-      q.m_y = (m_V[4] + m_V[1]) / S;
-      q.m_z = (m_V[8] + m_V[2]) / S;
+      q.m_y = (this->m_V[4] + this->m_V[1]) / S;
+      q.m_z = (this->m_V[8] + this->m_V[2]) / S;
     }
-    else if (m_V[5] > m_V[10]) {
-      Real S = sqrt(static_cast<Real>(1.0) + m_V[5] - m_V[0] - m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_y
-      q.m_w = (m_V[8] - m_V[2]) / S;
-      q.m_x = (m_V[4] + m_V[1]) / S;
+    else if (this->m_V[5] > this->m_V[10]) {
+      Real S = sqrt(static_cast<Real>(1.0) + this->m_V[5] - this->m_V[0] - this->m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_y
+      q.m_w = (this->m_V[8] - this->m_V[2]) / S;
+      q.m_x = (this->m_V[4] + this->m_V[1]) / S;
       q.m_y = static_cast<Real>(0.25) * S;
-      q.m_z = (m_V[9] + m_V[6]) / S;
+      q.m_z = (this->m_V[9] + this->m_V[6]) / S;
     }
     else {
-      Real S = sqrt(static_cast<Real>(1.0) + m_V[10] - m_V[0] - m_V[5]) * static_cast<Real>(2.0); // S=4*q.m_z
-      q.m_w = (m_V[1] - m_V[4]) / S;
-      q.m_x = (m_V[8] + m_V[2]) / S;
-      q.m_y = (m_V[9] + m_V[6]) / S;
+      Real S = sqrt(static_cast<Real>(1.0) + this->m_V[10] - this->m_V[0] - this->m_V[5]) * static_cast<Real>(2.0); // S=4*q.m_z
+      q.m_w = (this->m_V[1] - this->m_V[4]) / S;
+      q.m_x = (this->m_V[8] + this->m_V[2]) / S;
+      q.m_y = (this->m_V[9] + this->m_V[6]) / S;
       q.m_z = static_cast<Real>(0.25) * S;
     }
 
@@ -277,9 +279,9 @@ namespace Dg
 
     // multiply -translation by inverted 3x3 to get its inverse
 
-    result.m_V[12] = -result.m_V[0] * a_mat.m_V[12] - result.m_V[1] * a_mat.m_V[13] - result.m_V[2] * a_mat.m_V[14];
-    result.m_V[13] = -result.m_V[4] * a_mat.m_V[12] - result.m_V[5] * a_mat.m_V[13] - result.m_V[6] * a_mat.m_V[14];
-    result.m_V[14] = -result.m_V[8] * a_mat.m_V[12] - result.m_V[9] * a_mat.m_V[13] - result.m_V[10] * a_mat.m_V[14];
+    result.m_V[12] = -a_mat.m_V[12] * result.m_V[0] - a_mat.m_V[13] * result.m_V[4] - a_mat.m_V[14] * result.m_V[8];
+    result.m_V[13] = -a_mat.m_V[12] * result.m_V[1] - a_mat.m_V[13] * result.m_V[5] - a_mat.m_V[14] * result.m_V[9];
+    result.m_V[14] = -a_mat.m_V[12] * result.m_V[2] - a_mat.m_V[13] * result.m_V[6] - a_mat.m_V[14] * result.m_V[10];
 
     return result;
 
@@ -292,22 +294,22 @@ namespace Dg
   template<typename Real>
   Matrix44<Real>& Matrix44<Real>::Translation(Matrix<1, 4, Real> const & a_xlate)
   {
-    m_V[0] = static_cast<Real>(1.0);
-    m_V[1] = static_cast<Real>(0.0);
-    m_V[2] = static_cast<Real>(0.0);
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = static_cast<Real>(0.0);
-    m_V[5] = static_cast<Real>(1.0);
-    m_V[6] = static_cast<Real>(0.0);
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = static_cast<Real>(0.0);
-    m_V[9] = static_cast<Real>(0.0);
-    m_V[10] = static_cast<Real>(1.0);
-    m_V[11] = static_cast<Real>(0.0);
-    m_V[12] = a_xlate[0];
-    m_V[13] = a_xlate[1];
-    m_V[14] = a_xlate[2];
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = static_cast<Real>(1.0);
+    this->m_V[1] = static_cast<Real>(0.0);
+    this->m_V[2] = static_cast<Real>(0.0);
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = static_cast<Real>(0.0);
+    this->m_V[5] = static_cast<Real>(1.0);
+    this->m_V[6] = static_cast<Real>(0.0);
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = static_cast<Real>(0.0);
+    this->m_V[9] = static_cast<Real>(0.0);
+    this->m_V[10] = static_cast<Real>(1.0);
+    this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[12] = a_xlate[0];
+    this->m_V[13] = a_xlate[1];
+    this->m_V[14] = a_xlate[2];
+    this->m_V[15] = static_cast<Real>(1.0);
 
     return *this;
 
@@ -333,189 +335,189 @@ namespace Dg
     Real Sz = static_cast<Real>(sin(a_zRotation));
 
 
-    m_V[12] = m_V[13] = m_V[14] = m_V[3] = m_V[7] = m_V[11] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[12] = this->m_V[13] = this->m_V[14] = this->m_V[3] = this->m_V[7] = this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
 
     switch (a_order)
     {
     case EulerOrder::XYZ:
     {
-      m_V[0] = Cy * Cz;
-      m_V[1] = Cy * Sz;
-      m_V[2] = -Sy;
+      this->m_V[0] = Cy * Cz;
+      this->m_V[1] = Cy * Sz;
+      this->m_V[2] = -Sy;
 
-      m_V[4] = (Sx * Sy * Cz) - (Cx * Sz);
-      m_V[5] = (Sx * Sy * Sz) + (Cx * Cz);
-      m_V[6] = Sx * Cy;
+      this->m_V[4] = (Sx * Sy * Cz) - (Cx * Sz);
+      this->m_V[5] = (Sx * Sy * Sz) + (Cx * Cz);
+      this->m_V[6] = Sx * Cy;
 
-      m_V[8] = (Cx * Sy * Cz) + (Sx * Sz);
-      m_V[9] = (Cx * Sy * Sz) - (Sx * Cz);
-      m_V[10] = (Cx * Cy);
+      this->m_V[8] = (Cx * Sy * Cz) + (Sx * Sz);
+      this->m_V[9] = (Cx * Sy * Sz) - (Sx * Cz);
+      this->m_V[10] = (Cx * Cy);
       break;
     }
     case EulerOrder::XZY:
     {
-      m_V[0] = Cy * Cz;
-      m_V[1] = Sz;
-      m_V[2] = -(Sy * Cz);
+      this->m_V[0] = Cy * Cz;
+      this->m_V[1] = Sz;
+      this->m_V[2] = -(Sy * Cz);
 
-      m_V[4] = (Sy * Sx) - (Sz * Cx * Cy);
-      m_V[5] = Cx * Cz;
-      m_V[6] = (Sz * Sy * Cx) + (Sx * Cy);
+      this->m_V[4] = (Sy * Sx) - (Sz * Cx * Cy);
+      this->m_V[5] = Cx * Cz;
+      this->m_V[6] = (Sz * Sy * Cx) + (Sx * Cy);
 
-      m_V[8] = (Sy * Cx) + (Sz * Sx * Cy);
-      m_V[9] = -(Sx * Cz);
-      m_V[10] = (Cx * Cy) - (Sz * Sy * Sx);
+      this->m_V[8] = (Sy * Cx) + (Sz * Sx * Cy);
+      this->m_V[9] = -(Sx * Cz);
+      this->m_V[10] = (Cx * Cy) - (Sz * Sy * Sx);
       break;
     }
     case EulerOrder::YXZ:
     {
-      m_V[0] = (Cy * Cz) - (Sx * Sy * Sz);
-      m_V[1] = (Sz * Cy) + (Sx * Sy * Cz);
-      m_V[2] = -(Sy * Cx);
+      this->m_V[0] = (Cy * Cz) - (Sx * Sy * Sz);
+      this->m_V[1] = (Sz * Cy) + (Sx * Sy * Cz);
+      this->m_V[2] = -(Sy * Cx);
 
-      m_V[4] = -(Sz * Cx);
-      m_V[5] = Cx * Cz;
-      m_V[6] = Sx;
+      this->m_V[4] = -(Sz * Cx);
+      this->m_V[5] = Cx * Cz;
+      this->m_V[6] = Sx;
 
-      m_V[8] = (Sz * Sx * Cy) + (Sy * Cz);
-      m_V[9] = (Sz * Sy) - (Sx * Cy * Cz);
-      m_V[10] = Cx * Cy;
+      this->m_V[8] = (Sz * Sx * Cy) + (Sy * Cz);
+      this->m_V[9] = (Sz * Sy) - (Sx * Cy * Cz);
+      this->m_V[10] = Cx * Cy;
       break;
     }
     case EulerOrder::YZX:
     {
-      m_V[0] = Cy * Cz;
-      m_V[1] = (Sy * Sx) + (Sz * Cx * Cy);
-      m_V[2] = (Sz * Sx * Cy) - (Sy * Cx);
+      this->m_V[0] = Cy * Cz;
+      this->m_V[1] = (Sy * Sx) + (Sz * Cx * Cy);
+      this->m_V[2] = (Sz * Sx * Cy) - (Sy * Cx);
 
-      m_V[4] = -Sz;
-      m_V[5] = Cx * Cz;
-      m_V[6] = Sx * Cz;
+      this->m_V[4] = -Sz;
+      this->m_V[5] = Cx * Cz;
+      this->m_V[6] = Sx * Cz;
 
-      m_V[8] = Sy * Cz;
-      m_V[9] = (Sz * Sy * Cx) - (Sx * Cy);
-      m_V[10] = (Sz * Sy * Sx) + (Cx * Cy);
+      this->m_V[8] = Sy * Cz;
+      this->m_V[9] = (Sz * Sy * Cx) - (Sx * Cy);
+      this->m_V[10] = (Sz * Sy * Sx) + (Cx * Cy);
       break;
     }
     case EulerOrder::ZYX:
     {
-      m_V[0] = Cy * Cz;
-      m_V[1] = (Sz * Cx) + (Sy * Sx * Cz);
-      m_V[2] = (Sz * Sx) - (Sy * Cx * Cz);
+      this->m_V[0] = Cy * Cz;
+      this->m_V[1] = (Sz * Cx) + (Sy * Sx * Cz);
+      this->m_V[2] = (Sz * Sx) - (Sy * Cx * Cz);
 
-      m_V[4] = -(Sz * Cy);
-      m_V[5] = (Cx * Cz) - (Sz * Sy * Sx);
-      m_V[6] = (Sz * Sy * Cx) + (Sx * Cz);
+      this->m_V[4] = -(Sz * Cy);
+      this->m_V[5] = (Cx * Cz) - (Sz * Sy * Sx);
+      this->m_V[6] = (Sz * Sy * Cx) + (Sx * Cz);
 
-      m_V[8] = Sy;
-      m_V[9] = -(Sx * Cy);
-      m_V[10] = Cx * Cy;
+      this->m_V[8] = Sy;
+      this->m_V[9] = -(Sx * Cy);
+      this->m_V[10] = Cx * Cy;
       break;
     }
     case EulerOrder::ZXY:
     {
-      m_V[0] = (Sz * Sy * Sx) + (Cy * Cz);
-      m_V[1] = Sz * Cx;
-      m_V[2] = (Sz * Sx * Cy) - (Sy * Cz);
+      this->m_V[0] = (Sz * Sy * Sx) + (Cy * Cz);
+      this->m_V[1] = Sz * Cx;
+      this->m_V[2] = (Sz * Sx * Cy) - (Sy * Cz);
 
-      m_V[4] = (Sy * Sx * Cz) - (Sz * Cy);
-      m_V[5] = Cx * Cz;
-      m_V[6] = (Sz * Sy) + (Sx * Cy * Cz);
+      this->m_V[4] = (Sy * Sx * Cz) - (Sz * Cy);
+      this->m_V[5] = Cx * Cz;
+      this->m_V[6] = (Sz * Sy) + (Sx * Cy * Cz);
 
-      m_V[8] = Sy * Cx;
-      m_V[9] = -Sx;
-      m_V[10] = Cx * Cy;
+      this->m_V[8] = Sy * Cx;
+      this->m_V[9] = -Sx;
+      this->m_V[10] = Cx * Cy;
       break;
     }
     case EulerOrder::XYX:
     {
-      m_V[0] = Cy;
-      m_V[1] = Sy * Sx;
-      m_V[2] = -Sy * Cx;
+      this->m_V[0] = Cy;
+      this->m_V[1] = Sy * Sx;
+      this->m_V[2] = -Sy * Cx;
 
-      m_V[4] = Sy * Sx;
-      m_V[5] = (Cx * Cx) - (Sx * Sx * Cy);
-      m_V[6] = (Sx * Cx) + (Sx * Cy * Cx);
+      this->m_V[4] = Sy * Sx;
+      this->m_V[5] = (Cx * Cx) - (Sx * Sx * Cy);
+      this->m_V[6] = (Sx * Cx) + (Sx * Cy * Cx);
 
-      m_V[8] = Sy * Cx;
-      m_V[9] = -(Sx * Cx) - (Sx * Cy * Cx);
-      m_V[10] = (Cx * Cx * Cy) - (Sx * Sx);
+      this->m_V[8] = Sy * Cx;
+      this->m_V[9] = -(Sx * Cx) - (Sx * Cy * Cx);
+      this->m_V[10] = (Cx * Cx * Cy) - (Sx * Sx);
       break;
     }
     case EulerOrder::XZX:
     {
-      m_V[0] = Cy;
-      m_V[1] = Sy * Cz;
-      m_V[2] = Sz * Sy;
+      this->m_V[0] = Cy;
+      this->m_V[1] = Sy * Cz;
+      this->m_V[2] = Sz * Sy;
 
-      m_V[4] = -(Sy * Cx);
-      m_V[5] = (Cx * Cy * Cz) - (Sz * Sx);
-      m_V[6] = (Sx * Cz) + (Sz * Cy * Cx);
+      this->m_V[4] = -(Sy * Cx);
+      this->m_V[5] = (Cx * Cy * Cz) - (Sz * Sx);
+      this->m_V[6] = (Sx * Cz) + (Sz * Cy * Cx);
 
-      m_V[8] = (Sy * Sx);
-      m_V[9] = -(Sz * Cx) - (Sx * Cz * Cy);
-      m_V[10] = (Cx * Cz) - (Sz * Sx * Cy);
+      this->m_V[8] = (Sy * Sx);
+      this->m_V[9] = -(Sz * Cx) - (Sx * Cz * Cy);
+      this->m_V[10] = (Cx * Cz) - (Sz * Sx * Cy);
       break;
     }
     case EulerOrder::YXY:
     {
-      m_V[0] = (Cx * Cz) - (Sz * Sx * Cy);
-      m_V[1] = Sy * Sx;
-      m_V[2] = -(Sz * Cx) - (Sx * Cy * Cz);
+      this->m_V[0] = (Cx * Cz) - (Sz * Sx * Cy);
+      this->m_V[1] = Sy * Sx;
+      this->m_V[2] = -(Sz * Cx) - (Sx * Cy * Cz);
 
-      m_V[4] = Sz * Sy;
-      m_V[5] = Cy;
-      m_V[6] = Sy * Cz;
+      this->m_V[4] = Sz * Sy;
+      this->m_V[5] = Cy;
+      this->m_V[6] = Sy * Cz;
 
-      m_V[8] = (Sz * Cx * Cy) + (Sx * Cz);
-      m_V[9] = -(Sy * Cx);
-      m_V[10] = (Cx * Cy * Cz) - (Sz * Sx);
+      this->m_V[8] = (Sz * Cx * Cy) + (Sx * Cz);
+      this->m_V[9] = -(Sy * Cx);
+      this->m_V[10] = (Cx * Cy * Cz) - (Sz * Sx);
       break;
     }
     case EulerOrder::YZY:
     {
-      m_V[0] = (Cx * Cy * Cz) - (Sz * Sx);
-      m_V[1] = Sy * Cx;
-      m_V[2] = -(Sz * Cx * Cy) - (Sx * Cz);
+      this->m_V[0] = (Cx * Cy * Cz) - (Sz * Sx);
+      this->m_V[1] = Sy * Cx;
+      this->m_V[2] = -(Sz * Cx * Cy) - (Sx * Cz);
 
-      m_V[4] = -(Sy * Cz);
-      m_V[5] = Cy;
-      m_V[6] = Sz * Sy;
+      this->m_V[4] = -(Sy * Cz);
+      this->m_V[5] = Cy;
+      this->m_V[6] = Sz * Sy;
 
-      m_V[8] = (Sz * Cx) + (Sx * Cy * Cz);
-      m_V[9] = Sy * Sx;
-      m_V[10] = (Cx * Cz) - (Sz * Sx * Cy);
+      this->m_V[8] = (Sz * Cx) + (Sx * Cy * Cz);
+      this->m_V[9] = Sy * Sx;
+      this->m_V[10] = (Cx * Cz) - (Sz * Sx * Cy);
       break;
     }
     case EulerOrder::ZXZ:
     {
-      m_V[0] = (Cx * Cz) - (Sz * Sx * Cy);
-      m_V[1] = (Sz * Cx) + (Sx * Cy * Cz);
-      m_V[2] = Sy * Sx;
+      this->m_V[0] = (Cx * Cz) - (Sz * Sx * Cy);
+      this->m_V[1] = (Sz * Cx) + (Sx * Cy * Cz);
+      this->m_V[2] = Sy * Sx;
 
-      m_V[4] = -(Sz * Cx * Cy) - (Sx * Cz);
-      m_V[5] = (Cx * Cy * Cz) - (Sz * Sx);
-      m_V[6] = Sy * Cx;
+      this->m_V[4] = -(Sz * Cx * Cy) - (Sx * Cz);
+      this->m_V[5] = (Cx * Cy * Cz) - (Sz * Sx);
+      this->m_V[6] = Sy * Cx;
 
-      m_V[8] = Sz * Sy;
-      m_V[9] = -(Sy * Cz);
-      m_V[10] = Cy;
+      this->m_V[8] = Sz * Sy;
+      this->m_V[9] = -(Sy * Cz);
+      this->m_V[10] = Cy;
       break;
     }
     case EulerOrder::ZYZ:
     {
-      m_V[0] = (Cx * Cy * Cz) - (Sz * Sx);
-      m_V[1] = (Sz * Cx * Cy) + (Sx * Cz);
-      m_V[2] = -(Sy * Cx);
+      this->m_V[0] = (Cx * Cy * Cz) - (Sz * Sx);
+      this->m_V[1] = (Sz * Cx * Cy) + (Sx * Cz);
+      this->m_V[2] = -(Sy * Cx);
 
-      m_V[4] = -(Sz * Cx) - (Sx * Cy * Cz);
-      m_V[5] = (Cx * Cz) - (Sz * Sx * Cy);
-      m_V[6] = Sy * Sx;
+      this->m_V[4] = -(Sz * Cx) - (Sx * Cy * Cz);
+      this->m_V[5] = (Cx * Cz) - (Sz * Sx * Cy);
+      this->m_V[6] = Sy * Sx;
 
-      m_V[8] = Sy * Cz;
-      m_V[9] = Sz * Sy;
-      m_V[10] = Cy;
+      this->m_V[8] = Sy * Cz;
+      this->m_V[9] = Sz * Sy;
+      this->m_V[10] = Cy;
       break;
     }
     }
@@ -544,18 +546,18 @@ namespace Dg
     Real x1Sin = a_axis[1] * sn;
     Real x2Sin = a_axis[2] * sn;
 
-    m_V[0] = x0sqr*oneMinusCos + cs;
-    m_V[4] = x0x1m - x2Sin;
-    m_V[8] = x0x2m + x1Sin;
-    m_V[1] = x0x1m + x2Sin;
-    m_V[5] = x1sqr*oneMinusCos + cs;
-    m_V[9] = x1x2m - x0Sin;
-    m_V[2] = x0x2m - x1Sin;
-    m_V[6] = x1x2m + x0Sin;
-    m_V[10] = x2sqr*oneMinusCos + cs;
-
-    m_V[3] = m_V[7] = m_V[11] = m_V[12] = m_V[13] = m_V[14] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = x0sqr*oneMinusCos + cs;
+    this->m_V[4] = x0x1m - x2Sin;
+    this->m_V[8] = x0x2m + x1Sin;
+    this->m_V[1] = x0x1m + x2Sin;
+    this->m_V[5] = x1sqr*oneMinusCos + cs;
+    this->m_V[9] = x1x2m - x0Sin;
+    this->m_V[2] = x0x2m - x1Sin;
+    this->m_V[6] = x1x2m + x0Sin;
+    this->m_V[10] = x2sqr*oneMinusCos + cs;
+
+    this->m_V[3] = this->m_V[7] = this->m_V[11] = this->m_V[12] = this->m_V[13] = this->m_V[14] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
     return *this;
 
   }  // End: Matrix44::Rotation()
@@ -584,22 +586,22 @@ namespace Dg
     yz = a_rotate.m_y * zs;
     zz = a_rotate.m_z * zs;
 
-    m_V[0] = static_cast<Real>(1.0) - (yy + zz);
-    m_V[1] = xy + wz;
-    m_V[2] = xz - wy;
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = xy - wz;
-    m_V[5] = static_cast<Real>(1.0) - (xx + zz);
-    m_V[6] = yz + wx;
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = xz + wy;
-    m_V[9] = yz - wx;
-    m_V[10] = static_cast<Real>(1.0) - (xx + yy);
-    m_V[11] = static_cast<Real>(0.0);
-    m_V[12] = static_cast<Real>(0.0);
-    m_V[13] = static_cast<Real>(0.0);
-    m_V[14] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = static_cast<Real>(1.0) - (yy + zz);
+    this->m_V[1] = xy + wz;
+    this->m_V[2] = xz - wy;
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = xy - wz;
+    this->m_V[5] = static_cast<Real>(1.0) - (xx + zz);
+    this->m_V[6] = yz + wx;
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = xz + wy;
+    this->m_V[9] = yz - wx;
+    this->m_V[10] = static_cast<Real>(1.0) - (xx + yy);
+    this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[12] = static_cast<Real>(0.0);
+    this->m_V[13] = static_cast<Real>(0.0);
+    this->m_V[14] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
 
     return *this;
 
@@ -612,22 +614,22 @@ namespace Dg
   template<typename Real>
   Matrix44<Real>& Matrix44<Real>::Scaling(Matrix<1, 4, Real> const & a_scaleFactors)
   {
-    m_V[0] = a_scaleFactors[0];
-    m_V[1] = static_cast<Real>(0.0);
-    m_V[2] = static_cast<Real>(0.0);
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = static_cast<Real>(0.0);
-    m_V[5] = a_scaleFactors[1];
-    m_V[6] = static_cast<Real>(0.0);
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = static_cast<Real>(0.0);
-    m_V[9] = static_cast<Real>(0.0);
-    m_V[10] = a_scaleFactors[2];
-    m_V[11] = static_cast<Real>(0.0);
-    m_V[12] = static_cast<Real>(0.0);
-    m_V[13] = static_cast<Real>(0.0);
-    m_V[14] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = a_scaleFactors[0];
+    this->m_V[1] = static_cast<Real>(0.0);
+    this->m_V[2] = static_cast<Real>(0.0);
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = static_cast<Real>(0.0);
+    this->m_V[5] = a_scaleFactors[1];
+    this->m_V[6] = static_cast<Real>(0.0);
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = static_cast<Real>(0.0);
+    this->m_V[9] = static_cast<Real>(0.0);
+    this->m_V[10] = a_scaleFactors[2];
+    this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[12] = static_cast<Real>(0.0);
+    this->m_V[13] = static_cast<Real>(0.0);
+    this->m_V[14] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
 
     return *this;
 
@@ -640,22 +642,22 @@ namespace Dg
   template<typename Real>
   Matrix44<Real>& Matrix44<Real>::Scaling(Real a_val)
   {
-    m_V[0] = a_val;
-    m_V[1] = static_cast<Real>(0.0);
-    m_V[2] = static_cast<Real>(0.0);
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = static_cast<Real>(0.0);
-    m_V[5] = a_val;
-    m_V[6] = static_cast<Real>(0.0);
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = static_cast<Real>(0.0);
-    m_V[9] = static_cast<Real>(0.0);
-    m_V[10] = a_val;
-    m_V[11] = static_cast<Real>(0.0);
-    m_V[12] = static_cast<Real>(0.0);
-    m_V[13] = static_cast<Real>(0.0);
-    m_V[14] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = a_val;
+    this->m_V[1] = static_cast<Real>(0.0);
+    this->m_V[2] = static_cast<Real>(0.0);
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = static_cast<Real>(0.0);
+    this->m_V[5] = a_val;
+    this->m_V[6] = static_cast<Real>(0.0);
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = static_cast<Real>(0.0);
+    this->m_V[9] = static_cast<Real>(0.0);
+    this->m_V[10] = a_val;
+    this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[12] = static_cast<Real>(0.0);
+    this->m_V[13] = static_cast<Real>(0.0);
+    this->m_V[14] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
 
     return *this;
 
@@ -671,22 +673,22 @@ namespace Dg
     Real sintheta = Real(sin(a_angle));
     Real costheta = Real(cos(a_angle));
 
-    m_V[0] = static_cast<Real>(1.0);
-    m_V[1] = static_cast<Real>(0.0);
-    m_V[2] = static_cast<Real>(0.0);
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = static_cast<Real>(0.0);
-    m_V[5] = costheta;
-    m_V[6] = sintheta;
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = static_cast<Real>(0.0);
-    m_V[9] = -sintheta;
-    m_V[10] = costheta;
-    m_V[11] = static_cast<Real>(0.0);
-    m_V[12] = static_cast<Real>(0.0);
-    m_V[13] = static_cast<Real>(0.0);
-    m_V[14] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = static_cast<Real>(1.0);
+    this->m_V[1] = static_cast<Real>(0.0);
+    this->m_V[2] = static_cast<Real>(0.0);
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = static_cast<Real>(0.0);
+    this->m_V[5] = costheta;
+    this->m_V[6] = sintheta;
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = static_cast<Real>(0.0);
+    this->m_V[9] = -sintheta;
+    this->m_V[10] = costheta;
+    this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[12] = static_cast<Real>(0.0);
+    this->m_V[13] = static_cast<Real>(0.0);
+    this->m_V[14] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
 
     return *this;
 
@@ -702,22 +704,22 @@ namespace Dg
     Real sintheta = Real(sin(a_angle));
     Real costheta = Real(cos(a_angle));
 
-    m_V[0] = costheta;
-    m_V[1] = static_cast<Real>(0.0);
-    m_V[2] = -sintheta;
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = static_cast<Real>(0.0);
-    m_V[5] = static_cast<Real>(1.0);
-    m_V[6] = static_cast<Real>(0.0);
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = sintheta;
-    m_V[9] = static_cast<Real>(0.0);
-    m_V[10] = costheta;
-    m_V[11] = static_cast<Real>(0.0);
-    m_V[12] = static_cast<Real>(0.0);
-    m_V[13] = static_cast<Real>(0.0);
-    m_V[14] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = costheta;
+    this->m_V[1] = static_cast<Real>(0.0);
+    this->m_V[2] = -sintheta;
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = static_cast<Real>(0.0);
+    this->m_V[5] = static_cast<Real>(1.0);
+    this->m_V[6] = static_cast<Real>(0.0);
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = sintheta;
+    this->m_V[9] = static_cast<Real>(0.0);
+    this->m_V[10] = costheta;
+    this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[12] = static_cast<Real>(0.0);
+    this->m_V[13] = static_cast<Real>(0.0);
+    this->m_V[14] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
 
     return *this;
 
@@ -733,22 +735,22 @@ namespace Dg
     Real sintheta = Real(sin(a_angle));
     Real costheta = Real(cos(a_angle));
 
-    m_V[0] = costheta;
-    m_V[1] = sintheta;
-    m_V[2] = static_cast<Real>(0.0);
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = -sintheta;
-    m_V[5] = costheta;
-    m_V[6] = static_cast<Real>(0.0);
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = static_cast<Real>(0.0);
-    m_V[9] = static_cast<Real>(0.0);
-    m_V[10] = static_cast<Real>(1.0);
-    m_V[11] = static_cast<Real>(0.0);
-    m_V[12] = static_cast<Real>(0.0);
-    m_V[13] = static_cast<Real>(0.0);
-    m_V[14] = static_cast<Real>(0.0);
-    m_V[15] = static_cast<Real>(1.0);
+    this->m_V[0] = costheta;
+    this->m_V[1] = sintheta;
+    this->m_V[2] = static_cast<Real>(0.0);
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = -sintheta;
+    this->m_V[5] = costheta;
+    this->m_V[6] = static_cast<Real>(0.0);
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = static_cast<Real>(0.0);
+    this->m_V[9] = static_cast<Real>(0.0);
+    this->m_V[10] = static_cast<Real>(1.0);
+    this->m_V[11] = static_cast<Real>(0.0);
+    this->m_V[12] = static_cast<Real>(0.0);
+    this->m_V[13] = static_cast<Real>(0.0);
+    this->m_V[14] = static_cast<Real>(0.0);
+    this->m_V[15] = static_cast<Real>(1.0);
 
     return *this;
 
@@ -769,22 +771,22 @@ namespace Dg
     Real B = (a_near + a_far) / (a_near - a_far);
     Real C = (static_cast<Real>(2.0) * a_near * a_far) / (a_near - a_far);
 
-    m_V[0] = A;
-    m_V[1] = static_cast<Real>(0.0);
-    m_V[2] = static_cast<Real>(0.0);
-    m_V[3] = static_cast<Real>(0.0);
-    m_V[4] = static_cast<Real>(0.0);
-    m_V[5] = d;
-    m_V[6] = static_cast<Real>(0.0);
-    m_V[7] = static_cast<Real>(0.0);
-    m_V[8] = static_cast<Real>(0.0);
-    m_V[9] = static_cast<Real>(0.0);
-    m_V[10] = B;
-    m_V[11] = static_cast<Real>(-1.0);
-    m_V[12] = static_cast<Real>(0.0);
-    m_V[13] = static_cast<Real>(0.0);
-    m_V[14] = C;
-    m_V[15] = static_cast<Real>(0.0);
+    this->m_V[0] = A;
+    this->m_V[1] = static_cast<Real>(0.0);
+    this->m_V[2] = static_cast<Real>(0.0);
+    this->m_V[3] = static_cast<Real>(0.0);
+    this->m_V[4] = static_cast<Real>(0.0);
+    this->m_V[5] = d;
+    this->m_V[6] = static_cast<Real>(0.0);
+    this->m_V[7] = static_cast<Real>(0.0);
+    this->m_V[8] = static_cast<Real>(0.0);
+    this->m_V[9] = static_cast<Real>(0.0);
+    this->m_V[10] = B;
+    this->m_V[11] = static_cast<Real>(-1.0);
+    this->m_V[12] = static_cast<Real>(0.0);
+    this->m_V[13] = static_cast<Real>(0.0);
+    this->m_V[14] = C;
+    this->m_V[15] = static_cast<Real>(0.0);
 
     return *this;
   }	//End: Matrix44::Perspective()
@@ -797,36 +799,86 @@ namespace Dg
   void Matrix44<Real>::GetQuaternion(Quaternion<Real>& a_out) const
   {
     //Get trace
-    Real tr = m_V[0] + m_V[5] + m_V[10];
+    Real tr = this->m_V[0] + this->m_V[5] + this->m_V[10];
     if (tr > static_cast<Real>(0.0)) {
       Real S = sqrt(tr + static_cast<Real>(1.0)) * static_cast<Real>(2.0); // S=4*q.m_w 
       a_out.m_w = static_cast<Real>(0.25) * S;
-      a_out.m_x = (m_V[6] - m_V[9]) / S;
-      a_out.m_y = (m_V[8] - m_V[2]) / S;
-      a_out.m_z = (m_V[1] - m_V[4]) / S;
+      a_out.m_x = (this->m_V[6] - this->m_V[9]) / S;
+      a_out.m_y = (this->m_V[8] - this->m_V[2]) / S;
+      a_out.m_z = (this->m_V[1] - this->m_V[4]) / S;
     }
-    else if ((m_V[0] > m_V[5])&(m_V[0] > m_V[10])) {
-      Real S = sqrt(static_cast<Real>(1.0) + m_V[0] - m_V[5] - m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_x 
-      a_out.m_w = (m_V[6] - m_V[9]) / S;
+    else if ((this->m_V[0] > this->m_V[5])&(this->m_V[0] > this->m_V[10])) {
+      Real S = sqrt(static_cast<Real>(1.0) + this->m_V[0] - this->m_V[5] - this->m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_x 
+      a_out.m_w = (this->m_V[6] - this->m_V[9]) / S;
       a_out.m_x = static_cast<Real>(0.25) * S;
-      a_out.m_y = (m_V[4] + m_V[1]) / S;
-      a_out.m_z = (m_V[8] + m_V[2]) / S;
+      a_out.m_y = (this->m_V[4] + this->m_V[1]) / S;
+      a_out.m_z = (this->m_V[8] + this->m_V[2]) / S;
     }
-    else if (m_V[5] > m_V[10]) {
-      Real S = sqrt(static_cast<Real>(1.0) + m_V[5] - m_V[0] - m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_y
-      a_out.m_w = (m_V[8] - m_V[2]) / S;
-      a_out.m_x = (m_V[4] + m_V[1]) / S;
+    else if (this->m_V[5] > this->m_V[10]) {
+      Real S = sqrt(static_cast<Real>(1.0) + this->m_V[5] - this->m_V[0] - this->m_V[10]) * static_cast<Real>(2.0); // S=4*q.m_y
+      a_out.m_w = (this->m_V[8] - this->m_V[2]) / S;
+      a_out.m_x = (this->m_V[4] + this->m_V[1]) / S;
       a_out.m_y = static_cast<Real>(0.25) * S;
-      a_out.m_z = (m_V[9] + m_V[6]) / S;
+      a_out.m_z = (this->m_V[9] + this->m_V[6]) / S;
     }
     else {
-      Real S = sqrt(static_cast<Real>(1.0) + m_V[10] - m_V[0] - m_V[5]) * static_cast<Real>(2.0); // S=4*q.m_z
-      a_out.m_w = (m_V[1] - m_V[4]) / S;
-      a_out.m_x = (m_V[8] + m_V[2]) / S;
-      a_out.m_y = (m_V[9] + m_V[6]) / S;
+      Real S = sqrt(static_cast<Real>(1.0) + this->m_V[10] - this->m_V[0] - this->m_V[5]) * static_cast<Real>(2.0); // S=4*q.m_z
+      a_out.m_w = (this->m_V[1] - this->m_V[4]) / S;
+      a_out.m_x = (this->m_V[8] + this->m_V[2]) / S;
+      a_out.m_y = (this->m_V[9] + this->m_V[6]) / S;
       a_out.m_z = static_cast<Real>(0.25) * S;
     }
   } // End: Matrix44::GetQuaternion()
 
+#ifdef DG_SSE
+
+  //--------------------------------------------------------------------------------
+  //	@	AffineInverse() SSE specialization
+  //--------------------------------------------------------------------------------
+  template<>
+  inline Matrix44<float> AffineInverse<float>(Matrix44<float> const & a_mat)
+  {
+    Matrix44<float> result(NoInit);
+
+    __m128 r0 = SSE::Load(a_mat.m_V);
+    __m128 r1 = SSE::Load(a_mat.m_V + 4);
+    __m128 r2 = SSE::Load(a_mat.m_V + 8);
+
+    //The columns of the adjugate of the upper 3x3 are cross products of its rows
+    __m128 c0 = SSE::Cross(r1, r2);
+    __m128 c1 = SSE::Cross(r2, r0);
+    __m128 c2 = SSE::Cross(r0, r1);
+    __m128 c3 = _mm_setzero_ps();
+
+    float det = _mm_cvtss_f32(SSE::Dot(r0, c0));
+    if (Dg::IsZero(det))
+    {
+      result.Identity();
+      return result;
+    }
+
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), _mm_set1_ps(det));
+    c0 = _mm_mul_ps(c0, invDet);
+    c1 = _mm_mul_ps(c1, invDet);
+    c2 = _mm_mul_ps(c2, invDet);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    //Translation is -p * inverse(upper 3x3)
+    __m128 p = SSE::Load(a_mat.m_V + 12);
+    __m128 t = _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)), c0);
+    t = _mm_add_ps(t, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)), c1));
+    t = _mm_add_ps(t, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)), c2));
+    t = _mm_sub_ps(_mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f), t);
+
+    SSE::Store(result.m_V, c0);
+    SSE::Store(result.m_V + 4, c1);
+    SSE::Store(result.m_V + 8, c2);
+    SSE::Store(result.m_V + 12, t);
+    return result;
+
+  }	//End: ::AffineInverse()
+
+#endif
+
 }
 #endif
\ No newline at end of file
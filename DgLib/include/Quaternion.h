@@ -88,7 +88,6 @@ namespace Dg
     Quaternion() : m_w(static_cast<Real>(1.0)), m_x(static_cast<Real>(0.0)), m_y(static_cast<Real>(0.0)), m_z(static_cast<Real>(0.0)) {}
     Quaternion(Real a_w, Real a_x, Real a_y, Real a_z) :
       m_w(a_w), m_x(a_x), m_y(a_y), m_z(a_z) {}
-    ~Quaternion() {}
 
     //! Construct quaternion based on axis-angle.
     Quaternion(const Vector4<Real>& axis, Real angle);
@@ -99,8 +98,8 @@ namespace Dg
     //! Construct quaternion from vector elements.
     explicit Quaternion(const Vector4<Real>&);
 
-    Quaternion(const Quaternion&);
-    Quaternion& operator=(const Quaternion&);
+    Quaternion(const Quaternion&) = default;
+    Quaternion& operator=(const Quaternion&) = default;
 
     //! Accessor member by index
     Real& operator[](unsigned int a_i)         { return (&m_w)[a_i]; }
@@ -308,33 +307,6 @@ namespace Dg
   }   // End of Quaternion::Quaternion()
 
 
-  //-------------------------------------------------------------------------------
-  //	@	Quaternion::Quaternion()
-  //-------------------------------------------------------------------------------
-  template<typename Real>
-  Quaternion<Real>::Quaternion(const Quaternion<Real>& a_other) :
-    m_w(a_other.m_w), m_x(a_other.m_x), m_y(a_other.m_y), m_z(a_other.m_z)
-  {
-
-  }   // End of Quaternion::Quaternion()
-
-
-  //-------------------------------------------------------------------------------
-  //	@	Quaternion::operator=()
-  //-------------------------------------------------------------------------------
-  template<typename Real>
-  Quaternion<Real>& Quaternion<Real>::operator=(const Quaternion<Real>& a_other)
-  {
-    m_w = a_other.m_w;
-    m_x = a_other.m_x;
-    m_y = a_other.m_y;
-    m_z = a_other.m_z;
-
-    return *this;
-
-  }   // End of Quaternion::operator=()
-
-
   //-------------------------------------------------------------------------------
   //	@	Quaternion::Magnitude()
   //-------------------------------------------------------------------------------
@@ -107,7 +107,7 @@ namespace Dg
   Dg_Result ResourceManager::RegisterResource(RKey a_key, 
                                               uint32_t a_options)
   {
-    if (a_key != RKey_INVALID)
+    if (a_key == RKey_INVALID)
     {
       return DgR_Failure;
     }
@@ -127,6 +127,7 @@ namespace Dg
     {
       if (rc.m_resource->Init() != DgR_Success)
       {
+        delete rc.m_resource;
         return DgR_Failure;
       }
     }
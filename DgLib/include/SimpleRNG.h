@@ -7,6 +7,7 @@
 
 #ifndef RANDOMBASE_H
 #define RANDOMBASE_H
+#include <cmath>
 
 namespace Dg
 {
@@ -18,6 +19,9 @@ namespace Dg
   //! @brief A simple random number generator.
   //! Original code by John D. Cook
   //!
+  //! The state is static and shared by every instance, so it is not thread
+  //! safe. Multi-threaded samplers should use a Dg::RNG per thread (DgRNG.h).
+  //!
   //! @author Frank Hart
   //! @date 4/8/2015
   class SimpleRNG
@@ -127,7 +131,7 @@ namespace Dg
   template<class Real>
   Real SimpleRNG::GetNormal(Real mean, Real std)
   {
-    if (standardDeviation <= Real(0.0))
+    if (std <= Real(0.0))
     {
       return mean;
     }
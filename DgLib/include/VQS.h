@@ -50,11 +50,10 @@ namespace Dg
             m_s(static_cast<Real>(1.0)) {m_v.Zero();}
     VQS(Vector4<Real> const & a_v, Quaternion<Real> const & a_q, Real a_s) :
       m_v(a_v), m_q(a_q), m_s(a_s) {}
-    ~VQS() {}
 
     //Copy operations
-    VQS(VQS<Real> const & a_other) : m_v(a_other.m_v), m_q(a_other.m_q), m_s(a_other.m_s) {}
-    VQS<Real>& operator=(VQS<Real> const &);
+    VQS(VQS<Real> const &) = default;
+    VQS<Real>& operator=(VQS<Real> const &) = default;
 
     //Comparison
     bool operator==(VQS<Real> const & a_other) const;
@@ -87,16 +86,16 @@ namespace Dg
     VQS<Real>& operator*= (VQS<Real> const &);
 
     //! Point transformations also apply translation.
-    Vector4<Real> TransformPoint(Vector4<Real> const &);
+    Vector4<Real> TransformPoint(Vector4<Real> const &) const;
 
     //! Vector transformations do not apply translation.
-    Vector4<Real> TransformVector(Vector4<Real> const &);
+    Vector4<Real> TransformVector(Vector4<Real> const &) const;
 
     //! Point transformations also apply translation.
-    Vector4<Real>& TransformPointSelf(Vector4<Real>&);
+    Vector4<Real>& TransformPointSelf(Vector4<Real>&) const;
 
     //! Vector transformations do not apply translation.
-    Vector4<Real>& TransformVectorSelf(Vector4<Real>&);
+    Vector4<Real>& TransformVectorSelf(Vector4<Real>&) const;
 
     //! Apply translation to Vector4.
     Vector4<Real> Translate(Vector4<Real> const &) const;
@@ -145,9 +144,10 @@ namespace Dg
   template<typename Real>
   void VQS<Real>::Set(Matrix44<Real> const & a_m)
   {
-    m_v.m_x = a_m[12];
-    m_v.m_y = a_m[13];
-    m_v.m_z = a_m[14];
+    m_v.m_V[0] = a_m[12];
+    m_v.m_V[1] = a_m[13];
+    m_v.m_V[2] = a_m[14];
+    m_v.m_V[3] = static_cast<Real>(0.0);
 
     a_m.GetQuaternion(m_q);
 
@@ -201,7 +201,7 @@ namespace Dg
   void VQS<Real>::UpdateV(Vector4<Real> const & a_v)
   {
     m_v += a_v;
-    m_v.m_w = static_cast<Real>(0.0);
+    m_v.m_V[3] = static_cast<Real>(0.0);
 
   }	//End: VQS<Real>::UpdateV()
 
@@ -256,21 +256,6 @@ namespace Dg
   }	//End: VQS<Real>::operator!=();
 
 
-  //--------------------------------------------------------------------------------
-  //	@	VQS<Real>::operator=()
-  //--------------------------------------------------------------------------------
-  template<typename Real>
-  VQS<Real>& VQS<Real>::operator=(VQS<Real> const & a_other)
-  {
-    m_v = a_other.m_v;
-    m_q = a_other.m_q;
-    m_s = a_other.m_s;
-
-    return *this;
-
-  }	//End: VQS<Real>::operator=();
-
-
   //--------------------------------------------------------------------------------
   //	@	VQS<Real>::MakeValid
   //--------------------------------------------------------------------------------
@@ -309,14 +294,14 @@ namespace Dg
   //	@	TransformPoint()
   //--------------------------------------------------------------------------------
   template<typename Real>
-  Vector4<Real> VQS<Real>::TransformPoint(Vector4<Real> const & a_v)
+  Vector4<Real> VQS<Real>::TransformPoint(Vector4<Real> const & a_v) const
   {
     Vector4<Real> result(a_v);
 
     //Scale
-    result.m_x *= m_s;
-    result.m_y *= m_s;
-    result.m_z *= m_s;
+    result.m_V[0] *= m_s;
+    result.m_V[1] *= m_s;
+    result.m_V[2] *= m_s;
 
     //Rotate;
     m_q.RotateSelf(result);
@@ -333,12 +318,12 @@ namespace Dg
   //	@	TransformPointSelf()
   //--------------------------------------------------------------------------------
   template<typename Real>
-  Vector4<Real>& VQS<Real>::TransformPointSelf(Vector4<Real> & a_v)
+  Vector4<Real>& VQS<Real>::TransformPointSelf(Vector4<Real> & a_v) const
   {
     //Scale
-    a_v.m_x *= m_s;
-    a_v.m_y *= m_s;
-    a_v.m_z *= m_s;
+    a_v.m_V[0] *= m_s;
+    a_v.m_V[1] *= m_s;
+    a_v.m_V[2] *= m_s;
 
     //Rotate;
     m_q.RotateSelf(a_v);
@@ -355,7 +340,7 @@ namespace Dg
   //	@	TransformVector()
   //--------------------------------------------------------------------------------
   template<typename Real>
-  Vector4<Real> VQS<Real>::TransformVector(Vector4<Real> const & a_v)
+  Vector4<Real> VQS<Real>::TransformVector(Vector4<Real> const & a_v) const
   {
     Vector4<Real> result(a_v);
 
@@ -376,12 +361,12 @@ namespace Dg
   //	@	TransformVectorSelf()
   //--------------------------------------------------------------------------------
   template<typename Real>
-  Vector4<Real>& VQS<Real>::TransformVectorSelf(Vector4<Real> & a_v)
+  Vector4<Real>& VQS<Real>::TransformVectorSelf(Vector4<Real> & a_v) const
   {
     //Scale
-    a_v.m_x *= m_s;
-    a_v.m_y *= m_s;
-    a_v.m_z *= m_s;
+    a_v.m_V[0] *= m_s;
+    a_v.m_V[1] *= m_s;
+    a_v.m_V[2] *= m_s;
 
     //Rotate;
     m_q.RotateSelf(a_v);
@@ -429,9 +414,9 @@ namespace Dg
   {
     Vector4<Real> result(a_v);
 
-    result.m_x *= m_s;
-    result.m_y *= m_s;
-    result.m_z *= m_s;
+    result.m_V[0] *= m_s;
+    result.m_V[1] *= m_s;
+    result.m_V[2] *= m_s;
 
     return result;
 
@@ -444,9 +429,9 @@ namespace Dg
   template<typename Real>
   void VQS<Real>::TranslateSelf(Vector4<Real>& a_v) const
   {
-    a_v.x += m_v.x;
-    a_v.y += m_v.y;
-    a_v.z += m_v.z;
+    a_v.m_V[0] += m_v.m_V[0];
+    a_v.m_V[1] += m_v.m_V[1];
+    a_v.m_V[2] += m_v.m_V[2];
 
   }	//End: VQS<Real>::TranslateSelf()
 
@@ -470,9 +455,9 @@ namespace Dg
   void VQS<Real>::ScaleSelf(Vector4<Real>& a_v) const
   {
     //Scale
-    a_v.x *= m_s;
-    a_v.y *= m_s;
-    pa_v.z *= m_s;
+    a_v.m_V[0] *= m_s;
+    a_v.m_V[1] *= m_s;
+    a_v.m_V[2] *= m_s;
 
   }	//End: VQS<Real>::ScaleSelf()
 
@@ -517,19 +502,20 @@ namespace Dg
   {
     a_out.Rotation(m_q);
 
-    a_out.m_V[0] *= m_s;
-    a_out.m_V[1] *= m_s;
-    a_out.m_V[2] *= m_s;
-    a_out.m_V[4] *= m_s;
-    a_out.m_V[5] *= m_s;
-    a_out.m_V[6] *= m_s;
-    a_out.m_V[8] *= m_s;
-    a_out.m_V[9] *= m_s;
-    a_out.m_V[10] *= m_s;
-
-    a_out.m_V[12] = m_v.m_x *= m_s;
-    a_out.m_V[13] = m_v.m_y *= m_s;
-    a_out.m_V[14] = m_v.m_z *= m_s;
+    a_out[0] *= m_s;
+    a_out[1] *= m_s;
+    a_out[2] *= m_s;
+    a_out[4] *= m_s;
+    a_out[5] *= m_s;
+    a_out[6] *= m_s;
+    a_out[8] *= m_s;
+    a_out[9] *= m_s;
+    a_out[10] *= m_s;
+
+    //Translation is applied after scaling, so is not scaled itself
+    a_out[12] = m_v.m_V[0];
+    a_out[13] = m_v.m_V[1];
+    a_out[14] = m_v.m_V[2];
 
   }	//End: VQS<Real>::Get()
 
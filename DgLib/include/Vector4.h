@@ -72,12 +72,14 @@ namespace Dg
     friend class Quaternion<Real>;
     friend class VQS<Real>;
 
+    friend Vector4<Real> Cross<>(Vector4<Real> const &, Vector4<Real> const &);
+    friend Real Dot<>(Vector4<Real> const &, Vector4<Real> const &);
+
   public:
 
     //! Default constructor. Members not initialized.
     Vector4() {}
     Vector4(Real x, Real y, Real z, Real w);
-    ~Vector4() {}
 
     // copy operations
     Vector4(Matrix<1, 4, Real> const & a_other) : Matrix<1, 4, Real>(a_other) {}
@@ -174,10 +176,10 @@ namespace Dg
   template<typename Real>
   Vector4<Real>::Vector4(Real a_x, Real a_y, Real a_z, Real a_w)
   {
-    m_V[0] = a_x;
-    m_V[1] = a_y;
-    m_V[2] = a_z;
-    m_V[3] = a_w;
+    this->m_V[0] = a_x;
+    this->m_V[1] = a_y;
+    this->m_V[2] = a_z;
+    this->m_V[3] = a_w;
   }   // End:  Vector4::Vector4()
 
   //-------------------------------------------------------------------------------
@@ -186,10 +188,10 @@ namespace Dg
   template<typename Real>
   void Vector4<Real>::Set(Real a_x, Real a_y, Real a_z, Real a_w)
   {
-    m_V[0] = a_x;
-    m_V[1] = a_y;
-    m_V[2] = a_z;
-    m_V[3] = a_w;
+    this->m_V[0] = a_x;
+    this->m_V[1] = a_y;
+    this->m_V[2] = a_z;
+    this->m_V[3] = a_w;
 
   }   // End: Vector4::Set()
 
@@ -199,10 +201,10 @@ namespace Dg
   template<typename Real>
   Real Vector4<Real>::Length() const
   {
-    return sqrt(m_V[0] * m_V[0] + 
-                m_V[1] * m_V[1] + 
-                m_V[2] * m_V[2] + 
-                m_V[3] * m_V[3]);
+    return sqrt(this->m_V[0] * this->m_V[0] + 
+                this->m_V[1] * this->m_V[1] + 
+                this->m_V[2] * this->m_V[2] + 
+                this->m_V[3] * this->m_V[3]);
 
   }   // End:  Vector4::Length()
 
@@ -213,10 +215,10 @@ namespace Dg
   template<typename Real>
   Real Vector4<Real>::LengthSquared() const
   {
-    return (m_V[0] * m_V[0] + 
-            m_V[1] * m_V[1] + 
-            m_V[2] * m_V[2] + 
-            m_V[3] * m_V[3]);
+    return (this->m_V[0] * this->m_V[0] + 
+            this->m_V[1] * this->m_V[1] + 
+            this->m_V[2] * this->m_V[2] + 
+            this->m_V[3] * this->m_V[3]);
 
   }   // End:  Vector4::LengthSquared()
 
@@ -242,18 +244,18 @@ namespace Dg
 
     if (Dg::IsZero(lengthsq))
     {
-      m_V[0] = static_cast<Real>(1.0);
-      m_V[1] = static_cast<Real>(0.0);
-      m_V[2] = static_cast<Real>(0.0);
-      m_V[3] = static_cast<Real>(0.0);
+      this->m_V[0] = static_cast<Real>(1.0);
+      this->m_V[1] = static_cast<Real>(0.0);
+      this->m_V[2] = static_cast<Real>(0.0);
+      this->m_V[3] = static_cast<Real>(0.0);
     }
     else
     {
       Real factor = static_cast<Real>(1.0) / sqrt(lengthsq);
-      m_V[0] *= factor;
-      m_V[1] *= factor;
-      m_V[2] *= factor;
-      m_V[3] *= factor;
+      this->m_V[0] *= factor;
+      this->m_V[1] *= factor;
+      this->m_V[2] *= factor;
+      this->m_V[3] *= factor;
     }
 
   }   // End:  Vector4::Normalize()
@@ -454,6 +456,63 @@ namespace Dg
     return (cos(phi) * a_axis + sin(phi) * GetRandomOrthonormalVector(a_axis));
   }	//End: GetRandomVector()
 
+
+#ifdef DG_SSE
+
+  //--------------------------------------------------------------------------------
+  //	@	Vector4<float> SSE specializations
+  //--------------------------------------------------------------------------------
+  template<>
+  inline float Vector4<float>::LengthSquared() const
+  {
+    __m128 v = SSE::Load(m_V);
+    return _mm_cvtss_f32(SSE::Dot(v, v));
+  }
+
+
+  template<>
+  inline float Vector4<float>::Length() const
+  {
+    __m128 v = SSE::Load(m_V);
+    return _mm_cvtss_f32(_mm_sqrt_ss(SSE::Dot(v, v)));
+  }
+
+
+  template<>
+  inline void Vector4<float>::Normalize()
+  {
+    __m128 v = SSE::Load(m_V);
+    __m128 lengthsq = SSE::Dot(v, v);
+
+    if (Dg::IsZero(_mm_cvtss_f32(lengthsq)))
+    {
+      SSE::Store(m_V, _mm_set_ps(0.0f, 0.0f, 0.0f, 1.0f));
+    }
+    else
+    {
+      __m128 factor = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthsq));
+      SSE::Store(m_V, _mm_mul_ps(v, factor));
+    }
+  }
+
+
+  template<>
+  inline Vector4<float> Cross<float>(Vector4<float> const & a_v1, Vector4<float> const & a_v2)
+  {
+    Vector4<float> result;
+    SSE::Store(result.m_V, SSE::Cross(SSE::Load(a_v1.m_V), SSE::Load(a_v2.m_V)));
+    return result;
+  }
+
+
+  template<>
+  inline float Dot<float>(Vector4<float> const & a_v1, Vector4<float> const & a_v2)
+  {
+    return _mm_cvtss_f32(SSE::Dot(SSE::Load(a_v1.m_V), SSE::Load(a_v2.m_V)));
+  }
+
+#endif
+
 }
 
 
@@ -5,4 +5,9 @@
 #define PRECISION_F32
 //#define PRECISION_F64
 
+//! Use SSE for Matrix<1, 4, float>, Matrix<4, 4, float>, Vector4<float> and
+//! Matrix44<float>. Ignored if the target does not support SSE2. Building with
+//! /arch:AVX also enables the AVX 4x4 multiply.
+#define DG_USE_SSE
+
 #endif
\ No newline at end of file
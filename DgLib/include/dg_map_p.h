@@ -9,6 +9,8 @@
 #define DG_MAP_P_H
 
 #include <exception>
+#include <stdexcept>
+#include <new>
 #include <assert.h>
 
 #include "impl_container_common.h"
@@ -161,7 +163,7 @@ namespace Dg
 
     if (tempPtr == nullptr)
     {
-      throw std::bad_alloc;
+      throw std::bad_alloc();
     }
 
     m_data = tempPtr;
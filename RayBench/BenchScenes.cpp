@@ -0,0 +1,211 @@
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "BenchScenes.h"
+#include "Camera.h"
+#include "DgRNG.h"
+#include "dgmath.h"
+#include "scene.h"
+
+static char const * const s_names[] =
+{
+  "primitives",
+  "spheres",
+  "mesh",
+  "reflections"
+};
+
+
+char const * GetName(BenchScene a_scene)
+{
+  return s_names[int(a_scene)];
+}
+
+
+bool FindScene(std::string const & a_name, BenchScene & a_scene)
+{
+  for (int i = 0; i < int(BenchScene::COUNT); i++)
+  {
+    if (a_name == s_names[i])
+    {
+      a_scene = BenchScene(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	Scenes
+//--------------------------------------------------------------------------------
+static uint32_t AddMaterials(Scene & a_scene, float a_r, float a_g, float a_b, float a_reflectance)
+{
+  Materials mat;
+  mat.color.Set(a_r, a_g, a_b, 1.0f);
+  mat.reflectance = a_reflectance;
+  return a_scene.AddMaterials(mat);
+}
+
+
+static void AddBox(Scene & a_scene, float a_x0, float a_y0, float a_z0,
+                   float a_x1, float a_y1, float a_z1, uint32_t a_materials)
+{
+  AABB box;
+  box.min.Set(a_x0, a_y0, a_z0, 1.0f);
+  box.max.Set(a_x1, a_y1, a_z1, 1.0f);
+  box.materials = a_materials;
+  a_scene.AddBox(box);
+}
+
+
+//A 100 by 100 grid of spheres in front of the camera, each moved and sized
+//at random and given one of four materials, one of them reflective
+static void CreateSpheres(Scene & a_scene)
+{
+  uint32_t ground = AddMaterials(a_scene, 0.6f, 0.6f, 0.6f, 0.0f);
+  uint32_t first = AddMaterials(a_scene, 0.9f, 0.2f, 0.2f, 0.0f);
+  AddMaterials(a_scene, 0.2f, 0.8f, 0.3f, 0.0f);
+  AddMaterials(a_scene, 0.2f, 0.3f, 0.9f, 0.0f);
+  AddMaterials(a_scene, 0.9f, 0.9f, 0.9f, 0.5f);
+
+  AddBox(a_scene, 0.0f, -55.0f, -1.0f, 110.0f, 55.0f, 0.0f, ground);
+
+  Dg::RNG_PCG32 rng(1, 0);
+  for (int i = 0; i < 100; i++)
+  {
+    for (int j = 0; j < 100; j++)
+    {
+      Sphere sphere;
+      sphere.radius = rng.GetUniform(0.2f, 0.45f);
+      sphere.center.Set(5.0f + float(i) + rng.GetUniform(-0.25f, 0.25f),
+                        -49.5f + float(j) + rng.GetUniform(-0.25f, 0.25f),
+                        sphere.radius, 1.0f);
+      sphere.materials = first + (rng.GetUint() % 4);
+      a_scene.AddSphere(sphere);
+    }
+  }
+}
+
+
+//1000 steps around the ring by 500 around the tube, two triangles each.
+//The tube radius ripples so that no two triangles are alike.
+static void CreateMesh(Scene & a_scene)
+{
+  int const nU = 1000;
+  int const nV = 500;
+  float const R = 6.0f;
+  float const r = 2.0f;
+
+  std::vector<float> positions;
+  positions.reserve(3 * nU * nV);
+  for (int i = 0; i < nU; i++)
+  {
+    float u = 2.0f * Dg::PI_f * float(i) / float(nU);
+    for (int j = 0; j < nV; j++)
+    {
+      float v = 2.0f * Dg::PI_f * float(j) / float(nV);
+      float tube = r * (1.0f + 0.08f * sinf(23.0f * u) * sinf(17.0f * v));
+      float ring = R + tube * cosf(v);
+      positions.push_back(20.0f + ring * cosf(u));
+      positions.push_back(ring * sinf(u));
+      positions.push_back(tube * sinf(v));
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  indices.reserve(6 * nU * nV);
+  for (int i = 0; i < nU; i++)
+  {
+    for (int j = 0; j < nV; j++)
+    {
+      uint32_t a = uint32_t(i * nV + j);
+      uint32_t b = uint32_t(((i + 1) % nU) * nV + j);
+      uint32_t c = uint32_t(((i + 1) % nU) * nV + (j + 1) % nV);
+      uint32_t d = uint32_t(i * nV + (j + 1) % nV);
+      uint32_t quad[6] = {a, b, c, a, c, d};
+      indices.insert(indices.end(), quad, quad + 6);
+    }
+  }
+
+  uint32_t materials = AddMaterials(a_scene, 0.8f, 0.7f, 0.5f, 0.0f);
+  AddBox(a_scene, 0.0f, -20.0f, -10.0f, 40.0f, 20.0f, -9.0f, AddMaterials(a_scene, 0.6f, 0.6f, 0.6f, 0.0f));
+  a_scene.AddMesh(&positions[0], unsigned(nU * nV), &indices[0], unsigned(2 * nU * nV), materials);
+}
+
+
+//Two mirrors facing each other down a corridor, a mirror floor, and a row
+//of spheres between them, so most paths run to the bounce limit
+static void CreateReflections(Scene & a_scene)
+{
+  uint32_t mirror = AddMaterials(a_scene, 0.9f, 0.9f, 0.9f, 0.9f);
+  uint32_t floor = AddMaterials(a_scene, 0.5f, 0.5f, 0.6f, 0.6f);
+  uint32_t red = AddMaterials(a_scene, 1.0f, 0.2f, 0.2f, 0.3f);
+  uint32_t blue = AddMaterials(a_scene, 0.2f, 0.3f, 1.0f, 0.3f);
+
+  AddBox(a_scene, 0.0f, -5.0f, -2.0f, 60.0f, -4.0f, 8.0f, mirror);
+  AddBox(a_scene, 0.0f, 4.0f, -2.0f, 60.0f, 5.0f, 8.0f, mirror);
+  AddBox(a_scene, 0.0f, -4.0f, -3.0f, 60.0f, 4.0f, -2.0f, floor);
+
+  for (int i = 0; i < 12; i++)
+  {
+    Sphere sphere;
+    sphere.center.Set(8.0f + 4.0f * float(i), (i % 2 == 0) ? -1.5f : 1.5f, -0.5f, 1.0f);
+    sphere.radius = 1.25f;
+    sphere.materials = (i % 2 == 0) ? red : blue;
+    a_scene.AddSphere(sphere);
+  }
+}
+
+
+unsigned CreateScene(BenchScene a_scene, Scene & a_out)
+{
+  a_out.Clear();
+  switch (a_scene)
+  {
+    case BenchScene::Primitives:
+    {
+      a_out.LoadDefault();
+      return NUM_REFLECTIONS;
+    }
+    case BenchScene::Spheres:
+    {
+      CreateSpheres(a_out);
+      return NUM_REFLECTIONS;
+    }
+    case BenchScene::Mesh:
+    {
+      CreateMesh(a_out);
+      return NUM_REFLECTIONS;
+    }
+    case BenchScene::Reflections:
+    default:
+    {
+      CreateReflections(a_out);
+      return BENCH_DEEP_BOUNCES;
+    }
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	GetView()
+//--------------------------------------------------------------------------------
+void GetView(BenchScene a_scene, float a_aspect, Camera & a_camera)
+{
+  //Position, then yaw, pitch and roll in degrees
+  static float const views[int(BenchScene::COUNT)][6] =
+  {
+    {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f},
+    {-2.0f, 0.0f, 6.0f, 0.0f, 15.0f, 0.0f},
+    {4.0f, 0.0f, 6.0f, 0.0f, 20.0f, 0.0f},
+    {-2.0f, -1.0f, 3.0f, 8.0f, 8.0f, 0.0f}
+  };
+
+  float const * view = views[int(a_scene)];
+  float const toRadians = Dg::PI_f / 180.0f;
+  a_camera.SetScreen(a_aspect, 1.0f);
+  a_camera.SetYPR(view[3] * toRadians, view[4] * toRadians, view[5] * toRadians);
+  a_camera.SetPosition(view[0], view[1], view[2]);
+}
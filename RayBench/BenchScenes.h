@@ -0,0 +1,35 @@
+#ifndef BENCHSCENES_H
+#define BENCHSCENES_H
+
+#include <string>
+
+class Camera;
+class Scene;
+
+//! The scenes RayBench times. Each is generated from fixed seeds, so every
+//! run and every machine traces exactly the same rays.
+enum class BenchScene
+{
+  Primitives,     //The default scene, a few large primitives of every type
+  Spheres,        //10k spheres over a ground box
+  Mesh,           //A displaced torus of 1M triangles
+  Reflections,    //Mirrors facing each other, traced with BENCH_DEEP_BOUNCES
+
+  COUNT
+};
+
+//Bounces of the reflections scene
+#define BENCH_DEEP_BOUNCES 16
+
+char const * GetName(BenchScene);
+
+//! False if a_name is not one of the names above.
+bool FindScene(std::string const & name, BenchScene &);
+
+//! Fills a_scene and returns the reflection bounces to trace it with.
+unsigned CreateScene(BenchScene, Scene &);
+
+//! The fixed view of the scene, for an a_aspect wide by 1 high image.
+void GetView(BenchScene, float aspect, Camera &);
+
+#endif
@@ -0,0 +1,497 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "BenchScenes.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "CPUTracer.h"
+#include "Framebuffer.h"
+#include "PacketTraversal.h"
+#include "scene.h"
+#include "WideBVH.h"
+
+//Bumped whenever the scenes, views or output change, so results from
+//different versions are not compared
+#define RAYBENCH_VERSION 2
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct Options
+{
+  int         width;
+  int         height;
+  unsigned    samples;
+  unsigned    threads;
+  unsigned    warmup;
+  unsigned    repetitions;
+  BVH::Builder builder;
+  int         bvhWidth;
+  std::string packets;
+  std::string output;
+  std::string label;
+  std::vector<BenchScene> scenes;
+};
+
+struct Result
+{
+  BenchScene  scene;
+  unsigned    nPrimitives;
+  unsigned    nTriangles;
+  unsigned    bounces;
+  double      buildMs;
+  double      wideMs;         //Collapsing the BVH, with -width 4 or 8
+  size_t      bvhBytes;
+  uint64_t    raysPerFrame;
+  std::vector<double> frameMs;  //Sorted
+  double      memoryMB;       //Growth in resident memory while the scene is loaded
+};
+
+
+static void PrintUsage()
+{
+  printf("Usage: RayBench [-scene <name>]... [-size <w> <h>] [-spp <n>] [-threads <n>] [-warmup <n>] [-reps <n>] [-builder <sah|lbvh|lbvh63>] [-width <2|4|8>] [-packets <off|sse|avx2|avx512>] [-out <file.json>] [-label <text>]\n");
+  printf("  -scene     Scene to time, may be given more than once. Default all of:");
+  for (int i = 0; i < int(BenchScene::COUNT); i++)
+  {
+    printf(" %s", GetName(BenchScene(i)));
+  }
+  printf("\n");
+  printf("  -size      Image size. Default 640 480.\n");
+  printf("  -spp       Samples per pixel. Default 1.\n");
+  printf("  -threads   Worker threads. Default is one per core.\n");
+  printf("  -warmup    Frames traced before timing. Default 2.\n");
+  printf("  -reps      Frames timed. Default 10.\n");
+  printf("  -builder   BVH builder. Default sah.\n");
+  printf("  -width     Children per BVH node. Default 2.\n");
+  printf("  -packets   Primary ray packets. Default is the widest the CPU runs.\n");
+  printf("  -out       JSON results. Default raybench.json.\n");
+  printf("  -label     Stored with the results, to tell runs apart, e.g. a commit.\n");
+}
+
+
+static bool ParseOptions(int argc, char ** argv, Options & a_opts)
+{
+  a_opts.width = 640;
+  a_opts.height = 480;
+  a_opts.samples = 1;
+  a_opts.threads = 0;
+  a_opts.warmup = 2;
+  a_opts.repetitions = 10;
+  a_opts.builder = BVH::Builder::SAH;
+  a_opts.bvhWidth = 2;
+  a_opts.packets = "auto";
+  a_opts.output = "raybench.json";
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-scene") == 0 && i + 1 < argc)
+    {
+      BenchScene scene;
+      if (!FindScene(argv[++i], scene))
+      {
+        return false;
+      }
+      a_opts.scenes.push_back(scene);
+    }
+    else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc)
+    {
+      a_opts.width = atoi(argv[++i]);
+      a_opts.height = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-spp") == 0 && i + 1 < argc)
+    {
+      int samples = atoi(argv[++i]);
+      if (samples <= 0)
+      {
+        return false;
+      }
+      a_opts.samples = unsigned(samples);
+    }
+    else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+    {
+      a_opts.threads = unsigned(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc)
+    {
+      int warmup = atoi(argv[++i]);
+      if (warmup < 0)
+      {
+        return false;
+      }
+      a_opts.warmup = unsigned(warmup);
+    }
+    else if (strcmp(argv[i], "-reps") == 0 && i + 1 < argc)
+    {
+      int repetitions = atoi(argv[++i]);
+      if (repetitions <= 0)
+      {
+        return false;
+      }
+      a_opts.repetitions = unsigned(repetitions);
+    }
+    else if (strcmp(argv[i], "-builder") == 0 && i + 1 < argc)
+    {
+      ++i;
+      if (strcmp(argv[i], "sah") == 0)          a_opts.builder = BVH::Builder::SAH;
+      else if (strcmp(argv[i], "lbvh") == 0)    a_opts.builder = BVH::Builder::LBVH30;
+      else if (strcmp(argv[i], "lbvh63") == 0)  a_opts.builder = BVH::Builder::LBVH63;
+      else return false;
+    }
+    else if (strcmp(argv[i], "-width") == 0 && i + 1 < argc)
+    {
+      a_opts.bvhWidth = atoi(argv[++i]);
+      if (a_opts.bvhWidth != 2 && a_opts.bvhWidth != 4 && a_opts.bvhWidth != 8)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-packets") == 0 && i + 1 < argc)
+    {
+      a_opts.packets = argv[++i];
+      if (a_opts.packets != "off" && a_opts.packets != "sse" && a_opts.packets != "avx2" && a_opts.packets != "avx512")
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-out") == 0 && i + 1 < argc)
+    {
+      a_opts.output = argv[++i];
+    }
+    else if (strcmp(argv[i], "-label") == 0 && i + 1 < argc)
+    {
+      a_opts.label = argv[++i];
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  if (a_opts.scenes.empty())
+  {
+    for (int i = 0; i < int(BenchScene::COUNT); i++)
+    {
+      a_opts.scenes.push_back(BenchScene(i));
+    }
+  }
+  return (a_opts.width > 0 && a_opts.height > 0);
+}
+
+
+static double Milliseconds(Clock::time_point a_from)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - a_from).count();
+}
+
+
+//Current resident memory of the process.
+static double GetResidentMemoryMB()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+  {
+    return 0.0;
+  }
+  return double(counters.WorkingSetSize) / (1024.0 * 1024.0);
+#else
+  FILE * file = fopen("/proc/self/statm", "r");
+  if (file == nullptr)
+  {
+    return 0.0;
+  }
+  unsigned long size = 0, resident = 0;
+  int nRead = fscanf(file, "%lu %lu", &size, &resident);
+  fclose(file);
+  if (nRead != 2)
+  {
+    return 0.0;
+  }
+  return double(resident) * double(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#endif
+}
+
+
+//Peak resident memory of the process, which only grows, so it covers every
+//scene timed so far rather than any one of them.
+static double GetPeakMemoryMB()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+  {
+    return 0.0;
+  }
+  return double(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return 0.0;
+  }
+  return double(usage.ru_maxrss) / 1024.0;    //kB on Linux
+#endif
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunScene()
+//--------------------------------------------------------------------------------
+static bool RunScene(BenchScene a_scene, Options const & a_opts, Result & a_result)
+{
+  a_result.scene = a_scene;
+  double residentMB = GetResidentMemoryMB();
+
+  Scene scene;
+  a_result.bounces = CreateScene(a_scene, scene);
+  a_result.nPrimitives = scene.GetBoxes().size + scene.GetSpheres().size + scene.GetOBBs().size
+                       + scene.GetCapsules().size + scene.GetCylinders().size + scene.GetTori().size
+                       + scene.GetCones().size;
+  a_result.nTriangles = 0;
+  for (unsigned i = 0; i < scene.GetMeshes().size; i++)
+  {
+    a_result.nTriangles += scene.GetMeshes()[i].nTriangles;
+  }
+
+  BVH bvh;
+  bvh.SetBuilder(a_opts.builder);
+  Clock::time_point start = Clock::now();
+  bvh.Build(scene);
+  a_result.buildMs = Milliseconds(start);
+  a_result.bvhBytes = bvh.GetNodes().size() * sizeof(BVHNode) + bvh.GetPrimitives().size() * sizeof(BVHPrimitive);
+
+  WideBVH wide;
+  a_result.wideMs = 0.0;
+  if (a_opts.bvhWidth > 2)
+  {
+    wide.SetWidth(a_opts.bvhWidth);
+    start = Clock::now();
+    if (!wide.Build(bvh))
+    {
+      return false;
+    }
+    a_result.wideMs = Milliseconds(start);
+  }
+
+  CPUTracer tracer;
+  tracer.SetScene(&scene);
+  tracer.SetBVH(&bvh);
+  if (a_opts.bvhWidth > 2)
+  {
+    tracer.SetWideBVH(&wide);
+  }
+  tracer.SetThreadCount(a_opts.threads);
+  tracer.SetSamplesPerPixel(a_opts.samples);
+  tracer.SetReflectionCount(a_result.bounces);
+
+  if (a_opts.packets == "off")
+  {
+    tracer.SetPacketTraversal(false);
+  }
+  else if (a_opts.packets != "auto")
+  {
+    PacketTraversal::ISA isa = PacketTraversal::ISA::SSE;
+    if (a_opts.packets == "avx2")         isa = PacketTraversal::ISA::AVX2;
+    else if (a_opts.packets == "avx512")  isa = PacketTraversal::ISA::AVX512;
+    if (!tracer.SetPacketISA(isa))
+    {
+      printf("This CPU or build has no %s packet traversal.\n", PacketTraversal::GetName(isa));
+      return false;
+    }
+  }
+
+  Camera camera;
+  GetView(a_scene, float(a_opts.width) / float(a_opts.height), camera);
+
+  Framebuffer fb;
+  fb.Resize(a_opts.width, a_opts.height);
+
+  //The wavefront mode queues exactly the rays the path tracer casts, so one
+  //frame of it counts them without slowing down the frames that are timed
+  tracer.SetWavefront(true);
+  tracer.Trace(camera, fb);
+  a_result.raysPerFrame = uint64_t(a_opts.width) * uint64_t(a_opts.height) * a_opts.samples
+                        + tracer.GetWavefrontStats().queuedRays;
+  tracer.SetWavefront(false);
+
+  for (unsigned i = 0; i < a_opts.warmup; i++)
+  {
+    tracer.Trace(camera, fb);
+  }
+
+  a_result.frameMs.clear();
+  for (unsigned i = 0; i < a_opts.repetitions; i++)
+  {
+    start = Clock::now();
+    tracer.Trace(camera, fb);
+    a_result.frameMs.push_back(Milliseconds(start));
+  }
+  std::sort(a_result.frameMs.begin(), a_result.frameMs.end());
+
+  //Taken while the scene, BVH and framebuffer are still alive. Memory the
+  //allocator kept from earlier scenes can make this an underestimate.
+  a_result.memoryMB = GetResidentMemoryMB() - residentMB;
+  return true;
+}
+
+
+static double GetMedian(std::vector<double> const & a_sorted)
+{
+  size_t n = a_sorted.size();
+  return (n % 2 == 1) ? a_sorted[n / 2] : 0.5 * (a_sorted[n / 2 - 1] + a_sorted[n / 2]);
+}
+
+
+static double GetMean(std::vector<double> const & a_values)
+{
+  double sum = 0.0;
+  for (size_t i = 0; i < a_values.size(); i++)
+  {
+    sum += a_values[i];
+  }
+  return sum / double(a_values.size());
+}
+
+
+static double GetMrays(Result const & a_result, double a_ms)
+{
+  return double(a_result.raysPerFrame) / (a_ms * 1.0e3);
+}
+
+
+static std::string Escape(std::string const & a_text)
+{
+  std::string result;
+  for (size_t i = 0; i < a_text.size(); i++)
+  {
+    char c = a_text[i];
+    if (c == '"' || c == '\\')
+    {
+      result += '\\';
+    }
+    if (static_cast<unsigned char>(c) >= 0x20)
+    {
+      result += c;
+    }
+  }
+  return result;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	WriteResults()
+//--------------------------------------------------------------------------------
+static bool WriteResults(Options const & a_opts, unsigned a_nThreads, double a_peakMB, std::vector<Result> const & a_results)
+{
+  std::ofstream file(a_opts.output.c_str());
+  if (!file)
+  {
+    printf("Unable to open file %s\n", a_opts.output.c_str());
+    return false;
+  }
+
+  char const * builder = (a_opts.builder == BVH::Builder::SAH) ? "sah"
+                       : (a_opts.builder == BVH::Builder::LBVH30) ? "lbvh" : "lbvh63";
+
+  file.setf(std::ios::fixed);
+  file.precision(3);
+  file << "{\n"
+       << "  \"version\": " << RAYBENCH_VERSION << ",\n"
+       << "  \"label\": \"" << Escape(a_opts.label) << "\",\n"
+       << "  \"config\": {\"width\": " << a_opts.width << ", \"height\": " << a_opts.height
+       << ", \"spp\": " << a_opts.samples << ", \"threads\": " << a_nThreads
+       << ", \"warmup\": " << a_opts.warmup << ", \"repetitions\": " << a_opts.repetitions
+       << ", \"builder\": \"" << builder << "\", \"bvhWidth\": " << a_opts.bvhWidth
+       << ", \"packets\": \"" << a_opts.packets << "\"},\n"
+       << "  \"processPeakMemoryMB\": " << a_peakMB << ",\n"
+       << "  \"scenes\": [";
+
+  for (size_t i = 0; i < a_results.size(); i++)
+  {
+    Result const & r = a_results[i];
+    double median = GetMedian(r.frameMs);
+    file << ((i == 0) ? "\n" : ",\n")
+         << "    {\"name\": \"" << GetName(r.scene) << "\""
+         << ", \"primitives\": " << r.nPrimitives
+         << ", \"triangles\": " << r.nTriangles
+         << ", \"bounces\": " << r.bounces
+         << ", \"buildMs\": " << r.buildMs
+         << ", \"wideBuildMs\": " << r.wideMs
+         << ", \"bvhMB\": " << double(r.bvhBytes) / (1024.0 * 1024.0)
+         << ", \"raysPerFrame\": " << r.raysPerFrame
+         << ", \"frameMs\": {\"min\": " << r.frameMs.front()
+         << ", \"median\": " << median
+         << ", \"mean\": " << GetMean(r.frameMs)
+         << ", \"max\": " << r.frameMs.back() << "}"
+         << ", \"mraysPerSecond\": " << GetMrays(r, median)
+         << ", \"memoryMB\": " << r.memoryMB << "}";
+  }
+  file << "\n  ]\n}\n";
+  return file.good();
+}
+
+
+int main(int argc, char ** argv)
+{
+  Options opts;
+  if (!ParseOptions(argc, argv, opts))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  unsigned nThreads = opts.threads;
+  if (nThreads == 0)
+  {
+    nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+  }
+
+  printf("%ix%i pixels, %u spp, %u threads, %u warm-up and %u timed frames\n",
+         opts.width, opts.height, opts.samples, nThreads, opts.warmup, opts.repetitions);
+  printf("%-12s %10s %10s %12s %10s %10s %10s %10s\n",
+         "scene", "triangles", "build ms", "rays/frame", "median ms", "min ms", "Mrays/s", "mem MB");
+
+  std::vector<Result> results;
+  for (size_t i = 0; i < opts.scenes.size(); i++)
+  {
+    Result result;
+    if (!RunScene(opts.scenes[i], opts, result))
+    {
+      return 1;
+    }
+    double median = GetMedian(result.frameMs);
+    printf("%-12s %10u %10.2f %12llu %10.2f %10.2f %10.2f %10.1f\n",
+           GetName(result.scene), result.nTriangles, result.buildMs + result.wideMs,
+           (unsigned long long)result.raysPerFrame, median, result.frameMs.front(),
+           GetMrays(result, median), result.memoryMB);
+    results.push_back(result);
+  }
+
+  double peakMB = GetPeakMemoryMB();
+  printf("Process peak memory %.1f MB\n", peakMB);
+
+  if (!WriteResults(opts, nThreads, peakMB, results))
+  {
+    return 1;
+  }
+  printf("Wrote %s\n", opts.output.c_str());
+  return 0;
+}
@@ -15,9 +15,12 @@
 #include <iostream>
 #include <fstream>
 #include "Application.h"
+#include "BVHResource.h"
 #include <string>
 #include <cstring>
+#include <vector>
 #include "Matrix44.h"
+#include "MeshLoader.h"
 #include "Vector4.h"
 #include <math.h>
 
@@ -26,11 +29,28 @@ typedef Dg::Matrix44<float> mat4;
 
 Application * Application::s_instance(nullptr);
 
+//Once this many samples are averaged the image is left as is.
+#define MAX_ACCUMULATED_SAMPLES 1024
+
 static void OnKeyCallback(GLFWwindow* a_window, int a_key, int a_scancode, int a_action, int a_mods)
 {
   Application::GetInstance()->OnKey(a_window, a_key, a_scancode, a_action, a_mods);
 }
 
+//Radical inverse, for low discrepancy sub-pixel offsets.
+static float Halton(unsigned a_index, unsigned a_base)
+{
+  float result = 0.0f;
+  float f = 1.0f / float(a_base);
+  while (a_index > 0)
+  {
+    result += f * float(a_index % a_base);
+    a_index /= a_base;
+    f /= float(a_base);
+  }
+  return result;
+}
+
 static void OnMouseMoveCallback(GLFWwindow* a_window, double a_x, double a_y)
 {
   Application::GetInstance()->OnMouseMove(a_window, a_x, a_y);
@@ -54,7 +74,7 @@ Application * Application::GetInstance()
 	Side Effects:
 		-None
 */
-GLuint Application::LoadShaderFromFile(std::string a_path, GLenum a_shaderType)
+GLuint Application::LoadShaderFromFile(std::string a_path, GLenum a_shaderType, std::string a_defines)
 {
 	//Open file
 	GLuint shaderID = 0;
@@ -67,6 +87,15 @@ GLuint Application::LoadShaderFromFile(std::string a_path, GLenum a_shaderType)
 		//Get shader source
 		shaderString.assign((std::istreambuf_iterator< char >(sourceFile)), std::istreambuf_iterator< char >());
 
+		//Insert defines after the #version directive
+		if (!a_defines.empty())
+		{
+			size_t pos = shaderString.find("#version");
+			pos = (pos == std::string::npos) ? 0 : shaderString.find('\n', pos);
+			pos = (pos == std::string::npos) ? shaderString.size() : pos + 1;
+			shaderString.insert(pos, a_defines);
+		}
+
 		//Create shader ID
 		shaderID = glCreateShader( a_shaderType );
 
@@ -150,16 +179,31 @@ void Application::InitQuadProgram()
   glUseProgram(m_quadProgram);
   GLint texUniform = glGetUniformLocation(m_quadProgram, "tex");
   glUniform1i(texUniform, 0);
+  GLint costTexUniform = glGetUniformLocation(m_quadProgram, "costTex");
+  glUniform1i(costTexUniform, 1);
+  m_quadRenderSizeUniform = glGetUniformLocation(m_quadProgram, "renderSize");
+  m_quadUpscaleUniform = glGetUniformLocation(m_quadProgram, "upscaleFilter");
+  m_quadCostChannelUniform = glGetUniformLocation(m_quadProgram, "costChannel");
+  m_quadCostScaleUniform = glGetUniformLocation(m_quadProgram, "costScale");
   glUseProgram(0);
 }
 
 
-GLuint Application::CreateComputeProgram()
+GLuint Application::LinkComputeProgram(std::string const & a_defines, std::string const & a_file)
 {
+  char defines[256] = {};
+  int length = snprintf(defines, sizeof(defines), "#define NUM_REFLECTIONS %u\n#define WAVEFRONT_GROUP_SIZE %i\n#define BVH_STACK_SIZE %i\n",
+                        m_nReflections, WAVEFRONT_GROUP_SIZE, BVH_STACK_SIZE);
+  if (m_bvhWidth > 2)
+  {
+    snprintf(defines + length, sizeof(defines) - length, "#define WIDE_BVH %i\n", m_bvhWidth);
+  }
+
   GLuint computeProgram = glCreateProgram();
-  GLuint cshader = LoadShaderFromFile("raytracer_cs.glsl", GL_COMPUTE_SHADER);
+  GLuint cshader = LoadShaderFromFile(a_file, GL_COMPUTE_SHADER, defines + a_defines);
   glAttachShader(computeProgram, cshader);
   glLinkProgram(computeProgram);
+  glDeleteShader(cshader);
   GLint linked(0);
   glGetProgramiv(computeProgram, GL_LINK_STATUS, &linked);
   if (linked == 0)
@@ -168,11 +212,145 @@ GLuint Application::CreateComputeProgram()
     GLsizei length;
     glGetProgramInfoLog(computeProgram, 2048, &length, buf);
     printf(buf);
+    glDeleteProgram(computeProgram);
+    computeProgram = 0;
   }
   return computeProgram;
 }
 
 
+GLuint Application::CreateComputeProgram(int a_workGroupSizeX, int a_workGroupSizeY)
+{
+  char defines[128] = {};
+  snprintf(defines, sizeof(defines), "#define WORK_GROUP_SIZE_X %i\n#define WORK_GROUP_SIZE_Y %i\n", a_workGroupSizeX, a_workGroupSizeY);
+  return LinkComputeProgram(defines);
+}
+
+
+void Application::CreateWavefrontPrograms()
+{
+  m_prepareProgram = LinkComputeProgram("#define PASS_PREPARE\n");
+  m_shadowProgram = LinkComputeProgram("#define PASS_SHADOW\n");
+  m_bounceProgram = LinkComputeProgram("#define PASS_BOUNCE\n");
+  m_resolveProgram = LinkComputeProgram("#define PASS_RESOLVE\n");
+
+  m_prepareBounceUniform = glGetUniformLocation(m_prepareProgram, "bounce");
+  m_bounceBounceUniform = glGetUniformLocation(m_bounceProgram, "bounce");
+  m_shadowSortedUniform = glGetUniformLocation(m_shadowProgram, "sortedQueue");
+  m_bounceSortedUniform = glGetUniformLocation(m_bounceProgram, "sortedQueue");
+  m_sampleIndexUniform = glGetUniformLocation(m_resolveProgram, "sampleIndex");
+  m_resolveSizeUniform = glGetUniformLocation(m_resolveProgram, "renderSize");
+
+  //Built whether or not sorting starts on, it can be toggled at any time
+  char scanSize[64] = {};
+  snprintf(scanSize, sizeof(scanSize), "#define RAYSORT_SCAN_SIZE %i\n", RAYSORT_SCAN_SIZE);
+  std::string defines(scanSize);
+
+  GPURaySorter::Programs programs;
+  programs.keys = LinkComputeProgram(defines + "#define PASS_SORT_KEYS\n");
+  programs.histogram = LinkComputeProgram(defines + "#define PASS_SORT_HISTOGRAM\n");
+  programs.scan = LinkComputeProgram(defines + "#define PASS_SORT_SCAN\n");
+  programs.scatter = LinkComputeProgram(defines + "#define PASS_SORT_SCATTER\n");
+  m_raySorter.Init(programs, unsigned(m_info.windowWidth * m_info.windowHeight));
+}
+
+
+void Application::CreateLBVHPrograms()
+{
+  char groupSize[64] = {};
+  snprintf(groupSize, sizeof(groupSize), "#define LBVH_GROUP_SIZE %i\n", LBVH_GROUP_SIZE);
+  std::string defines(groupSize);
+
+  GPUBVHBuilder::Programs programs;
+  programs.morton = LinkComputeProgram(defines + "#define PASS_MORTON\n", "lbvh_cs.glsl");
+  programs.histogram = LinkComputeProgram(defines + "#define PASS_HISTOGRAM\n", "lbvh_cs.glsl");
+  programs.scan = LinkComputeProgram(defines + "#define PASS_SCAN\n", "lbvh_cs.glsl");
+  programs.scatter = LinkComputeProgram(defines + "#define PASS_SCATTER\n", "lbvh_cs.glsl");
+  programs.emit = LinkComputeProgram(defines + "#define PASS_EMIT\n", "lbvh_cs.glsl");
+  programs.bounds = LinkComputeProgram(defines + "#define PASS_BOUNDS\n", "lbvh_cs.glsl");
+  programs.layout = LinkComputeProgram(defines + "#define PASS_LAYOUT\n", "lbvh_cs.glsl");
+  m_gpuBVHBuilder.Init(programs);
+}
+
+
+/*
+	Compiles the tracer with each candidate work group shape, times a few
+	frames of each with GL timer queries and keeps the fastest.
+*/
+void Application::TuneWorkGroupSize()
+{
+  static const int s_candidates[][2] = 
+  {
+    {16, 8}, {8, 8}, {8, 16}, {32, 4}, {16, 16}, {32, 8}, {64, 1}, {4, 32}
+  };
+  int const nCandidates = sizeof(s_candidates) / sizeof(s_candidates[0]);
+  int const nWarmUp = 2;
+  int const nTimed = 8;
+
+  GLint maxInvocations(0);
+  glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+
+  bool accumulate = m_accumulate;
+  m_accumulate = false;
+
+  GLuint query(0);
+  glGenQueries(1, &query);
+
+  GLuint bestProgram(0);
+  GLuint64 bestTime(0);
+
+  for (int i = 0; i < nCandidates; i++)
+  {
+    if (s_candidates[i][0] * s_candidates[i][1] > maxInvocations)
+    {
+      continue;
+    }
+
+    m_computeProgram = CreateComputeProgram(s_candidates[i][0], s_candidates[i][1]);
+    if (m_computeProgram == 0)
+    {
+      continue;
+    }
+    InitComputeProgram();
+
+    for (int f = 0; f < nWarmUp; f++)
+    {
+      TraceGPU();
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int f = 0; f < nTimed; f++)
+    {
+      TraceGPU();
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GLuint64 elapsed(0);
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    printf("Work group %ix%i: %.3f ms\n", s_candidates[i][0], s_candidates[i][1], double(elapsed) / (1.0e6 * nTimed));
+
+    if (bestProgram == 0 || elapsed < bestTime)
+    {
+      if (bestProgram != 0) glDeleteProgram(bestProgram);
+      bestProgram = m_computeProgram;
+      bestTime = elapsed;
+    }
+    else
+    {
+      glDeleteProgram(m_computeProgram);
+    }
+  }
+
+  glDeleteQueries(1, &query);
+
+  m_accumulate = accumulate;
+  m_sampleCount = 0;
+  m_computeProgram = bestProgram;
+  InitComputeProgram();
+  printf("Using work group %ix%i\n", m_workGroupSizeX, m_workGroupSizeY);
+}
+
+
 void Application::InitComputeProgram()
 {
   glUseProgram(m_computeProgram);
@@ -185,12 +363,20 @@ void Application::InitComputeProgram()
   m_ray10Uniform = glGetUniformLocation(m_computeProgram, "ray10");
   m_ray01Uniform = glGetUniformLocation(m_computeProgram, "ray01");
   m_ray11Uniform = glGetUniformLocation(m_computeProgram, "ray11");
+  m_jitterUniform = glGetUniformLocation(m_computeProgram, "jitter");
+  m_renderSizeUniform = glGetUniformLocation(m_computeProgram, "renderSize");
   glUseProgram(0);
 }
 
 
-void Application::Init()
+bool Application::Init()
 {
+  //Before opening a window, so a bad scene only prints why
+  if (!LoadScene())
+  {
+    return false;
+  }
+
   //Init defaults
 	strcpy_s(m_info.title, "Raytracer example");
 	m_info.windowWidth = 800;
@@ -213,7 +399,7 @@ void Application::Init()
   if (!glfwInit())
   {
     fprintf(stderr, "Failed to initialize GLFW\n");
-    return;
+    return false;
   }
 
   //Init Window
@@ -255,7 +441,7 @@ void Application::Init()
   {
     fprintf(stderr, "Failed to open m_window\n");
     glfwTerminate();
-    return;
+    return false;
   }
 
   glfwMakeContextCurrent(m_window);
@@ -288,13 +474,101 @@ void Application::Init()
   printf("Renderer: %s\n", renderer);
   printf("OpenGL version supported %s\n", version);
 
+  // Set up the CPU backend
+  m_cpuTracer.SetScene(&m_scene);
+  m_cpuTracer.SetBVH(&m_bvh);
+  m_cpuTracer.SetReflectionCount(m_nReflections);
+  if (m_bvhWidth > 2)
+  {
+    m_wideBVH.SetWidth(m_bvhWidth);
+    m_cpuTracer.SetWideBVH(&m_wideBVH);
+    if (m_gpuBVHBuild)
+    {
+      printf("The GPU builder writes binary nodes, building the BVH on the CPU instead.\n");
+      m_gpuBVHBuild = false;
+    }
+  }
+  m_renderWidth = m_info.windowWidth;
+  m_renderHeight = m_info.windowHeight;
+  m_cpuFramebuffer.Resize(m_renderWidth, m_renderHeight);
+
   // Create all needed GL resources
   m_tex = CreateFramebufferTexture();
+  m_accumTex = CreateFramebufferTexture();
+  m_costTex = CreateCostTexture();
   m_vao = QuadFullScreenVao();
-  m_computeProgram = CreateComputeProgram();
-  InitComputeProgram();
+  if (!m_sceneBuffers.Init())
+  {
+    printf("Unable to create the scene buffers, using the CPU tracer\n");
+    m_backend = Backend::CPU;
+  }
+  m_queues.Init(unsigned(m_info.windowWidth * m_info.windowHeight));
+  InitProfiler();
+  CreateWavefrontPrograms();
+  if (m_gpuBVHBuild)
+  {
+    CreateLBVHPrograms();
+  }
+  UpdateScene();
+
+  if (m_workGroupSizeX > 0 && m_workGroupSizeY > 0)
+  {
+    m_computeProgram = CreateComputeProgram(m_workGroupSizeX, m_workGroupSizeY);
+    InitComputeProgram();
+  }
+  else
+  {
+    TuneWorkGroupSize();
+  }
   m_quadProgram = CreateQuadProgram();
   InitQuadProgram();
+  return true;
+}
+
+
+bool Application::LoadScene()
+{
+  if (!m_sceneFilePath.empty())
+  {
+    if (!m_meshFiles.empty())
+    {
+      printf("Mesh files can not be added to a scene file\n");
+      return false;
+    }
+    if (!m_sceneFile.Open(m_sceneFilePath) || !m_scene.Load(m_sceneFile))
+    {
+      printf("Unable to load the scene file %s\n", m_sceneFilePath.c_str());
+      return false;
+    }
+    BVHData bvh;
+    m_bvhLoaded = m_sceneFile.GetBVH(bvh) && m_bvh.Load(m_scene, bvh);
+    return true;
+  }
+
+  m_scene.LoadDefault();
+  if (!m_meshFiles.empty())
+  {
+    Materials grey;
+    grey.color.Set(0.8f, 0.8f, 0.8f, 1.0f);
+    uint32_t materials = m_scene.AddMaterials(grey);
+    for (size_t i = 0; i < m_meshFiles.size(); i++)
+    {
+      if (!LoadMesh(m_meshFiles[i], m_scene, materials))
+      {
+        return false;
+      }
+    }
+    if (m_scene.GetMeshes().size > 0)
+    {
+      m_scene.ScatterInstances(m_scene.GetMeshes().size - 1, m_nInstances, materials);
+    }
+    if (m_bvhCache)
+    {
+      BVHResource::BuildCached(m_scene, m_meshFiles.back() + ".bvh", m_bvh);
+      m_bvhLoaded = true;
+    }
+  }
+  return true;
 }
 
 
@@ -312,8 +586,299 @@ GLuint Application::CreateFramebufferTexture()
 }
 
 
+//Integer textures cannot be filtered
+GLuint Application::CreateCostTexture()
+{
+  GLuint tex(0);
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  GLuint * zero(nullptr);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, m_info.windowWidth, m_info.windowHeight, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, zero);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return tex;
+}
+
+
+void Application::UploadBVH()
+{
+  if (m_bvhWidth > 2)
+  {
+    UploadWideBVH();
+    return;
+  }
+
+  std::vector<BVHNode> nodes(m_bvh.GetNodes());
+  std::vector<BVHPrimitive> primitives(m_bvh.GetPrimitives());
+  int32_t root = m_bvh.GetRoot();
+
+  //Empty scene. Upload a root the shader can never hit.
+  if (root < 0)
+  {
+    BVHNode empty = {};
+    empty.min[0] = empty.min[1] = empty.min[2] = 1.0f;
+    empty.max[0] = empty.max[1] = empty.max[2] = -1.0f;
+    root = int32_t(nodes.size());
+    nodes.push_back(empty);
+  }
+  if (primitives.empty())
+  {
+    primitives.push_back(BVHPrimitive());
+  }
+
+  //Room for the GPU to build the top level over the current scene after
+  //the bottom levels, one primitive per leaf
+  if (m_gpuBVHBuild)
+  {
+    size_t nTop = m_bvh.GetPrimitives().size() - m_bvh.GetTopLevelPrimitiveOffset();
+    size_t nNodes = m_bvh.GetTopLevelOffset() + GPUBVHBuilder::NodeCount(unsigned(nTop)) + 1;
+    size_t nPrimitives = m_bvh.GetTopLevelPrimitiveOffset() + nTop;
+    if (nodes.size() < nNodes) nodes.resize(nNodes);
+    if (primitives.size() < nPrimitives) primitives.resize(nPrimitives);
+  }
+  m_bvhNodeCapacity = nodes.size();
+  m_bvhPrimitiveCapacity = primitives.size();
+
+  //The root of the top level goes first, then the root of each mesh
+  std::vector<int32_t> meshRoots(1, root);
+  meshRoots.insert(meshRoots.end(), m_bvh.GetMeshRoots().begin(), m_bvh.GetMeshRoots().end());
+
+  if (m_bvhNodeBuffer == 0) glGenBuffers(1, &m_bvhNodeBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhNodeBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, nodes.size() * sizeof(BVHNode), &nodes[0], GL_DYNAMIC_DRAW);
+
+  if (m_bvhPrimitiveBuffer == 0) glGenBuffers(1, &m_bvhPrimitiveBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhPrimitiveBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, primitives.size() * sizeof(BVHPrimitive), &primitives[0], GL_STATIC_DRAW);
+
+  if (m_bvhMeshRootBuffer == 0) glGenBuffers(1, &m_bvhMeshRootBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhMeshRootBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, meshRoots.size() * sizeof(int32_t), &meshRoots[0], GL_STATIC_DRAW);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+//A refit only moves the bounds of top level nodes
+void Application::UploadBVHTopLevel()
+{
+  //Collapsing does not keep the top level nodes in place
+  if (m_bvhWidth > 2)
+  {
+    UploadWideBVH();
+    return;
+  }
+
+  std::vector<BVHNode> const & nodes = m_bvh.GetNodes();
+  size_t first = m_bvh.GetTopLevelOffset();
+  if (m_bvh.GetRoot() < 0 || first >= nodes.size())
+  {
+    return;
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhNodeBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(BVHNode), (nodes.size() - first) * sizeof(BVHNode), &nodes[first]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+//Collapses the BVH and uploads the wide nodes in place of the binary ones
+void Application::UploadWideBVH()
+{
+  if (!m_wideBVH.Build(m_bvh))
+  {
+    m_wideBVH.Clear();
+  }
+
+  //A node with no children is never hit
+  std::vector<uint8_t> nodes(m_wideBVH.GetNodes(), m_wideBVH.GetNodes() + m_wideBVH.GetNodeCount() * m_wideBVH.GetNodeSize());
+  int32_t root = m_wideBVH.GetRoot();
+  if (root < 0)
+  {
+    root = int32_t(m_wideBVH.GetNodeCount());
+    nodes.resize(nodes.size() + m_wideBVH.GetNodeSize(), 0);
+  }
+
+  std::vector<BVHPrimitive> primitives(m_wideBVH.GetPrimitives());
+  if (primitives.empty())
+  {
+    primitives.push_back(BVHPrimitive());
+  }
+
+  std::vector<int32_t> meshRoots(1, root);
+  meshRoots.insert(meshRoots.end(), m_wideBVH.GetMeshRoots().begin(), m_wideBVH.GetMeshRoots().end());
+
+  if (m_bvhNodeBuffer == 0) glGenBuffers(1, &m_bvhNodeBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhNodeBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, nodes.size(), &nodes[0], GL_DYNAMIC_DRAW);
+
+  if (m_bvhPrimitiveBuffer == 0) glGenBuffers(1, &m_bvhPrimitiveBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhPrimitiveBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, primitives.size() * sizeof(BVHPrimitive), &primitives[0], GL_STATIC_DRAW);
+
+  if (m_bvhMeshRootBuffer == 0) glGenBuffers(1, &m_bvhMeshRootBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhMeshRootBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, meshRoots.size() * sizeof(int32_t), &meshRoots[0], GL_STATIC_DRAW);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+/*
+	Replaces the top level in the BVH buffers with one built by lbvh_cs.glsl.
+	The bottom levels UploadBVH() wrote stay as they are.
+*/
+void Application::BuildTopLevelGPU()
+{
+  std::vector<BVHPrimitive> primitives;
+  std::vector<Bounds> bounds;
+  m_bvh.GetTopLevelInput(m_scene, primitives, bounds);
+
+  size_t firstNode = m_bvh.GetTopLevelOffset();
+  size_t firstPrimitive = m_bvh.GetTopLevelPrimitiveOffset();
+  unsigned nNodes = GPUBVHBuilder::NodeCount(unsigned(primitives.size()));
+  if (firstNode + nNodes + 1 > m_bvhNodeCapacity
+    || firstPrimitive + primitives.size() > m_bvhPrimitiveCapacity)
+  {
+    //Primitives were added. The CPU build sizes the buffers for them.
+    m_bvh.BuildTopLevel(m_scene);
+    UploadBVH();
+  }
+
+  m_profiler.Begin(m_stages.bvhBuild);
+  int32_t root = int32_t(firstNode);
+  if (primitives.empty())
+  {
+    BVHNode empty = {};
+    empty.min[0] = empty.min[1] = empty.min[2] = 1.0f;
+    empty.max[0] = empty.max[1] = empty.max[2] = -1.0f;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhNodeBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, firstNode * sizeof(BVHNode), sizeof(BVHNode), &empty);
+  }
+  else
+  {
+    m_gpuBVHBuilder.Build(primitives, bounds,
+                          m_bvhNodeBuffer, unsigned(firstNode),
+                          m_bvhPrimitiveBuffer, unsigned(firstPrimitive));
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bvhMeshRootBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(int32_t), &root);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  m_profiler.End(m_stages.bvhBuild);
+}
+
+
+void Application::UpdateScene()
+{
+  //A top level rebuilt in the background goes in as soon as it is done
+  if (m_bvh.EndRebuild(m_scene))
+  {
+    UploadBVH();
+  }
+
+  if (!m_scene.IsDirty())
+  {
+    return;
+  }
+
+  //Shading carried over would show the scene as it was
+  m_reprojector.Reset();
+
+  //New meshes need their own hierarchies. Anything else moving only
+  //refits the top level, until it has degraded enough to rebuild.
+  bool meshesChanged = !m_scene.DirtyMeshes().Empty()
+    || m_bvh.GetMeshRoots().size() != m_scene.GetMeshes().size;
+  if (m_bvhLoaded)
+  {
+    //Everything is dirty after loading a scene, but its hierarchy already
+    //matches
+    m_bvhLoaded = false;
+    m_cpuTracer.SetBVH(&m_bvh);
+    UploadBVH();
+  }
+  else if (m_scene.GeometryChanged() && meshesChanged)
+  {
+    m_bvh.Build(m_scene);
+    m_cpuTracer.SetBVH(&m_bvh);
+    m_cpuTopLevelStale = false;
+    UploadBVH();
+    if (m_gpuBVHBuild)
+    {
+      BuildTopLevelGPU();
+    }
+  }
+  else if (m_gpuBVHBuild && (m_scene.GeometryChanged() || m_scene.InstancesChanged()))
+  {
+    BuildTopLevelGPU();
+    m_cpuTopLevelStale = true;
+  }
+  else if (m_scene.GeometryChanged() || m_scene.InstancesChanged())
+  {
+    if (m_bvh.Refit(m_scene))
+    {
+      UploadBVHTopLevel();
+      if (m_bvh.NeedsRebuild())
+      {
+        m_bvh.BeginRebuild(m_scene);
+      }
+    }
+    else
+    {
+      m_bvh.BuildTopLevel(m_scene);
+      UploadBVH();
+    }
+  }
+
+  if (!m_sceneBuffers.Upload(m_scene) && m_backend == Backend::GPU)
+  {
+    printf("Unable to upload the scene to the GPU, switching to the CPU tracer\n");
+    m_backend = Backend::CPU;
+  }
+  m_scene.ClearDirty();
+  m_sampleCount = 0;
+}
+
+
+void Application::InitProfiler()
+{
+  m_profiler.Init();
+  m_stages.poll = m_profiler.AddStage("Poll events", false);
+  m_stages.input = m_profiler.AddStage("Input", false);
+  m_stages.scene = m_profiler.AddStage("Scene update", false);
+  m_stages.bvhBuild = m_profiler.AddStage("BVH build", true);
+  m_stages.traceGPU = m_profiler.AddStage("Trace", true);
+  m_stages.traceCPU = m_profiler.AddStage("Trace (CPU)", false);
+  m_stages.blit = m_profiler.AddStage("Blit", true);
+  m_stages.swap = m_profiler.AddStage("Swap buffers", false);
+
+  if (!m_traceFile.empty())
+  {
+    m_profiler.StartCapture();
+  }
+}
+
+
 void Application::ShutDown()
 {
+  if (m_profiler.IsCapturing())
+  {
+    m_profiler.StopCapture(m_traceFile.empty() ? "trace.json" : m_traceFile);
+  }
+  m_profiler.PrintStats();
+  m_profiler.ShutDown();
+
+  m_sceneBuffers.ShutDown();
+  m_queues.ShutDown();
+  m_raySorter.ShutDown();
+  m_gpuBVHBuilder.ShutDown();
+  glDeleteProgram(m_prepareProgram);
+  glDeleteProgram(m_shadowProgram);
+  glDeleteProgram(m_bounceProgram);
+  glDeleteProgram(m_resolveProgram);
+  glDeleteBuffers(1, &m_bvhNodeBuffer);
+  glDeleteBuffers(1, &m_bvhPrimitiveBuffer);
+  glDeleteBuffers(1, &m_bvhMeshRootBuffer);
 }
 
 
@@ -321,6 +886,101 @@ void Application::OnKey(GLFWwindow* m_window, int key, int scancode, int action,
 {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(m_window, GL_TRUE);
+
+  if (key == GLFW_KEY_B && action == GLFW_PRESS)
+  {
+    m_backend = (m_backend == Backend::GPU) ? Backend::CPU : Backend::GPU;
+    if (m_backend == Backend::GPU && !m_sceneBuffers.IsMapped())
+    {
+      printf("The scene is not on the GPU, staying on the CPU tracer\n");
+      m_backend = Backend::CPU;
+    }
+    m_sampleCount = 0;
+    m_reprojector.Reset();
+  }
+
+  if (key == GLFW_KEY_I && action == GLFW_PRESS)
+  {
+    m_profiler.PrintStats();
+    if (m_scaler.IsEnabled())
+    {
+      printf("Tracing %ix%i of %ix%i for a %.1f ms budget\n", m_renderWidth, m_renderHeight,
+             m_info.windowWidth, m_info.windowHeight, m_scaler.GetBudget());
+    }
+    if (m_reproject && m_backend == Backend::CPU && m_reprojector.GetPixelCount() > 0)
+    {
+      printf("Traced %.1f%% of the pixels of the last frame\n",
+             100.0 * double(m_reprojector.GetTraceCount()) / double(m_reprojector.GetPixelCount()));
+    }
+  }
+
+  if (key == GLFW_KEY_L && action == GLFW_PRESS)
+  {
+    m_reproject = !m_reproject;
+    m_reprojector.Reset();
+    printf("Reprojection %s%s\n", m_reproject ? "on" : "off",
+           (m_reproject && m_backend == Backend::GPU) ? ", press B for the CPU tracer" : "");
+  }
+
+  if (key == GLFW_KEY_U && action == GLFW_PRESS)
+  {
+    bool edge = (m_upscaleFilter == ResolutionScaler::Filter::Bilinear);
+    m_upscaleFilter = edge ? ResolutionScaler::Filter::EdgeAware : ResolutionScaler::Filter::Bilinear;
+    printf("Upscaling %s\n", edge ? "edge-aware" : "bilinear");
+  }
+
+  if (key == GLFW_KEY_T && action == GLFW_PRESS)
+  {
+    if (m_profiler.IsCapturing())
+      m_profiler.StopCapture(m_traceFile.empty() ? "trace.json" : m_traceFile);
+    else
+      m_profiler.StartCapture();
+  }
+
+  if (key == GLFW_KEY_P && action == GLFW_PRESS)
+  {
+    m_accumulate = !m_accumulate;
+    m_sampleCount = 0;
+  }
+
+  if (key == GLFW_KEY_O && action == GLFW_PRESS)
+  {
+    m_sortRays = !m_sortRays;
+    printf("Ray sorting %s\n", m_sortRays ? "on" : "off");
+  }
+
+  //Only the CPU tracer counts its work
+  if (key == GLFW_KEY_H && action == GLFW_PRESS)
+  {
+    m_costChannel = (m_costChannel + 1) % (CostImage::CHANNEL_COUNT + 1);
+    if (m_costChannel == CostImage::CHANNEL_COUNT)
+    {
+      printf("Cost heatmap off\n");
+    }
+    else
+    {
+      if (m_backend == Backend::GPU)
+      {
+        printf("Switching to the CPU tracer for the cost heatmap\n");
+        m_backend = Backend::CPU;
+        m_sampleCount = 0;
+      }
+      printf("Cost heatmap: %s\n", CostImage::GetName(CostImage::Channel(m_costChannel)));
+    }
+  }
+
+  if (key == GLFW_KEY_J && action == GLFW_PRESS)
+  {
+    if (m_costImage.Width() == 0)
+    {
+      printf("No cost image yet, press H to trace one\n");
+    }
+    else
+    {
+      m_costImage.PrintStats();
+      m_costImage.Write("cost");
+    }
+  }
 }
 
 
@@ -367,8 +1027,14 @@ void Application::DoInput()
 }
 
 
-void Application::Trace()
+void Application::TraceGPU()
 {
+  //Converged, nothing left to add
+  if (m_accumulate && m_sampleCount >= MAX_ACCUMULATED_SAMPLES)
+  {
+    return;
+  }
+
   glUseProgram(m_computeProgram);
 
   vec4 ray00, ray01, ray10, ray11, eye;
@@ -378,52 +1044,286 @@ void Application::Trace()
   glUniform3f(m_ray01Uniform, ray01[0], ray01[1], ray01[2]);
   glUniform3f(m_ray10Uniform, ray10[0], ray10[1], ray10[2]);
   glUniform3f(m_ray11Uniform, ray11[0], ray11[1], ray11[2]);
+  glUniform2i(m_renderSizeUniform, m_renderWidth, m_renderHeight);
+  glProgramUniform2i(m_resolveProgram, m_resolveSizeUniform, m_renderWidth, m_renderHeight);
+  m_scaler.AddFrame(m_profiler.GetFrame());
+
+  // The first sample goes through the pixel corner, the same as without
+  // accumulation. Later ones are spread over the pixel.
+  if (m_accumulate)
+  {
+    float jx = (m_sampleCount == 0) ? 0.0f : Halton(m_sampleCount, 2) - 0.5f;
+    float jy = (m_sampleCount == 0) ? 0.0f : Halton(m_sampleCount, 3) - 0.5f;
+    glUniform2f(m_jitterUniform, jx, jy);
+    glProgramUniform1i(m_resolveProgram, m_sampleIndexUniform, int(m_sampleCount));
+    m_sampleCount++;
+  }
+  else
+  {
+    glUniform2f(m_jitterUniform, 0.0f, 0.0f);
+    glProgramUniform1i(m_resolveProgram, m_sampleIndexUniform, -1);
+  }
 
   // Bind level 0 of framebuffer texture as writable image in the shader.
   glBindImageTexture(0, m_tex, 0, false, 0, GL_WRITE_ONLY, GL_RGBA32F);
+  glBindImageTexture(1, m_accumTex, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
 
-  // Compute appropriate invocation dimension.
-  int worksizeX = Dg::NextPower2(m_info.windowWidth);
-  int worksizeY = Dg::NextPower2(m_info.windowHeight);
+  // Bind the acceleration structure and scene.
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_bvhNodeBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_bvhPrimitiveBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, m_bvhMeshRootBuffer);
+  m_sceneBuffers.Bind();
+  m_queues.Bind();
+  m_queues.ResetCounters();
 
-  /* Invoke the compute shader. */
-  glDispatchCompute(worksizeX / m_workGroupSizeX, worksizeY / m_workGroupSizeY, 1);
+  // Enough work groups to cover every pixel, and no more.
+  int numGroupsX = (m_renderWidth + m_workGroupSizeX - 1) / m_workGroupSizeX;
+  int numGroupsY = (m_renderHeight + m_workGroupSizeY - 1) / m_workGroupSizeY;
+
+  /* Primary rays, then the queued shadow and reflection rays. */
+  glDispatchCompute(numGroupsX, numGroupsY, 1);
+  DispatchWavefront();
 
   /* Reset image binding. */
   glBindImageTexture(0, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
+  glBindImageTexture(1, 0, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
   glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
   glUseProgram(0);
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+  m_sceneBuffers.Fence();
+}
+
+
+/*
+	Drains the queues filled by the primary pass. Each bounce first turns
+	the queue counters into dispatch arguments, then traces the pending
+	shadow rays and the pending reflection rays with one invocation per ray,
+	each queue sorted first if ray sorting is on.
+	The shadow rays of the last bounce are traced before the resolve pass
+	writes the image.
+*/
+void Application::DispatchWavefront()
+{
+  GLbitfield const queueBarrier = GL_SHADER_STORAGE_BARRIER_BIT;
+  GLbitfield const argsBarrier = GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT;
+
+  //Binned over the bounds of the CPU hierarchy. When the GPU builds the top
+  //level these lag behind moving instances, which only costs sort quality.
+  if (m_sortRays && m_bvh.GetRoot() >= 0)
+  {
+    BVHNode const & root = m_bvh.GetNodes()[m_bvh.GetRoot()];
+    m_raySorter.SetBounds(root.min, root.max);
+  }
+
+  for (unsigned bounce = 0; bounce <= m_nReflections; bounce++)
+  {
+    glMemoryBarrier(queueBarrier);
+    glUseProgram(m_prepareProgram);
+    glUniform1i(m_prepareBounceUniform, int(bounce));
+    glDispatchCompute(1, 1, 1);
+
+    if (m_sortRays)
+    {
+      m_raySorter.Sort(GPURaySorter::QUEUE_SHADOWS, bounce);
+    }
+    glMemoryBarrier(argsBarrier);
+    glUseProgram(m_shadowProgram);
+    glUniform1i(m_shadowSortedUniform, m_sortRays ? 1 : 0);
+    glDispatchComputeIndirect(WavefrontQueues::ShadowDispatchOffset());
+
+    if (bounce < m_nReflections)
+    {
+      if (m_sortRays)
+      {
+        m_raySorter.Sort(GPURaySorter::QUEUE_RAYS, bounce);
+      }
+      glMemoryBarrier(queueBarrier);
+      glUseProgram(m_bounceProgram);
+      glUniform1i(m_bounceBounceUniform, int(bounce));
+      glUniform1i(m_bounceSortedUniform, m_sortRays ? 1 : 0);
+      glDispatchComputeIndirect(WavefrontQueues::BounceDispatchOffset());
+    }
+  }
+
+  // Resolve has one invocation per pixel
+  GLuint nPixels = GLuint(m_renderWidth * m_renderHeight);
+  glMemoryBarrier(queueBarrier);
+  glUseProgram(m_resolveProgram);
+  glDispatchCompute((nPixels + WAVEFRONT_GROUP_SIZE - 1) / WAVEFRONT_GROUP_SIZE, 1, 1);
+}
 
+
+void Application::TraceCPU()
+{
+  //The GPU has its own top level, the CPU one is only rebuilt when used
+  if (m_cpuTopLevelStale)
+  {
+    m_bvh.BuildTopLevel(m_scene);
+    m_cpuTopLevelStale = false;
+  }
+
+  bool showCost = (m_costChannel != CostImage::CHANNEL_COUNT);
+  m_cpuTracer.SetCostImage(showCost ? &m_costImage : nullptr);
+  m_cpuTracer.SetReprojector(m_reproject ? &m_reprojector : nullptr);
+  m_cpuTracer.Trace(m_camera, m_cpuFramebuffer);
+  m_scaler.AddFrame(m_profiler.GetFrame());
+
+  glBindTexture(GL_TEXTURE_2D, m_tex);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                  m_cpuFramebuffer.Width(), m_cpuFramebuffer.Height(),
+                  GL_RGBA, GL_FLOAT, m_cpuFramebuffer.Data());
+
+  if (showCost)
+  {
+    glBindTexture(GL_TEXTURE_2D, m_costTex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                    m_costImage.Width(), m_costImage.Height(),
+                    GL_RGBA_INTEGER, GL_UNSIGNED_INT, m_costImage.Data());
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void Application::DrawFramebuffer()
+{
   /*
   * Draw the rendered image on the screen using textured full-screen
   * quad.
   */
   glUseProgram(m_quadProgram);
   glBindVertexArray(m_vao);
+  glUniform2i(m_quadRenderSizeUniform, m_renderWidth, m_renderHeight);
+  glUniform1i(m_quadUpscaleUniform, (m_upscaleFilter == ResolutionScaler::Filter::EdgeAware) ? 1 : 0);
+
+  //The heatmap only means something over frames the CPU tracer counted
+  bool showCost = (m_backend == Backend::CPU && m_costChannel != CostImage::CHANNEL_COUNT);
+  if (showCost)
+  {
+    CostImage::Stats stats = m_costImage.GetStats(CostImage::Channel(m_costChannel));
+    glUniform1i(m_quadCostChannelUniform, m_costChannel);
+    glUniform1f(m_quadCostScaleUniform, float((stats.p99 > 0) ? stats.p99 : 1));
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_costTex);
+    glActiveTexture(GL_TEXTURE0);
+  }
+  else
+  {
+    glUniform1i(m_quadCostChannelUniform, -1);
+  }
+
   glBindTexture(GL_TEXTURE_2D, m_tex);
   glDrawArrays(GL_TRIANGLES, 0, 6);
   glBindTexture(GL_TEXTURE_2D, 0);
+  if (showCost)
+  {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+  }
   glBindVertexArray(0);
   glUseProgram(0);
 }
 
 
-void Application::Run()
+//--------------------------------------------------------------------------------
+//	@	Application::UpdateRenderSize()
+//--------------------------------------------------------------------------------
+void Application::UpdateRenderSize()
+{
+  int stage = (m_backend == Backend::CPU) ? m_stages.traceCPU : m_stages.traceGPU;
+  double ms(0.0);
+  uint64_t frame(0);
+  if (m_scaler.IsEnabled() && m_profiler.GetLatest(stage, ms, frame))
+  {
+    m_scaler.AddTiming(frame, ms);
+  }
+
+  //Samples only add up at one size, so a still view keeps its size until
+  //it converges. The CPU tracer does not accumulate.
+  if (m_accumulate && m_sampleCount > 0 && m_backend == Backend::GPU)
+  {
+    return;
+  }
+
+  int width(0), height(0);
+  m_scaler.GetSize(m_info.windowWidth, m_info.windowHeight, width, height);
+  if (width != m_renderWidth || height != m_renderHeight)
+  {
+    m_renderWidth = width;
+    m_renderHeight = height;
+    m_cpuFramebuffer.Resize(m_renderWidth, m_renderHeight);
+    m_sampleCount = 0;
+  }
+}
+
+
+void Application::Trace()
+{
+  //Restart accumulation whenever the view changes
+  if (m_camera.GetVersion() != m_cameraVersion)
+  {
+    m_cameraVersion = m_camera.GetVersion();
+    m_sampleCount = 0;
+  }
+
+  UpdateRenderSize();
+
+  if (m_backend == Backend::CPU)
+  {
+    ProfileScope scope(m_profiler, m_stages.traceCPU);
+    TraceCPU();
+  }
+  else
+  {
+    m_profiler.Begin(m_stages.traceGPU);
+    TraceGPU();
+    m_profiler.End(m_stages.traceGPU);
+  }
+
+  m_profiler.Begin(m_stages.blit);
+  DrawFramebuffer();
+  m_profiler.End(m_stages.blit);
+}
+
+
+bool Application::Run()
 {
   //Init all systems and data
-  Init();
+  if (!Init())
+  {
+    return false;
+  }
 
   //Run the app
   while (glfwWindowShouldClose(m_window) == GL_FALSE) 
   {
-    glfwPollEvents();
+    m_profiler.BeginFrame();
+
+    {
+      ProfileScope scope(m_profiler, m_stages.poll);
+      glfwPollEvents();
+    }
     glViewport(0, 0, m_info.windowWidth, m_info.windowHeight);
 
-    DoInput();
+    {
+      ProfileScope scope(m_profiler, m_stages.input);
+      DoInput();
+    }
+
+    {
+      ProfileScope scope(m_profiler, m_stages.scene);
+      UpdateScene();
+    }
 
     Trace();
 
-    glfwSwapBuffers(m_window);
+    {
+      ProfileScope scope(m_profiler, m_stages.swap);
+      glfwSwapBuffers(m_window);
+    }
+
+    m_profiler.EndFrame();
   }
 
   //Shut down and clean up.
@@ -431,4 +1331,5 @@ void Application::Run()
 
 	glfwDestroyWindow(m_window);
 	glfwTerminate();
+  return true;
 }
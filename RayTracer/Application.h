@@ -13,8 +13,22 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <string>
+#include <vector>
 
 #include "Camera.h"
+#include "BVH.h"
+#include "CostImage.h"
+#include "CPUTracer.h"
+#include "Framebuffer.h"
+#include "GPUBVHBuilder.h"
+#include "GPURaySorter.h"
+#include "Profiler.h"
+#include "ResolutionScaler.h"
+#include "scene.h"
+#include "SceneBuffers.h"
+#include "SceneFile.h"
+#include "WideBVH.h"
+#include "WavefrontQueues.h"
 
 struct GLFWwindow;
 
@@ -39,19 +53,107 @@ private:
   Application& operator= (const Application&);
 
   Application() : m_window(nullptr)
+    , m_backend(Backend::GPU)
+    , m_workGroupSizeX(0)
+    , m_workGroupSizeY(0)
+    , m_nReflections(NUM_REFLECTIONS)
+    , m_nInstances(0)
+    , m_gpuBVHBuild(false)
+    , m_bvhWidth(2)
+    , m_sortRays(false)
+    , m_cpuTopLevelStale(false)
+    , m_bvhLoaded(false)
+    , m_bvhCache(true)
+    , m_costTex(0)
+    , m_bvhNodeBuffer(0)
+    , m_bvhPrimitiveBuffer(0)
+    , m_bvhMeshRootBuffer(0)
+    , m_bvhNodeCapacity(0)
+    , m_bvhPrimitiveCapacity(0)
+    , m_accumulate(true)
+    , m_sampleCount(0)
+    , m_cameraVersion(0)
     , m_w(false)
     , m_s(false)
     , m_a(false)
     , m_d(false)
     , m_r(false)
-    , m_f(false){}
+    , m_f(false)
+    , m_costChannel(CostImage::CHANNEL_COUNT)
+    , m_upscaleFilter(ResolutionScaler::Filter::Bilinear)
+    , m_renderWidth(0)
+    , m_renderHeight(0)
+    , m_reproject(false){}
   ~Application() {}
 
 public:
 
   static Application * GetInstance();
 
-	void Run();
+  enum class Backend
+  {
+    GPU,  // raytracer_cs.glsl
+    CPU   // CPUTracer
+  };
+
+  //! Select the tracer. Must be called before Run().
+  void SetBackend(Backend a_backend) { m_backend = a_backend; }
+
+  //! Force the compute work group shape. 0 picks the fastest shape on startup.
+  //! Must be called before Run().
+  void SetWorkGroupSize(int a_x, int a_y) { m_workGroupSizeX = a_x; m_workGroupSizeY = a_y; }
+
+  //! Reflection bounces after the primary hit. Must be called before Run().
+  void SetReflectionCount(unsigned a_count) { m_nReflections = a_count; }
+
+  //! Record a Chrome trace of the whole run and write it to this file on exit.
+  void SetTraceFile(std::string const & a_path) { m_traceFile = a_path; }
+
+  //! OBJ or PLY file to add to the default scene. Must be called before Run().
+  void AddMeshFile(std::string const & a_path) { m_meshFiles.push_back(a_path); }
+
+  //! Scatter this many instances of the last mesh file over the scene.
+  void SetInstanceCount(unsigned a_count) { m_nInstances = a_count; }
+
+  //! Binary scene file to load instead of the default scene. Can not be
+  //! combined with mesh files. Must be called before Run().
+  void SetSceneFile(std::string const & a_path) { m_sceneFilePath = a_path; }
+
+  //! Load the BVH over the mesh files from a cache next to the last one,
+  //! see BVHResource. On by default. Must be called before Run().
+  void SetBVHCache(bool a_enable) { m_bvhCache = a_enable; }
+
+  //! Builder of the CPU hierarchy. Must be called before Run().
+  void SetBVHBuilder(BVH::Builder a_builder) { m_bvh.SetBuilder(a_builder); }
+
+  //! Rebuild the top level with lbvh_cs.glsl whenever the scene moves,
+  //! instead of refitting it on the CPU. Must be called before Run().
+  void SetGPUBVHBuild(bool a_enable) { m_gpuBVHBuild = a_enable; }
+
+  //! Children per BVH node for both tracers, 2, 4 or 8. Wider nodes are
+  //! collapsed from the binary BVH after every change. Must be called
+  //! before Run().
+  void SetBVHWidth(int a_width) { m_bvhWidth = a_width; }
+
+  //! Sort the queued shadow and reflection rays of the GPU tracer before
+  //! tracing them, see GPURaySorter. Toggled with O while running.
+  void SetRaySorting(bool a_enable) { m_sortRays = a_enable; }
+
+  //! Shrink the traced image to hold each frame near a_ms milliseconds of
+  //! tracing, see ResolutionScaler. 0, the default, always traces at the
+  //! window size. Must be called before Run().
+  void SetFrameBudget(double a_ms) { m_scaler.SetBudget(a_ms); }
+
+  //! How a shrunk image is stretched over the window. Toggled with U
+  //! while running.
+  void SetUpscaleFilter(ResolutionScaler::Filter a_filter) { m_upscaleFilter = a_filter; }
+
+  //! Carry the shading of each frame of the CPU tracer over to the next,
+  //! see Reprojector. Toggled with L while running.
+  void SetReprojection(bool a_enable) { m_reproject = a_enable; }
+
+  //! Returns false if the window or the scene could not be set up.
+	bool Run();
 	void Render(double currentTime);
 	void OnResize(int w, int h);
 	void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -85,22 +187,48 @@ public:
 
 private:
 
-  void Init();
+  bool Init();
 
-  GLuint LoadShaderFromFile(std::string path, GLenum shaderType);
+  //! Loads the scene file, or the default scene and mesh files, and the
+  //! BVH over them. Prints what failed and returns false on error.
+  bool LoadScene();
+
+  //! a_defines is inserted after the #version line.
+  GLuint LoadShaderFromFile(std::string path, GLenum shaderType, std::string defines = "");
   void Trace();
+  void TraceGPU();
+  void TraceCPU();
+  void DrawFramebuffer();
+
+  //! Picks the size of the next frame from the trace times so far.
+  void UpdateRenderSize();
 
   void DoInput();
 
   GLuint QuadFullScreenVao();
 
-  GLuint CreateComputeProgram();
+  //! a_defines selects the pass, see the end of raytracer_cs.glsl.
+  GLuint LinkComputeProgram(std::string const & defines, std::string const & file = "raytracer_cs.glsl");
+  GLuint CreateComputeProgram(int workGroupSizeX, int workGroupSizeY);
   void InitComputeProgram();
+  void CreateWavefrontPrograms();
+  void CreateLBVHPrograms();
+  void DispatchWavefront();
+  void TuneWorkGroupSize();
 
   GLuint CreateQuadProgram();
   void InitQuadProgram();
 
   GLuint CreateFramebufferTexture();
+  GLuint CreateCostTexture();
+
+  void UploadBVH();
+  void UploadBVHTopLevel();
+  void BuildTopLevelGPU();
+  void UploadWideBVH();
+  void UpdateScene();
+
+  void InitProfiler();
 
   void ShutDown();
 
@@ -109,19 +237,56 @@ private:
 	APPINFO		    m_info;
 	GLFWwindow*   m_window;
 
+  Backend       m_backend;
+
   GLint         m_workGroupSizeX;
   GLint         m_workGroupSizeY;
+  unsigned      m_nReflections;
+  unsigned      m_nInstances;
+  bool          m_gpuBVHBuild;
+  int           m_bvhWidth;
+  bool          m_sortRays;
+  bool          m_cpuTopLevelStale;   //The GPU built the top level since the CPU one
+  bool          m_bvhLoaded;          //The BVH was loaded rather than built and is not uploaded yet
+  bool          m_bvhCache;
 
   GLuint        m_vao;
   GLuint        m_tex;
-  GLuint        m_computeProgram;
+  GLuint        m_accumTex;
+  GLuint        m_costTex;          //CostImage of the CPU tracer
+  GLuint        m_computeProgram;   //Primary rays
+  GLuint        m_prepareProgram;
+  GLuint        m_shadowProgram;
+  GLuint        m_bounceProgram;
+  GLuint        m_resolveProgram;
   GLuint        m_quadProgram;
+  GLuint        m_bvhNodeBuffer;
+  GLuint        m_bvhPrimitiveBuffer;
+  GLuint        m_bvhMeshRootBuffer;
+  size_t        m_bvhNodeCapacity;
+  size_t        m_bvhPrimitiveCapacity;
 
   GLuint        m_eyeUniform;
   GLuint        m_ray00Uniform;
   GLuint        m_ray10Uniform;
   GLuint        m_ray01Uniform;
   GLuint        m_ray11Uniform;
+  GLuint        m_jitterUniform;
+  GLuint        m_sampleIndexUniform;   //Resolve pass
+  GLuint        m_renderSizeUniform;
+  GLuint        m_resolveSizeUniform;
+  GLuint        m_prepareBounceUniform;
+  GLuint        m_bounceBounceUniform;
+  GLuint        m_shadowSortedUniform;
+  GLuint        m_bounceSortedUniform;
+  GLuint        m_quadRenderSizeUniform;  //Quad program
+  GLuint        m_quadUpscaleUniform;
+  GLuint        m_quadCostChannelUniform;
+  GLuint        m_quadCostScaleUniform;
+
+  bool          m_accumulate;
+  unsigned      m_sampleCount;
+  unsigned      m_cameraVersion;
 
   double        m_mouseX;
   double        m_mouseY; 
@@ -136,6 +301,46 @@ private:
   bool          m_f;
 
   Camera        m_camera;
+
+  Profiler      m_profiler;
+  std::string   m_traceFile;
+  std::vector<std::string>  m_meshFiles;
+  std::string   m_sceneFilePath;
+
+  struct
+  {
+    int poll;
+    int input;
+    int scene;
+    int bvhBuild;
+    int traceGPU;
+    int traceCPU;
+    int blit;
+    int swap;
+  }             m_stages;
+
+  SceneFile     m_sceneFile;          //Mapped for as long as m_scene uses it
+  Scene         m_scene;
+  BVH           m_bvh;
+  GPUBVHBuilder m_gpuBVHBuilder;
+  GPURaySorter  m_raySorter;
+  WideBVH       m_wideBVH;
+  SceneBuffers  m_sceneBuffers;
+  WavefrontQueues m_queues;
+  CPUTracer     m_cpuTracer;
+  Framebuffer   m_cpuFramebuffer;
+  CostImage     m_costImage;
+  int           m_costChannel;        //CHANNEL_COUNT shows the image instead
+
+  //Both tracers fill the lower left m_renderWidth x m_renderHeight of the
+  //window sized textures
+  ResolutionScaler          m_scaler;
+  ResolutionScaler::Filter  m_upscaleFilter;
+  int           m_renderWidth;
+  int           m_renderHeight;
+
+  Reprojector   m_reprojector;
+  bool          m_reproject;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1293 @@
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "BVH.h"
+#include "LBVH.h"
+
+#define BVH_NUM_BINS      16
+
+//Dirty leaves below which a refit is not worth spreading over threads
+#define BVH_PARALLEL_REFIT  1024
+
+//Relative costs used by the surface area heuristic
+static const float s_traversalCost = 1.0f;
+static const float s_intersectCost = 1.0f;
+
+//Widens the far slab distance by 2 gamma(3) so rounding in the slab test
+//never culls a ray through a vertex on the boundary of a node (Ize 2013).
+static const float s_slabFarScale = 1.0f + 2.0f * 3.0f * FLT_EPSILON * 0.5f / (1.0f - 3.0f * FLT_EPSILON * 0.5f);
+
+
+//--------------------------------------------------------------------------------
+//	@	Bounds
+//--------------------------------------------------------------------------------
+void Bounds::Empty()
+{
+  for (int i = 0; i < 3; i++)
+  {
+    min[i] = FLT_MAX;
+    max[i] = -FLT_MAX;
+  }
+}
+
+
+void Bounds::Grow(Bounds const & a_other)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    if (a_other.min[i] < min[i]) min[i] = a_other.min[i];
+    if (a_other.max[i] > max[i]) max[i] = a_other.max[i];
+  }
+}
+
+
+void Bounds::Grow(float const a_point[3])
+{
+  for (int i = 0; i < 3; i++)
+  {
+    if (a_point[i] < min[i]) min[i] = a_point[i];
+    if (a_point[i] > max[i]) max[i] = a_point[i];
+  }
+}
+
+
+float Bounds::SurfaceArea() const
+{
+  float dx = max[0] - min[0];
+  float dy = max[1] - min[1];
+  float dz = max[2] - min[2];
+  if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+  {
+    return 0.0f;
+  }
+  return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+
+//Bounds of a disk with the given centre and normal
+static void GrowDisk(Bounds & a_bounds, vec4 const & a_center, vec4 const & a_normal, real a_radius)
+{
+  float nn = a_normal[0] * a_normal[0] + a_normal[1] * a_normal[1] + a_normal[2] * a_normal[2];
+  float lower[3], upper[3];
+  for (int i = 0; i < 3; i++)
+  {
+    float extent = a_radius * sqrt(std::max(0.0f, 1.0f - a_normal[i] * a_normal[i] / nn));
+    lower[i] = a_center[i] - extent;
+    upper[i] = a_center[i] + extent;
+  }
+  a_bounds.Grow(lower);
+  a_bounds.Grow(upper);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::GetBounds()
+//--------------------------------------------------------------------------------
+Bounds BVH::GetBounds(Scene const & a_scene, BVHPrimitive const & a_prim)
+{
+  Bounds result;
+  result.Empty();
+
+  switch (a_prim.type)
+  {
+    case TYPE_AABB:
+    {
+      AABB const & box = a_scene.GetBoxes()[a_prim.index];
+      for (int i = 0; i < 3; i++)
+      {
+        result.min[i] = box.min[i];
+        result.max[i] = box.max[i];
+      }
+      break;
+    }
+    case TYPE_SPHERE:
+    {
+      Sphere const & sphere = a_scene.GetSpheres()[a_prim.index];
+      for (int i = 0; i < 3; i++)
+      {
+        result.min[i] = sphere.center[i] - sphere.radius;
+        result.max[i] = sphere.center[i] + sphere.radius;
+      }
+      break;
+    }
+    case TYPE_OBB:
+    {
+      OBB const & box = a_scene.GetOBBs()[a_prim.index];
+      for (int i = 0; i < 3; i++)
+      {
+        float extent = 0.0f;
+        for (int a = 0; a < 3; a++)
+        {
+          extent += fabs(box.axes[a][i]) * box.extents[a];
+        }
+        result.min[i] = box.center[i] - extent;
+        result.max[i] = box.center[i] + extent;
+      }
+      break;
+    }
+    case TYPE_CAPSULE:
+    {
+      Capsule const & capsule = a_scene.GetCapsules()[a_prim.index];
+      for (int i = 0; i < 3; i++)
+      {
+        float p0 = capsule.origin[i];
+        float p1 = p0 + capsule.direction[i];
+        result.min[i] = ((p0 < p1) ? p0 : p1) - capsule.radius;
+        result.max[i] = ((p0 < p1) ? p1 : p0) + capsule.radius;
+      }
+      break;
+    }
+    case TYPE_CYLINDER:
+    {
+      Cylinder const & cylinder = a_scene.GetCylinders()[a_prim.index];
+      GrowDisk(result, cylinder.origin, cylinder.direction, cylinder.radius);
+      GrowDisk(result, cylinder.origin + cylinder.direction, cylinder.direction, cylinder.radius);
+      break;
+    }
+    case TYPE_TORUS:
+    {
+      Torus const & torus = a_scene.GetTori()[a_prim.index];
+      for (int i = 0; i < 3; i++)
+      {
+        //Extent of the centre circle along each axis, plus the tube
+        float a = torus.axis[i];
+        float extent = torus.radius_circle * sqrt(std::max(0.0f, 1.0f - a * a)) + torus.radius_thick;
+        result.min[i] = torus.center[i] - extent;
+        result.max[i] = torus.center[i] + extent;
+      }
+      break;
+    }
+    case TYPE_CONE:
+    {
+      ConeSegment const & cone = a_scene.GetCones()[a_prim.index];
+      GrowDisk(result, cone.origin, cone.direction, cone.r0);
+      GrowDisk(result, cone.origin + cone.direction, cone.direction, cone.r1);
+      break;
+    }
+    case TYPE_MESH:
+    {
+      Mesh const & mesh = a_scene.GetMeshes()[a_prim.index];
+      float const * positions = a_scene.GetPositions().data + 3 * mesh.firstVertex;
+      for (unsigned v = 0; v < mesh.nVertices; v++)
+      {
+        result.Grow(positions + 3 * v);
+      }
+      break;
+    }
+    case TYPE_INSTANCE:
+    {
+      Instance const & instance = a_scene.GetInstances()[a_prim.index];
+      BVHPrimitive mesh = {TYPE_MESH, int32_t(instance.mesh)};
+      result = Transform(GetBounds(a_scene, mesh), instance.transform);
+      break;
+    }
+  }
+
+  return result;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::Transform()
+//--------------------------------------------------------------------------------
+//		Transforms the centre and projects the rotated half extents onto the
+//		world axes. Gives the same box as bounding all 8 corners, with 3
+//		rotations instead of 8 transforms. Refits spend most of their time here.
+//--------------------------------------------------------------------------------
+Bounds BVH::Transform(Bounds const & a_bounds, vqs const & a_transform)
+{
+  vec4 center(a_bounds.Centroid(0), a_bounds.Centroid(1), a_bounds.Centroid(2), 1.0f);
+  center = a_transform.TransformPoint(center);
+
+  float extent[3] = {0.0f, 0.0f, 0.0f};
+  for (int a = 0; a < 3; a++)
+  {
+    vec4 axis(0.0f, 0.0f, 0.0f, 0.0f);
+    axis[a] = 0.5f * a_transform.S() * (a_bounds.max[a] - a_bounds.min[a]);
+    axis = a_transform.Rotate(axis);
+    for (int i = 0; i < 3; i++)
+    {
+      extent[i] += fabs(axis[i]);
+    }
+  }
+
+  Bounds result;
+  for (int i = 0; i < 3; i++)
+  {
+    result.min[i] = center[i] - extent[i];
+    result.max[i] = center[i] + extent[i];
+  }
+  return result;
+}
+
+
+static Bounds GetNodeBounds(BVHNode const & a_node)
+{
+  Bounds result;
+  for (int i = 0; i < 3; i++)
+  {
+    result.min[i] = a_node.min[i];
+    result.max[i] = a_node.max[i];
+  }
+  return result;
+}
+
+
+static void SetNodeBounds(BVHNode & a_node, Bounds const & a_bounds)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    a_node.min[i] = a_bounds.min[i];
+    a_node.max[i] = a_bounds.max[i];
+  }
+}
+
+
+//Term of a node in the SAH cost of the tree, before dividing by the root area
+static double GetNodeCost(BVHNode const & a_node)
+{
+  float weight = (a_node.count > 0) ? s_intersectCost * float(a_node.count) : s_traversalCost;
+  return double(weight * GetNodeBounds(a_node).SurfaceArea());
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::~BVH()
+//--------------------------------------------------------------------------------
+BVH::~BVH()
+{
+  CancelRebuild();
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::Clear()
+//--------------------------------------------------------------------------------
+void BVH::Clear()
+{
+  CancelRebuild();
+
+  m_nodes.clear();
+  m_primitives.clear();
+  m_meshRoots.clear();
+  m_meshBounds.clear();
+  m_root = -1;
+  m_bottomNodes = 0;
+  m_bottomPrimitives = 0;
+  IndexTopLevel();
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::Load()
+//--------------------------------------------------------------------------------
+bool BVH::Load(Scene const & a_scene, BVHData const & a_data)
+{
+  Clear();
+
+  //Mesh hierarchies come one after the other from the start of the
+  //arrays, the top level after them, as Build() leaves them
+  qArray<Mesh> const & meshes = a_scene.GetMeshes();
+  bool valid = a_data.nMeshRoots == meshes.size
+    && a_data.bottomNodes <= a_data.nNodes
+    && a_data.bottomPrimitives <= a_data.nPrimitives
+    && ((a_data.root < 0) ? a_data.bottomNodes == a_data.nNodes
+                          : unsigned(a_data.root) == a_data.bottomNodes && a_data.bottomNodes < a_data.nNodes);
+
+  for (unsigned m = 0; valid && m < meshes.size; m++)
+  {
+    int32_t first = a_data.meshRoots[m];
+    int32_t end = (m + 1 < meshes.size) ? a_data.meshRoots[m + 1] : int32_t(a_data.bottomNodes);
+    valid = (m > 0 || first == 0)
+      && first < end
+      && unsigned(end) <= a_data.bottomNodes
+      && ValidateTree(a_data, first, end, 0, a_data.bottomPrimitives);
+
+    for (int32_t i = first; valid && i < end; i++)
+    {
+      BVHNode const & node = a_data.nodes[i];
+      for (int32_t p = node.offset; valid && p < node.offset + node.count; p++)
+      {
+        BVHPrimitive const & prim = a_data.primitives[p];
+        valid = prim.type == TYPE_TRIANGLE && prim.index >= 0 && unsigned(prim.index) < meshes[m].nTriangles;
+      }
+    }
+  }
+
+  //The top level has to hold every primitive of the scene exactly once, in
+  //a leaf reachable from the root. Refit() finds a primitive's leaf through
+  //IndexTopLevel(), which would leave a missing one unindexed.
+  if (valid && a_data.root >= 0)
+  {
+    valid = ValidateTree(a_data, a_data.bottomNodes, a_data.nNodes, a_data.bottomPrimitives, a_data.nPrimitives);
+
+    unsigned firstKey[TYPE_COUNT + 1] = {};
+    for (int type = 0; type < TYPE_COUNT; type++)
+    {
+      firstKey[type + 1] = firstKey[type] + GetPrimitiveCount(a_scene, type);
+    }
+    valid = valid && a_data.nPrimitives - a_data.bottomPrimitives == firstKey[TYPE_COUNT];
+
+    std::vector<bool> seen(firstKey[TYPE_COUNT], false);
+    std::vector<int32_t> stack(1, a_data.root);
+    unsigned nNodes = 0;
+    unsigned nSeen = 0;
+    while (valid && !stack.empty())
+    {
+      int32_t i = stack.back();
+      stack.pop_back();
+      nNodes++;
+
+      BVHNode const & node = a_data.nodes[i];
+      if (node.count == 0)
+      {
+        stack.push_back(i + 1);
+        stack.push_back(node.offset);
+        continue;
+      }
+
+      for (int32_t p = node.offset; valid && p < node.offset + node.count; p++)
+      {
+        BVHPrimitive const & prim = a_data.primitives[p];
+        valid = prim.type >= 0 && prim.type < TYPE_COUNT
+          && prim.index >= 0 && unsigned(prim.index) < GetPrimitiveCount(a_scene, prim.type)
+          && !seen[firstKey[prim.type] + prim.index];
+        if (valid)
+        {
+          seen[firstKey[prim.type] + prim.index] = true;
+          nSeen++;
+        }
+      }
+    }
+    valid = valid && nSeen == firstKey[TYPE_COUNT] && nNodes == a_data.nNodes - a_data.bottomNodes;
+  }
+
+  if (!valid)
+  {
+    printf("The saved BVH does not match the scene\n");
+    return false;
+  }
+
+  m_nodes.assign(a_data.nodes, a_data.nodes + a_data.nNodes);
+  m_primitives.assign(a_data.primitives, a_data.primitives + a_data.nPrimitives);
+  m_meshRoots.assign(a_data.meshRoots, a_data.meshRoots + a_data.nMeshRoots);
+  m_root = a_data.root;
+  m_bottomNodes = a_data.bottomNodes;
+  m_bottomPrimitives = a_data.bottomPrimitives;
+
+  m_meshBounds.resize(meshes.size);
+  for (unsigned m = 0; m < meshes.size; m++)
+  {
+    BVHNode const & root = m_nodes[m_meshRoots[m]];
+    for (int a = 0; a < 3; a++)
+    {
+      m_meshBounds[m].min[a] = root.min[a];
+      m_meshBounds[m].max[a] = root.max[a];
+    }
+  }
+
+  IndexTopLevel();
+  m_buildCost = GetCost();
+  return true;
+}
+
+
+BVHData BVH::GetData() const
+{
+  BVHData data;
+  data.nodes = m_nodes.empty() ? nullptr : &m_nodes[0];
+  data.nNodes = unsigned(m_nodes.size());
+  data.primitives = m_primitives.empty() ? nullptr : &m_primitives[0];
+  data.nPrimitives = unsigned(m_primitives.size());
+  data.meshRoots = m_meshRoots.empty() ? nullptr : &m_meshRoots[0];
+  data.nMeshRoots = unsigned(m_meshRoots.size());
+  data.root = m_root;
+  data.bottomNodes = unsigned(m_bottomNodes);
+  data.bottomPrimitives = unsigned(m_bottomPrimitives);
+  return data;
+}
+
+
+//Children come after their parent and stay inside the range, so traversal
+//ends, and leaves stay inside their part of the primitive list
+bool BVH::ValidateTree(BVHData const & a_data, unsigned a_firstNode, unsigned a_endNode,
+                       unsigned a_firstPrimitive, unsigned a_endPrimitive)
+{
+  for (unsigned i = a_firstNode; i < a_endNode; i++)
+  {
+    BVHNode const & node = a_data.nodes[i];
+    if (node.count > 0)
+    {
+      if (node.offset < int32_t(a_firstPrimitive)
+        || int64_t(node.offset) + node.count > int64_t(a_endPrimitive))
+      {
+        return false;
+      }
+    }
+    else if (node.count < 0
+      || i + 1 >= a_endNode
+      || node.offset <= int32_t(i + 1)
+      || node.offset >= int32_t(a_endNode))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::Build()
+//--------------------------------------------------------------------------------
+void BVH::Build(Scene const & a_scene)
+{
+  Clear();
+
+  //Each mesh gets its own hierarchy over its triangles. They are stored
+  //first, so rebuilding the top level leaves them where they are.
+  std::vector<BuildItem> items;
+  qArray<Mesh> const & meshes = a_scene.GetMeshes();
+  m_meshRoots.resize(meshes.size);
+  m_meshBounds.resize(meshes.size);
+  for (unsigned m = 0; m < meshes.size; m++)
+  {
+    Mesh const & mesh = meshes[m];
+    items.resize(mesh.nTriangles);
+    for (unsigned i = 0; i < mesh.nTriangles; i++)
+    {
+      BuildItem & triangle = items[i];
+      triangle.primitive.type = TYPE_TRIANGLE;
+      triangle.primitive.index = int32_t(i);
+      triangle.bounds.Empty();
+      for (int c = 0; c < 3; c++)
+      {
+        triangle.bounds.Grow(a_scene.GetTriangleVertex(mesh, i, c));
+      }
+    }
+    m_meshRoots[m] = BuildTree(items, m_nodes, m_primitives);
+
+    BVHNode const & root = m_nodes[m_meshRoots[m]];
+    for (int a = 0; a < 3; a++)
+    {
+      m_meshBounds[m].min[a] = root.min[a];
+      m_meshBounds[m].max[a] = root.max[a];
+    }
+  }
+
+  m_bottomNodes = m_nodes.size();
+  m_bottomPrimitives = m_primitives.size();
+
+  BuildTopLevel(a_scene);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::BuildTopLevel()
+//--------------------------------------------------------------------------------
+void BVH::BuildTopLevel(Scene const & a_scene)
+{
+  CancelRebuild();
+
+  m_nodes.resize(m_bottomNodes);
+  m_primitives.resize(m_bottomPrimitives);
+  m_root = -1;
+
+  std::vector<BuildItem> items;
+  GetTopLevelItems(a_scene, items);
+  if (!items.empty())
+  {
+    m_root = BuildTree(items, m_nodes, m_primitives);
+  }
+
+  IndexTopLevel();
+  m_buildCost = GetCost();
+}
+
+
+void BVH::GetTopLevelItems(Scene const & a_scene, std::vector<BuildItem> & a_items) const
+{
+  a_items.clear();
+
+  BuildItem item;
+  for (int type = 0; type < TYPE_COUNT; type++)
+  {
+    item.primitive.type = type;
+    unsigned count = GetPrimitiveCount(a_scene, type);
+    for (unsigned i = 0; i < count; i++)
+    {
+      item.primitive.index = i;
+      item.bounds = GetTopLevelBounds(a_scene, item.primitive);
+      a_items.push_back(item);
+    }
+  }
+}
+
+
+void BVH::GetTopLevelInput(Scene const & a_scene,
+                           std::vector<BVHPrimitive> & a_primitives,
+                           std::vector<Bounds> & a_bounds) const
+{
+  std::vector<BuildItem> items;
+  GetTopLevelItems(a_scene, items);
+  a_primitives.resize(items.size());
+  a_bounds.resize(items.size());
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    a_primitives[i] = items[i].primitive;
+    a_bounds[i] = items[i].bounds;
+  }
+}
+
+
+//Mesh bounds come from the mesh hierarchies rather than every vertex
+Bounds BVH::GetTopLevelBounds(Scene const & a_scene, BVHPrimitive const & a_prim) const
+{
+  if (a_prim.type == TYPE_MESH)
+  {
+    return m_meshBounds[a_prim.index];
+  }
+  if (a_prim.type == TYPE_INSTANCE)
+  {
+    Instance const & instance = a_scene.GetInstances()[a_prim.index];
+    return Transform(m_meshBounds[instance.mesh], instance.transform);
+  }
+  return GetBounds(a_scene, a_prim);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::BuildTree()
+//--------------------------------------------------------------------------------
+//		Appends a hierarchy over the items to the node and primitive arrays.
+//		Returns the index of its root.
+//--------------------------------------------------------------------------------
+int BVH::BuildTree(std::vector<BuildItem> & a_items,
+                   std::vector<BVHNode> & a_nodes,
+                   std::vector<BVHPrimitive> & a_primitives) const
+{
+  int root = int(a_nodes.size());
+  int firstPrimitive = int(a_primitives.size());
+  a_primitives.reserve(a_primitives.size() + a_items.size());
+
+  if (m_builder == Builder::SAH)
+  {
+    for (size_t i = 0; i < a_items.size(); i++)
+    {
+      for (int a = 0; a < 3; a++)
+      {
+        a_items[i].centroid[a] = a_items[i].bounds.Centroid(a);
+      }
+    }
+
+    a_nodes.reserve(a_nodes.size() + 2 * a_items.size());
+    a_nodes.push_back(BVHNode());
+    BuildRecursive(a_items, a_nodes, root, 0, int(a_items.size()), 1);
+
+    for (size_t i = 0; i < a_items.size(); i++)
+    {
+      a_primitives.push_back(a_items[i].primitive);
+    }
+  }
+  else
+  {
+    std::vector<Bounds> bounds(a_items.size());
+    for (size_t i = 0; i < a_items.size(); i++)
+    {
+      bounds[i] = a_items[i].bounds;
+    }
+
+    LBVHBuilder lbvh;
+    lbvh.SetMaxLeafSize(m_maxLeafSize);
+    lbvh.Use64BitCodes(m_builder == Builder::LBVH63);
+    std::vector<uint32_t> order;
+    lbvh.Build(bounds, a_nodes, order);
+
+    for (size_t i = 0; i < order.size(); i++)
+    {
+      a_primitives.push_back(a_items[order[i]].primitive);
+    }
+  }
+
+  //Leaves were built with offsets into the list of items
+  for (size_t i = root; i < a_nodes.size(); i++)
+  {
+    if (a_nodes[i].count > 0)
+    {
+      a_nodes[i].offset += firstPrimitive;
+    }
+  }
+
+  return root;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::BuildRecursive()
+//--------------------------------------------------------------------------------
+void BVH::BuildRecursive(std::vector<BuildItem> & a_items, std::vector<BVHNode> & a_nodes,
+                         int a_node, int a_first, int a_count, int a_depth) const
+{
+  Bounds bounds;
+  bounds.Empty();
+  for (int i = a_first; i < a_first + a_count; i++)
+  {
+    bounds.Grow(a_items[i].bounds);
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    a_nodes[a_node].min[i] = bounds.min[i];
+    a_nodes[a_node].max[i] = bounds.max[i];
+  }
+
+  //Past the depth a traversal stack holds, everything left is one leaf
+  int split = (a_depth < BVH_STACK_SIZE) ? Partition(a_items, a_first, a_count, bounds) : -1;
+  if (split < 0)
+  {
+    a_nodes[a_node].offset = a_first;
+    a_nodes[a_node].count = a_count;
+    return;
+  }
+
+  int left = int(a_nodes.size());
+  a_nodes.push_back(BVHNode());
+  BuildRecursive(a_items, a_nodes, left, a_first, split - a_first, a_depth + 1);
+
+  int right = int(a_nodes.size());
+  a_nodes.push_back(BVHNode());
+  BuildRecursive(a_items, a_nodes, right, split, a_first + a_count - split, a_depth + 1);
+
+  a_nodes[a_node].offset = right;
+  a_nodes[a_node].count = 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::Partition()
+//--------------------------------------------------------------------------------
+//		Finds the cheapest binned SAH split and partitions the items around it.
+//		Returns the index of the first item on the right, or -1 if a leaf is
+//		cheaper than any split.
+//--------------------------------------------------------------------------------
+int BVH::Partition(std::vector<BuildItem> & a_items, int a_first, int a_count, Bounds const & a_nodeBounds) const
+{
+  if (a_count <= 1)
+  {
+    return -1;
+  }
+
+  Bounds centroidBounds;
+  centroidBounds.Empty();
+  for (int i = a_first; i < a_first + a_count; i++)
+  {
+    centroidBounds.Grow(a_items[i].centroid);
+  }
+
+  float bestCost = FLT_MAX;
+  int bestAxis = -1;
+  int bestBin = 0;
+
+  for (int axis = 0; axis < 3; axis++)
+  {
+    float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+    if (extent <= 0.0f)
+    {
+      continue;
+    }
+
+    Bounds binBounds[BVH_NUM_BINS];
+    int binCounts[BVH_NUM_BINS] = {};
+    for (int b = 0; b < BVH_NUM_BINS; b++)
+    {
+      binBounds[b].Empty();
+    }
+
+    float scale = float(BVH_NUM_BINS) / extent;
+    for (int i = a_first; i < a_first + a_count; i++)
+    {
+      int b = int((a_items[i].centroid[axis] - centroidBounds.min[axis]) * scale);
+      if (b >= BVH_NUM_BINS) b = BVH_NUM_BINS - 1;
+      binCounts[b]++;
+      binBounds[b].Grow(a_items[i].bounds);
+    }
+
+    //Sweep from the right to get the cost of everything right of each plane
+    float rightArea[BVH_NUM_BINS - 1];
+    int rightCount[BVH_NUM_BINS - 1];
+    Bounds accum;
+    accum.Empty();
+    int count = 0;
+    for (int b = BVH_NUM_BINS - 1; b > 0; b--)
+    {
+      accum.Grow(binBounds[b]);
+      count += binCounts[b];
+      rightArea[b - 1] = accum.SurfaceArea();
+      rightCount[b - 1] = count;
+    }
+
+    accum.Empty();
+    count = 0;
+    for (int b = 0; b < BVH_NUM_BINS - 1; b++)
+    {
+      accum.Grow(binBounds[b]);
+      count += binCounts[b];
+      if (count == 0 || rightCount[b] == 0)
+      {
+        continue;
+      }
+
+      float cost = accum.SurfaceArea() * float(count) + rightArea[b] * float(rightCount[b]);
+      if (cost < bestCost)
+      {
+        bestCost = cost;
+        bestAxis = axis;
+        bestBin = b;
+      }
+    }
+  }
+
+  float nodeArea = a_nodeBounds.SurfaceArea();
+  float leafCost = s_intersectCost * float(a_count);
+
+  if (bestAxis < 0)
+  {
+    //All centroids coincide. Only split if the leaf would be too big.
+    if (a_count <= m_maxLeafSize)
+    {
+      return -1;
+    }
+    return a_first + a_count / 2;
+  }
+
+  float splitCost = s_traversalCost;
+  if (nodeArea > 0.0f)
+  {
+    splitCost += s_intersectCost * bestCost / nodeArea;
+  }
+
+  if (a_count <= m_maxLeafSize && leafCost <= splitCost)
+  {
+    return -1;
+  }
+
+  float extent = centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis];
+  float scale = float(BVH_NUM_BINS) / extent;
+  float minC = centroidBounds.min[bestAxis];
+  BuildItem * mid = std::partition(&a_items[a_first], &a_items[a_first] + a_count,
+    [=](BuildItem const & a_item)
+  {
+    int b = int((a_item.centroid[bestAxis] - minC) * scale);
+    if (b >= BVH_NUM_BINS) b = BVH_NUM_BINS - 1;
+    return b <= bestBin;
+  });
+
+  return int(mid - &a_items[0]);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::IndexTopLevel()
+//--------------------------------------------------------------------------------
+void BVH::IndexTopLevel()
+{
+  size_t nNodes = m_nodes.size() - m_bottomNodes;
+  m_parents.assign(nNodes, -1);
+  m_dirty.assign(nNodes, 0);
+  m_nDirtyLeaves = 0;
+  m_cost = 0.0;
+
+  for (int type = 0; type <= TYPE_COUNT; type++)
+  {
+    m_firstKey[type] = 0;
+  }
+  for (size_t i = m_bottomPrimitives; i < m_primitives.size(); i++)
+  {
+    m_firstKey[m_primitives[i].type + 1]++;
+  }
+  for (int type = 0; type < TYPE_COUNT; type++)
+  {
+    m_firstKey[type + 1] += m_firstKey[type];
+  }
+  m_leaves.assign(m_firstKey[TYPE_COUNT], -1);
+
+  for (size_t i = m_bottomNodes; i < m_nodes.size(); i++)
+  {
+    BVHNode const & node = m_nodes[i];
+    m_cost += GetNodeCost(node);
+    if (node.count > 0)
+    {
+      for (int p = node.offset; p < node.offset + node.count; p++)
+      {
+        BVHPrimitive const & prim = m_primitives[p];
+        m_leaves[m_firstKey[prim.type] + prim.index] = int32_t(i);
+      }
+    }
+    else
+    {
+      m_parents[i + 1 - m_bottomNodes] = int32_t(i);
+      m_parents[node.offset - m_bottomNodes] = int32_t(i);
+    }
+  }
+}
+
+
+bool BVH::MatchesScene(Scene const & a_scene) const
+{
+  for (int type = 0; type < TYPE_COUNT; type++)
+  {
+    if (m_firstKey[type + 1] - m_firstKey[type] != GetPrimitiveCount(a_scene, type))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::GetCost()
+//--------------------------------------------------------------------------------
+float BVH::GetCost() const
+{
+  if (m_root < 0)
+  {
+    return 0.0f;
+  }
+  float area = GetNodeBounds(m_nodes[m_root]).SurfaceArea();
+  return (area > 0.0f) ? float(m_cost / double(area)) : 0.0f;
+}
+
+
+bool BVH::NeedsRebuild() const
+{
+  return m_buildCost > 0.0f && GetCost() > m_rebuildThreshold * m_buildCost;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::Refit()
+//--------------------------------------------------------------------------------
+static DirtyRange const & GetDirtyRange(Scene const & a_scene, int a_type)
+{
+  switch (a_type)
+  {
+    case TYPE_AABB:     return a_scene.DirtyBoxes();
+    case TYPE_SPHERE:   return a_scene.DirtySpheres();
+    case TYPE_OBB:      return a_scene.DirtyOBBs();
+    case TYPE_CAPSULE:  return a_scene.DirtyCapsules();
+    case TYPE_CYLINDER: return a_scene.DirtyCylinders();
+    case TYPE_TORUS:    return a_scene.DirtyTori();
+    case TYPE_CONE:     return a_scene.DirtyCones();
+    case TYPE_MESH:     return a_scene.DirtyMeshes();
+  }
+  return a_scene.DirtyInstances();
+}
+
+
+bool BVH::Refit(Scene const & a_scene)
+{
+  if (!MatchesScene(a_scene))
+  {
+    return false;
+  }
+
+  for (int type = 0; type < TYPE_COUNT; type++)
+  {
+    DirtyRange const & range = GetDirtyRange(a_scene, type);
+    for (unsigned i = range.first; i < range.end; i++)
+    {
+      MarkDirty(m_leaves[m_firstKey[type] + i]);
+    }
+  }
+
+  RefitDirty(a_scene);
+  return true;
+}
+
+
+//Flags the node and its ancestors, stopping at the first one already flagged
+void BVH::MarkDirty(int a_node)
+{
+  if (m_nodes[a_node].count > 0 && !m_dirty[a_node - m_bottomNodes])
+  {
+    m_nDirtyLeaves++;
+  }
+
+  while (a_node >= 0 && !m_dirty[a_node - m_bottomNodes])
+  {
+    m_dirty[a_node - m_bottomNodes] = 1;
+    a_node = m_parents[a_node - m_bottomNodes];
+  }
+}
+
+
+void BVH::RefitDirty(Scene const & a_scene)
+{
+  if (m_root < 0 || !m_dirty[m_root - m_bottomNodes])
+  {
+    return;
+  }
+
+  unsigned nThreads = 1;
+  if (m_nDirtyLeaves >= BVH_PARALLEL_REFIT)
+  {
+    nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+  }
+
+  //Split the dirty part of the tree into a few subtrees per thread. The
+  //interior nodes above them are refit afterwards, on this thread.
+  std::vector<int> subtrees(1, m_root);
+  std::vector<int> upper;
+  while (nThreads > 1 && subtrees.size() < 4 * nThreads)
+  {
+    std::vector<int> next;
+    for (size_t i = 0; i < subtrees.size(); i++)
+    {
+      int n = subtrees[i];
+      BVHNode const & node = m_nodes[n];
+      if (node.count > 0)
+      {
+        next.push_back(n);
+        continue;
+      }
+      upper.push_back(n);
+      if (m_dirty[n + 1 - m_bottomNodes]) next.push_back(n + 1);
+      if (m_dirty[node.offset - m_bottomNodes]) next.push_back(node.offset);
+    }
+    if (next.size() == subtrees.size())
+    {
+      break;
+    }
+    subtrees.swap(next);
+  }
+
+  if (nThreads > subtrees.size())
+  {
+    nThreads = unsigned(subtrees.size());
+  }
+
+  std::vector<double> costDeltas(subtrees.size(), 0.0);
+  std::atomic<int> nextSubtree(0);
+  auto worker = [&]()
+  {
+    for (int i = nextSubtree++; i < int(subtrees.size()); i = nextSubtree++)
+    {
+      RefitNode(a_scene, subtrees[i], costDeltas[i]);
+    }
+  };
+
+  //The calling thread takes a share of the subtrees too.
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < nThreads; i++)
+  {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+
+  for (size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i].join();
+  }
+
+  for (size_t i = 0; i < costDeltas.size(); i++)
+  {
+    m_cost += costDeltas[i];
+  }
+
+  //Children always come after their parent
+  double costDelta = 0.0;
+  for (size_t i = upper.size(); i-- > 0;)
+  {
+    RefitNode(a_scene, upper[i], costDelta);
+  }
+  m_cost += costDelta;
+  m_nDirtyLeaves = 0;
+}
+
+
+//Refits the dirty nodes below and including a_node. Interior nodes whose
+//children are already clean just take the union of them.
+void BVH::RefitNode(Scene const & a_scene, int a_node, double & a_costDelta)
+{
+  BVHNode & node = m_nodes[a_node];
+  double before = GetNodeCost(node);
+
+  Bounds bounds;
+  bounds.Empty();
+  if (node.count > 0)
+  {
+    for (int i = node.offset; i < node.offset + node.count; i++)
+    {
+      bounds.Grow(GetTopLevelBounds(a_scene, m_primitives[i]));
+    }
+  }
+  else
+  {
+    int left = a_node + 1;
+    int right = node.offset;
+    if (m_dirty[left - m_bottomNodes]) RefitNode(a_scene, left, a_costDelta);
+    if (m_dirty[right - m_bottomNodes]) RefitNode(a_scene, right, a_costDelta);
+    bounds = GetNodeBounds(m_nodes[left]);
+    bounds.Grow(GetNodeBounds(m_nodes[right]));
+  }
+
+  SetNodeBounds(node, bounds);
+  m_dirty[a_node - m_bottomNodes] = 0;
+  a_costDelta += GetNodeCost(node) - before;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::BeginRebuild()
+//--------------------------------------------------------------------------------
+void BVH::BeginRebuild(Scene const & a_scene)
+{
+  if (IsRebuilding() || m_root < 0)
+  {
+    return;
+  }
+
+  //Bounds are gathered here, the worker never reads the scene
+  GetTopLevelItems(a_scene, m_rebuildItems);
+  m_rebuildNodes.clear();
+  m_rebuildPrimitives.clear();
+  m_rebuildReady = false;
+
+  m_rebuildThread = std::thread([this]()
+  {
+    BuildTree(m_rebuildItems, m_rebuildNodes, m_rebuildPrimitives);
+    m_rebuildReady.store(true, std::memory_order_release);
+  });
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::EndRebuild()
+//--------------------------------------------------------------------------------
+bool BVH::EndRebuild(Scene const & a_scene)
+{
+  if (!IsRebuilding() || !m_rebuildReady.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  m_rebuildThread.join();
+  m_rebuildReady = false;
+
+  //The worker built its tree from zero, move it after the mesh hierarchies
+  m_nodes.resize(m_bottomNodes);
+  m_primitives.resize(m_bottomPrimitives);
+  m_root = int(m_nodes.size());
+  for (size_t i = 0; i < m_rebuildNodes.size(); i++)
+  {
+    BVHNode node = m_rebuildNodes[i];
+    node.offset += int32_t((node.count > 0) ? m_bottomPrimitives : m_bottomNodes);
+    m_nodes.push_back(node);
+  }
+  m_primitives.insert(m_primitives.end(), m_rebuildPrimitives.begin(), m_rebuildPrimitives.end());
+  IndexTopLevel();
+
+  if (!MatchesScene(a_scene))
+  {
+    BuildTopLevel(a_scene);
+    return true;
+  }
+
+  //Primitives kept moving while the worker ran
+  for (size_t i = m_bottomNodes; i < m_nodes.size(); i++)
+  {
+    MarkDirty(int(i));
+  }
+  RefitDirty(a_scene);
+  m_buildCost = GetCost();
+  return true;
+}
+
+
+void BVH::CancelRebuild()
+{
+  if (IsRebuilding())
+  {
+    m_rebuildThread.join();
+  }
+  m_rebuildReady = false;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVH::Intersect()
+//--------------------------------------------------------------------------------
+static bool IntersectNode(BVHNode const & a_node, Ray const & a_ray, float const a_invDir[3], real a_tMax, real & a_tNear)
+{
+  float tNear = -FLT_MAX;
+  float tFar = FLT_MAX;
+  for (int i = 0; i < 3; i++)
+  {
+    float t0 = (a_node.min[i] - a_ray.origin[i]) * a_invDir[i];
+    float t1 = (a_node.max[i] - a_ray.origin[i]) * a_invDir[i];
+    if (t0 > t1) std::swap(t0, t1);
+    if (t0 > tNear) tNear = t0;
+    if (t1 < tFar) tFar = t1;
+  }
+
+  tFar *= s_slabFarScale;
+  a_tNear = tNear;
+  return tNear <= tFar && tFar >= 0.0f && tNear < a_tMax;
+}
+
+
+void BVH::Intersect(Ray const & a_ray, Scene const & a_scene, HitInfo & a_info, RayCost * a_cost) const
+{
+  if (m_root < 0)
+  {
+    return;
+  }
+
+  float invDir[3];
+  for (int i = 0; i < 3; i++)
+  {
+    invDir[i] = 1.0f / a_ray.direction[i];
+  }
+
+  TriangleRay triangleRay;
+  if (!m_meshRoots.empty())
+  {
+    SetupTriangleRay(a_ray, triangleRay);
+  }
+
+  IntersectTree(m_root, -1, a_ray, triangleRay, invDir, a_scene, a_info, a_cost);
+}
+
+
+void BVH::IntersectInstance(int a_instance, Ray const & a_ray, Scene const & a_scene, HitInfo & a_info, RayCost * a_cost) const
+{
+  Instance const & instance = a_scene.GetInstances()[a_instance];
+  Ray ray = ToObjectSpace(instance, a_ray);
+
+  float invDir[3];
+  for (int i = 0; i < 3; i++)
+  {
+    invDir[i] = 1.0f / ray.direction[i];
+  }
+
+  TriangleRay triangleRay;
+  SetupTriangleRay(ray, triangleRay);
+
+  //The closest hit so far limits the search in the mesh as well
+  HitInfo hit(a_info);
+  hit.type = TYPE_NULL;
+  IntersectTree(m_meshRoots[instance.mesh], int(instance.mesh), ray, triangleRay, invDir, a_scene, hit, a_cost);
+
+  if (hit.type != TYPE_NULL)
+  {
+    a_info.type = TYPE_INSTANCE;
+    a_info.t = hit.t;
+    a_info.index = a_instance;
+    a_info.triangle = hit.triangle;
+  }
+}
+
+
+void BVH::IntersectTree(int a_root, int a_mesh,
+                        Ray const & a_ray, TriangleRay const & a_triangleRay, float const a_invDir[3],
+                        Scene const & a_scene, HitInfo & a_info, RayCost * a_cost) const
+{
+  int stack[BVH_STACK_SIZE];
+  int stackSize = 0;
+  int nodeIndex = a_root;
+
+  real tNear;
+  if (!IntersectNode(m_nodes[a_root], a_ray, a_invDir, a_info.t, tNear))
+  {
+    return;
+  }
+
+  for (;;)
+  {
+    BVHNode const & node = m_nodes[nodeIndex];
+    if (a_cost) a_cost->nodes++;
+
+    if (node.count > 0)
+    {
+      for (int i = node.offset; i < node.offset + node.count; i++)
+      {
+        BVHPrimitive const & prim = m_primitives[i];
+
+        if (prim.type == TYPE_MESH)
+        {
+          IntersectTree(m_meshRoots[prim.index], prim.index, a_ray, a_triangleRay, a_invDir, a_scene, a_info, a_cost);
+          continue;
+        }
+
+        if (prim.type == TYPE_INSTANCE)
+        {
+          IntersectInstance(prim.index, a_ray, a_scene, a_info, a_cost);
+          continue;
+        }
+
+        if (a_cost) a_cost->primitives++;
+
+        if (prim.type == TYPE_TRIANGLE)
+        {
+          Mesh const & mesh = a_scene.GetMeshes()[a_mesh];
+          real t = IntersectTriangle(a_triangleRay,
+                                     a_scene.GetTriangleVertex(mesh, prim.index, 0),
+                                     a_scene.GetTriangleVertex(mesh, prim.index, 1),
+                                     a_scene.GetTriangleVertex(mesh, prim.index, 2));
+          if (t < a_info.t)
+          {
+            a_info.type = TYPE_MESH;
+            a_info.t = t;
+            a_info.index = a_mesh;
+            a_info.triangle = prim.index;
+          }
+          continue;
+        }
+
+        real t = IntersectPrimitive(a_ray, a_scene, prim.type, prim.index);
+        if (t < a_info.t)
+        {
+          a_info.type = prim.type;
+          a_info.t = t;
+          a_info.index = prim.index;
+          a_info.triangle = -1;
+        }
+      }
+    }
+    else
+    {
+      //Visit the nearer child first
+      int left = nodeIndex + 1;
+      int right = node.offset;
+      real tLeft, tRight;
+      bool hitLeft = IntersectNode(m_nodes[left], a_ray, a_invDir, a_info.t, tLeft);
+      bool hitRight = IntersectNode(m_nodes[right], a_ray, a_invDir, a_info.t, tRight);
+
+      if (hitLeft && hitRight)
+      {
+        if (tRight < tLeft) std::swap(left, right);
+        if (stackSize < BVH_STACK_SIZE) stack[stackSize++] = right;
+        nodeIndex = left;
+        continue;
+      }
+      if (hitLeft)
+      {
+        nodeIndex = left;
+        continue;
+      }
+      if (hitRight)
+      {
+        nodeIndex = right;
+        continue;
+      }
+    }
+
+    if (stackSize == 0)
+    {
+      break;
+    }
+    nodeIndex = stack[--stackSize];
+  }
+}
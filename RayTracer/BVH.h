@@ -0,0 +1,247 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "RayTracerConfig.h"
+#include "Intersect.h"
+#include "scene.h"
+
+//! Axis aligned bounds used by the acceleration structures.
+struct Bounds
+{
+  float min[3];
+  float max[3];
+
+  void Empty();
+  void Grow(Bounds const &);
+  void Grow(float const point[3]);
+  float SurfaceArea() const;
+  float Centroid(int axis) const { return 0.5f * (min[axis] + max[axis]); }
+};
+
+//! Node layout shared with raytracer_cs.glsl (std430, 32 bytes).
+//! Interior nodes: the left child directly follows the node, 'offset'
+//! is the index of the right child and 'count' is 0.
+//! Leaves: 'offset' is the first entry in the primitive list, 'count' > 0.
+struct BVHNode
+{
+  float   min[3];
+  int32_t offset;
+  float   max[3];
+  int32_t count;
+};
+
+//! Reference to one scene primitive, shared with raytracer_cs.glsl.
+//! In a mesh hierarchy the type is TYPE_TRIANGLE and the index is the
+//! triangle within the mesh. Instances in the top level point at the mesh
+//! hierarchy of their mesh.
+struct BVHPrimitive
+{
+  int32_t type;
+  int32_t index;
+};
+
+//! The arrays of a built hierarchy, for saving it or loading it back.
+struct BVHData
+{
+  BVHNode const *       nodes;
+  unsigned              nNodes;
+  BVHPrimitive const *  primitives;
+  unsigned              nPrimitives;
+  int32_t const *       meshRoots;
+  unsigned              nMeshRoots;
+  int32_t               root;
+  unsigned              bottomNodes;
+  unsigned              bottomPrimitives;
+};
+
+/*!
+ * @class BVH
+ *
+ * @brief Bounding volume hierarchy over the scene primitives.
+ *
+ * Built top down with a binned surface area heuristic, or with the linear
+ * builder in LBVH.h when build time matters more than trace time, and
+ * stored as a flat, depth first node array so it can be uploaded to the
+ * GPU as is.
+ *
+ * Meshes and mesh instances appear in the top level as a single primitive.
+ * Each mesh has its own hierarchy over its triangles, stored in the same
+ * arrays before the top level; GetMeshRoots() gives the root node of each
+ * and GetRoot() the root of the top level. Rays are moved into the frame of
+ * an instance when traversal reaches it, so any number of instances share
+ * one mesh hierarchy, and moving instances only rebuilds the top level.
+ *
+ * Moving primitives can also just be refit: the top level keeps its shape
+ * and only the nodes above dirty leaves get new bounds. Refitting lets the
+ * tree degrade, so once its SAH cost has grown past the rebuild threshold
+ * a new top level is built on a worker thread and swapped in when done.
+ */
+class BVH
+{
+public:
+
+  enum class Builder
+  {
+    SAH,      // Binned SAH, top down
+    LBVH30,   // LBVHBuilder with 30 bit Morton codes
+    LBVH63    // LBVHBuilder with 63 bit Morton codes
+  };
+
+  BVH() : m_builder(Builder::SAH)
+        , m_maxLeafSize(4)
+        , m_root(-1)
+        , m_bottomNodes(0)
+        , m_bottomPrimitives(0)
+        , m_firstKey()
+        , m_nDirtyLeaves(0)
+        , m_cost(0.0)
+        , m_buildCost(0.0f)
+        , m_rebuildThreshold(BVH_REBUILD_THRESHOLD)
+        , m_rebuildReady(false) {}
+
+  ~BVH();
+
+  void SetBuilder(Builder a_builder) { m_builder = a_builder; }
+  Builder GetBuilder() const { return m_builder; }
+
+  void SetMaxLeafSize(int a_size) { m_maxLeafSize = (a_size > 0) ? a_size : 1; }
+  int GetMaxLeafSize() const { return m_maxLeafSize; }
+
+  //! Cost growth over the last build at which NeedsRebuild() returns true.
+  void SetRebuildThreshold(float a_ratio) { m_rebuildThreshold = a_ratio; }
+
+  void Build(Scene const &);
+
+  //! Rebuilds the top level over the mesh hierarchies of the last Build().
+  //! Enough after instances or primitives other than meshes changed.
+  void BuildTopLevel(Scene const &);
+
+  //! Updates the top level bounds of everything the scene marked dirty,
+  //! bottom up and only along the paths to the root from dirty leaves.
+  //! Returns false if primitives were added since the top level was built,
+  //! in which case it has to be rebuilt instead.
+  bool Refit(Scene const &);
+
+  //! SAH cost of the top level, relative to the surface area of its root.
+  float GetCost() const;
+
+  //! GetCost() right after the top level was last built.
+  float GetBuildCost() const { return m_buildCost; }
+
+  //! True if refitting has degraded the top level past the threshold.
+  bool NeedsRebuild() const;
+
+  //! Starts building a new top level on a worker thread from the bounds
+  //! the scene has now. Does nothing if a rebuild is already running.
+  void BeginRebuild(Scene const &);
+
+  bool IsRebuilding() const { return m_rebuildThread.joinable(); }
+
+  //! If the worker has finished, swaps its top level in and refits it to
+  //! the scene. Returns true if the hierarchy was replaced.
+  bool EndRebuild(Scene const &);
+
+  void Clear();
+
+  //! Replaces the hierarchy with one saved from GetData() after building
+  //! over the same scene. Every index in it is checked, so a damaged one
+  //! is refused, leaving the hierarchy empty, rather than traversed.
+  bool Load(Scene const &, BVHData const &);
+  BVHData GetData() const;
+
+  //! Closest hit against the scene the hierarchy was built from. Adds the
+  //! nodes entered and primitives tested to a_cost if given.
+  void Intersect(Ray const &, Scene const &, HitInfo &, RayCost * cost = nullptr) const;
+
+  std::vector<BVHNode> const & GetNodes() const { return m_nodes; }
+  std::vector<BVHPrimitive> const & GetPrimitives() const { return m_primitives; }
+  std::vector<int32_t> const & GetMeshRoots() const { return m_meshRoots; }
+
+  //! Root node of the top level, -1 if the scene is empty.
+  int GetRoot() const { return m_root; }
+
+  //! Index of the first top level node. Refit() only changes nodes from here on.
+  size_t GetTopLevelOffset() const { return m_bottomNodes; }
+
+  //! Index of the first top level entry in the primitive list.
+  size_t GetTopLevelPrimitiveOffset() const { return m_bottomPrimitives; }
+
+  static Bounds GetBounds(Scene const &, BVHPrimitive const &);
+
+  //! Everything the top level is built over, with the bounds it would use.
+  void GetTopLevelInput(Scene const &, std::vector<BVHPrimitive> &, std::vector<Bounds> &) const;
+
+  //! World bounds of a box in the frame of a transform.
+  static Bounds Transform(Bounds const &, vqs const &);
+
+private:
+
+  struct BuildItem
+  {
+    BVHPrimitive  primitive;
+    Bounds        bounds;
+    float         centroid[3];
+  };
+
+  int BuildTree(std::vector<BuildItem> &, std::vector<BVHNode> &, std::vector<BVHPrimitive> &) const;
+  void BuildRecursive(std::vector<BuildItem> &, std::vector<BVHNode> &, int node, int first, int count, int depth) const;
+  int Partition(std::vector<BuildItem> &, int first, int count, Bounds const & nodeBounds) const;
+
+  void GetTopLevelItems(Scene const &, std::vector<BuildItem> &) const;
+  Bounds GetTopLevelBounds(Scene const &, BVHPrimitive const &) const;
+
+  //! Rebuilds the parent links, leaf lookup and cost of the top level.
+  void IndexTopLevel();
+  bool MatchesScene(Scene const &) const;
+  static bool ValidateTree(BVHData const &, unsigned firstNode, unsigned endNode,
+                           unsigned firstPrimitive, unsigned endPrimitive);
+  void MarkDirty(int node);
+  void RefitDirty(Scene const &);
+  void RefitNode(Scene const &, int node, double & costDelta);
+  void CancelRebuild();
+
+  void IntersectTree(int root, int mesh,
+                     Ray const &, TriangleRay const &, float const invDir[3],
+                     Scene const &, HitInfo &, RayCost *) const;
+  void IntersectInstance(int instance, Ray const &, Scene const &, HitInfo &, RayCost *) const;
+
+private:
+
+  Builder                     m_builder;
+  int                         m_maxLeafSize;
+  std::vector<BVHNode>        m_nodes;
+  std::vector<BVHPrimitive>   m_primitives;
+  std::vector<int32_t>        m_meshRoots;
+  std::vector<Bounds>         m_meshBounds;
+  int                         m_root;
+
+  //Size of the arrays without the top level
+  size_t                      m_bottomNodes;
+  size_t                      m_bottomPrimitives;
+
+  //Refit state, indexed by top level node minus m_bottomNodes. Leaves are
+  //found by primitive, m_firstKey[type] + index.
+  std::vector<int32_t>        m_parents;
+  std::vector<uint8_t>        m_dirty;
+  std::vector<int32_t>        m_leaves;
+  unsigned                    m_firstKey[TYPE_COUNT + 1];
+  unsigned                    m_nDirtyLeaves;
+  double                      m_cost;         //Not yet divided by the root area
+  float                       m_buildCost;
+  float                       m_rebuildThreshold;
+
+  //Background rebuild. The worker only touches the m_rebuild arrays until
+  //it sets m_rebuildReady.
+  std::thread                 m_rebuildThread;
+  std::atomic<bool>           m_rebuildReady;
+  std::vector<BuildItem>      m_rebuildItems;
+  std::vector<BVHNode>        m_rebuildNodes;
+  std::vector<BVHPrimitive>   m_rebuildPrimitives;
+};
+
+#endif
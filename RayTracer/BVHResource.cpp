@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <map>
+
+#include "BVHResource.h"
+#include "ResourceHandle.h"
+#include "ResourceManager.h"
+#include "SceneFile.h"
+#include "SceneLayout.h"
+
+//What Init() builds from, by key
+struct BVHSource
+{
+  Scene const * scene;
+  BVH::Builder  builder;
+  int           maxLeafSize;
+  std::string   cachePath;
+  uint64_t      hash;
+};
+
+static std::map<Dg::RKey, BVHSource> s_sources;
+
+
+//--------------------------------------------------------------------------------
+//	@	Hashing
+//--------------------------------------------------------------------------------
+//FNV-1a, 64 bit
+static uint64_t Hash(uint64_t a_hash, void const * a_data, size_t a_size)
+{
+  uint8_t const * bytes = static_cast<uint8_t const *>(a_data);
+  for (size_t i = 0; i < a_size; i++)
+  {
+    a_hash = (a_hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return a_hash;
+}
+
+
+//Hashes the GPU layout, which has no padding left uninitialised
+template<typename GPUType, typename T>
+static uint64_t HashArray(uint64_t a_hash, qArray<T> const & a_items)
+{
+  a_hash = Hash(a_hash, &a_items.size, sizeof(a_items.size));
+  for (unsigned i = 0; i < a_items.size; i++)
+  {
+    GPUType item = {};
+    Pack(a_items[i], item);
+    item.materials = 0;
+    a_hash = Hash(a_hash, &item, sizeof(item));
+  }
+  return a_hash;
+}
+
+
+template<typename T>
+static uint64_t HashArray(uint64_t a_hash, qArray<T> const & a_items)
+{
+  a_hash = Hash(a_hash, &a_items.size, sizeof(a_items.size));
+  return Hash(a_hash, a_items.data, a_items.size * sizeof(T));
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVHResource::HashInput()
+//--------------------------------------------------------------------------------
+uint64_t BVHResource::HashInput(Scene const & a_scene, BVH::Builder a_builder, int a_maxLeafSize)
+{
+  uint32_t settings[3] = {SCENE_FILE_VERSION, uint32_t(a_builder), uint32_t(a_maxLeafSize)};
+  uint64_t hash = Hash(14695981039346656037ull, settings, sizeof(settings));
+  hash = HashArray<GPUAABB>(hash, a_scene.GetBoxes());
+  hash = HashArray<GPUSphere>(hash, a_scene.GetSpheres());
+  hash = HashArray<GPUOBB>(hash, a_scene.GetOBBs());
+  hash = HashArray<GPUCapsule>(hash, a_scene.GetCapsules());
+  hash = HashArray<GPUCapsule>(hash, a_scene.GetCylinders());
+  hash = HashArray<GPUTorus>(hash, a_scene.GetTori());
+  hash = HashArray<GPUCone>(hash, a_scene.GetCones());
+  hash = HashArray<GPUMesh>(hash, a_scene.GetMeshes());
+  hash = HashArray<GPUInstance>(hash, a_scene.GetInstances());
+  hash = HashArray(hash, a_scene.GetPositions());
+  hash = HashArray(hash, a_scene.GetIndices());
+  return hash;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVHResource::Register()
+//--------------------------------------------------------------------------------
+Dg::RKey BVHResource::Register(Scene const & a_scene, BVH::Builder a_builder, int a_maxLeafSize,
+                               std::string const & a_cachePath, uint32_t a_options)
+{
+  uint64_t hash = HashInput(a_scene, a_builder, a_maxLeafSize);
+  Dg::RKey key = Dg::RKey(hash ^ (hash >> 32));
+  if (key == Dg::RKey_INVALID)
+  {
+    key = 1;
+  }
+
+  //Registering with AutoInit already calls Init()
+  BVHSource source = {&a_scene, a_builder, a_maxLeafSize, a_cachePath, hash};
+  s_sources[key] = source;
+
+  Dg::Dg_Result result = Dg::ResourceManager::Instance()->RegisterResource<BVHResource>(key, a_options);
+  if (result != Dg::DgR_Success && result != Dg::DgR_Duplicate)
+  {
+    s_sources.erase(key);
+    return Dg::RKey_INVALID;
+  }
+  return key;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVHResource::BuildCached()
+//--------------------------------------------------------------------------------
+bool BVHResource::BuildCached(Scene const & a_scene, std::string const & a_cachePath, BVH & a_bvh)
+{
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  Dg::RKey key = Register(a_scene, a_bvh.GetBuilder(), a_bvh.GetMaxLeafSize(), a_cachePath,
+                          uint32_t(Dg::rOption::AutoDeinit));
+  bool fromCache = false;
+  bool loaded = false;
+  if (key != Dg::RKey_INVALID)
+  {
+    Dg::hResource handle;
+    if (Dg::ResourceManager::Instance()->GetResourceHandle(key, handle) == Dg::DgR_Success)
+    {
+      BVHResource const & resource = static_cast<BVHResource &>(*handle);
+      fromCache = resource.FromCache();
+      loaded = a_bvh.Load(a_scene, resource.GetBVH().GetData());
+    }
+  }
+  if (!loaded)
+  {
+    a_bvh.Build(a_scene);
+    fromCache = false;
+  }
+
+  std::chrono::duration<double, std::milli> dt = std::chrono::high_resolution_clock::now() - start;
+  printf("%s the BVH in %.1f ms\n", fromCache ? "Loaded" : "Built", dt.count());
+  return fromCache;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVHResource::BVHResource()
+//--------------------------------------------------------------------------------
+BVHResource::BVHResource(Dg::RKey a_key) : Dg::Resource(a_key)
+                                         , m_initialised(false)
+                                         , m_fromCache(false)
+{
+
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVHResource::Init()
+//--------------------------------------------------------------------------------
+Dg::Dg_Result BVHResource::Init()
+{
+  std::map<Dg::RKey, BVHSource>::const_iterator it = s_sources.find(GetKey());
+  if (it == s_sources.end())
+  {
+    return Dg::DgR_Failure;
+  }
+  BVHSource const & source = it->second;
+
+  m_bvh.SetBuilder(source.builder);
+  m_bvh.SetMaxLeafSize(source.maxLeafSize);
+  m_fromCache = LoadCache(*source.scene, source.cachePath, source.hash);
+  if (!m_fromCache)
+  {
+    //Failing to write the cache only costs the next start up a build
+    m_bvh.Build(*source.scene);
+    SceneFile::WriteBVH(source.cachePath, m_bvh, source.hash);
+  }
+
+  m_initialised = true;
+  return Dg::DgR_Success;
+}
+
+
+Dg::Dg_Result BVHResource::DeInit()
+{
+  m_bvh.Clear();
+  m_initialised = false;
+  m_fromCache = false;
+  return Dg::DgR_Success;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BVHResource::LoadCache()
+//--------------------------------------------------------------------------------
+bool BVHResource::LoadCache(Scene const & a_scene, std::string const & a_path, uint64_t a_hash)
+{
+  //No cache yet is the usual first run, not worth a message
+  if (!std::ifstream(a_path.c_str()).good())
+  {
+    return false;
+  }
+
+  //The mapping is closed again before the cache can be rewritten
+  SceneFile file;
+  uint64_t const * stored(nullptr);
+  unsigned count(0);
+  if (!file.Open(a_path) || !file.Get(SCENE_SECTION_BVH_INPUT_HASH, stored, count) || count != 1)
+  {
+    return false;
+  }
+
+  if (*stored != a_hash)
+  {
+    printf("'%s' was built from other input, rebuilding it\n", a_path.c_str());
+    return false;
+  }
+
+  BVHData data;
+  return file.GetBVH(data) && m_bvh.Load(a_scene, data);
+}
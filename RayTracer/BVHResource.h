@@ -0,0 +1,69 @@
+#ifndef BVHRESOURCE_H
+#define BVHRESOURCE_H
+
+#include <stdint.h>
+#include <string>
+
+#include "BVH.h"
+#include "Resource.h"
+#include "scene.h"
+
+/*!
+ * @class BVHResource
+ *
+ * @brief The hierarchy over a scene as a Dg::Resource, cached on disk.
+ *
+ * Its key is a hash of everything the build depends on: the geometry of
+ * every primitive, mesh and instance, the builder and the leaf size.
+ * Init() maps the cache file, and if the hash saved with it matches loads
+ * the hierarchy from it. Otherwise it builds one and writes the cache, so
+ * changing the asset or the builder just rebuilds it once.
+ *
+ * Materials are left out of the hash since they do not change the tree.
+ *
+ * Dg::ResourceManager only hands a resource its key, so Register() keeps
+ * the scene and build settings in a table by key for Init() to find.
+ */
+class BVHResource : public Dg::Resource
+{
+public:
+
+  //! Registers the hierarchy over the scene with Dg::ResourceManager and
+  //! returns its key, Dg::RKey_INVALID if that failed. The scene has to
+  //! stay as it is until the resource is initialised. a_options are those
+  //! of Dg::rOption.
+  static Dg::RKey Register(Scene const &, BVH::Builder, int maxLeafSize,
+                           std::string const & cachePath, uint32_t options);
+
+  //! Hash of the build input, as saved in the cache.
+  static uint64_t HashInput(Scene const &, BVH::Builder, int maxLeafSize);
+
+  //! Fills a_bvh through a resource that is deinitialised again once
+  //! copied, using the builder and leaf size a_bvh is set up with. Returns
+  //! true if the hierarchy came from the cache.
+  static bool BuildCached(Scene const &, std::string const & cachePath, BVH &);
+
+  BVHResource(Dg::RKey);
+
+  bool IsInitialised() { return m_initialised; }
+
+  Dg::Dg_Result Init();
+  Dg::Dg_Result DeInit();
+
+  BVH const & GetBVH() const { return m_bvh; }
+
+  //! True if Init() found a matching cache rather than building.
+  bool FromCache() const { return m_fromCache; }
+
+private:
+
+  bool LoadCache(Scene const &, std::string const & path, uint64_t hash);
+
+private:
+
+  BVH   m_bvh;
+  bool  m_initialised;
+  bool  m_fromCache;
+};
+
+#endif
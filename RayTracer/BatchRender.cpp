@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include "BatchRender.h"
+#include "Camera.h"
+#include "CPUTracer.h"
+#include "Framebuffer.h"
+#include "dgmath.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+
+//--------------------------------------------------------------------------------
+//	@	Helpers
+//--------------------------------------------------------------------------------
+//FNV-1a, 64 bit, of the floats as traced
+static uint64_t HashPixels(Framebuffer const & a_fb)
+{
+  uint8_t const * bytes = reinterpret_cast<uint8_t const *>(a_fb.Data());
+  size_t size = size_t(a_fb.Width()) * size_t(a_fb.Height()) * 4 * sizeof(float);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+
+//The rest of the line, without surrounding white space
+static std::string GetRest(std::istringstream & a_in)
+{
+  std::string rest;
+  std::getline(a_in >> std::ws, rest);
+  size_t end = rest.find_last_not_of(" \t\r");
+  return (end == std::string::npos) ? std::string() : rest.substr(0, end + 1);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BatchRender::BatchRender()
+//--------------------------------------------------------------------------------
+BatchRender::BatchRender() : m_width(800)
+                           , m_height(600)
+                           , m_samples(1)
+                           , m_reflections(NUM_REFLECTIONS)
+                           , m_seed(0)
+                           , m_nFrames(0)
+{
+
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BatchRender::Load()
+//--------------------------------------------------------------------------------
+bool BatchRender::Load(std::string const & a_path)
+{
+  std::ifstream file(a_path.c_str());
+  if (!file)
+  {
+    printf("Unable to open file %s\n", a_path.c_str());
+    return false;
+  }
+
+  *this = BatchRender();
+
+  std::string line;
+  unsigned lineNumber = 0;
+  while (std::getline(file, line))
+  {
+    lineNumber++;
+    std::istringstream in(line);
+    std::string name;
+    if (!(in >> name) || name[0] == '#')
+    {
+      continue;
+    }
+
+    int value(0);
+    bool ok(false);
+    if (name == "size")
+    {
+      ok = (in >> m_width >> m_height) && m_width > 0 && m_height > 0;
+    }
+    else if (name == "spp")
+    {
+      ok = (in >> value) && value > 0;
+      m_samples = unsigned(value);
+    }
+    else if (name == "bounces")
+    {
+      ok = (in >> value) && value >= 0;
+      m_reflections = unsigned(value);
+    }
+    else if (name == "seed")
+    {
+      unsigned long long seed(0);
+      ok = !!(in >> seed);
+      m_seed = seed;
+    }
+    else if (name == "frames")
+    {
+      ok = (in >> value) && value > 0;
+      m_nFrames = unsigned(value);
+    }
+    else if (name == "output")
+    {
+      m_output = GetRest(in);
+      ok = !m_output.empty();
+    }
+    else if (name == "timings")
+    {
+      m_timings = GetRest(in);
+      ok = !m_timings.empty();
+    }
+    else if (name == "key")
+    {
+      Key key;
+      ok = (in >> value) && value >= 0
+        && (in >> key.position[0] >> key.position[1] >> key.position[2])
+        && (in >> key.ypr[0] >> key.ypr[1] >> key.ypr[2]);
+      key.frame = unsigned(value);
+      m_keys.push_back(key);
+    }
+    else
+    {
+      printf("%s:%u: unknown setting '%s'\n", a_path.c_str(), lineNumber, name.c_str());
+      return false;
+    }
+
+    std::string extra;
+    if (!ok || (in >> extra))
+    {
+      printf("%s:%u: bad '%s' line\n", a_path.c_str(), lineNumber, name.c_str());
+      return false;
+    }
+  }
+
+  if (m_keys.empty())
+  {
+    printf("%s: no camera keyframes\n", a_path.c_str());
+    return false;
+  }
+  if (m_output.empty())
+  {
+    printf("%s: no output path\n", a_path.c_str());
+    return false;
+  }
+
+  std::stable_sort(m_keys.begin(), m_keys.end(), [](Key const & a, Key const & b)
+  {
+    return a.frame < b.frame;
+  });
+  for (size_t i = 1; i < m_keys.size(); i++)
+  {
+    if (m_keys[i].frame == m_keys[i - 1].frame)
+    {
+      printf("%s: two keyframes for frame %u\n", a_path.c_str(), m_keys[i].frame);
+      return false;
+    }
+  }
+
+  if (m_nFrames == 0)
+  {
+    m_nFrames = m_keys.back().frame + 1;
+  }
+  if (m_nFrames > 1 && m_output.find('#') == std::string::npos)
+  {
+    printf("%s: the output path needs # where the frame number goes\n", a_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BatchRender::GetCamera()
+//--------------------------------------------------------------------------------
+void BatchRender::GetCamera(unsigned a_frame, Camera & a_camera) const
+{
+  size_t next = 0;
+  while (next < m_keys.size() && m_keys[next].frame < a_frame)
+  {
+    next++;
+  }
+
+  Key const & b = m_keys[(next < m_keys.size()) ? next : m_keys.size() - 1];
+  Key const & a = m_keys[(next > 0) ? next - 1 : 0];
+  float t = 0.0f;
+  if (b.frame > a.frame)
+  {
+    t = float(a_frame - a.frame) / float(b.frame - a.frame);
+  }
+
+  float position[3], ypr[3];
+  for (int i = 0; i < 3; i++)
+  {
+    position[i] = a.position[i] + t * (b.position[i] - a.position[i]);
+
+    //Turn the short way round, so 350 to 10 degrees is 20 degrees, not 340
+    float turn = b.ypr[i] - a.ypr[i];
+    turn -= 360.0f * floorf((turn + 180.0f) / 360.0f);
+    ypr[i] = (a.ypr[i] + t * turn) * (Dg::PI_f / 180.0f);
+  }
+
+  a_camera.SetScreen(float(m_width) / float(m_height), 1.0f);
+  a_camera.SetYPR(ypr[0], ypr[1], ypr[2]);
+  a_camera.SetPosition(position[0], position[1], position[2]);
+}
+
+
+std::string BatchRender::GetOutputPath(unsigned a_frame) const
+{
+  size_t first = m_output.find('#');
+  if (first == std::string::npos)
+  {
+    return m_output;
+  }
+  size_t end = m_output.find_first_not_of('#', first);
+  if (end == std::string::npos)
+  {
+    end = m_output.size();
+  }
+
+  char number[32];
+  snprintf(number, sizeof(number), "%0*u", int(end - first), a_frame);
+  return m_output.substr(0, first) + number + m_output.substr(end);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	BatchRender::Run()
+//--------------------------------------------------------------------------------
+bool BatchRender::Run(CPUTracer & a_tracer) const
+{
+  std::ofstream timings;
+  if (!m_timings.empty())
+  {
+    timings.open(m_timings.c_str());
+    if (!timings)
+    {
+      printf("Unable to open file %s\n", m_timings.c_str());
+      return false;
+    }
+    timings << "frame,ms,hash,image\n";
+    timings.setf(std::ios::fixed);
+    timings.precision(3);
+  }
+
+  a_tracer.SetSamplesPerPixel(m_samples);
+  a_tracer.SetReflectionCount(m_reflections);
+
+  Framebuffer fb;
+  fb.Resize(m_width, m_height);
+
+  double total = 0.0;
+  double fastest = 0.0;
+  double slowest = 0.0;
+  for (unsigned frame = 0; frame < m_nFrames; frame++)
+  {
+    Camera camera;
+    GetCamera(frame, camera);
+    a_tracer.SetSeed(m_seed + frame);
+
+    Clock::time_point start = Clock::now();
+    a_tracer.Trace(camera, fb);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::string path = GetOutputPath(frame);
+    if (!fb.WritePPM(path))
+    {
+      return false;
+    }
+
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)HashPixels(fb));
+    Reprojector const * reprojector = a_tracer.GetReprojector();
+    if (reprojector != nullptr)
+    {
+      printf("Frame %u: %.3f ms, %.1f%% traced, %s, %s\n", frame, ms,
+             100.0 * double(reprojector->GetTraceCount()) / double(reprojector->GetPixelCount()), hash, path.c_str());
+    }
+    else
+    {
+      printf("Frame %u: %.3f ms, %s, %s\n", frame, ms, hash, path.c_str());
+    }
+    if (timings.is_open())
+    {
+      timings << frame << "," << ms << "," << hash << "," << path << "\n";
+    }
+
+    total += ms;
+    if (frame == 0 || ms < fastest) fastest = ms;
+    if (frame == 0 || ms > slowest) slowest = ms;
+  }
+
+  printf("%u frames in %.3f ms: mean %.3f, min %.3f, max %.3f ms\n",
+         m_nFrames, total, total / m_nFrames, fastest, slowest);
+  return !timings.is_open() || timings.good();
+}
@@ -0,0 +1,78 @@
+#ifndef BATCHRENDER_H
+#define BATCHRENDER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Camera;
+class CPUTracer;
+
+/*!
+ * @class BatchRender
+ *
+ * @brief Renders the frames of a camera path on the CPU, without a window.
+ *
+ * The job file is plain text, one setting per line and # for comments:
+ *
+ *   size    800 600
+ *   spp     4
+ *   bounces 3
+ *   seed    1234
+ *   frames  60                     (default: last keyframe + 1)
+ *   output  frames/shot_####.ppm   (# run replaced by the zero padded frame)
+ *   timings frames/timings.csv     (optional)
+ *   key     <frame> <x> <y> <z> <yaw> <pitch> <roll>
+ *
+ * Keyframe angles are in degrees and passed to Camera::SetYPR(). Frames
+ * between keyframes are interpolated linearly, each angle turning the
+ * shorter way round, and those outside them hold the nearest keyframe. Frame n is traced with seed + n, and since the tracer
+ * gives every pixel its own random stream, the same job gives the same
+ * images whatever the thread count. Each frame's time and a hash of its
+ * pixels are printed so runs can be compared, along with the share of
+ * pixels traced if the tracer has a Reprojector.
+ */
+class BatchRender
+{
+public:
+
+  BatchRender();
+
+  //! Prints the line at fault and returns false if the file can not be used.
+  bool Load(std::string const & path);
+
+  int Width() const { return m_width; }
+  int Height() const { return m_height; }
+  unsigned FrameCount() const { return m_nFrames; }
+
+  //! Camera of frame a_frame. The screen is set from the job's size.
+  void GetCamera(unsigned frame, Camera &) const;
+  std::string GetOutputPath(unsigned frame) const;
+
+  //! Renders every frame with a tracer set up with the scene, writing each
+  //! image as it is done. False if an image could not be written.
+  bool Run(CPUTracer &) const;
+
+private:
+
+  struct Key
+  {
+    unsigned  frame;
+    float     position[3];
+    float     ypr[3];       //Degrees
+  };
+
+private:
+
+  int               m_width;
+  int               m_height;
+  unsigned          m_samples;
+  unsigned          m_reflections;
+  uint64_t          m_seed;
+  unsigned          m_nFrames;
+  std::string       m_output;
+  std::string       m_timings;
+  std::vector<Key>  m_keys;         //By frame
+};
+
+#endif
@@ -0,0 +1,963 @@
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "CPUTracer.h"
+#include "DgSIMD.h"
+#include "Intersect.h"
+#include "scene.h"
+#include "DgRNG.h"
+#include "Framebuffer.h"
+#include "Matrix44.h"
+#include "PacketTraversal.h"
+#include "SimpleRNG.h"
+#include "Vector4.h"
+#include "WideBVH.h"
+
+#define BENCH_PASSES 5
+
+
+//A float the SIMD specializations do not match, so Dg types built on it
+//run the generic Matrix template. This is the scalar reference.
+struct RefFloat
+{
+  RefFloat() {}
+  RefFloat(float a_v) : v(a_v) {}
+  operator float() const { return v; }
+
+  RefFloat & operator+=(RefFloat a_other) { v += a_other.v; return *this; }
+  RefFloat & operator-=(RefFloat a_other) { v -= a_other.v; return *this; }
+  RefFloat & operator*=(RefFloat a_other) { v *= a_other.v; return *this; }
+  RefFloat & operator/=(RefFloat a_other) { v /= a_other.v; return *this; }
+
+  float v;
+};
+
+//Found by argument dependent lookup from the Dg templates
+static RefFloat abs(RefFloat a_x) { return fabsf(a_x.v); }
+static RefFloat sqrt(RefFloat a_x) { return sqrtf(a_x.v); }
+
+
+//--------------------------------------------------------------------------------
+//	@	Test primitives
+//--------------------------------------------------------------------------------
+//Each primitive is roughly unit sized and centred on the origin
+static void AddPrimitive(Scene & a_scene, int a_type)
+{
+  switch (a_type)
+  {
+    case TYPE_AABB:
+    {
+      AABB box;
+      box.min.Set(-1.0f, -1.0f, -1.0f, 1.0f);
+      box.max.Set(1.0f, 1.0f, 1.0f, 1.0f);
+      box.materials = 0;
+      a_scene.AddBox(box);
+      break;
+    }
+    case TYPE_SPHERE:
+    {
+      Sphere sphere;
+      sphere.center.Set(0.0f, 0.0f, 0.0f, 1.0f);
+      sphere.radius = 1.0f;
+      sphere.materials = 0;
+      a_scene.AddSphere(sphere);
+      break;
+    }
+    case TYPE_OBB:
+    {
+      OBB obb;
+      obb.center.Set(0.0f, 0.0f, 0.0f, 1.0f);
+      obb.axes[0].Set(0.7071068f, 0.7071068f, 0.0f, 0.0f);
+      obb.axes[1].Set(-0.7071068f, 0.7071068f, 0.0f, 0.0f);
+      obb.axes[2].Set(0.0f, 0.0f, 1.0f, 0.0f);
+      obb.extents[0] = 1.0f;
+      obb.extents[1] = 0.5f;
+      obb.extents[2] = 0.75f;
+      obb.materials = 0;
+      a_scene.AddOBB(obb);
+      break;
+    }
+    case TYPE_CAPSULE:
+    {
+      Capsule capsule;
+      capsule.origin.Set(-0.5f, -0.5f, 0.0f, 1.0f);
+      capsule.direction.Set(1.0f, 1.0f, 0.0f, 0.0f);
+      capsule.radius = 0.5f;
+      capsule.materials = 0;
+      a_scene.AddCapsule(capsule);
+      break;
+    }
+    case TYPE_CYLINDER:
+    {
+      Cylinder cylinder;
+      cylinder.origin.Set(0.0f, 0.0f, -1.0f, 1.0f);
+      cylinder.direction.Set(0.0f, 0.0f, 2.0f, 0.0f);
+      cylinder.radius = 0.75f;
+      cylinder.materials = 0;
+      a_scene.AddCylinder(cylinder);
+      break;
+    }
+    case TYPE_TORUS:
+    {
+      Torus torus;
+      torus.center.Set(0.0f, 0.0f, 0.0f, 1.0f);
+      torus.axis.Set(0.0f, 0.0f, 1.0f, 0.0f);
+      torus.radius_circle = 1.0f;
+      torus.radius_thick = 0.3f;
+      torus.materials = 0;
+      a_scene.AddTorus(torus);
+      break;
+    }
+    case TYPE_CONE:
+    {
+      ConeSegment cone;
+      cone.origin.Set(0.0f, 0.0f, -1.0f, 1.0f);
+      cone.direction.Set(0.0f, 0.0f, 2.0f, 0.0f);
+      cone.r0 = 1.0f;
+      cone.r1 = 0.25f;
+      cone.materials = 0;
+      a_scene.AddCone(cone);
+      break;
+    }
+    case TYPE_MESH:
+    {
+      //A single triangle, so the triangle kernel is what gets timed
+      float positions[] = {-1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+      uint32_t indices[] = {0, 1, 2};
+      a_scene.AddMesh(positions, 3, indices, 1, 0);
+      break;
+    }
+    case TYPE_INSTANCE:
+    {
+      //The same triangle, so the difference to TYPE_MESH is the transform
+      float positions[] = {-1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+      uint32_t indices[] = {0, 1, 2};
+      a_scene.AddMesh(positions, 3, indices, 1, 0);
+
+      Instance instance;
+      instance.transform.Set(vec4(0.25f, 0.0f, 0.0f, 0.0f),
+                             Dg::Quaternion<real>(vec4(0.0f, 1.0f, 0.0f, 0.0f), 0.5f),
+                             1.5f);
+      instance.mesh = 0;
+      instance.materials = 0;
+      a_scene.AddInstance(instance);
+      break;
+    }
+  }
+}
+
+
+static char const * TypeName(int a_type)
+{
+  switch (a_type)
+  {
+    case TYPE_AABB:     return "AABB";
+    case TYPE_SPHERE:   return "Sphere";
+    case TYPE_OBB:      return "OBB";
+    case TYPE_CAPSULE:  return "Capsule";
+    case TYPE_CYLINDER: return "Cylinder";
+    case TYPE_TORUS:    return "Torus";
+    case TYPE_CONE:     return "ConeSegment";
+    case TYPE_MESH:     return "Triangle";
+    case TYPE_INSTANCE: return "Instance";
+  }
+  return "Unknown";
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunPrimitiveBenchmarks()
+//--------------------------------------------------------------------------------
+int RunPrimitiveBenchmarks(unsigned a_nRays)
+{
+  if (a_nRays == 0)
+  {
+    return 1;
+  }
+
+  //Rays start on a sphere around the primitive and aim somewhere near it,
+  //so a mix of hits and misses is timed.
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<Ray> rays(a_nRays);
+  for (unsigned i = 0; i < a_nRays; i++)
+  {
+    float v[3], l;
+    do
+    {
+      v[0] = dist(rng); v[1] = dist(rng); v[2] = dist(rng);
+      l = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    } while (l < 0.01f || l > 1.0f);
+    l = 5.0f / sqrt(l);
+
+    rays[i].origin.Set(v[0] * l, v[1] * l, v[2] * l, 1.0f);
+    vec4 target(1.5f * dist(rng), 1.5f * dist(rng), 1.5f * dist(rng), 1.0f);
+    rays[i].direction = target - rays[i].origin;
+  }
+
+  printf("%-12s %12s %10s\n", "Primitive", "ns/isect", "hit rate");
+  for (int type = 0; type < TYPE_COUNT; type++)
+  {
+    Scene scene;
+    AddPrimitive(scene, type);
+
+    double best = 0.0;
+    unsigned hits = 0;
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+      hits = 0;
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      for (unsigned i = 0; i < a_nRays; i++)
+      {
+        if (IntersectPrimitive(rays[i], scene, type, 0) != NO_INTERSECT)
+        {
+          hits++;
+        }
+      }
+      std::chrono::duration<double, std::nano> dt = std::chrono::high_resolution_clock::now() - start;
+      double ns = dt.count() / double(a_nRays);
+      if (pass == 0 || ns < best)
+      {
+        best = ns;
+      }
+    }
+
+    printf("%-12s %12.2f %9.1f%%\n", TypeName(type), best, 100.0 * double(hits) / double(a_nRays));
+  }
+
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	Math benchmarks
+//--------------------------------------------------------------------------------
+enum MathOp
+{
+  OP_ADD,
+  OP_SCALE,
+  OP_DOT,
+  OP_CROSS,
+  OP_NORMALIZE,
+  OP_VECMAT,
+  OP_MATMAT,
+  OP_INVERSE,
+  OP_COUNT
+};
+
+
+static char const * MathOpName(int a_op)
+{
+  switch (a_op)
+  {
+    case OP_ADD:        return "v + v";
+    case OP_SCALE:      return "v * s";
+    case OP_DOT:        return "Dot";
+    case OP_CROSS:      return "Cross";
+    case OP_NORMALIZE:  return "Normalize";
+    case OP_VECMAT:     return "v * M";
+    case OP_MATMAT:     return "M * M";
+    case OP_INVERSE:    return "AffineInverse";
+  }
+  return "Unknown";
+}
+
+
+template<typename Real>
+struct MathSet
+{
+  std::vector<Dg::Vector4<Real>>   v;
+  std::vector<Dg::Matrix44<Real>>  m;
+  std::vector<Dg::Vector4<Real>>   vOut;
+  std::vector<Dg::Matrix44<Real>>  mOut;
+};
+
+
+template<typename Real>
+static void RunMathOp(int a_op, MathSet<Real> & a_set)
+{
+  size_t n = a_set.v.size();
+  std::vector<Dg::Vector4<Real>> const & v = a_set.v;
+  std::vector<Dg::Matrix44<Real>> const & m = a_set.m;
+  std::vector<Dg::Vector4<Real>> & vOut = a_set.vOut;
+  std::vector<Dg::Matrix44<Real>> & mOut = a_set.mOut;
+
+  //Each op pairs element i with element i + 1
+  switch (a_op)
+  {
+    case OP_ADD:
+      for (size_t i = 0; i + 1 < n; i++) vOut[i] = v[i] + v[i + 1];
+      break;
+    case OP_SCALE:
+      for (size_t i = 0; i + 1 < n; i++) vOut[i] = v[i] * v[i + 1][0];
+      break;
+    case OP_DOT:
+      for (size_t i = 0; i + 1 < n; i++) vOut[i][0] = Dg::Dot(v[i], v[i + 1]);
+      break;
+    case OP_CROSS:
+      for (size_t i = 0; i + 1 < n; i++) vOut[i] = Dg::Cross(v[i], v[i + 1]);
+      break;
+    case OP_NORMALIZE:
+      for (size_t i = 0; i + 1 < n; i++) { vOut[i] = v[i]; vOut[i].Normalize(); }
+      break;
+    case OP_VECMAT:
+      for (size_t i = 0; i + 1 < n; i++) vOut[i] = v[i] * m[i];
+      break;
+    case OP_MATMAT:
+      for (size_t i = 0; i + 1 < n; i++) mOut[i] = m[i] * m[i + 1];
+      break;
+    case OP_INVERSE:
+      for (size_t i = 0; i + 1 < n; i++) mOut[i] = Dg::AffineInverse(m[i]);
+      break;
+  }
+}
+
+
+template<typename Real>
+static double TimeMathOp(int a_op, MathSet<Real> & a_set)
+{
+  double best = 0.0;
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    RunMathOp(a_op, a_set);
+    std::chrono::duration<double, std::nano> dt = std::chrono::high_resolution_clock::now() - start;
+    double ns = dt.count() / double(a_set.v.size() - 1);
+    if (pass == 0 || ns < best)
+    {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+
+static float MaxDifference(int a_op, MathSet<float> const & a_simd, MathSet<RefFloat> const & a_ref)
+{
+  bool matrixOut = (a_op == OP_MATMAT || a_op == OP_INVERSE);
+  size_t nElements = matrixOut ? 16 : (a_op == OP_DOT ? 1 : 4);
+
+  float result = 0.0f;
+  for (size_t i = 0; i + 1 < a_simd.v.size(); i++)
+  {
+    for (size_t e = 0; e < nElements; e++)
+    {
+      float x = matrixOut ? a_simd.mOut[i][e] : a_simd.vOut[i][e];
+      float y = matrixOut ? a_ref.mOut[i][e] : a_ref.vOut[i][e];
+      float d = fabsf(x - y);
+      if (d > result)
+      {
+        result = d;
+      }
+    }
+  }
+  return result;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunMathBenchmarks()
+//--------------------------------------------------------------------------------
+int RunMathBenchmarks(unsigned a_count)
+{
+  if (a_count < 2)
+  {
+    return 1;
+  }
+
+  //Random vectors and affine matrices, the same values in both sets
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+  MathSet<float> simd;
+  MathSet<RefFloat> ref;
+  simd.v.resize(a_count);
+  simd.m.resize(a_count);
+  ref.v.resize(a_count);
+  ref.m.resize(a_count);
+  for (unsigned i = 0; i < a_count; i++)
+  {
+    simd.v[i].Set(4.0f * dist(rng), 4.0f * dist(rng), 4.0f * dist(rng), dist(rng));
+
+    Dg::Matrix44<float> rotation, scale;
+    rotation.Rotation(Dg::PI_f * dist(rng), Dg::PI_f * dist(rng), Dg::PI_f * dist(rng), Dg::EulerOrder::ZYX);
+    scale.Scaling(Dg::Vector4<float>(1.5f + dist(rng), 1.5f + dist(rng), 1.5f + dist(rng), 1.0f));
+    simd.m[i] = scale * rotation;
+    simd.m[i].SetRow(3, Dg::Vector4<float>(10.0f * dist(rng), 10.0f * dist(rng), 10.0f * dist(rng), 1.0f));
+
+    for (size_t e = 0; e < 4; e++)
+    {
+      ref.v[i][e] = simd.v[i][e];
+    }
+    for (size_t e = 0; e < 16; e++)
+    {
+      ref.m[i][e] = simd.m[i][e];
+    }
+  }
+  simd.vOut.resize(a_count);
+  simd.mOut.resize(a_count);
+  ref.vOut.resize(a_count);
+  ref.mOut.resize(a_count);
+
+#if defined(DG_AVX)
+  char const * simdName = "AVX";
+#elif defined(DG_SSE)
+  char const * simdName = "SSE";
+#else
+  char const * simdName = "none";
+#endif
+
+  printf("SIMD path: %s\n", simdName);
+  printf("%-14s %12s %12s %9s %12s\n", "Operation", "scalar ns", "simd ns", "speed up", "max diff");
+  for (int op = 0; op < OP_COUNT; op++)
+  {
+    double nsRef = TimeMathOp(op, ref);
+    double nsSIMD = TimeMathOp(op, simd);
+    printf("%-14s %12.2f %12.2f %8.2fx %12.3g\n",
+           MathOpName(op), nsRef, nsSIMD, nsRef / nsSIMD, MaxDifference(op, simd, ref));
+  }
+
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RNG benchmarks
+//--------------------------------------------------------------------------------
+template<typename Generator>
+static float SumUniforms(Generator & a_rng, unsigned a_count)
+{
+  float sum = 0.0f;
+  for (unsigned i = 0; i < a_count; i++)
+  {
+    sum += a_rng.template GetUniform<float>();
+  }
+  return sum;
+}
+
+
+static float SumUniforms(Dg::Xoshiro128PlusX8 & a_rng, unsigned a_count)
+{
+  float u[8];
+  float sum = 0.0f;
+  for (unsigned i = 0; i < a_count; i += 8)
+  {
+    a_rng.GetUniform(u);
+    sum += ((u[0] + u[1]) + (u[2] + u[3])) + ((u[4] + u[5]) + (u[6] + u[7]));
+  }
+  return sum;
+}
+
+
+//Best of BENCH_PASSES, in ns per uniform. a_mean gets the sample mean as a sanity check.
+template<typename Generator>
+static double TimeUniforms(Generator & a_rng, unsigned a_count, double & a_mean)
+{
+  double best = 0.0;
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    float sum = SumUniforms(a_rng, a_count);
+    std::chrono::duration<double, std::nano> dt = std::chrono::high_resolution_clock::now() - start;
+    double ns = dt.count() / double(a_count);
+    if (pass == 0 || ns < best)
+    {
+      best = ns;
+    }
+    a_mean = double(sum) / double(a_count);
+  }
+  return best;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunRNGBenchmarks()
+//--------------------------------------------------------------------------------
+int RunRNGBenchmarks(unsigned a_count)
+{
+  if (a_count == 0)
+  {
+    return 1;
+  }
+
+  //Multiple of 8 so the 8 wide generator does the same work
+  a_count = (a_count + 7) & ~7u;
+
+  double mean = 0.0;
+  printf("%-20s %12s %10s\n", "Generator", "ns/uniform", "mean");
+
+  Dg::SimpleRNG simple;
+  double ns = TimeUniforms(simple, a_count, mean);
+  printf("%-20s %12.3f %10.4f\n", "SimpleRNG", ns, mean);
+
+  Dg::RNG_PCG32 pcg(1234);
+  ns = TimeUniforms(pcg, a_count, mean);
+  printf("%-20s %12.3f %10.4f\n", "PCG32", ns, mean);
+
+  Dg::RNG_Xoshiro128Plus xoshiro(1234);
+  ns = TimeUniforms(xoshiro, a_count, mean);
+  printf("%-20s %12.3f %10.4f\n", "Xoshiro128+", ns, mean);
+
+  Dg::Xoshiro128PlusX8 xoshiroX8(1234);
+  ns = TimeUniforms(xoshiroX8, a_count, mean);
+  printf("%-20s %12.3f %10.4f\n", "Xoshiro128+ x8", ns, mean);
+
+  //One PCG32 stream per thread, nothing shared
+  unsigned nHardware = std::thread::hardware_concurrency();
+  if (nHardware == 0)
+  {
+    nHardware = 1;
+  }
+
+  printf("\n%-8s %16s %10s\n", "Threads", "Muniforms/s", "scaling");
+  double single = 0.0;
+  for (unsigned nThreads = 1;; nThreads *= 2)
+  {
+    if (nThreads > nHardware)
+    {
+      nThreads = nHardware;
+    }
+
+    std::vector<float> sums(nThreads);
+    std::vector<std::thread> threads;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (unsigned t = 0; t < nThreads; t++)
+    {
+      threads.push_back(std::thread([&sums, t, a_count]()
+      {
+        Dg::RNG_PCG32 rng(1234, t);
+        sums[t] = SumUniforms(rng, a_count);
+      }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+      threads[t].join();
+    }
+    std::chrono::duration<double> dt = std::chrono::high_resolution_clock::now() - start;
+
+    double rate = double(nThreads) * double(a_count) / dt.count() / 1.0e6;
+    if (nThreads == 1)
+    {
+      single = rate;
+    }
+    printf("%-8u %16.1f %9.2fx\n", nThreads, rate, rate / single);
+
+    if (nThreads == nHardware)
+    {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunBuildBenchmarks()
+//--------------------------------------------------------------------------------
+
+//The default scene plus small triangles scattered through the view of the
+//default camera, and a fixed set of rays from the camera into it
+static void CreateTriangleScene(unsigned a_nTriangles, Scene & a_scene, std::vector<Ray> & a_rays)
+{
+  a_scene.LoadDefault();
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float> positions(9 * a_nTriangles);
+  std::vector<uint32_t> indices(3 * a_nTriangles);
+  for (unsigned i = 0; i < a_nTriangles; i++)
+  {
+    float center[3] = {25.0f + 15.0f * dist(rng), 20.0f * dist(rng), 15.0f * dist(rng)};
+    for (int v = 0; v < 3; v++)
+    {
+      for (int a = 0; a < 3; a++)
+      {
+        positions[9 * i + 3 * v + a] = center[a] + 0.25f * dist(rng);
+      }
+      indices[3 * i + v] = 3 * i + v;
+    }
+  }
+  a_scene.AddMesh(&positions[0], 3 * a_nTriangles, &indices[0], a_nTriangles, 0);
+
+  for (size_t i = 0; i < a_rays.size(); i++)
+  {
+    a_rays[i].origin.Set(0.0f, 0.0f, 0.0f, 1.0f);
+    a_rays[i].direction.Set(1.0f, 0.75f * dist(rng), 0.55f * dist(rng), 0.0f);
+  }
+}
+
+
+//Best of BENCH_PASSES, in seconds
+template<typename Hierarchy>
+static double TimeTrace(Hierarchy const & a_hierarchy, Scene const & a_scene,
+                        std::vector<Ray> const & a_rays, unsigned & a_hits)
+{
+  double best = 0.0;
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    a_hits = 0;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < a_rays.size(); i++)
+    {
+      HitInfo info;
+      info.type = TYPE_NULL;
+      info.t = MAX_SCENE_BOUNDS;
+      info.index = -1;
+      info.triangle = -1;
+      a_hierarchy.Intersect(a_rays[i], a_scene, info);
+      if (info.type != TYPE_NULL)
+      {
+        a_hits++;
+      }
+    }
+    std::chrono::duration<double> dt = std::chrono::high_resolution_clock::now() - start;
+    if (pass == 0 || dt.count() < best)
+    {
+      best = dt.count();
+    }
+  }
+  return best;
+}
+
+
+int RunBuildBenchmarks(unsigned a_nTriangles)
+{
+  if (a_nTriangles == 0)
+  {
+    return 1;
+  }
+
+  unsigned const nRays = 256 * 1024;
+  Scene scene;
+  std::vector<Ray> rays(nRays);
+  CreateTriangleScene(a_nTriangles, scene, rays);
+
+  struct
+  {
+    BVH::Builder  builder;
+    char const *  name;
+  } const builders[] =
+  {
+    {BVH::Builder::SAH,     "SAH"},
+    {BVH::Builder::LBVH30,  "LBVH 30 bit"},
+    {BVH::Builder::LBVH63,  "LBVH 63 bit"}
+  };
+
+  unsigned nThreads = std::thread::hardware_concurrency();
+  printf("%u triangles, %u rays, LBVH on %u threads\n", a_nTriangles, nRays, nThreads ? nThreads : 1);
+  printf("%-12s %12s %10s %12s %10s\n", "Builder", "build ms", "nodes", "Mrays/s", "hit rate");
+  for (size_t b = 0; b < sizeof(builders) / sizeof(builders[0]); b++)
+  {
+    BVH bvh;
+    bvh.SetBuilder(builders[b].builder);
+
+    double buildMs = 0.0;
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      bvh.Build(scene);
+      std::chrono::duration<double, std::milli> dt = std::chrono::high_resolution_clock::now() - start;
+      if (pass == 0 || dt.count() < buildMs)
+      {
+        buildMs = dt.count();
+      }
+    }
+
+    unsigned hits = 0;
+    double traceSeconds = TimeTrace(bvh, scene, rays, hits);
+    printf("%-12s %12.2f %10u %12.2f %9.1f%%\n", builders[b].name, buildMs, unsigned(bvh.GetNodes().size()),
+           double(nRays) / traceSeconds / 1.0e6, 100.0 * double(hits) / double(nRays));
+  }
+
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunWideBVHBenchmarks()
+//--------------------------------------------------------------------------------
+int RunWideBVHBenchmarks(unsigned a_nTriangles)
+{
+  if (a_nTriangles == 0)
+  {
+    return 1;
+  }
+
+  unsigned const nRays = 256 * 1024;
+  Scene scene;
+  std::vector<Ray> rays(nRays);
+  CreateTriangleScene(a_nTriangles, scene, rays);
+
+  BVH bvh;
+  bvh.Build(scene);
+
+#if defined(DG_AVX)
+  char const * isa = "AVX";
+#elif defined(DG_SSE)
+  char const * isa = "SSE";
+#else
+  char const * isa = "scalar";
+#endif
+  printf("%u triangles, %u rays, %s node tests\n", a_nTriangles, nRays, isa);
+  printf("%-8s %12s %10s %12s %12s %10s\n", "Width", "collapse ms", "nodes", "node KB", "Mrays/s", "hit rate");
+
+  unsigned hits = 0;
+  double traceSeconds = TimeTrace(bvh, scene, rays, hits);
+  printf("%-8s %12s %10u %12.1f %12.2f %9.1f%%\n", "BVH2", "-", unsigned(bvh.GetNodes().size()),
+         double(bvh.GetNodes().size() * sizeof(BVHNode)) / 1024.0,
+         double(nRays) / traceSeconds / 1.0e6, 100.0 * double(hits) / double(nRays));
+
+  int const widths[] = {4, 8};
+  for (int w = 0; w < 2; w++)
+  {
+    WideBVH wide;
+    wide.SetWidth(widths[w]);
+
+    double collapseMs = 0.0;
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      wide.Build(bvh);
+      std::chrono::duration<double, std::milli> dt = std::chrono::high_resolution_clock::now() - start;
+      if (pass == 0 || dt.count() < collapseMs)
+      {
+        collapseMs = dt.count();
+      }
+    }
+
+    char name[16] = {};
+    snprintf(name, sizeof(name), "BVH%i", widths[w]);
+    traceSeconds = TimeTrace(wide, scene, rays, hits);
+    printf("%-8s %12.2f %10u %12.1f %12.2f %9.1f%%\n", name, collapseMs, unsigned(wide.GetNodeCount()),
+           double(wide.GetNodeCount() * wide.GetNodeSize()) / 1024.0,
+           double(nRays) / traceSeconds / 1.0e6, 100.0 * double(hits) / double(nRays));
+  }
+
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunPacketBenchmarks()
+//--------------------------------------------------------------------------------
+
+//Traces every block of a_rays, a row major a_gridWidth wide grid, as one
+//packet of the traversal's shape. Best of BENCH_PASSES, in seconds.
+static double TimePackets(PacketTraversal const & a_packets, BVH const & a_bvh, Scene const & a_scene,
+                          std::vector<Ray> const & a_rays, int a_gridWidth, std::vector<HitInfo> & a_hits)
+{
+  int gridHeight = int(a_rays.size()) / a_gridWidth;
+  int packetWidth, packetHeight;
+  a_packets.GetShape(packetWidth, packetHeight);
+
+  double best = 0.0;
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (int by = 0; by < gridHeight; by += packetHeight)
+    {
+      for (int bx = 0; bx < a_gridWidth; bx += packetWidth)
+      {
+        RayPacket packet;
+        packet.size = 0;
+        for (int y = by; y < by + packetHeight && y < gridHeight; y++)
+        {
+          for (int x = bx; x < bx + packetWidth && x < a_gridWidth; x++)
+          {
+            HitInfo & info = packet.hits[packet.size];
+            info.type = TYPE_NULL;
+            info.t = MAX_SCENE_BOUNDS;
+            info.index = -1;
+            info.triangle = -1;
+            packet.rays[packet.size++] = a_rays[y * a_gridWidth + x];
+          }
+        }
+
+        a_packets.Intersect(a_bvh, a_scene, packet);
+
+        int lane = 0;
+        for (int y = by; y < by + packetHeight && y < gridHeight; y++)
+        {
+          for (int x = bx; x < bx + packetWidth && x < a_gridWidth; x++)
+          {
+            a_hits[y * a_gridWidth + x] = packet.hits[lane++];
+          }
+        }
+      }
+    }
+    std::chrono::duration<double> dt = std::chrono::high_resolution_clock::now() - start;
+    if (pass == 0 || dt.count() < best)
+    {
+      best = dt.count();
+    }
+  }
+  return best;
+}
+
+
+int RunPacketBenchmarks(unsigned a_nTriangles)
+{
+  if (a_nTriangles == 0)
+  {
+    return 1;
+  }
+
+  //A camera's worth of rays from the origin over the same view as the
+  //random rays of the other benchmarks
+  int const gridWidth = 640;
+  int const gridHeight = 480;
+  Scene scene;
+  std::vector<Ray> rays(gridWidth * gridHeight);
+  CreateTriangleScene(a_nTriangles, scene, rays);
+  for (int y = 0; y < gridHeight; y++)
+  {
+    for (int x = 0; x < gridWidth; x++)
+    {
+      float u = 2.0f * float(x) / float(gridWidth - 1) - 1.0f;
+      float v = 2.0f * float(y) / float(gridHeight - 1) - 1.0f;
+      rays[y * gridWidth + x].direction.Set(1.0f, 0.75f * u, 0.55f * v, 0.0f);
+    }
+  }
+
+  BVH bvh;
+  bvh.Build(scene);
+
+  //Reference hits
+  std::vector<HitInfo> reference(rays.size());
+  for (size_t i = 0; i < rays.size(); i++)
+  {
+    HitInfo & info = reference[i];
+    info.type = TYPE_NULL;
+    info.t = MAX_SCENE_BOUNDS;
+    info.index = -1;
+    info.triangle = -1;
+    bvh.Intersect(rays[i], scene, info);
+  }
+
+  unsigned hits = 0;
+  double single = TimeTrace(bvh, scene, rays, hits);
+  double nRays = double(rays.size());
+
+  printf("%u triangles, %ix%i camera rays\n", a_nTriangles, gridWidth, gridHeight);
+  printf("%-10s %6s %8s %12s %9s %10s\n", "ISA", "width", "frustum", "Mrays/s", "speed up", "mismatch");
+  printf("%-10s %6i %8s %12.2f %8.2fx %10s\n", "Single", 1, "-", nRays / single / 1.0e6, 1.0, "-");
+
+  PacketTraversal::ISA const isas[] = {PacketTraversal::ISA::SSE, PacketTraversal::ISA::AVX2, PacketTraversal::ISA::AVX512};
+  std::vector<HitInfo> result(rays.size());
+  for (int i = 0; i < 3; i++)
+  {
+    PacketTraversal packets;
+    if (!packets.SetISA(isas[i]))
+    {
+      printf("%-10s %6i %8s %12s\n", PacketTraversal::GetName(isas[i]), PacketTraversal::GetWidth(isas[i]),
+             "-", "unsupported");
+      continue;
+    }
+
+    for (int frustum = 1; frustum >= 0; frustum--)
+    {
+      packets.SetFrustumCulling(frustum != 0);
+      double seconds = TimePackets(packets, bvh, scene, rays, gridWidth, result);
+
+      unsigned mismatches = 0;
+      for (size_t r = 0; r < rays.size(); r++)
+      {
+        if (result[r].type != reference[r].type || result[r].index != reference[r].index ||
+            result[r].triangle != reference[r].triangle || result[r].t != reference[r].t)
+        {
+          mismatches++;
+        }
+      }
+
+      printf("%-10s %6i %8s %12.2f %8.2fx %10u\n", PacketTraversal::GetName(isas[i]), packets.GetWidth(),
+             frustum ? "on" : "off", nRays / seconds / 1.0e6, single / seconds, mismatches);
+    }
+  }
+
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	RunRaySortBenchmarks()
+//--------------------------------------------------------------------------------
+int RunRaySortBenchmarks(unsigned a_nTriangles)
+{
+  if (a_nTriangles == 0)
+  {
+    return 1;
+  }
+
+  int const width = 640;
+  int const height = 480;
+  Scene scene;
+  std::vector<Ray> rays;
+  CreateTriangleScene(a_nTriangles, scene, rays);
+
+  BVH bvh;
+  bvh.Build(scene);
+
+  Camera camera;
+  camera.SetScreen(float(width) / float(height), 1.0f);
+
+  CPUTracer tracer;
+  tracer.SetScene(&scene);
+  tracer.SetBVH(&bvh);
+  tracer.SetWavefront(true);
+
+  printf("%u triangles, %ix%i pixels, %i bounces\n", a_nTriangles, width, height, NUM_REFLECTIONS);
+  printf("%-8s %12s %12s %10s %10s %9s %10s\n", "sort", "queued rays", "Mrays/s", "trace ms", "sort ms", "speed up", "mismatch");
+
+  Framebuffer images[2];
+  double unsortedTime = 0.0;
+  for (int sort = 0; sort < 2; sort++)
+  {
+    tracer.SetRaySorting(sort != 0);
+    images[sort].Resize(width, height);
+
+    //Best of BENCH_PASSES frames
+    CPUTracer::WavefrontStats best = {};
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+      tracer.Trace(camera, images[sort]);
+      CPUTracer::WavefrontStats const & stats = tracer.GetWavefrontStats();
+      if (pass == 0 || stats.traceSeconds + stats.sortSeconds < best.traceSeconds + best.sortSeconds)
+      {
+        best = stats;
+      }
+    }
+
+    unsigned mismatches = 0;
+    for (int y = 0; y < height; y++)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        float const * a = images[0].Pixel(x, y);
+        float const * b = images[sort].Pixel(x, y);
+        if (a[0] != b[0] || a[1] != b[1] || a[2] != b[2] || a[3] != b[3])
+        {
+          mismatches++;
+        }
+      }
+    }
+
+    double total = best.traceSeconds + best.sortSeconds;
+    if (sort == 0)
+    {
+      unsortedTime = total;
+    }
+    printf("%-8s %12llu %12.2f %10.2f %10.2f %8.2fx %10u\n", sort ? "on" : "off",
+           (unsigned long long)best.queuedRays, double(best.queuedRays) / best.traceSeconds / 1.0e6,
+           best.traceSeconds * 1.0e3, best.sortSeconds * 1.0e3, unsortedTime / total, mismatches);
+  }
+
+  return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+//! Times every primitive intersection routine against a fixed set of random
+//! rays and prints nanoseconds per intersection. Returns a process exit code.
+int RunPrimitiveBenchmarks(unsigned nRays);
+
+//! Times the Vector4<float> and Matrix44<float> operations against the generic
+//! Matrix template over <count> random inputs, and prints ns per operation,
+//! the speed up and the largest difference between the two results.
+int RunMathBenchmarks(unsigned count);
+
+//! Times SimpleRNG and the Dg::RNG generators, <count> uniforms each, then
+//! runs a PCG32 stream per thread for 1, 2, 4 ... hardware threads and prints
+//! the throughput at each count.
+int RunRNGBenchmarks(unsigned count);
+
+//! Builds a BVH over the test scene plus <nTriangles> random triangles with
+//! each builder, and prints the build time, node count and the rate at which
+//! it traces a fixed set of camera rays.
+int RunBuildBenchmarks(unsigned nTriangles);
+
+//! Collapses the SAH BVH of the same scene into BVH4 and BVH8, and prints the
+//! collapse time, node count and memory, and trace rate of each next to the
+//! binary hierarchy.
+int RunWideBVHBenchmarks(unsigned nTriangles);
+
+//! Traces a grid of camera rays over the same scene one at a time, then in
+//! packets with every instruction set the CPU supports, with and without
+//! frustum culling, and prints the rate of each and any hit that differs
+//! from the single ray traversal.
+int RunPacketBenchmarks(unsigned nTriangles);
+
+//! Renders the same scene from the default camera with the wavefront mode
+//! of CPUTracer, without and with sorting the queued rays, and prints the
+//! rate at which the shadow and reflection rays are traced, the time spent
+//! sorting them and any pixel that differs between the two images.
+int RunRaySortBenchmarks(unsigned nTriangles);
+
+#endif
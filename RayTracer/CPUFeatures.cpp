@@ -0,0 +1,99 @@
+#include <stdint.h>
+
+#include "CPUFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define CPUFEATURES_X86
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#define CPUFEATURES_X86
+#endif
+
+#ifdef CPUFEATURES_X86
+
+//eax, ebx, ecx, edx of a leaf and sub leaf
+static void CPUID(uint32_t a_leaf, uint32_t a_subLeaf, uint32_t a_regs[4])
+{
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuidex(regs, int(a_leaf), int(a_subLeaf));
+  for (int i = 0; i < 4; i++)
+  {
+    a_regs[i] = uint32_t(regs[i]);
+  }
+#else
+  __cpuid_count(a_leaf, a_subLeaf, a_regs[0], a_regs[1], a_regs[2], a_regs[3]);
+#endif
+}
+
+
+//Register state the OS saves, XCR0
+static uint64_t XGETBV()
+{
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t lo, hi;
+  __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+
+static CPUFeatures QueryFeatures()
+{
+  CPUFeatures result = {};
+
+  uint32_t regs[4];
+  CPUID(0, 0, regs);
+  uint32_t maxLeaf = regs[0];
+  if (maxLeaf < 1)
+  {
+    return result;
+  }
+
+  CPUID(1, 0, regs);
+  result.sse2 = (regs[3] & (1u << 26)) != 0;
+  result.sse41 = (regs[2] & (1u << 19)) != 0;
+
+  bool osxsave = (regs[2] & (1u << 27)) != 0;
+  bool avx = (regs[2] & (1u << 28)) != 0;
+  bool fma = (regs[2] & (1u << 12)) != 0;
+
+  //XMM and YMM state, then opmask, ZMM0-15 upper halves and ZMM16-31
+  uint64_t xcr0 = osxsave ? XGETBV() : 0;
+  bool osYMM = (xcr0 & 0x6) == 0x6;
+  bool osZMM = (xcr0 & 0xE6) == 0xE6;
+
+  result.avx = avx && osYMM;
+  result.fma = fma && result.avx;
+
+  if (maxLeaf >= 7)
+  {
+    CPUID(7, 0, regs);
+    result.avx2 = result.avx && (regs[1] & (1u << 5)) != 0;
+    result.avx512f = osZMM && (regs[1] & (1u << 16)) != 0;
+  }
+
+  return result;
+}
+
+#else
+
+static CPUFeatures QueryFeatures()
+{
+  CPUFeatures result = {};
+  return result;
+}
+
+#endif
+
+
+CPUFeatures const & GetCPUFeatures()
+{
+  //VS2013 does not make local statics thread safe, so the first call has
+  //to come before any worker thread starts. PacketTraversal makes it.
+  static CPUFeatures const s_features = QueryFeatures();
+  return s_features;
+}
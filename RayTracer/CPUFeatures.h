@@ -0,0 +1,21 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+//! Instruction sets of the CPU the program runs on, as opposed to the ones
+//! it was compiled for. AVX and AVX-512 are only reported if the operating
+//! system also saves their registers on a context switch.
+struct CPUFeatures
+{
+  bool sse2;
+  bool sse41;
+  bool avx;
+  bool avx2;
+  bool fma;
+  bool avx512f;
+};
+
+//! Queried with CPUID the first time and cached. Everything is false on
+//! targets other than x86.
+CPUFeatures const & GetCPUFeatures();
+
+#endif
@@ -0,0 +1,685 @@
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "CPUTracer.h"
+#include "DgRNG.h"
+#include "Intersect.h"
+#include "ParallelSort.h"
+
+//Shading, the same as raytracer_cs.glsl
+static const vec4 LIGHT_DIRECTION(-0.408248f, 0.408248f, 0.816497f, 0.0f);  //Towards the light
+static const real AMBIENT = 0.2f;
+static const real RAY_OFFSET = 1.0e-3f;
+
+//A ray waiting for a later pass of the wavefront mode, as GPUQueuedRay.
+//Reflection rays carry the throughput of the path in weight, shadow rays
+//the light they add if nothing is hit.
+struct CPUTracer::QueuedRay
+{
+  Ray   ray;
+  int   pixel;
+  real  weight[3];
+};
+
+//Queues and per pixel state of a wavefront frame. Like the compute shader,
+//a path only has one ray in flight, so no two rays of a queue add to the
+//same pixel.
+struct CPUTracer::Wavefront
+{
+  std::vector<vec4>       radiance;     //Current sample
+  std::vector<QueuedRay>  shadows;
+  std::vector<QueuedRay>  rays[2];      //Ping-ponged between bounces
+  std::vector<QueuedRay>  sorted;
+  std::atomic<size_t>     shadowCount;
+  std::atomic<size_t>     rayCount[2];
+  float                   gridMin[3];   //Origins are binned over the scene bounds
+  float                   gridScale[3];
+  unsigned                nThreads;
+};
+
+
+void CPUTracer::SetTileSize(int a_tileSize)
+{
+  if (a_tileSize > 0)
+  {
+    m_tileSize = a_tileSize;
+  }
+}
+
+
+void CPUTracer::SetSamplesPerPixel(unsigned a_samples)
+{
+  m_samplesPerPixel = (a_samples > 0) ? a_samples : 1;
+}
+
+
+void CPUTracer::Intersect(Ray const & a_ray, HitInfo & a_info, RayCost * a_cost) const
+{
+  if (a_cost)
+  {
+    a_cost->rays++;
+  }
+
+  if (m_wideBVH)
+  {
+    m_wideBVH->Intersect(a_ray, *m_scene, a_info, a_cost);
+  }
+  else if (m_bvh)
+  {
+    m_bvh->Intersect(a_ray, *m_scene, a_info, a_cost);
+  }
+  else
+  {
+    IntersectScene(a_ray, *m_scene, a_info, a_cost);
+  }
+}
+
+
+//Follows the path the wavefront passes take through the queues: every hit
+//adds its ambient term, queues a shadow ray for the direct term and, if it
+//reflects, continues with a mirrored ray.
+vec4 CPUTracer::TraceRay(Ray const & a_ray, RayCost * a_cost, HitInfo * a_primary) const
+{
+  HitInfo info;
+  info.type = TYPE_NULL;
+  info.t = MAX_SCENE_BOUNDS;
+  info.index = -1;
+  info.triangle = -1;
+  Intersect(a_ray, info, a_cost);
+  if (a_primary)
+  {
+    *a_primary = info;
+  }
+  return Shade(a_ray, info, a_cost);
+}
+
+
+vec4 CPUTracer::Shade(Ray const & a_ray, HitInfo const & a_hit, RayCost * a_cost) const
+{
+  vec4 radiance(0.0f, 0.0f, 0.0f, 1.0f);
+  real weight[3] = {1.0f, 1.0f, 1.0f};
+  Ray ray(a_ray);
+  HitInfo info(a_hit);
+
+  for (unsigned bounce = 0; bounce <= m_nReflections; bounce++)
+  {
+    if (bounce > 0)
+    {
+      info.type = TYPE_NULL;
+      info.t = MAX_SCENE_BOUNDS;
+      info.index = -1;
+      info.triangle = -1;
+      Intersect(ray, info, a_cost);
+      if (a_cost) a_cost->bounces++;
+    }
+
+    if (info.type == TYPE_NULL)
+    {
+      break;
+    }
+
+    Materials const & mat = m_scene->GetMaterials()[GetPrimitiveMaterials(*m_scene, info.type, info.index)];
+    vec4 point = ray.origin + ray.direction * info.t;
+    vec4 normal = GetNormal(*m_scene, info, point);
+    if (Dg::Dot(normal, ray.direction) > 0.0f)
+    {
+      normal = -normal;
+    }
+
+    real diffuse[3];
+    for (int i = 0; i < 3; i++)
+    {
+      diffuse[i] = weight[i] * mat.color[i] * (1.0f - mat.reflectance);
+      radiance[i] += AMBIENT * diffuse[i];
+    }
+
+    Ray next;
+    next.origin = point + normal * RAY_OFFSET;
+
+    real nDotL = Dg::Dot(normal, LIGHT_DIRECTION);
+    if (nDotL > 0.0f)
+    {
+      HitInfo shadow;
+      shadow.type = TYPE_NULL;
+      shadow.t = MAX_SCENE_BOUNDS;
+      shadow.index = -1;
+      shadow.triangle = -1;
+      next.direction = LIGHT_DIRECTION;
+      Intersect(next, shadow, a_cost);
+
+      if (shadow.type == TYPE_NULL)
+      {
+        for (int i = 0; i < 3; i++)
+        {
+          radiance[i] += (1.0f - AMBIENT) * nDotL * diffuse[i];
+        }
+      }
+    }
+
+    if (mat.reflectance <= 0.0f)
+    {
+      break;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+      weight[i] *= mat.reflectance;
+    }
+    next.direction = ray.direction - normal * (2.0f * Dg::Dot(normal, ray.direction));
+    ray = next;
+  }
+
+  return radiance;
+}
+
+
+vec4 CPUTracer::GetDirection(View const & a_view, float a_x, float a_y)
+{
+  vec4 bottom = a_view.ray00 + (a_view.ray01 - a_view.ray00) * a_x;
+  vec4 top = a_view.ray10 + (a_view.ray11 - a_view.ray10) * a_x;
+  return bottom + (top - bottom) * a_y;
+}
+
+
+void CPUTracer::TraceTile(View const & a_view, Framebuffer & a_fb, int a_tile) const
+{
+  int nTilesX = (a_fb.Width() + m_tileSize - 1) / m_tileSize;
+  int x0 = (a_tile % nTilesX) * m_tileSize;
+  int y0 = (a_tile / nTilesX) * m_tileSize;
+  int x1 = (x0 + m_tileSize < a_fb.Width()) ? x0 + m_tileSize : a_fb.Width();
+  int y1 = (y0 + m_tileSize < a_fb.Height()) ? y0 + m_tileSize : a_fb.Height();
+
+  if (m_usePackets && m_bvh != nullptr && m_wideBVH == nullptr && m_packets.IsAvailable() && m_costImage == nullptr)
+  {
+    TracePackets(a_view, a_fb, x0, y0, x1, y1);
+    return;
+  }
+
+  //Same interpolation as main() in raytracer_cs.glsl
+  float sx = (a_fb.Width() > 1) ? 1.0f / float(a_fb.Width() - 1) : 0.0f;
+  float sy = (a_fb.Height() > 1) ? 1.0f / float(a_fb.Height() - 1) : 0.0f;
+
+  Ray ray;
+  ray.origin = a_view.eye;
+
+  for (int y = y0; y < y1; y++)
+  {
+    for (int x = x0; x < x1; x++)
+    {
+      vec4 color(0.0f, 0.0f, 0.0f, 0.0f);
+      Dg::RNG_PCG32 rng(m_seed, uint64_t(y) * uint64_t(a_fb.Width()) + uint64_t(x));
+      RayCost cost = {};
+
+      if (m_reprojector && !m_reprojector->NeedsTrace(x, y))
+      {
+        if (m_costImage)
+        {
+          memset(m_costImage->Pixel(x, y), 0, CostImage::CHANNEL_COUNT * sizeof(uint32_t));
+        }
+        continue;
+      }
+
+      for (unsigned s = 0; s < m_samplesPerPixel; s++)
+      {
+        float jx = (s == 0) ? 0.0f : rng.GetUniform<float>() - 0.5f;
+        float jy = (s == 0) ? 0.0f : rng.GetUniform<float>() - 0.5f;
+        ray.direction = GetDirection(a_view, (float(x) + jx) * sx, (float(y) + jy) * sy);
+
+        HitInfo primary;
+        color += TraceRay(ray, m_costImage ? &cost : nullptr, &primary);
+
+        //The first sample goes through the pixel corner
+        if (s == 0 && m_reprojector)
+        {
+          m_reprojector->SetHit(x, y, ray, primary);
+        }
+      }
+
+      if (m_costImage)
+      {
+        uint32_t * pixelCost = m_costImage->Pixel(x, y);
+        pixelCost[CostImage::NODES] = cost.nodes;
+        pixelCost[CostImage::PRIMITIVES] = cost.primitives;
+        pixelCost[CostImage::BOUNCES] = cost.bounces;
+        pixelCost[CostImage::RAYS] = cost.rays;
+      }
+      if (m_samplesPerPixel > 1)
+      {
+        color *= 1.0f / float(m_samplesPerPixel);
+      }
+
+      float * pixel = a_fb.Pixel(x, y);
+      pixel[0] = color[0];
+      pixel[1] = color[1];
+      pixel[2] = color[2];
+      pixel[3] = color[3];
+    }
+  }
+}
+
+
+//Same pixels and samples as the loop in TraceTile(), but the primary rays of
+//each block of GetShape() pixels are traced together
+void CPUTracer::TracePackets(View const & a_view, Framebuffer & a_fb, int a_x0, int a_y0, int a_x1, int a_y1) const
+{
+  float sx = (a_fb.Width() > 1) ? 1.0f / float(a_fb.Width() - 1) : 0.0f;
+  float sy = (a_fb.Height() > 1) ? 1.0f / float(a_fb.Height() - 1) : 0.0f;
+
+  int packetWidth, packetHeight;
+  m_packets.GetShape(packetWidth, packetHeight);
+
+  RayPacket packet;
+  int px[PACKET_MAX_WIDTH];
+  int py[PACKET_MAX_WIDTH];
+  vec4 color[PACKET_MAX_WIDTH];
+  Dg::RNG_PCG32 rng[PACKET_MAX_WIDTH];
+
+  for (int by = a_y0; by < a_y1; by += packetHeight)
+  {
+    for (int bx = a_x0; bx < a_x1; bx += packetWidth)
+    {
+      packet.size = 0;
+      for (int y = by; y < by + packetHeight && y < a_y1; y++)
+      {
+        for (int x = bx; x < bx + packetWidth && x < a_x1; x++)
+        {
+          if (m_reprojector && !m_reprojector->NeedsTrace(x, y))
+          {
+            continue;
+          }
+          int lane = packet.size++;
+          px[lane] = x;
+          py[lane] = y;
+          color[lane].Set(0.0f, 0.0f, 0.0f, 0.0f);
+          rng[lane].SetSeed(m_seed, uint64_t(y) * uint64_t(a_fb.Width()) + uint64_t(x));
+        }
+      }
+
+      //Every pixel of the block was carried over
+      if (packet.size == 0)
+      {
+        continue;
+      }
+
+      for (unsigned s = 0; s < m_samplesPerPixel; s++)
+      {
+        for (int lane = 0; lane < packet.size; lane++)
+        {
+          float jx = (s == 0) ? 0.0f : rng[lane].GetUniform<float>() - 0.5f;
+          float jy = (s == 0) ? 0.0f : rng[lane].GetUniform<float>() - 0.5f;
+          packet.rays[lane].origin = a_view.eye;
+          packet.rays[lane].direction = GetDirection(a_view, (float(px[lane]) + jx) * sx, (float(py[lane]) + jy) * sy);
+
+          HitInfo & info = packet.hits[lane];
+          info.type = TYPE_NULL;
+          info.t = MAX_SCENE_BOUNDS;
+          info.index = -1;
+          info.triangle = -1;
+        }
+
+        m_packets.Intersect(*m_bvh, *m_scene, packet);
+
+        for (int lane = 0; lane < packet.size; lane++)
+        {
+          color[lane] += Shade(packet.rays[lane], packet.hits[lane]);
+          if (s == 0 && m_reprojector)
+          {
+            m_reprojector->SetHit(px[lane], py[lane], packet.rays[lane], packet.hits[lane]);
+          }
+        }
+      }
+
+      for (int lane = 0; lane < packet.size; lane++)
+      {
+        if (m_samplesPerPixel > 1)
+        {
+          color[lane] *= 1.0f / float(m_samplesPerPixel);
+        }
+
+        float * pixel = a_fb.Pixel(px[lane], py[lane]);
+        pixel[0] = color[lane][0];
+        pixel[1] = color[lane][1];
+        pixel[2] = color[lane][2];
+        pixel[3] = color[lane][3];
+      }
+    }
+  }
+}
+
+
+unsigned CPUTracer::GetThreadCount() const
+{
+  unsigned nThreads = m_nThreads;
+  if (nThreads == 0)
+  {
+    nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+  }
+  return nThreads;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	CPUTracer::Trace()
+//--------------------------------------------------------------------------------
+void CPUTracer::Trace(Camera const & a_camera, Framebuffer & a_fb) const
+{
+  if (m_scene == nullptr || a_fb.Width() == 0 || a_fb.Height() == 0)
+  {
+    return;
+  }
+
+  View view;
+  a_camera.GetCornerRays(view.ray00, view.ray01, view.ray10, view.ray11, view.eye);
+
+  if (m_costImage)
+  {
+    if (m_costImage->Width() != a_fb.Width() || m_costImage->Height() != a_fb.Height())
+    {
+      m_costImage->Resize(a_fb.Width(), a_fb.Height());
+    }
+  }
+
+  if (m_reprojector)
+  {
+    m_reprojector->Reproject(a_camera, a_fb);
+  }
+  else if (m_wavefront && m_costImage == nullptr)
+  {
+    TraceWavefront(view, a_fb);
+    return;
+  }
+
+  int nTilesX = (a_fb.Width() + m_tileSize - 1) / m_tileSize;
+  int nTilesY = (a_fb.Height() + m_tileSize - 1) / m_tileSize;
+
+  //The calling thread takes a share of the tiles too.
+  m_scheduler.Run(nTilesX, nTilesY, GetThreadCount(), [&](int a_tile)
+  {
+    TraceTile(view, a_fb, a_tile);
+  });
+
+  if (m_reprojector)
+  {
+    m_reprojector->Store(a_fb);
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//		Wavefront
+//--------------------------------------------------------------------------------
+
+//Direction octant in bits 27 to 29, above the top 9 bits per axis of the
+//Morton code of the origin, so rays leaving the same region the same way
+//end up next to each other. Same key as PASS_SORT_KEYS in raytracer_cs.glsl.
+static uint32_t RaySortKey(Ray const & a_ray, float const a_gridMin[3], float const a_gridScale[3])
+{
+  float unit[3];
+  uint32_t octant = 0;
+  for (int a = 0; a < 3; a++)
+  {
+    unit[a] = (a_ray.origin[a] - a_gridMin[a]) * a_gridScale[a];
+    if (a_ray.direction[a] < 0.0f)
+    {
+      octant |= 1u << a;
+    }
+  }
+  return (octant << 27) | (MortonCode<uint32_t>(unit) >> 3);
+}
+
+
+void CPUTracer::ShadeQueued(Ray const & a_ray, HitInfo const & a_info, int a_pixel, real const a_weight[3],
+                            bool a_queueReflection, int a_queueOut, Wavefront & a_wf) const
+{
+  Materials const & mat = m_scene->GetMaterials()[GetPrimitiveMaterials(*m_scene, a_info.type, a_info.index)];
+  vec4 point = a_ray.origin + a_ray.direction * a_info.t;
+  vec4 normal = GetNormal(*m_scene, a_info, point);
+  if (Dg::Dot(normal, a_ray.direction) > 0.0f)
+  {
+    normal = -normal;
+  }
+  vec4 origin = point + normal * RAY_OFFSET;
+
+  real diffuse[3];
+  for (int i = 0; i < 3; i++)
+  {
+    diffuse[i] = a_weight[i] * mat.color[i] * (1.0f - mat.reflectance);
+    a_wf.radiance[a_pixel][i] += AMBIENT * diffuse[i];
+  }
+
+  real nDotL = Dg::Dot(normal, LIGHT_DIRECTION);
+  if (nDotL > 0.0f)
+  {
+    QueuedRay & q = a_wf.shadows[a_wf.shadowCount++];
+    q.ray.origin = origin;
+    q.ray.direction = LIGHT_DIRECTION;
+    q.pixel = a_pixel;
+    for (int i = 0; i < 3; i++)
+    {
+      q.weight[i] = (1.0f - AMBIENT) * nDotL * diffuse[i];
+    }
+  }
+
+  if (a_queueReflection && mat.reflectance > 0.0f)
+  {
+    QueuedRay & q = a_wf.rays[a_queueOut][a_wf.rayCount[a_queueOut]++];
+    q.ray.origin = origin;
+    q.ray.direction = a_ray.direction - normal * (2.0f * Dg::Dot(normal, a_ray.direction));
+    q.pixel = a_pixel;
+    for (int i = 0; i < 3; i++)
+    {
+      q.weight[i] = a_weight[i] * mat.reflectance;
+    }
+  }
+}
+
+
+//Radix sorts the first a_count rays of the queue by RaySortKey() and moves
+//them into that order, so the trace that follows reads them in sequence
+void CPUTracer::SortQueue(std::vector<QueuedRay> & a_queue, size_t a_count, Wavefront & a_wf) const
+{
+  std::vector<uint32_t> keys(a_count);
+  std::vector<uint32_t> order(a_count);
+  ParallelFor(a_wf.nThreads, a_count, [&](unsigned, size_t a_first, size_t a_end)
+  {
+    for (size_t i = a_first; i < a_end; i++)
+    {
+      keys[i] = RaySortKey(a_queue[i].ray, a_wf.gridMin, a_wf.gridScale);
+      order[i] = uint32_t(i);
+    }
+  });
+
+  RadixSort(keys, order, a_wf.nThreads);
+
+  ParallelFor(a_wf.nThreads, a_count, [&](unsigned, size_t a_first, size_t a_end)
+  {
+    for (size_t i = a_first; i < a_end; i++)
+    {
+      a_wf.sorted[i] = a_queue[order[i]];
+    }
+  });
+  a_queue.swap(a_wf.sorted);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	CPUTracer::TraceWavefront()
+//--------------------------------------------------------------------------------
+//The passes of Application::DispatchWavefront(): each sample traces every
+//primary ray, then for each bounce drains the shadow queue and the
+//reflection queue the previous pass filled. Every pixel gathers its terms
+//in the same order as Shade(), so the image matches the path tracer's.
+void CPUTracer::TraceWavefront(View const & a_view, Framebuffer & a_fb) const
+{
+  typedef std::chrono::high_resolution_clock Clock;
+
+  int width = a_fb.Width();
+  size_t nPixels = size_t(width) * size_t(a_fb.Height());
+  float sx = (width > 1) ? 1.0f / float(width - 1) : 0.0f;
+  float sy = (a_fb.Height() > 1) ? 1.0f / float(a_fb.Height() - 1) : 0.0f;
+
+  Wavefront wf;
+  wf.radiance.resize(nPixels);
+  wf.shadows.resize(nPixels);
+  wf.rays[0].resize(nPixels);
+  wf.rays[1].resize(nPixels);
+  wf.shadowCount = 0;
+  wf.rayCount[0] = 0;
+  wf.rayCount[1] = 0;
+  wf.nThreads = GetThreadCount();
+  for (int a = 0; a < 3; a++)
+  {
+    wf.gridMin[a] = 0.0f;
+    wf.gridScale[a] = 0.0f;
+  }
+  if (m_sortRays)
+  {
+    wf.sorted.resize(nPixels);
+    if (m_bvh != nullptr && m_bvh->GetRoot() >= 0)
+    {
+      BVHNode const & root = m_bvh->GetNodes()[m_bvh->GetRoot()];
+      for (int a = 0; a < 3; a++)
+      {
+        float extent = root.max[a] - root.min[a];
+        wf.gridMin[a] = root.min[a];
+        wf.gridScale[a] = (extent > 0.0f) ? 1.0f / extent : 0.0f;
+      }
+    }
+  }
+
+  std::vector<vec4> color(nPixels, vec4(0.0f, 0.0f, 0.0f, 0.0f));
+  std::vector<Dg::RNG_PCG32> rngs(nPixels);
+  for (size_t i = 0; i < nPixels; i++)
+  {
+    rngs[i].SetSeed(m_seed, uint64_t(i));
+  }
+
+  m_stats.queuedRays = 0;
+  m_stats.sortSeconds = 0.0;
+  m_stats.traceSeconds = 0.0;
+
+  real const white[3] = {1.0f, 1.0f, 1.0f};
+
+  for (unsigned s = 0; s < m_samplesPerPixel; s++)
+  {
+    ParallelFor(wf.nThreads, nPixels, [&](unsigned, size_t a_first, size_t a_end)
+    {
+      Ray ray;
+      ray.origin = a_view.eye;
+      for (size_t i = a_first; i < a_end; i++)
+      {
+        int x = int(i % size_t(width));
+        int y = int(i / size_t(width));
+        float jx = (s == 0) ? 0.0f : rngs[i].GetUniform<float>() - 0.5f;
+        float jy = (s == 0) ? 0.0f : rngs[i].GetUniform<float>() - 0.5f;
+        ray.direction = GetDirection(a_view, (float(x) + jx) * sx, (float(y) + jy) * sy);
+        wf.radiance[i].Set(0.0f, 0.0f, 0.0f, 1.0f);
+
+        HitInfo info;
+        info.type = TYPE_NULL;
+        info.t = MAX_SCENE_BOUNDS;
+        info.index = -1;
+        info.triangle = -1;
+        Intersect(ray, info);
+        if (info.type != TYPE_NULL)
+        {
+          ShadeQueued(ray, info, int(i), white, m_nReflections > 0, 0, wf);
+        }
+      }
+    });
+
+    for (unsigned bounce = 0; bounce <= m_nReflections; bounce++)
+    {
+      //Directional light, anything in the way blocks it
+      size_t nShadows = wf.shadowCount.exchange(0);
+      Clock::time_point start = Clock::now();
+      if (m_sortRays)
+      {
+        SortQueue(wf.shadows, nShadows, wf);
+      }
+      Clock::time_point sorted = Clock::now();
+      ParallelFor(wf.nThreads, nShadows, [&](unsigned, size_t a_first, size_t a_end)
+      {
+        for (size_t i = a_first; i < a_end; i++)
+        {
+          QueuedRay const & q = wf.shadows[i];
+          HitInfo info;
+          info.type = TYPE_NULL;
+          info.t = MAX_SCENE_BOUNDS;
+          info.index = -1;
+          info.triangle = -1;
+          Intersect(q.ray, info);
+          if (info.type == TYPE_NULL)
+          {
+            for (int c = 0; c < 3; c++)
+            {
+              wf.radiance[q.pixel][c] += q.weight[c];
+            }
+          }
+        }
+      });
+      Clock::time_point traced = Clock::now();
+      m_stats.queuedRays += nShadows;
+      m_stats.sortSeconds += std::chrono::duration<double>(sorted - start).count();
+      m_stats.traceSeconds += std::chrono::duration<double>(traced - sorted).count();
+
+      if (bounce == m_nReflections)
+      {
+        break;
+      }
+
+      int queueIn = bounce & 1;
+      size_t nRays = wf.rayCount[queueIn].exchange(0);
+      start = Clock::now();
+      if (m_sortRays)
+      {
+        SortQueue(wf.rays[queueIn], nRays, wf);
+      }
+      sorted = Clock::now();
+      ParallelFor(wf.nThreads, nRays, [&](unsigned, size_t a_first, size_t a_end)
+      {
+        for (size_t i = a_first; i < a_end; i++)
+        {
+          QueuedRay const & q = wf.rays[queueIn][i];
+          HitInfo info;
+          info.type = TYPE_NULL;
+          info.t = MAX_SCENE_BOUNDS;
+          info.index = -1;
+          info.triangle = -1;
+          Intersect(q.ray, info);
+          if (info.type != TYPE_NULL)
+          {
+            ShadeQueued(q.ray, info, q.pixel, q.weight, bounce + 1 < m_nReflections, 1 - queueIn, wf);
+          }
+        }
+      });
+      traced = Clock::now();
+      m_stats.queuedRays += nRays;
+      m_stats.sortSeconds += std::chrono::duration<double>(sorted - start).count();
+      m_stats.traceSeconds += std::chrono::duration<double>(traced - sorted).count();
+    }
+
+    for (size_t i = 0; i < nPixels; i++)
+    {
+      color[i] += wf.radiance[i];
+    }
+  }
+
+  for (size_t i = 0; i < nPixels; i++)
+  {
+    if (m_samplesPerPixel > 1)
+    {
+      color[i] *= 1.0f / float(m_samplesPerPixel);
+    }
+
+    float * pixel = a_fb.Pixel(int(i % size_t(width)), int(i / size_t(width)));
+    pixel[0] = color[i][0];
+    pixel[1] = color[i][1];
+    pixel[2] = color[i][2];
+    pixel[3] = color[i][3];
+  }
+}
@@ -0,0 +1,183 @@
+#ifndef CPUTRACER_H
+#define CPUTRACER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "RayTracerConfig.h"
+#include "Camera.h"
+#include "CostImage.h"
+#include "Framebuffer.h"
+#include "BVH.h"
+#include "WideBVH.h"
+#include "Intersect.h"
+#include "PacketTraversal.h"
+#include "Reprojector.h"
+#include "TileScheduler.h"
+#include "scene.h"
+
+/*!
+ * @class CPUTracer
+ *
+ * @brief Reference implementation of raytracer_cs.glsl on the CPU.
+ *
+ * Needs no GL context. The image is split into square tiles, handed out by
+ * a TileScheduler whose threads are kept from one frame to the next.
+ *
+ * With more than one sample per pixel, the first goes through the pixel
+ * corner like the compute shader and the rest are jittered. Every pixel has
+ * its own random stream, so the image does not depend on the thread count.
+ *
+ * Rays are shaded one path at a time, but the light gathered is the same as
+ * the shadow and bounce passes of the compute shader. The wavefront mode
+ * runs those passes instead: all primary rays, then for each bounce the
+ * queue of shadow rays and the queue of reflection rays, each traced over
+ * all threads. Before a queue is traced it can be sorted by origin cell and
+ * direction octant so that rays going through the same part of the BVH are
+ * traced one after the other.
+ *
+ * With a binary BVH, primary rays are traced in packets over small blocks of
+ * pixels, see PacketTraversal. Shadow and reflection rays, and everything
+ * when a WideBVH is set, are traced one at a time.
+ *
+ * With a CostImage set, every ray is traced one at a time with the path
+ * tracer, and the nodes, primitives, bounces and rays of each pixel are
+ * counted into it. Frames are slower but the image is the same.
+ *
+ * With a Reprojector set, the last frame is carried over to the new view
+ * first, and only the pixels it marks are traced. Their primary hits are
+ * handed back to it for the next frame.
+ */
+class CPUTracer
+{
+public:
+
+  CPUTracer() : m_scene(nullptr)
+              , m_bvh(nullptr)
+              , m_wideBVH(nullptr)
+              , m_nThreads(0)
+              , m_tileSize(16)
+              , m_samplesPerPixel(1)
+              , m_nReflections(NUM_REFLECTIONS)
+              , m_seed(0)
+              , m_usePackets(true)
+              , m_wavefront(false)
+              , m_sortRays(false)
+              , m_costImage(nullptr)
+              , m_reprojector(nullptr)
+              , m_stats() {}
+
+  void SetScene(Scene const * a_scene) { m_scene = a_scene; }
+
+  //! Hierarchy built over the scene. Without one every ray tests every primitive.
+  void SetBVH(BVH const * a_bvh) { m_bvh = a_bvh; }
+
+  //! Collapsed copy of the BVH, traversed instead of it when set.
+  void SetWideBVH(WideBVH const * a_bvh) { m_wideBVH = a_bvh; }
+
+  //! 0 uses one thread per hardware thread.
+  void SetThreadCount(unsigned a_nThreads) { m_nThreads = a_nThreads; }
+  void SetTileSize(int a_tileSize);
+
+  //! Order the tiles are handed out in, Hilbert by default.
+  void SetTileOrder(TileScheduler::Order a_order) { m_scheduler.SetOrder(a_order); }
+
+  //! Per tile timings of the last frame. Not filled in by the wavefront mode.
+  TileScheduler const & GetTileScheduler() const { return m_scheduler; }
+  void SetSamplesPerPixel(unsigned a_samples);
+
+  //! Reflection bounces after the primary hit.
+  void SetReflectionCount(unsigned a_count) { m_nReflections = a_count; }
+
+  //! Selects the random streams used for jittering.
+  void SetSeed(uint64_t a_seed) { m_seed = a_seed; }
+
+  //! Traces primary rays in packets. On by default where the CPU has SSE2.
+  void SetPacketTraversal(bool a_on) { m_usePackets = a_on; }
+
+  //! Returns false, and keeps the current one, if the CPU cannot run it.
+  bool SetPacketISA(PacketTraversal::ISA a_isa) { return m_packets.SetISA(a_isa); }
+
+  //! Traces the frame pass by pass through queues of rays, like the compute
+  //! shader, instead of path by path. The image is the same.
+  void SetWavefront(bool a_on) { m_wavefront = a_on; }
+
+  //! Sorts each queue of the wavefront mode before it is traced.
+  void SetRaySorting(bool a_on) { m_sortRays = a_on; }
+
+  //! Counts the work of every pixel into a_image, resized to the frame,
+  //! while set. Overrides packets and the wavefront mode.
+  void SetCostImage(CostImage * a_image) { m_costImage = a_image; }
+
+  //! Reuses the shading of the last frame through a_reprojector while set.
+  //! Overrides the wavefront mode.
+  void SetReprojector(Reprojector * a_reprojector) { m_reprojector = a_reprojector; }
+  Reprojector const * GetReprojector() const { return m_reprojector; }
+
+  //! The queued rays of the last wavefront frame.
+  struct WavefrontStats
+  {
+    uint64_t  queuedRays;     //Shadow and reflection rays
+    double    sortSeconds;
+    double    traceSeconds;   //Tracing and shading them, sorting aside
+  };
+  WavefrontStats const & GetWavefrontStats() const { return m_stats; }
+
+  //! Traces the whole framebuffer from the camera's point of view.
+  void Trace(Camera const &, Framebuffer &) const;
+
+private:
+
+  struct View
+  {
+    vec4 eye;
+    vec4 ray00;
+    vec4 ray01;
+    vec4 ray10;
+    vec4 ray11;
+  };
+
+  struct QueuedRay;
+  struct Wavefront;
+
+  static vec4 GetDirection(View const &, float x, float y);
+  unsigned GetThreadCount() const;
+
+  void TraceTile(View const &, Framebuffer &, int tile) const;
+  void TracePackets(View const &, Framebuffer &, int x0, int y0, int x1, int y1) const;
+  void Intersect(Ray const &, HitInfo &, RayCost * = nullptr) const;
+  //! a_primary, if given, is set to the first hit.
+  vec4 TraceRay(Ray const &, RayCost * = nullptr, HitInfo * primary = nullptr) const;
+
+  //! Shades the path of a ray from its first hit.
+  vec4 Shade(Ray const &, HitInfo const &, RayCost * = nullptr) const;
+
+  void TraceWavefront(View const &, Framebuffer &) const;
+
+  //! Adds the ambient term of a hit and queues its shadow and reflection rays.
+  void ShadeQueued(Ray const &, HitInfo const &, int pixel, real const weight[3],
+                   bool queueReflection, int queueOut, Wavefront &) const;
+  void SortQueue(std::vector<QueuedRay> &, size_t count, Wavefront &) const;
+
+private:
+
+  Scene const * m_scene;
+  BVH const *   m_bvh;
+  WideBVH const * m_wideBVH;
+  unsigned      m_nThreads;
+  int           m_tileSize;
+  unsigned      m_samplesPerPixel;
+  unsigned      m_nReflections;
+  uint64_t      m_seed;
+  bool          m_usePackets;
+  bool          m_wavefront;
+  bool          m_sortRays;
+  CostImage *   m_costImage;
+  Reprojector * m_reprojector;
+  PacketTraversal m_packets;
+  mutable TileScheduler m_scheduler;
+
+  mutable WavefrontStats m_stats;
+};
+
+#endif
@@ -6,6 +6,7 @@ void Camera::GenerateMatrix()
   m_matrix.GetRow(3, trans);
   m_matrix.Rotation(m_roll, m_pitch, m_yaw, Dg::EulerOrder::YZX);
   m_matrix.SetRow(3, trans);
+  m_version++;
 }
 
 
@@ -20,6 +21,8 @@ void Camera::SetScreen(float a_ar, float a_projDist)
   {
     m_projDist = a_projDist;
   }
+
+  m_version++;
 }
 
 
@@ -55,6 +58,13 @@ void Camera::UpdateYPR(float a_yaw,
 }
 
 
+void Camera::SetPosition(float a_x, float a_y, float a_z)
+{
+  m_matrix.SetRow(3, vec4(a_x, a_y, a_z, 1.0f));
+  m_version++;
+}
+
+
 void Camera::MoveForward(float a_dx)
 {
   vec4 trans, forward;
@@ -62,6 +72,7 @@ void Camera::MoveForward(float a_dx)
   m_matrix.GetRow(3, trans);
   m_matrix.SetRow(3, ((forward * a_dx) + trans));
   m_matrix.GetRow(3, trans);
+  m_version++;
 }
 
 
@@ -71,6 +82,7 @@ void Camera::MoveLeft(float a_dx)
   m_matrix.GetRow(1, left);
   m_matrix.GetRow(3, trans);
   m_matrix.SetRow(3, ((left * a_dx) + trans));
+  m_version++;
 }
 
 
@@ -80,6 +92,7 @@ void Camera::MoveUp(float a_dx)
   m_matrix.GetRow(2, up);
   m_matrix.GetRow(3, trans);
   m_matrix.SetRow(3, ((up * a_dx) + trans));
+  m_version++;
 }
 
 
@@ -89,6 +102,7 @@ void Camera::MoveWorldUp(float a_dx)
   vec4 worldUp(0.0f, 0.0f, 1.0f, 0.0f);
   m_matrix.GetRow(3, trans);
   m_matrix.SetRow(3, ((worldUp * a_dx) + trans));
+  m_version++;
 }
 
 
@@ -96,7 +110,7 @@ void Camera::GetCornerRays(vec4 & a_ray00,
                            vec4 & a_ray01,
                            vec4 & a_ray10,
                            vec4 & a_ray11,
-                           vec4 & a_origin)
+                           vec4 & a_origin) const
 {
   vec4 hLeft, hUp, forward;
   m_matrix.GetRow(1, hLeft);
@@ -16,7 +16,8 @@ public:
            , m_pitch(0.0f)
            , m_yaw(0.0f)
            , m_ar(1.0f)
-           , m_projDist(1.0f){}
+           , m_projDist(1.0f)
+           , m_version(0){}
 
   void SetScreen(float a_ar, float a_projDist);
 
@@ -28,6 +29,9 @@ public:
                  float a_pitch,
                  float a_roll);
 
+  //! Places the eye, in world space.
+  void SetPosition(float a_x, float a_y, float a_z);
+
   void MoveForward(float a_dx);
   void MoveLeft(float a_dx);
   void MoveUp(float a_dx);
@@ -37,7 +41,10 @@ public:
                      vec4 & a_ray01, 
                      vec4 & a_ray10,
                      vec4 & a_ray11,
-                     vec4 & a_origin);
+                     vec4 & a_origin) const;
+
+  //! Changes every time the view changes.
+  unsigned GetVersion() const { return m_version; }
 
 private:
 
@@ -53,6 +60,8 @@ private:
   float   m_yaw;
 
   mat4    m_matrix;
+
+  unsigned m_version;
 };
 
 #endif
\ No newline at end of file
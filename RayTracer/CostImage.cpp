@@ -0,0 +1,137 @@
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+
+#include "CostImage.h"
+
+static char const * const s_channelNames[CostImage::CHANNEL_COUNT] =
+{
+  "nodes",
+  "primitives",
+  "bounces",
+  "rays"
+};
+
+
+//Blue through green to red, as Heatmap() in quad_fs.glsl
+static void Heatmap(float a_t, unsigned char a_rgb[3])
+{
+  float const centres[3] = {3.0f, 2.0f, 1.0f};
+  for (int c = 0; c < 3; c++)
+  {
+    float v = 1.5f - fabsf(4.0f * a_t - centres[c]);
+    if (v < 0.0f) v = 0.0f;
+    else if (v > 1.0f) v = 1.0f;
+    a_rgb[c] = static_cast<unsigned char>(v * 255.0f + 0.5f);
+  }
+}
+
+
+void CostImage::Resize(int a_width, int a_height)
+{
+  m_width = (a_width > 0) ? a_width : 0;
+  m_height = (a_height > 0) ? a_height : 0;
+  m_data.assign(size_t(m_width) * size_t(m_height) * CHANNEL_COUNT, 0);
+}
+
+
+char const * CostImage::GetName(Channel a_channel)
+{
+  return (a_channel >= 0 && a_channel < CHANNEL_COUNT) ? s_channelNames[a_channel] : "unknown";
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	CostImage::GetStats()
+//--------------------------------------------------------------------------------
+CostImage::Stats CostImage::GetStats(Channel a_channel) const
+{
+  Stats stats = {0.0, 0, 0};
+  size_t nPixels = size_t(m_width) * size_t(m_height);
+  if (nPixels == 0)
+  {
+    return stats;
+  }
+
+  std::vector<uint32_t> values(nPixels);
+  double sum = 0.0;
+  for (size_t i = 0; i < nPixels; i++)
+  {
+    values[i] = m_data[i * CHANNEL_COUNT + a_channel];
+    sum += values[i];
+  }
+  stats.mean = sum / double(nPixels);
+
+  //Nearest rank
+  size_t rank = (nPixels * 99 + 99) / 100 - 1;
+  std::nth_element(values.begin(), values.begin() + rank, values.end());
+  stats.p99 = values[rank];
+  stats.max = *std::max_element(values.begin() + rank, values.end());
+  return stats;
+}
+
+
+void CostImage::PrintStats() const
+{
+  printf("%-12s %12s %10s %10s\n", "per pixel", "mean", "p99", "max");
+  for (int c = 0; c < CHANNEL_COUNT; c++)
+  {
+    Stats stats = GetStats(Channel(c));
+    printf("%-12s %12.2f %10u %10u\n", s_channelNames[c], stats.mean, stats.p99, stats.max);
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	CostImage::WriteHeatmap()
+//--------------------------------------------------------------------------------
+bool CostImage::WriteHeatmap(std::string const & a_path, Channel a_channel, uint32_t a_scale) const
+{
+  std::ofstream file(a_path.c_str(), std::ios::out | std::ios::binary);
+  if (!file)
+  {
+    printf("Unable to open file %s\n", a_path.c_str());
+    return false;
+  }
+
+  file << "P6\n" << m_width << " " << m_height << "\n255\n";
+
+  float scale = 1.0f / float((a_scale > 0) ? a_scale : 1);
+  std::vector<unsigned char> row(m_width * 3);
+  for (int y = m_height - 1; y >= 0; y--)
+  {
+    for (int x = 0; x < m_width; x++)
+    {
+      float t = float(Pixel(x, y)[a_channel]) * scale;
+      Heatmap((t < 1.0f) ? t : 1.0f, &row[x * 3]);
+    }
+    file.write(reinterpret_cast<char const *>(row.data()), row.size());
+  }
+
+  return file.good();
+}
+
+
+bool CostImage::Write(std::string const & a_prefix) const
+{
+  std::string statsPath = a_prefix + "_stats.csv";
+  std::ofstream stats(statsPath.c_str());
+  if (!stats)
+  {
+    printf("Unable to open file %s\n", statsPath.c_str());
+    return false;
+  }
+  stats << "channel,mean,p99,max\n";
+
+  for (int c = 0; c < CHANNEL_COUNT; c++)
+  {
+    Stats channel = GetStats(Channel(c));
+    stats << s_channelNames[c] << "," << channel.mean << "," << channel.p99 << "," << channel.max << "\n";
+    if (!WriteHeatmap(a_prefix + "_" + s_channelNames[c] + ".ppm", Channel(c), channel.p99))
+    {
+      return false;
+    }
+  }
+  return stats.good();
+}
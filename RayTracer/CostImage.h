@@ -0,0 +1,76 @@
+#ifndef COSTIMAGE_H
+#define COSTIMAGE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*!
+ * @class CostImage
+ *
+ * @brief What each pixel of a frame cost to trace, see CPUTracer::SetCostImage().
+ *
+ * Four integers per pixel, one per Channel, summed over the samples of the
+ * pixel, in the same layout as the Framebuffer so it can be uploaded as an
+ * RGBA32UI texture and shown by quad_fs.glsl.
+ *
+ * Heatmaps scale a channel to its 99th percentile, so a few very expensive
+ * pixels do not wash out the rest. The colour map is the same as
+ * Heatmap() in quad_fs.glsl.
+ */
+class CostImage
+{
+public:
+
+  enum Channel
+  {
+    NODES,
+    PRIMITIVES,
+    BOUNCES,
+    RAYS,
+    CHANNEL_COUNT
+  };
+
+  struct Stats
+  {
+    double    mean;
+    uint32_t  p99;
+    uint32_t  max;
+  };
+
+  CostImage() : m_width(0), m_height(0) {}
+
+  //! Also zeroes every pixel.
+  void Resize(int a_width, int a_height);
+
+  int Width() const { return m_width; }
+  int Height() const { return m_height; }
+
+  uint32_t * Pixel(int a_x, int a_y) { return &m_data[(a_y * m_width + a_x) * CHANNEL_COUNT]; }
+  uint32_t const * Pixel(int a_x, int a_y) const { return &m_data[(a_y * m_width + a_x) * CHANNEL_COUNT]; }
+
+  uint32_t const * Data() const { return m_data.empty() ? nullptr : &m_data[0]; }
+
+  static char const * GetName(Channel);
+
+  Stats GetStats(Channel) const;
+
+  //! Mean, 99th percentile and maximum of every channel.
+  void PrintStats() const;
+
+  //! Binary PPM of the channel in false colour, top row first. a_scale and
+  //! above are the hottest colour.
+  bool WriteHeatmap(std::string const & path, Channel, uint32_t scale) const;
+
+  //! Writes <prefix>_<channel>.ppm for every channel, each scaled to its 99th
+  //! percentile, and <prefix>_stats.csv.
+  bool Write(std::string const & prefix) const;
+
+private:
+
+  int                   m_width;
+  int                   m_height;
+  std::vector<uint32_t> m_data;
+};
+
+#endif
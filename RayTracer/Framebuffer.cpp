@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <fstream>
+
+#include "Framebuffer.h"
+
+
+void Framebuffer::Resize(int a_width, int a_height)
+{
+  m_width = (a_width > 0) ? a_width : 0;
+  m_height = (a_height > 0) ? a_height : 0;
+  m_data.assign(m_width * m_height * 4, 0.0f);
+}
+
+
+bool Framebuffer::WritePPM(std::string const & a_path) const
+{
+  std::ofstream file(a_path.c_str(), std::ios::out | std::ios::binary);
+  if (!file)
+  {
+    printf("Unable to open file %s\n", a_path.c_str());
+    return false;
+  }
+
+  file << "P6\n" << m_width << " " << m_height << "\n255\n";
+
+  std::vector<unsigned char> row(m_width * 3);
+  for (int y = m_height - 1; y >= 0; y--)
+  {
+    for (int x = 0; x < m_width; x++)
+    {
+      float const * pixel = Pixel(x, y);
+      for (int c = 0; c < 3; c++)
+      {
+        float val = pixel[c];
+        if (val < 0.0f) val = 0.0f;
+        else if (val > 1.0f) val = 1.0f;
+        row[x * 3 + c] = static_cast<unsigned char>(val * 255.0f + 0.5f);
+      }
+    }
+    file.write(reinterpret_cast<char const *>(row.data()), row.size());
+  }
+
+  return file.good();
+}
@@ -0,0 +1,36 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <string>
+#include <vector>
+
+//! RGBA32F image in the same layout as the GL framebuffer texture.
+//! Row 0 is the bottom of the image.
+class Framebuffer
+{
+public:
+
+  Framebuffer() : m_width(0), m_height(0) {}
+
+  void Resize(int a_width, int a_height);
+
+  int Width() const { return m_width; }
+  int Height() const { return m_height; }
+
+  float * Pixel(int a_x, int a_y) { return &m_data[(a_y * m_width + a_x) * 4]; }
+  float const * Pixel(int a_x, int a_y) const { return &m_data[(a_y * m_width + a_x) * 4]; }
+
+  float * Data() { return m_data.empty() ? nullptr : &m_data[0]; }
+  float const * Data() const { return m_data.empty() ? nullptr : &m_data[0]; }
+
+  //! Writes a binary PPM, top row first. Colors are clamped to [0, 1].
+  bool WritePPM(std::string const & a_path) const;
+
+private:
+
+  int                 m_width;
+  int                 m_height;
+  std::vector<float>  m_data;
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include <float.h>
+
+#include "GPUBVHBuilder.h"
+
+static_assert(BVH_STACK_SIZE >= 61, "raytracer_cs.glsl could drop nodes of a GPU built tree, see GPUBVHBuilder.h");
+
+//Bounds as lbvh_cs.glsl reads them, std430 pads each vec3
+struct GPUBounds
+{
+  float min[3];
+  float pad0;
+  float max[3];
+  float pad1;
+};
+
+//Interior node of the radix tree, see lbvh_cs.glsl
+struct GPURadixNode
+{
+  int32_t left;
+  int32_t right;
+  int32_t first;
+  int32_t last;
+};
+
+
+//--------------------------------------------------------------------------------
+//	@	GPUBVHBuilder
+//--------------------------------------------------------------------------------
+static GLuint CreateBuffer(GLsizeiptr a_size, GLbitfield a_flags)
+{
+  GLuint id(0);
+  glGenBuffers(1, &id);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, id);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, a_size, nullptr, a_flags);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return id;
+}
+
+
+static void DeleteBuffer(GLuint & a_id)
+{
+  if (a_id != 0)
+  {
+    glDeleteBuffers(1, &a_id);
+  }
+  a_id = 0;
+}
+
+
+static void DeleteProgram(GLuint & a_id)
+{
+  if (a_id != 0)
+  {
+    glDeleteProgram(a_id);
+  }
+  a_id = 0;
+}
+
+
+GPUBVHBuilder::GPUBVHBuilder()
+  : m_capacity(0)
+  , m_bounds(0)
+  , m_input(0)
+  , m_histogram(0)
+  , m_interior(0)
+  , m_parents(0)
+  , m_nodeBounds(0)
+  , m_visits(0)
+{
+  Programs none = {};
+  m_programs = none;
+  Uniforms unused = {-1, -1, -1, -1, -1, -1, -1};
+  for (int i = 0; i < PASS_COUNT; i++)
+  {
+    m_uniforms[i] = unused;
+  }
+  m_keys[0] = m_keys[1] = 0;
+  m_values[0] = m_values[1] = 0;
+}
+
+
+GLuint GPUBVHBuilder::GetProgram(Pass a_pass) const
+{
+  switch (a_pass)
+  {
+    case PASS_MORTON:     return m_programs.morton;
+    case PASS_HISTOGRAM:  return m_programs.histogram;
+    case PASS_SCAN:       return m_programs.scan;
+    case PASS_SCATTER:    return m_programs.scatter;
+    case PASS_EMIT:       return m_programs.emit;
+    case PASS_BOUNDS:     return m_programs.bounds;
+    case PASS_LAYOUT:     return m_programs.layout;
+    default:              return 0;
+  }
+}
+
+
+void GPUBVHBuilder::Init(Programs const & a_programs)
+{
+  ShutDown();
+  m_programs = a_programs;
+
+  //Every pass is compiled from the same source, but the compiler drops the
+  //uniforms a pass does not use, leaving them at -1
+  for (int i = 0; i < PASS_COUNT; i++)
+  {
+    GLuint program = GetProgram(Pass(i));
+    m_uniforms[i].count = glGetUniformLocation(program, "count");
+    m_uniforms[i].centroidMin = glGetUniformLocation(program, "centroidMin");
+    m_uniforms[i].centroidScale = glGetUniformLocation(program, "centroidScale");
+    m_uniforms[i].shift = glGetUniformLocation(program, "shift");
+    m_uniforms[i].blockCount = glGetUniformLocation(program, "blockCount");
+    m_uniforms[i].firstNode = glGetUniformLocation(program, "firstNode");
+    m_uniforms[i].firstPrimitive = glGetUniformLocation(program, "firstPrimitive");
+  }
+}
+
+
+void GPUBVHBuilder::ShutDown()
+{
+  DeleteProgram(m_programs.morton);
+  DeleteProgram(m_programs.histogram);
+  DeleteProgram(m_programs.scan);
+  DeleteProgram(m_programs.scatter);
+  DeleteProgram(m_programs.emit);
+  DeleteProgram(m_programs.bounds);
+  DeleteProgram(m_programs.layout);
+
+  DeleteBuffer(m_bounds);
+  DeleteBuffer(m_input);
+  DeleteBuffer(m_keys[0]);
+  DeleteBuffer(m_keys[1]);
+  DeleteBuffer(m_values[0]);
+  DeleteBuffer(m_values[1]);
+  DeleteBuffer(m_histogram);
+  DeleteBuffer(m_interior);
+  DeleteBuffer(m_parents);
+  DeleteBuffer(m_nodeBounds);
+  DeleteBuffer(m_visits);
+  m_capacity = 0;
+}
+
+
+//Buffers only ever grow, with some slack so a slowly growing scene does
+//not reallocate every frame
+void GPUBVHBuilder::Reserve(unsigned a_count)
+{
+  if (a_count <= m_capacity)
+  {
+    return;
+  }
+
+  unsigned capacity = a_count + a_count / 2;
+  GLsizeiptr n = capacity;
+  GLsizeiptr nBlocks = (capacity + LBVH_GROUP_SIZE - 1) / LBVH_GROUP_SIZE;
+
+  DeleteBuffer(m_bounds);
+  DeleteBuffer(m_input);
+  DeleteBuffer(m_keys[0]);
+  DeleteBuffer(m_keys[1]);
+  DeleteBuffer(m_values[0]);
+  DeleteBuffer(m_values[1]);
+  DeleteBuffer(m_histogram);
+  DeleteBuffer(m_interior);
+  DeleteBuffer(m_parents);
+  DeleteBuffer(m_nodeBounds);
+  DeleteBuffer(m_visits);
+
+  m_bounds = CreateBuffer(n * sizeof(GPUBounds), GL_DYNAMIC_STORAGE_BIT);
+  m_input = CreateBuffer(n * sizeof(BVHPrimitive), GL_DYNAMIC_STORAGE_BIT);
+  m_keys[0] = CreateBuffer(n * sizeof(uint32_t), 0);
+  m_keys[1] = CreateBuffer(n * sizeof(uint32_t), 0);
+  m_values[0] = CreateBuffer(n * sizeof(uint32_t), 0);
+  m_values[1] = CreateBuffer(n * sizeof(uint32_t), 0);
+  m_histogram = CreateBuffer(LBVH_RADIX_SIZE * nBlocks * sizeof(uint32_t), 0);
+  m_interior = CreateBuffer(n * sizeof(GPURadixNode), 0);
+  m_parents = CreateBuffer(2 * n * sizeof(int32_t), 0);
+  m_nodeBounds = CreateBuffer(2 * n * sizeof(GPUBounds), 0);
+  m_visits = CreateBuffer(n * sizeof(uint32_t), 0);
+  m_capacity = capacity;
+}
+
+
+void GPUBVHBuilder::Dispatch(Pass a_pass, unsigned a_nItems)
+{
+  GLuint nGroups = (a_nItems + LBVH_GROUP_SIZE - 1) / LBVH_GROUP_SIZE;
+  if (nGroups == 0)
+  {
+    return;
+  }
+  glUseProgram(GetProgram(a_pass));
+  glDispatchCompute(nGroups, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+
+void GPUBVHBuilder::Build(std::vector<BVHPrimitive> const & a_primitives,
+                          std::vector<Bounds> const & a_bounds,
+                          GLuint a_nodeBuffer, unsigned a_firstNode,
+                          GLuint a_primitiveBuffer, unsigned a_firstPrimitive)
+{
+  unsigned n = unsigned(a_primitives.size());
+  if (n == 0 || a_bounds.size() != a_primitives.size())
+  {
+    return;
+  }
+  Reserve(n);
+
+  //The centroid bounds are a single pass over data already on the CPU,
+  //cheaper here than a reduction on the GPU
+  std::vector<GPUBounds> bounds(n);
+  float centroidMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float centroidMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (unsigned i = 0; i < n; i++)
+  {
+    for (int a = 0; a < 3; a++)
+    {
+      bounds[i].min[a] = a_bounds[i].min[a];
+      bounds[i].max[a] = a_bounds[i].max[a];
+      float c = a_bounds[i].Centroid(a);
+      if (c < centroidMin[a]) centroidMin[a] = c;
+      if (c > centroidMax[a]) centroidMax[a] = c;
+    }
+    bounds[i].pad0 = bounds[i].pad1 = 0.0f;
+  }
+  float centroidScale[3];
+  for (int a = 0; a < 3; a++)
+  {
+    float extent = centroidMax[a] - centroidMin[a];
+    centroidScale[a] = (extent > 0.0f) ? 1.0f / extent : 0.0f;
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bounds);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * sizeof(GPUBounds), &bounds[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_input);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * sizeof(BVHPrimitive), &a_primitives[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  GLuint nBlocks = (n + LBVH_GROUP_SIZE - 1) / LBVH_GROUP_SIZE;
+  for (int i = 0; i < PASS_COUNT; i++)
+  {
+    GLuint program = GetProgram(Pass(i));
+    Uniforms const & u = m_uniforms[i];
+    if (u.count >= 0) glProgramUniform1ui(program, u.count, n);
+    if (u.centroidMin >= 0) glProgramUniform3fv(program, u.centroidMin, 1, centroidMin);
+    if (u.centroidScale >= 0) glProgramUniform3fv(program, u.centroidScale, 1, centroidScale);
+    if (u.blockCount >= 0) glProgramUniform1ui(program, u.blockCount, nBlocks);
+    if (u.firstNode >= 0) glProgramUniform1ui(program, u.firstNode, a_firstNode);
+    if (u.firstPrimitive >= 0) glProgramUniform1ui(program, u.firstPrimitive, a_firstPrimitive);
+  }
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_NODES, a_nodeBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_PRIMITIVES, a_primitiveBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_BOUNDS, m_bounds);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_INPUT, m_input);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_HISTOGRAM, m_histogram);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_INTERIOR, m_interior);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_PARENTS, m_parents);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_NODE_BOUNDS, m_nodeBounds);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_VISITS, m_visits);
+
+  //Earlier draws may still read the BVH buffers the layout pass writes
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_KEYS, m_keys[0]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_VALUES, m_values[0]);
+  Dispatch(PASS_MORTON, n);
+
+  //Each pass sorts one digit from m_keys[src] into m_keys[1 - src]. An even
+  //number of passes leaves the result back in m_keys[0].
+  int src = 0;
+  for (GLuint shift = 0; shift < 30; shift += LBVH_RADIX_BITS)
+  {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_KEYS, m_keys[src]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_VALUES, m_values[src]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_KEYS_OUT, m_keys[1 - src]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_VALUES_OUT, m_values[1 - src]);
+    glProgramUniform1ui(m_programs.histogram, m_uniforms[PASS_HISTOGRAM].shift, shift);
+    glProgramUniform1ui(m_programs.scatter, m_uniforms[PASS_SCATTER].shift, shift);
+
+    Dispatch(PASS_HISTOGRAM, n);
+    Dispatch(PASS_SCAN, LBVH_GROUP_SIZE);   //A single work group
+    Dispatch(PASS_SCATTER, n);
+    src = 1 - src;
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_KEYS, m_keys[src]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LBVH_BINDING_VALUES, m_values[src]);
+
+  Dispatch(PASS_EMIT, n - 1);
+  Dispatch(PASS_BOUNDS, n);
+  Dispatch(PASS_LAYOUT, NodeCount(n));
+  glUseProgram(0);
+}
@@ -0,0 +1,131 @@
+#ifndef GPUBVHBUILDER_H
+#define GPUBVHBUILDER_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+
+#include "BVH.h"
+
+//Shader storage binding points of the build buffers, must match lbvh_cs.glsl.
+//The output goes to the BVH node and primitive bindings of raytracer_cs.glsl.
+enum LBVHBinding
+{
+  LBVH_BINDING_NODES        = 1,
+  LBVH_BINDING_PRIMITIVES   = 2,
+  LBVH_BINDING_BOUNDS       = 20,
+  LBVH_BINDING_INPUT        = 21,
+  LBVH_BINDING_KEYS         = 22,
+  LBVH_BINDING_VALUES       = 23,
+  LBVH_BINDING_KEYS_OUT     = 24,
+  LBVH_BINDING_VALUES_OUT   = 25,
+  LBVH_BINDING_HISTOGRAM    = 26,
+  LBVH_BINDING_INTERIOR     = 27,
+  LBVH_BINDING_PARENTS      = 28,
+  LBVH_BINDING_NODE_BOUNDS  = 29,
+  LBVH_BINDING_VISITS       = 30
+};
+
+//Work group size of every pass
+#define LBVH_GROUP_SIZE 256
+
+//Bits sorted per radix pass, and the digits that gives
+#define LBVH_RADIX_BITS 4
+#define LBVH_RADIX_SIZE 16
+
+/*!
+ * @class GPUBVHBuilder
+ *
+ * @brief Builds a linear BVH with compute shaders, straight into the buffers
+ * raytracer_cs.glsl traverses.
+ *
+ * Same steps as LBVHBuilder: 30 bit Morton codes, a radix sort of 4 bits per
+ * pass, Karras' interior node emission and bounds propagated from the
+ * leaves. Leaves are not collapsed, so n primitives always take 2n - 1 nodes
+ * and every node can find its depth first position on its own.
+ *
+ * The tree is not depth limited like the CPU builds. It does not need to be:
+ * each level splits on a later bit of a 30 bit code, then of a 31 bit index
+ * for equal codes, so no path has more than 62 nodes and a traversal never
+ * pushes more than 61.
+ */
+class GPUBVHBuilder
+{
+public:
+
+  //! One program per pass of lbvh_cs.glsl.
+  struct Programs
+  {
+    GLuint morton;
+    GLuint histogram;
+    GLuint scan;
+    GLuint scatter;
+    GLuint emit;
+    GLuint bounds;
+    GLuint layout;
+  };
+
+  GPUBVHBuilder();
+
+  //! Takes ownership of the programs.
+  void Init(Programs const &);
+  void ShutDown();
+
+  //! Builds over the primitives and writes the nodes from a_firstNode of
+  //! a_nodeBuffer and the primitives from a_firstPrimitive of
+  //! a_primitiveBuffer. The root is the node at a_firstNode, child offsets
+  //! are absolute. Both buffers need room for NodeCount() nodes and one
+  //! primitive per input after the first index.
+  void Build(std::vector<BVHPrimitive> const &, std::vector<Bounds> const &,
+             GLuint nodeBuffer, unsigned firstNode,
+             GLuint primitiveBuffer, unsigned firstPrimitive);
+
+  static unsigned NodeCount(unsigned nPrimitives) { return (nPrimitives > 0) ? 2 * nPrimitives - 1 : 0; }
+
+private:
+
+  enum Pass
+  {
+    PASS_MORTON,
+    PASS_HISTOGRAM,
+    PASS_SCAN,
+    PASS_SCATTER,
+    PASS_EMIT,
+    PASS_BOUNDS,
+    PASS_LAYOUT,
+    PASS_COUNT
+  };
+
+  struct Uniforms
+  {
+    GLint count;
+    GLint centroidMin;
+    GLint centroidScale;
+    GLint shift;
+    GLint blockCount;
+    GLint firstNode;
+    GLint firstPrimitive;
+  };
+
+  GLuint GetProgram(Pass) const;
+  void Reserve(unsigned count);
+  void Dispatch(Pass, unsigned nItems);
+
+private:
+
+  Programs  m_programs;
+  Uniforms  m_uniforms[PASS_COUNT];
+  unsigned  m_capacity;
+
+  GLuint    m_bounds;
+  GLuint    m_input;
+  GLuint    m_keys[2];
+  GLuint    m_values[2];
+  GLuint    m_histogram;
+  GLuint    m_interior;
+  GLuint    m_parents;
+  GLuint    m_nodeBounds;
+  GLuint    m_visits;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include <stdint.h>
+
+#include "GPURaySorter.h"
+#include "WavefrontQueues.h"
+
+
+//--------------------------------------------------------------------------------
+//	@	GPURaySorter
+//--------------------------------------------------------------------------------
+static GLuint CreateBuffer(GLsizeiptr a_size)
+{
+  GLuint id(0);
+  glGenBuffers(1, &id);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, id);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, a_size, nullptr, 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return id;
+}
+
+
+static void DeleteBuffer(GLuint & a_id)
+{
+  if (a_id != 0)
+  {
+    glDeleteBuffers(1, &a_id);
+  }
+  a_id = 0;
+}
+
+
+static void DeleteProgram(GLuint & a_id)
+{
+  if (a_id != 0)
+  {
+    glDeleteProgram(a_id);
+  }
+  a_id = 0;
+}
+
+
+GPURaySorter::GPURaySorter() : m_histogram(0)
+{
+  Programs none = {};
+  m_programs = none;
+  Uniforms unused = {-1, -1, -1, -1, -1};
+  for (int i = 0; i < PASS_COUNT; i++)
+  {
+    m_uniforms[i] = unused;
+  }
+  m_keys[0] = m_keys[1] = 0;
+  m_order[0] = m_order[1] = 0;
+}
+
+
+GLuint GPURaySorter::GetProgram(Pass a_pass) const
+{
+  switch (a_pass)
+  {
+    case PASS_KEYS:       return m_programs.keys;
+    case PASS_HISTOGRAM:  return m_programs.histogram;
+    case PASS_SCAN:       return m_programs.scan;
+    case PASS_SCATTER:    return m_programs.scatter;
+    default:              return 0;
+  }
+}
+
+
+void GPURaySorter::Init(Programs const & a_programs, unsigned a_nPixels)
+{
+  ShutDown();
+  m_programs = a_programs;
+
+  //The compiler drops the uniforms a pass does not use, leaving them at -1
+  for (int i = 0; i < PASS_COUNT; i++)
+  {
+    GLuint program = GetProgram(Pass(i));
+    m_uniforms[i].queue = glGetUniformLocation(program, "sortQueue");
+    m_uniforms[i].bounce = glGetUniformLocation(program, "bounce");
+    m_uniforms[i].sortMin = glGetUniformLocation(program, "sortMin");
+    m_uniforms[i].sortScale = glGetUniformLocation(program, "sortScale");
+    m_uniforms[i].shift = glGetUniformLocation(program, "sortShift");
+  }
+
+  GLsizeiptr n = (a_nPixels > 0) ? a_nPixels : 1;
+  GLsizeiptr nBlocks = (n + WAVEFRONT_GROUP_SIZE - 1) / WAVEFRONT_GROUP_SIZE;
+  m_keys[0] = CreateBuffer(n * sizeof(uint32_t));
+  m_keys[1] = CreateBuffer(n * sizeof(uint32_t));
+  m_order[0] = CreateBuffer(n * sizeof(uint32_t));
+  m_order[1] = CreateBuffer(n * sizeof(uint32_t));
+  m_histogram = CreateBuffer(RAYSORT_RADIX_SIZE * nBlocks * sizeof(uint32_t));
+}
+
+
+void GPURaySorter::ShutDown()
+{
+  DeleteProgram(m_programs.keys);
+  DeleteProgram(m_programs.histogram);
+  DeleteProgram(m_programs.scan);
+  DeleteProgram(m_programs.scatter);
+
+  DeleteBuffer(m_keys[0]);
+  DeleteBuffer(m_keys[1]);
+  DeleteBuffer(m_order[0]);
+  DeleteBuffer(m_order[1]);
+  DeleteBuffer(m_histogram);
+}
+
+
+void GPURaySorter::SetBounds(float const a_min[3], float const a_max[3])
+{
+  float scale[3];
+  for (int a = 0; a < 3; a++)
+  {
+    float extent = a_max[a] - a_min[a];
+    scale[a] = (extent > 0.0f) ? 1.0f / extent : 0.0f;
+  }
+
+  Uniforms const & u = m_uniforms[PASS_KEYS];
+  if (u.sortMin >= 0) glProgramUniform3fv(m_programs.keys, u.sortMin, 1, a_min);
+  if (u.sortScale >= 0) glProgramUniform3fv(m_programs.keys, u.sortScale, 1, scale);
+}
+
+
+void GPURaySorter::BindBuffers(int a_src) const
+{
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYSORT_BINDING_KEYS, m_keys[a_src]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYSORT_BINDING_ORDER, m_order[a_src]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYSORT_BINDING_KEYS_OUT, m_keys[1 - a_src]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYSORT_BINDING_ORDER_OUT, m_order[1 - a_src]);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	GPURaySorter::Sort()
+//--------------------------------------------------------------------------------
+void GPURaySorter::Sort(Queue a_queue, unsigned a_bounce)
+{
+  GLintptr args = (a_queue == QUEUE_SHADOWS) ? WavefrontQueues::ShadowDispatchOffset()
+                                             : WavefrontQueues::BounceDispatchOffset();
+
+  for (int i = 0; i < PASS_COUNT; i++)
+  {
+    GLuint program = GetProgram(Pass(i));
+    if (m_uniforms[i].queue >= 0) glProgramUniform1i(program, m_uniforms[i].queue, int(a_queue));
+    if (m_uniforms[i].bounce >= 0) glProgramUniform1i(program, m_uniforms[i].bounce, int(a_bounce));
+  }
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYSORT_BINDING_HISTOGRAM, m_histogram);
+  BindBuffers(0);
+
+  //The prepare pass has just written the counts and dispatch arguments
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+  glUseProgram(m_programs.keys);
+  glDispatchComputeIndirect(args);
+
+  //Each pass sorts one digit from m_keys[src] into m_keys[1 - src]. An even
+  //number of passes leaves the result back in m_keys[0].
+  int src = 0;
+  for (GLuint shift = 0; shift < RAYSORT_KEY_BITS; shift += RAYSORT_RADIX_BITS)
+  {
+    BindBuffers(src);
+    glProgramUniform1ui(m_programs.histogram, m_uniforms[PASS_HISTOGRAM].shift, shift);
+    glProgramUniform1ui(m_programs.scatter, m_uniforms[PASS_SCATTER].shift, shift);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glUseProgram(m_programs.histogram);
+    glDispatchComputeIndirect(args);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glUseProgram(m_programs.scan);
+    glDispatchCompute(1, 1, 1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glUseProgram(m_programs.scatter);
+    glDispatchComputeIndirect(args);
+    src = 1 - src;
+  }
+  BindBuffers(src);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
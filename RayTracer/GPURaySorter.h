@@ -0,0 +1,109 @@
+#ifndef GPURAYSORTER_H
+#define GPURAYSORTER_H
+
+#include <GL/glew.h>
+
+//Shader storage binding points of the sort buffers, must match raytracer_cs.glsl
+enum RaySortBinding
+{
+  RAYSORT_BINDING_KEYS        = 31,
+  RAYSORT_BINDING_ORDER       = 32,
+  RAYSORT_BINDING_KEYS_OUT    = 33,
+  RAYSORT_BINDING_ORDER_OUT   = 34,
+  RAYSORT_BINDING_HISTOGRAM   = 35
+};
+
+//Work group size of the scan pass, a single group
+#define RAYSORT_SCAN_SIZE 256
+
+//Bits sorted per radix pass, the digits that gives, and the bits of a key
+#define RAYSORT_RADIX_BITS  4
+#define RAYSORT_RADIX_SIZE  16
+#define RAYSORT_KEY_BITS    30
+
+/*!
+ * @class GPURaySorter
+ *
+ * @brief Sorts the queues of WavefrontQueues by origin cell and direction
+ * octant before they are traced.
+ *
+ * Rays of the same octant leaving the same region of the scene go through
+ * much the same nodes, so tracing them in neighbouring invocations keeps
+ * the BVH in cache and the invocations of a work group on the same path.
+ *
+ * Each queue gets a 30 bit key per ray, which a radix sort of 4 bits per
+ * pass orders like GPUBVHBuilder's. The rays themselves are not moved: the
+ * sorted order is left in a buffer the shadow and bounce passes read the
+ * queue through. Every pass is dispatched indirectly from the counts of
+ * the prepare pass, so sorting needs no read back either.
+ */
+class GPURaySorter
+{
+public:
+
+  //! Programs of the PASS_SORT_* passes of raytracer_cs.glsl.
+  struct Programs
+  {
+    GLuint keys;
+    GLuint histogram;
+    GLuint scan;
+    GLuint scatter;
+  };
+
+  //! Must match sortQueue in raytracer_cs.glsl.
+  enum Queue
+  {
+    QUEUE_SHADOWS = 0,
+    QUEUE_RAYS    = 1     //Reflection rays drained by the bounce pass
+  };
+
+  GPURaySorter();
+
+  //! Takes ownership of the programs. Room for one ray per pixel.
+  void Init(Programs const &, unsigned nPixels);
+  void ShutDown();
+
+  //! Origins are binned over these bounds, normally those of the scene.
+  void SetBounds(float const min[3], float const max[3]);
+
+  //! Sorts a queue after the prepare pass of a bounce. The queues must be
+  //! bound with WavefrontQueues::Bind(). Leaves the order at
+  //! RAYSORT_BINDING_ORDER.
+  void Sort(Queue, unsigned bounce);
+
+private:
+
+  enum Pass
+  {
+    PASS_KEYS,
+    PASS_HISTOGRAM,
+    PASS_SCAN,
+    PASS_SCATTER,
+    PASS_COUNT
+  };
+
+  struct Uniforms
+  {
+    GLint queue;
+    GLint bounce;
+    GLint sortMin;
+    GLint sortScale;
+    GLint shift;
+  };
+
+  GLuint GetProgram(Pass) const;
+
+  //! Binds the keys and order sorted from, and those sorted into.
+  void BindBuffers(int src) const;
+
+private:
+
+  Programs  m_programs;
+  Uniforms  m_uniforms[PASS_COUNT];
+
+  GLuint    m_keys[2];
+  GLuint    m_order[2];
+  GLuint    m_histogram;
+};
+
+#endif
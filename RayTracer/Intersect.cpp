@@ -0,0 +1,944 @@
+#include <math.h>
+
+#include "Intersect.h"
+
+#define PI_D 3.14159265358979323846
+
+
+static real Dot3(vec4 const & a_v0, vec4 const & a_v1)
+{
+  return a_v0[0] * a_v1[0] + a_v0[1] * a_v1[1] + a_v0[2] * a_v1[2];
+}
+
+
+static vec4 Normalize3(vec4 const & a_v)
+{
+  real length = sqrt(Dot3(a_v, a_v));
+  if (length > static_cast<real>(0.0))
+  {
+    return vec4(a_v[0] / length, a_v[1] / length, a_v[2] / length, static_cast<real>(0.0));
+  }
+  return vec4(static_cast<real>(0.0), static_cast<real>(0.0), static_cast<real>(1.0), static_cast<real>(0.0));
+}
+
+
+//! The capsule, cylinder and cone kernels work with a unit direction. The
+//! returned distance is scaled back to the units of the ray.
+static void UnitDirection(Ray const & a_ray, vec4 & a_dir, real & a_length)
+{
+  a_length = sqrt(Dot3(a_ray.direction, a_ray.direction));
+  a_dir = a_ray.direction / a_length;
+}
+
+
+static real ToRayDistance(real a_t, real a_length)
+{
+  if (a_t > static_cast<real>(0.0))
+  {
+    return a_t / a_length;
+  }
+  return NO_INTERSECT;
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - SPHERE
+//--------------------------------------------------------------------------------------
+
+static real IntersectSphereFromOutside(Ray const & a_ray, Sphere const & a_sphere)
+{
+  vec4 P = a_ray.origin - a_sphere.center;
+  real a = Dot3(a_ray.direction, a_ray.direction);
+  real b = static_cast<real>(2.0) * Dot3(P, a_ray.direction);
+  real c = Dot3(P, P) - a_sphere.radius * a_sphere.radius;
+  real discriment = b * b - static_cast<real>(4.0) * a * c;
+
+  // Ray does not intersect sphere
+  if (discriment <= static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  real numerator = -b - sqrt(discriment);
+
+  // Sphere behind ray origin
+  if (numerator < static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  return numerator / (static_cast<real>(2.0) * a);
+}
+
+
+static real IntersectSphereFromInside(Ray const & a_ray, Sphere const & a_sphere)
+{
+  vec4 P = a_ray.origin - a_sphere.center;
+  real a = Dot3(a_ray.direction, a_ray.direction);
+  real b = static_cast<real>(2.0) * Dot3(P, a_ray.direction);
+  real c = Dot3(P, P) - a_sphere.radius * a_sphere.radius;
+  real discriment = b * b - static_cast<real>(4.0) * a * c;
+
+  // Ray does not intersect sphere. ERROR: Ray SHOULD intersect sphere!
+  if (discriment <= static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  real numerator = -b + sqrt(discriment);
+
+  // Sphere behind ray origin. ERROR: Ray SHOULD intersect sphere ahead!
+  if (numerator < static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  return numerator / (static_cast<real>(2.0) * a);
+}
+
+
+real IntersectSphere(Ray const & a_ray, Sphere const & a_sphere)
+{
+  vec4 P_C = a_ray.origin - a_sphere.center;
+  if (Dot3(P_C, P_C) <= a_sphere.radius * a_sphere.radius)
+  {
+    return IntersectSphereFromInside(a_ray, a_sphere);
+  }
+  return IntersectSphereFromOutside(a_ray, a_sphere);
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - AABB
+//--------------------------------------------------------------------------------------
+
+static void SlabDistances(Ray const & a_ray, AABB const & a_box, real & a_tNear, real & a_tFar)
+{
+  a_tNear = -NO_INTERSECT;
+  a_tFar = NO_INTERSECT;
+  for (int i = 0; i < 3; i++)
+  {
+    real tMin = (a_box.min[i] - a_ray.origin[i]) / a_ray.direction[i];
+    real tMax = (a_box.max[i] - a_ray.origin[i]) / a_ray.direction[i];
+    real t1 = (tMin < tMax) ? tMin : tMax;
+    real t2 = (tMin < tMax) ? tMax : tMin;
+    if (t1 > a_tNear) a_tNear = t1;
+    if (t2 < a_tFar) a_tFar = t2;
+  }
+}
+
+
+static real IntersectAABBFromOutside(Ray const & a_ray, AABB const & a_box)
+{
+  real tNear, tFar;
+  SlabDistances(a_ray, a_box, tNear, tFar);
+
+  if (tNear > static_cast<real>(0.0) && tNear < tFar)
+  {
+    return tNear;
+  }
+  return NO_INTERSECT;
+}
+
+
+static real IntersectAABBFromInside(Ray const & a_ray, AABB const & a_box)
+{
+  real tNear, tFar;
+  SlabDistances(a_ray, a_box, tNear, tFar);
+
+  if (tNear < tFar)
+  {
+    return tNear;
+  }
+  return NO_INTERSECT;
+}
+
+
+real IntersectAABB(Ray const & a_ray, AABB const & a_box)
+{
+  if (a_ray.origin[0] > a_box.min[0]
+    && a_ray.origin[1] > a_box.min[1]
+    && a_ray.origin[2] > a_box.min[2]
+    && a_ray.origin[0] < a_box.max[0]
+    && a_ray.origin[1] < a_box.max[1]
+    && a_ray.origin[2] < a_box.max[2])
+  {
+    return IntersectAABBFromInside(a_ray, a_box);
+  }
+  return IntersectAABBFromOutside(a_ray, a_box);
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - OBB
+//--------------------------------------------------------------------------------------
+
+real IntersectOBB(Ray const & a_ray, OBB const & a_box)
+{
+  //Slab test in the frame of the box
+  vec4 P = a_ray.origin - a_box.center;
+  real tNear = -NO_INTERSECT;
+  real tFar = NO_INTERSECT;
+  for (int i = 0; i < 3; i++)
+  {
+    real o = Dot3(P, a_box.axes[i]);
+    real d = Dot3(a_ray.direction, a_box.axes[i]);
+    real tMin = (-a_box.extents[i] - o) / d;
+    real tMax = (a_box.extents[i] - o) / d;
+    real t1 = (tMin < tMax) ? tMin : tMax;
+    real t2 = (tMin < tMax) ? tMax : tMin;
+    if (t1 > tNear) tNear = t1;
+    if (t2 < tFar) tFar = t2;
+  }
+
+  if (tNear > tFar || tFar <= static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  //Origin inside the box
+  if (tNear <= static_cast<real>(0.0))
+  {
+    return tFar;
+  }
+  return tNear;
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - CAPSULE
+//--------------------------------------------------------------------------------------
+
+real IntersectCapsule(Ray const & a_ray, Capsule const & a_capsule)
+{
+  vec4 rd;
+  real length;
+  UnitDirection(a_ray, rd, length);
+
+  vec4 const & ba = a_capsule.direction;
+  vec4 oa = a_ray.origin - a_capsule.origin;
+  real baba = Dot3(ba, ba);
+  real bard = Dot3(ba, rd);
+  real baoa = Dot3(ba, oa);
+  real rdoa = Dot3(rd, oa);
+  real oaoa = Dot3(oa, oa);
+  real rr = a_capsule.radius * a_capsule.radius;
+
+  //Infinite cylinder around the segment
+  real a = baba - bard * bard;
+  real b = baba * rdoa - baoa * bard;
+  real c = baba * oaoa - baoa * baoa - rr * baba;
+  real h;
+  real y;
+  if (a < static_cast<real>(1.0e-6) * baba)
+  {
+    //Parallel to the axis a and b vanish and only the hemisphere the ray
+    //travels towards can be hit, when the ray lies within the radius
+    if (c > static_cast<real>(0.0))
+    {
+      return NO_INTERSECT;
+    }
+    y = (bard > static_cast<real>(0.0)) ? static_cast<real>(0.0) : baba;
+  }
+  else
+  {
+    h = b * b - a * c;
+    if (h < static_cast<real>(0.0))
+    {
+      return NO_INTERSECT;
+    }
+
+    real t = (-b - sqrt(h)) / a;
+    y = baoa + t * bard;
+    if (y > static_cast<real>(0.0) && y < baba)
+    {
+      return ToRayDistance(t, length);
+    }
+  }
+
+  //Hemisphere at the nearer end
+  vec4 oc = (y <= static_cast<real>(0.0)) ? oa : vec4(a_ray.origin - (a_capsule.origin + ba));
+  b = Dot3(rd, oc);
+  c = Dot3(oc, oc) - rr;
+  h = b * b - c;
+  if (h <= static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+  return ToRayDistance(-b - sqrt(h), length);
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - CYLINDER
+//--------------------------------------------------------------------------------------
+
+real IntersectCylinder(Ray const & a_ray, Cylinder const & a_cylinder)
+{
+  vec4 rd;
+  real length;
+  UnitDirection(a_ray, rd, length);
+
+  vec4 const & ba = a_cylinder.direction;
+  vec4 oc = a_ray.origin - a_cylinder.origin;
+  real baba = Dot3(ba, ba);
+  real bard = Dot3(ba, rd);
+  real baoc = Dot3(ba, oc);
+
+  real k2 = baba - bard * bard;
+  real k1 = baba * Dot3(oc, rd) - baoc * bard;
+  real k0 = baba * Dot3(oc, oc) - baoc * baoc - a_cylinder.radius * a_cylinder.radius * baba;
+
+  //Parallel to the axis, k1 and k2 vanish and only a cap can be hit, when
+  //the ray lies within the radius
+  if (k2 < static_cast<real>(1.0e-6) * baba)
+  {
+    if (k0 > static_cast<real>(0.0))
+    {
+      return NO_INTERSECT;
+    }
+    return ToRayDistance((((bard > static_cast<real>(0.0)) ? static_cast<real>(0.0) : baba) - baoc) / bard, length);
+  }
+
+  real h = k1 * k1 - k2 * k0;
+  if (h < static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+  h = sqrt(h);
+
+  //Side
+  real t = (-k1 - h) / k2;
+  real y = baoc + t * bard;
+  if (y > static_cast<real>(0.0) && y < baba)
+  {
+    return ToRayDistance(t, length);
+  }
+
+  //Caps
+  t = (((y < static_cast<real>(0.0)) ? static_cast<real>(0.0) : baba) - baoc) / bard;
+  if (fabs(k1 + k2 * t) < h)
+  {
+    return ToRayDistance(t, length);
+  }
+  return NO_INTERSECT;
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - CONE SEGMENT
+//--------------------------------------------------------------------------------------
+
+real IntersectConeSegment(Ray const & a_ray, ConeSegment const & a_cone)
+{
+  vec4 rd;
+  real length;
+  UnitDirection(a_ray, rd, length);
+
+  vec4 const & ba = a_cone.direction;
+  vec4 oa = a_ray.origin - a_cone.origin;
+  vec4 ob = oa - ba;
+  real m0 = Dot3(ba, ba);
+  real m1 = Dot3(oa, ba);
+  real m2 = Dot3(rd, ba);
+  real m3 = Dot3(rd, oa);
+  real m5 = Dot3(oa, oa);
+  real m9 = Dot3(ob, ba);
+
+  //Caps
+  if (m1 < static_cast<real>(0.0))
+  {
+    vec4 v = oa * m2 - rd * m1;
+    if (Dot3(v, v) < a_cone.r0 * a_cone.r0 * m2 * m2)
+    {
+      return ToRayDistance(-m1 / m2, length);
+    }
+  }
+  else if (m9 > static_cast<real>(0.0))
+  {
+    real t = -m9 / m2;
+    vec4 v = ob + rd * t;
+    if (Dot3(v, v) < a_cone.r1 * a_cone.r1)
+    {
+      return ToRayDistance(t, length);
+    }
+  }
+
+  //Side
+  real ra = a_cone.r0;
+  real rr = a_cone.r0 - a_cone.r1;
+  real hy = m0 + rr * rr;
+  real k2 = m0 * m0 - m2 * m2 * hy;
+  real k1 = m0 * m0 * m3 - m1 * m2 * hy + m0 * ra * (rr * m2);
+  real k0 = m0 * m0 * m5 - m1 * m1 * hy + m0 * ra * (rr * m1 * static_cast<real>(2.0) - m0 * ra);
+  real h = k1 * k1 - k2 * k0;
+  if (h < static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  real t = (-k1 - sqrt(h)) / k2;
+  real y = m1 + t * m2;
+  if (y < static_cast<real>(0.0) || y > m0)
+  {
+    return NO_INTERSECT;
+  }
+  return ToRayDistance(t, length);
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - TORUS
+//--------------------------------------------------------------------------------------
+
+//Roots of x^2 + b x + c, avoiding cancellation between b and the root.
+static int SolveQuadratic(double a_b, double a_c, double a_roots[2])
+{
+  double discriminant = a_b * a_b - 4.0 * a_c;
+  if (discriminant < 0.0)
+  {
+    return 0;
+  }
+
+  double q = -0.5 * (a_b + ((a_b < 0.0) ? -sqrt(discriminant) : sqrt(discriminant)));
+  a_roots[0] = q;
+  a_roots[1] = (q != 0.0) ? a_c / q : 0.0;
+  return 2;
+}
+
+
+//Largest real root of x^3 + a x^2 + b x + c.
+static double LargestCubicRoot(double a_a, double a_b, double a_c)
+{
+  double Q = (a_a * a_a - 3.0 * a_b) / 9.0;
+  double R = (2.0 * a_a * a_a * a_a - 9.0 * a_a * a_b + 27.0 * a_c) / 54.0;
+  double Q3 = Q * Q * Q;
+
+  if (R * R < Q3)
+  {
+    double theta = acos(R / sqrt(Q3));
+    return -2.0 * sqrt(Q) * cos((theta + 2.0 * PI_D) / 3.0) - a_a / 3.0;
+  }
+
+  double A = -((R < 0.0) ? -1.0 : 1.0) * pow(fabs(R) + sqrt(R * R - Q3), 1.0 / 3.0);
+  double B = (A != 0.0) ? Q / A : 0.0;
+  return (A + B) - a_a / 3.0;
+}
+
+
+//Real roots of x^4 + c[0] x^3 + c[1] x^2 + c[2] x + c[3] by Ferrari's method,
+//each polished with Newton steps on the original polynomial.
+static int SolveQuartic(double const a_c[4], double a_roots[4])
+{
+  double a = a_c[0];
+  double b = a_c[1];
+  double c = a_c[2];
+  double d = a_c[3];
+
+  //Depressed quartic y^4 + p y^2 + q y + r, x = y - a/4
+  double aa = a * a;
+  double p = b - 3.0 * aa / 8.0;
+  double q = c - a * b / 2.0 + aa * a / 8.0;
+  double r = d - a * c / 4.0 + aa * b / 16.0 - 3.0 * aa * aa / 256.0;
+
+  int n = 0;
+  double m = LargestCubicRoot(p, p * p / 4.0 - r, -q * q / 8.0);
+
+  if (m <= 1.0e-12)
+  {
+    //Biquadratic
+    double z[2];
+    if (SolveQuadratic(p, r, z) == 2)
+    {
+      for (int i = 0; i < 2; i++)
+      {
+        if (z[i] >= 0.0)
+        {
+          a_roots[n++] = sqrt(z[i]);
+          a_roots[n++] = -sqrt(z[i]);
+        }
+      }
+    }
+  }
+  else
+  {
+    double s = sqrt(2.0 * m);
+    double u = q / (2.0 * s);
+    n += SolveQuadratic(s, p / 2.0 + m - u, a_roots + n);
+    n += SolveQuadratic(-s, p / 2.0 + m + u, a_roots + n);
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    double x = a_roots[i] - a / 4.0;
+    for (int k = 0; k < 2; k++)
+    {
+      double f = (((x + a) * x + b) * x + c) * x + d;
+      double df = ((4.0 * x + 3.0 * a) * x + 2.0 * b) * x + c;
+      if (df == 0.0)
+      {
+        break;
+      }
+      x -= f / df;
+    }
+    a_roots[i] = x;
+  }
+  return n;
+}
+
+
+real IntersectTorus(Ray const & a_ray, Torus const & a_torus)
+{
+  double R = a_torus.radius_circle;
+  double r = a_torus.radius_thick;
+
+  double o[3], d[3], axis[3];
+  for (int i = 0; i < 3; i++)
+  {
+    o[i] = double(a_ray.origin[i]) - double(a_torus.center[i]);
+    d[i] = a_ray.direction[i];
+    axis[i] = a_torus.axis[i];
+  }
+  double length = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  for (int i = 0; i < 3; i++)
+  {
+    d[i] /= length;
+  }
+
+  //Reject against the bounding sphere, then start from where the ray enters
+  //it. Keeping the origin close to the torus keeps the quartic well scaled.
+  double bound = R + r;
+  double od = o[0] * d[0] + o[1] * d[1] + o[2] * d[2];
+  double oo = o[0] * o[0] + o[1] * o[1] + o[2] * o[2];
+  double h = od * od - (oo - bound * bound);
+  if (h <= 0.0)
+  {
+    return NO_INTERSECT;
+  }
+  double t0 = -od - sqrt(h);
+  if (t0 < 0.0)
+  {
+    t0 = 0.0;
+  }
+  if (-od + sqrt(h) <= 0.0)
+  {
+    return NO_INTERSECT;
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    o[i] += t0 * d[i];
+  }
+  od = o[0] * d[0] + o[1] * d[1] + o[2] * d[2];
+  oo = o[0] * o[0] + o[1] * o[1] + o[2] * o[2];
+  double oa = o[0] * axis[0] + o[1] * axis[1] + o[2] * axis[2];
+  double da = d[0] * axis[0] + d[1] * axis[1] + d[2] * axis[2];
+
+  //(|p|^2 + R^2 - r^2)^2 = 4 R^2 (|p|^2 - (p.axis)^2), p = o + t d
+  double k = oo + R * R - r * r;
+  double R4 = 4.0 * R * R;
+  double coeffs[4];
+  coeffs[0] = 4.0 * od;
+  coeffs[1] = 4.0 * od * od + 2.0 * k - R4 * (1.0 - da * da);
+  coeffs[2] = 4.0 * od * k - 2.0 * R4 * (od - oa * da);
+  coeffs[3] = k * k - R4 * (oo - oa * oa);
+
+  double roots[4];
+  int n = SolveQuartic(coeffs, roots);
+
+  double t = NO_INTERSECT;
+  for (int i = 0; i < n; i++)
+  {
+    if (roots[i] + t0 > 0.0 && roots[i] < t)
+    {
+      t = roots[i];
+    }
+  }
+  if (t == double(NO_INTERSECT))
+  {
+    return NO_INTERSECT;
+  }
+  return static_cast<real>((t + t0) / length);
+}
+
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - TRIANGLE
+//--------------------------------------------------------------------------------------
+
+void SetupTriangleRay(Ray const & a_ray, TriangleRay & a_out)
+{
+  //Shear and scale space so the ray runs down +z from the origin
+  int kz = 0;
+  for (int i = 1; i < 3; i++)
+  {
+    if (fabs(a_ray.direction[i]) > fabs(a_ray.direction[kz])) kz = i;
+  }
+  int kx = (kz + 1) % 3;
+  int ky = (kx + 1) % 3;
+
+  //Keep the winding of the sheared triangle
+  if (a_ray.direction[kz] < static_cast<real>(0.0))
+  {
+    int temp = kx;
+    kx = ky;
+    ky = temp;
+  }
+
+  a_out.kx = kx;
+  a_out.ky = ky;
+  a_out.kz = kz;
+  a_out.Sx = a_ray.direction[kx] / a_ray.direction[kz];
+  a_out.Sy = a_ray.direction[ky] / a_ray.direction[kz];
+  a_out.Sz = static_cast<real>(1.0) / a_ray.direction[kz];
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.origin[i] = a_ray.origin[i];
+  }
+}
+
+
+real IntersectTriangle(TriangleRay const & a_ray, float const * a_v0, float const * a_v1, float const * a_v2)
+{
+  int kx = a_ray.kx;
+  int ky = a_ray.ky;
+  int kz = a_ray.kz;
+
+  real A[3], B[3], C[3];
+  for (int i = 0; i < 3; i++)
+  {
+    A[i] = a_v0[i] - a_ray.origin[i];
+    B[i] = a_v1[i] - a_ray.origin[i];
+    C[i] = a_v2[i] - a_ray.origin[i];
+  }
+
+  real Ax = A[kx] - a_ray.Sx * A[kz];
+  real Ay = A[ky] - a_ray.Sy * A[kz];
+  real Bx = B[kx] - a_ray.Sx * B[kz];
+  real By = B[ky] - a_ray.Sy * B[kz];
+  real Cx = C[kx] - a_ray.Sx * C[kz];
+  real Cy = C[ky] - a_ray.Sy * C[kz];
+
+  //Scaled barycentrics
+  real U = Cx * By - Cy * Bx;
+  real V = Ax * Cy - Ay * Cx;
+  real W = Bx * Ay - By * Ax;
+
+  //The ray passes through an edge. Recompute in double precision so the edge
+  //is owned by exactly one of the triangles sharing it.
+  if (U == static_cast<real>(0.0) || V == static_cast<real>(0.0) || W == static_cast<real>(0.0))
+  {
+    U = static_cast<real>(double(Cx) * double(By) - double(Cy) * double(Bx));
+    V = static_cast<real>(double(Ax) * double(Cy) - double(Ay) * double(Cx));
+    W = static_cast<real>(double(Bx) * double(Ay) - double(By) * double(Ax));
+  }
+
+  if ((U < static_cast<real>(0.0) || V < static_cast<real>(0.0) || W < static_cast<real>(0.0))
+    && (U > static_cast<real>(0.0) || V > static_cast<real>(0.0) || W > static_cast<real>(0.0)))
+  {
+    return NO_INTERSECT;
+  }
+
+  real det = U + V + W;
+  if (det == static_cast<real>(0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  real T = U * a_ray.Sz * A[kz] + V * a_ray.Sz * B[kz] + W * a_ray.Sz * C[kz];
+
+  //Hit must be in front of the origin, either winding
+  if ((det < static_cast<real>(0.0)) ? (T >= static_cast<real>(0.0)) : (T <= static_cast<real>(0.0)))
+  {
+    return NO_INTERSECT;
+  }
+  return T / det;
+}
+
+
+void IntersectMesh(Ray const & a_ray, Scene const & a_scene, int a_mesh, HitInfo & a_info)
+{
+  TriangleRay ray;
+  SetupTriangleRay(a_ray, ray);
+
+  Mesh const & mesh = a_scene.GetMeshes()[a_mesh];
+  for (unsigned i = 0; i < mesh.nTriangles; i++)
+  {
+    real t = IntersectTriangle(ray,
+                               a_scene.GetTriangleVertex(mesh, i, 0),
+                               a_scene.GetTriangleVertex(mesh, i, 1),
+                               a_scene.GetTriangleVertex(mesh, i, 2));
+    if (t < a_info.t)
+    {
+      a_info.type = TYPE_MESH;
+      a_info.t = t;
+      a_info.index = a_mesh;
+      a_info.triangle = int(i);
+    }
+  }
+}
+
+
+Ray ToObjectSpace(Instance const & a_instance, Ray const & a_ray)
+{
+  vqs toObject = Dg::Inverse(a_instance.transform);
+  Ray result;
+  result.origin = toObject.TransformPoint(a_ray.origin);
+  result.direction = toObject.TransformVector(a_ray.direction);
+  return result;
+}
+
+
+void IntersectInstance(Ray const & a_ray, Scene const & a_scene, int a_instance, HitInfo & a_info)
+{
+  Instance const & instance = a_scene.GetInstances()[a_instance];
+
+  HitInfo hit(a_info);
+  hit.type = TYPE_NULL;
+  IntersectMesh(ToObjectSpace(instance, a_ray), a_scene, int(instance.mesh), hit);
+
+  if (hit.type != TYPE_NULL)
+  {
+    a_info.type = TYPE_INSTANCE;
+    a_info.t = hit.t;
+    a_info.index = a_instance;
+    a_info.triangle = hit.triangle;
+  }
+}
+
+
+//--------------------------------------------------------------------------------------
+//  NORMALS
+//--------------------------------------------------------------------------------------
+
+//Picks the face of a box, given the point in the box frame scaled to [-1, 1].
+static int DominantAxis(real const a_p[3])
+{
+  int axis = 0;
+  for (int i = 1; i < 3; i++)
+  {
+    if (fabs(a_p[i]) > fabs(a_p[axis])) axis = i;
+  }
+  return axis;
+}
+
+
+//Normal of a capped primitive about the segment from 'origin' to 'origin + direction'.
+//'slope' is the change in radius over the length of the segment.
+static vec4 CappedNormal(vec4 const & a_origin, vec4 const & a_direction, real a_r0, real a_slope, vec4 const & a_point)
+{
+  real length = sqrt(Dot3(a_direction, a_direction));
+  vec4 axis = a_direction / length;
+  vec4 P = a_point - a_origin;
+  real h = Dot3(P, axis);
+  vec4 radial = P - axis * h;
+  real radialLength = sqrt(Dot3(radial, radial));
+  real radius = a_r0 + a_slope * (h / length);
+
+  real sideDistance = fabs(radialLength - radius);
+  real capDistance = (h < static_cast<real>(0.5) * length) ? fabs(h) : fabs(length - h);
+  if (capDistance < sideDistance)
+  {
+    return (h < static_cast<real>(0.5) * length) ? vec4(-axis) : axis;
+  }
+
+  vec4 u = radial / radialLength;
+  return Normalize3(u * length - axis * a_slope);
+}
+
+
+vec4 GetNormal(Scene const & a_scene, HitInfo const & a_hit, vec4 const & a_point)
+{
+  int index = a_hit.index;
+  switch (a_hit.type)
+  {
+    case TYPE_AABB:
+    {
+      AABB const & box = a_scene.GetBoxes()[index];
+      real p[3];
+      for (int i = 0; i < 3; i++)
+      {
+        real half = static_cast<real>(0.5) * (box.max[i] - box.min[i]);
+        p[i] = (a_point[i] - (box.min[i] + half)) / half;
+      }
+      int axis = DominantAxis(p);
+      vec4 n(static_cast<real>(0.0), static_cast<real>(0.0), static_cast<real>(0.0), static_cast<real>(0.0));
+      n[axis] = (p[axis] < static_cast<real>(0.0)) ? static_cast<real>(-1.0) : static_cast<real>(1.0);
+      return n;
+    }
+    case TYPE_SPHERE:
+    {
+      Sphere const & sphere = a_scene.GetSpheres()[index];
+      return Normalize3(a_point - sphere.center);
+    }
+    case TYPE_OBB:
+    {
+      OBB const & box = a_scene.GetOBBs()[index];
+      vec4 P = a_point - box.center;
+      real p[3];
+      for (int i = 0; i < 3; i++)
+      {
+        p[i] = Dot3(P, box.axes[i]) / box.extents[i];
+      }
+      int axis = DominantAxis(p);
+      return (p[axis] < static_cast<real>(0.0)) ? vec4(-box.axes[axis]) : box.axes[axis];
+    }
+    case TYPE_CAPSULE:
+    {
+      Capsule const & capsule = a_scene.GetCapsules()[index];
+      real h = Dot3(a_point - capsule.origin, capsule.direction) / Dot3(capsule.direction, capsule.direction);
+      if (h < static_cast<real>(0.0)) h = static_cast<real>(0.0);
+      if (h > static_cast<real>(1.0)) h = static_cast<real>(1.0);
+      return Normalize3(a_point - (capsule.origin + capsule.direction * h));
+    }
+    case TYPE_CYLINDER:
+    {
+      Cylinder const & cylinder = a_scene.GetCylinders()[index];
+      return CappedNormal(cylinder.origin, cylinder.direction, cylinder.radius, static_cast<real>(0.0), a_point);
+    }
+    case TYPE_TORUS:
+    {
+      //Gradient of (|p|^2 + R^2 - r^2)^2 - 4 R^2 (|p|^2 - (p.axis)^2)
+      Torus const & torus = a_scene.GetTori()[index];
+      vec4 P = a_point - torus.center;
+      real R2 = torus.radius_circle * torus.radius_circle;
+      real r2 = torus.radius_thick * torus.radius_thick;
+      real pa = Dot3(P, torus.axis);
+      return Normalize3(P * (Dot3(P, P) - R2 - r2) + torus.axis * (static_cast<real>(2.0) * R2 * pa));
+    }
+    case TYPE_CONE:
+    {
+      ConeSegment const & cone = a_scene.GetCones()[index];
+      return CappedNormal(cone.origin, cone.direction, cone.r0, cone.r1 - cone.r0, a_point);
+    }
+    case TYPE_MESH:
+    {
+      Mesh const & mesh = a_scene.GetMeshes()[index];
+      float const * v0 = a_scene.GetTriangleVertex(mesh, a_hit.triangle, 0);
+      float const * v1 = a_scene.GetTriangleVertex(mesh, a_hit.triangle, 1);
+      float const * v2 = a_scene.GetTriangleVertex(mesh, a_hit.triangle, 2);
+      vec4 e0(v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2], static_cast<real>(0.0));
+      vec4 e1(v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2], static_cast<real>(0.0));
+      return Normalize3(Dg::Cross(e0, e1));
+    }
+    case TYPE_INSTANCE:
+    {
+      //Scaling is uniform, so only the rotation changes the normal
+      Instance const & instance = a_scene.GetInstances()[index];
+      HitInfo hit(a_hit);
+      hit.type = TYPE_MESH;
+      hit.index = int(instance.mesh);
+      return instance.transform.Rotate(GetNormal(a_scene, hit, a_point));
+    }
+  }
+  return vec4(static_cast<real>(0.0), static_cast<real>(0.0), static_cast<real>(1.0), static_cast<real>(0.0));
+}
+
+
+//--------------------------------------------------------------------------------------
+//  DISPATCH
+//--------------------------------------------------------------------------------------
+
+unsigned GetPrimitiveCount(Scene const & a_scene, int a_type)
+{
+  switch (a_type)
+  {
+    case TYPE_AABB:     return a_scene.GetBoxes().size;
+    case TYPE_SPHERE:   return a_scene.GetSpheres().size;
+    case TYPE_OBB:      return a_scene.GetOBBs().size;
+    case TYPE_CAPSULE:  return a_scene.GetCapsules().size;
+    case TYPE_CYLINDER: return a_scene.GetCylinders().size;
+    case TYPE_TORUS:    return a_scene.GetTori().size;
+    case TYPE_CONE:     return a_scene.GetCones().size;
+    case TYPE_MESH:     return a_scene.GetMeshes().size;
+    case TYPE_INSTANCE: return a_scene.GetInstances().size;
+  }
+  return 0;
+}
+
+
+uint32_t GetPrimitiveMaterials(Scene const & a_scene, int a_type, int a_index)
+{
+  switch (a_type)
+  {
+    case TYPE_AABB:     return a_scene.GetBoxes()[a_index].materials;
+    case TYPE_SPHERE:   return a_scene.GetSpheres()[a_index].materials;
+    case TYPE_OBB:      return a_scene.GetOBBs()[a_index].materials;
+    case TYPE_CAPSULE:  return a_scene.GetCapsules()[a_index].materials;
+    case TYPE_CYLINDER: return a_scene.GetCylinders()[a_index].materials;
+    case TYPE_TORUS:    return a_scene.GetTori()[a_index].materials;
+    case TYPE_CONE:     return a_scene.GetCones()[a_index].materials;
+    case TYPE_MESH:     return a_scene.GetMeshes()[a_index].materials;
+    case TYPE_INSTANCE: return a_scene.GetInstances()[a_index].materials;
+  }
+  return 0;
+}
+
+
+real IntersectPrimitive(Ray const & a_ray, Scene const & a_scene, int a_type, int a_index)
+{
+  switch (a_type)
+  {
+    case TYPE_AABB:     return IntersectAABB(a_ray, a_scene.GetBoxes()[a_index]);
+    case TYPE_SPHERE:   return IntersectSphere(a_ray, a_scene.GetSpheres()[a_index]);
+    case TYPE_OBB:      return IntersectOBB(a_ray, a_scene.GetOBBs()[a_index]);
+    case TYPE_CAPSULE:  return IntersectCapsule(a_ray, a_scene.GetCapsules()[a_index]);
+    case TYPE_CYLINDER: return IntersectCylinder(a_ray, a_scene.GetCylinders()[a_index]);
+    case TYPE_TORUS:    return IntersectTorus(a_ray, a_scene.GetTori()[a_index]);
+    case TYPE_CONE:     return IntersectConeSegment(a_ray, a_scene.GetCones()[a_index]);
+    case TYPE_MESH:
+    {
+      HitInfo info;
+      info.type = TYPE_NULL;
+      info.t = NO_INTERSECT;
+      info.index = -1;
+      info.triangle = -1;
+      IntersectMesh(a_ray, a_scene, a_index, info);
+      return info.t;
+    }
+    case TYPE_INSTANCE:
+    {
+      HitInfo info;
+      info.type = TYPE_NULL;
+      info.t = NO_INTERSECT;
+      info.index = -1;
+      info.triangle = -1;
+      IntersectInstance(a_ray, a_scene, a_index, info);
+      return info.t;
+    }
+  }
+  return NO_INTERSECT;
+}
+
+
+void IntersectScene(Ray const & a_ray, Scene const & a_scene, HitInfo & a_info, RayCost * a_cost)
+{
+  for (unsigned i = 0; i < a_scene.GetMeshes().size; i++)
+  {
+    IntersectMesh(a_ray, a_scene, int(i), a_info);
+    if (a_cost) a_cost->primitives += a_scene.GetMeshes()[i].nTriangles;
+  }
+
+  for (unsigned i = 0; i < a_scene.GetInstances().size; i++)
+  {
+    IntersectInstance(a_ray, a_scene, int(i), a_info);
+    if (a_cost) a_cost->primitives += a_scene.GetMeshes()[a_scene.GetInstances()[i].mesh].nTriangles;
+  }
+
+  for (int type = 0; type < TYPE_MESH; type++)
+  {
+    unsigned count = GetPrimitiveCount(a_scene, type);
+    if (a_cost) a_cost->primitives += count;
+    for (unsigned i = 0; i < count; i++)
+    {
+      real t = IntersectPrimitive(a_ray, a_scene, type, int(i));
+      if (t < a_info.t)
+      {
+        a_info.type = type;
+        a_info.t = t;
+        a_info.index = int(i);
+        a_info.triangle = -1;
+      }
+    }
+  }
+}
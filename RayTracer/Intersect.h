@@ -0,0 +1,94 @@
+#ifndef INTERSECT_H
+#define INTERSECT_H
+
+#include <limits>
+
+#include "scene.h"
+
+//C++ mirror of the intersection routines in raytracer_cs.glsl. Keep the two in step.
+
+const real NO_INTERSECT = std::numeric_limits<real>::infinity();
+const real MAX_SCENE_BOUNDS = static_cast<real>(100.0);
+
+enum PrimitiveType
+{
+  TYPE_NULL = -1,
+  TYPE_AABB = 0,
+  TYPE_SPHERE = 1,
+  TYPE_OBB = 2,
+  TYPE_CAPSULE = 3,
+  TYPE_CYLINDER = 4,
+  TYPE_TORUS = 5,
+  TYPE_CONE = 6,
+  TYPE_MESH = 7,
+  TYPE_INSTANCE = 8,
+  TYPE_COUNT,
+
+  //Only found in the leaves of a per mesh BVH
+  TYPE_TRIANGLE = TYPE_COUNT
+};
+
+struct HitInfo
+{
+  int   type;
+  real  t;
+  int   index;
+  int   triangle;   //For TYPE_MESH and TYPE_INSTANCE, the triangle within the mesh
+};
+
+//! Work done tracing rays, counted when a pointer to one is passed down.
+//! The hierarchies add nodes and primitives, CPUTracer rays and bounces.
+struct RayCost
+{
+  uint32_t  nodes;        //BVH nodes entered
+  uint32_t  primitives;   //Primitive and triangle tests
+  uint32_t  bounces;      //Reflection rays
+  uint32_t  rays;         //All rays, primary, shadow and reflection
+};
+
+//! Per ray constants of the watertight triangle test
+//! (Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection", 2013).
+struct TriangleRay
+{
+  int   kx, ky, kz;
+  real  Sx, Sy, Sz;
+  real  origin[3];
+};
+
+//All routines return the distance to the nearest hit in front of the ray
+//origin in units of the ray direction, or NO_INTERSECT.
+real IntersectSphere(Ray const &, Sphere const &);
+real IntersectAABB(Ray const &, AABB const &);
+real IntersectOBB(Ray const &, OBB const &);
+real IntersectCapsule(Ray const &, Capsule const &);
+real IntersectCylinder(Ray const &, Cylinder const &);
+real IntersectTorus(Ray const &, Torus const &);
+real IntersectConeSegment(Ray const &, ConeSegment const &);
+
+void SetupTriangleRay(Ray const &, TriangleRay &);
+real IntersectTriangle(TriangleRay const &, float const * v0, float const * v1, float const * v2);
+
+//! Closest hit against every triangle of a mesh.
+void IntersectMesh(Ray const &, Scene const &, int mesh, HitInfo &);
+
+//! The ray in the frame of the instance's mesh. Distances along the ray are
+//! the same in both frames.
+Ray ToObjectSpace(Instance const &, Ray const &);
+
+//! Closest hit against every triangle of an instance.
+void IntersectInstance(Ray const &, Scene const &, int instance, HitInfo &);
+
+//! Outward unit normal at a point on the surface of the primitive that was hit.
+//! Mesh normals follow the counter clockwise winding of the triangle.
+vec4 GetNormal(Scene const &, HitInfo const &, vec4 const & point);
+
+//! Number of primitives of a PrimitiveType in the scene.
+unsigned GetPrimitiveCount(Scene const &, int type);
+uint32_t GetPrimitiveMaterials(Scene const &, int type, int index);
+
+real IntersectPrimitive(Ray const &, Scene const &, int type, int index);
+
+//! Closest hit by testing every primitive, used when there is no BVH.
+void IntersectScene(Ray const &, Scene const &, HitInfo &, RayCost * cost = nullptr);
+
+#endif
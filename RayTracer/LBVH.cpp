@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "LBVH.h"
+#include "ParallelSort.h"
+
+//Below this many primitives per thread, spawning threads costs more than it saves
+#define LBVH_MIN_ITEMS_PER_THREAD   4096
+
+//Subtrees per thread when writing the tree out, to even out the load
+#define LBVH_SUBTREES_PER_THREAD    4
+
+
+//--------------------------------------------------------------------------------
+//		Helpers
+//--------------------------------------------------------------------------------
+
+static int CountLeadingZeros(uint32_t a_v)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  return _BitScanReverse(&index, a_v) ? 31 - int(index) : 32;
+#else
+  return a_v ? __builtin_clz(a_v) : 32;
+#endif
+}
+
+
+static int CountLeadingZeros(uint64_t a_v)
+{
+  uint32_t high = uint32_t(a_v >> 32);
+  return high ? CountLeadingZeros(high) : 32 + CountLeadingZeros(uint32_t(a_v));
+}
+
+
+//--------------------------------------------------------------------------------
+//		Radix tree
+//--------------------------------------------------------------------------------
+
+//Nodes are numbered with the n - 1 interior nodes first, then the n leaves.
+//Interior node 0 is the root, or leaf 0 if there is only one primitive.
+struct RadixNode
+{
+  int32_t left;
+  int32_t right;
+  int32_t first;    //Range of sorted primitives below the node
+  int32_t last;
+};
+
+
+//Length of the common prefix of the codes at i and j, -1 outside the
+//array. Equal codes are told apart by their index.
+template<typename Key>
+static int Delta(Key const * a_keys, int a_n, int a_i, int a_j)
+{
+  if (a_j < 0 || a_j >= a_n)
+  {
+    return -1;
+  }
+  if (a_keys[a_i] == a_keys[a_j])
+  {
+    return int(8 * sizeof(Key)) + CountLeadingZeros(uint32_t(a_i ^ a_j));
+  }
+  return CountLeadingZeros(Key(a_keys[a_i] ^ a_keys[a_j]));
+}
+
+
+//Finds the range and split of interior node i from the codes alone
+template<typename Key>
+static void EmitNode(Key const * a_keys, int a_n, int a_i, RadixNode & a_node)
+{
+  //Direction of the range, towards the neighbour sharing the longer prefix
+  int d = (Delta(a_keys, a_n, a_i, a_i + 1) - Delta(a_keys, a_n, a_i, a_i - 1)) >= 0 ? 1 : -1;
+
+  //Upper bound on the length of the range, then binary search for its end
+  int deltaMin = Delta(a_keys, a_n, a_i, a_i - d);
+  int lengthMax = 2;
+  while (Delta(a_keys, a_n, a_i, a_i + lengthMax * d) > deltaMin)
+  {
+    lengthMax *= 2;
+  }
+  int length = 0;
+  for (int t = lengthMax / 2; t >= 1; t /= 2)
+  {
+    if (Delta(a_keys, a_n, a_i, a_i + (length + t) * d) > deltaMin)
+    {
+      length += t;
+    }
+  }
+  int j = a_i + length * d;
+
+  //Binary search for the split, where the prefix over the range ends
+  int deltaNode = Delta(a_keys, a_n, a_i, j);
+  int split = 0;
+  int t = length;
+  do
+  {
+    t = (t + 1) / 2;
+    if (Delta(a_keys, a_n, a_i, a_i + (split + t) * d) > deltaNode)
+    {
+      split += t;
+    }
+  } while (t > 1);
+  int gamma = a_i + split * d + std::min(d, 0);
+
+  a_node.first = std::min(a_i, j);
+  a_node.last = std::max(a_i, j);
+  a_node.left = (a_node.first == gamma) ? (a_n - 1) + gamma : gamma;
+  a_node.right = (a_node.last == gamma + 1) ? (a_n - 1) + gamma + 1 : gamma + 1;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	LBVHBuilder::Build()
+//--------------------------------------------------------------------------------
+template<typename Key>
+static int BuildLBVH(std::vector<Bounds> const & a_bounds,
+                     std::vector<BVHNode> & a_nodes,
+                     std::vector<uint32_t> & a_order,
+                     unsigned a_nThreads,
+                     int a_maxLeafSize)
+{
+  int n = int(a_bounds.size());
+  int nInterior = n - 1;
+
+  //Morton codes of the centroids over the centroid bounds
+  std::vector<Bounds> threadBounds(a_nThreads);
+  ParallelFor(a_nThreads, n, [&](unsigned a_thread, size_t a_first, size_t a_end)
+  {
+    Bounds & bounds = threadBounds[a_thread];
+    bounds.Empty();
+    for (size_t i = a_first; i < a_end; i++)
+    {
+      float centroid[3];
+      for (int a = 0; a < 3; a++)
+      {
+        centroid[a] = a_bounds[i].Centroid(a);
+      }
+      bounds.Grow(centroid);
+    }
+  });
+  Bounds centroidBounds = threadBounds[0];
+  for (unsigned t = 1; t < a_nThreads; t++)
+  {
+    centroidBounds.Grow(threadBounds[t]);
+  }
+  float scale[3];
+  for (int a = 0; a < 3; a++)
+  {
+    float extent = centroidBounds.max[a] - centroidBounds.min[a];
+    scale[a] = (extent > 0.0f) ? 1.0f / extent : 0.0f;
+  }
+
+  std::vector<Key> keys(n);
+  a_order.resize(n);
+  ParallelFor(a_nThreads, n, [&](unsigned, size_t a_first, size_t a_end)
+  {
+    for (size_t i = a_first; i < a_end; i++)
+    {
+      float unit[3];
+      for (int a = 0; a < 3; a++)
+      {
+        unit[a] = (a_bounds[i].Centroid(a) - centroidBounds.min[a]) * scale[a];
+      }
+      keys[i] = MortonCode<Key>(unit);
+      a_order[i] = uint32_t(i);
+    }
+  });
+
+  RadixSort(keys, a_order, a_nThreads);
+
+  //Interior nodes and parent links
+  std::vector<RadixNode> interior(nInterior);
+  std::vector<int32_t> parents(2 * n - 1);
+  parents[0] = -1;
+  ParallelFor(a_nThreads, nInterior, [&](unsigned, size_t a_first, size_t a_end)
+  {
+    for (size_t i = a_first; i < a_end; i++)
+    {
+      EmitNode(&keys[0], n, int(i), interior[i]);
+      parents[interior[i].left] = int32_t(i);
+      parents[interior[i].right] = int32_t(i);
+    }
+  });
+
+  //Depth of each interior node. Long shared prefixes, which 63 bit codes
+  //make likely, give radix trees deeper than a traversal stack holds.
+  std::vector<int32_t> depths(nInterior);
+  std::vector<int32_t> pending;
+  if (nInterior > 0)
+  {
+    depths[0] = 1;
+    pending.push_back(0);
+  }
+  while (!pending.empty())
+  {
+    int node = pending.back();
+    pending.pop_back();
+    int children[2] = {interior[node].left, interior[node].right};
+    for (int c = 0; c < 2; c++)
+    {
+      if (children[c] < nInterior)
+      {
+        depths[children[c]] = depths[node] + 1;
+        pending.push_back(children[c]);
+      }
+    }
+  }
+
+  //Bounds and output sizes bottom up. Each leaf walks towards the root and
+  //the second thread to reach a node finishes it. Nodes at the depth of a
+  //traversal stack become leaves over everything below them.
+  auto isLeaf = [&](int a_node)
+  {
+    return a_node >= nInterior
+      || interior[a_node].last - interior[a_node].first + 1 <= a_maxLeafSize
+      || depths[a_node] >= BVH_STACK_SIZE;
+  };
+
+  std::vector<Bounds> bounds(2 * n - 1);
+  std::vector<int32_t> sizes(2 * n - 1);
+  std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[nInterior > 0 ? nInterior : 1]);
+  for (int i = 0; i < nInterior; i++)
+  {
+    visits[i] = 0;
+  }
+  ParallelFor(a_nThreads, n, [&](unsigned, size_t a_first, size_t a_end)
+  {
+    for (size_t k = a_first; k < a_end; k++)
+    {
+      int node = nInterior + int(k);
+      bounds[node] = a_bounds[a_order[k]];
+      sizes[node] = 1;
+
+      for (node = parents[node]; node >= 0; node = parents[node])
+      {
+        if (visits[node].fetch_add(1) == 0)
+        {
+          break;
+        }
+        RadixNode const & r = interior[node];
+        bounds[node] = bounds[r.left];
+        bounds[node].Grow(bounds[r.right]);
+        sizes[node] = isLeaf(node) ? 1 : 1 + sizes[r.left] + sizes[r.right];
+      }
+    }
+  });
+
+  //Write out depth first. Subtrees below the first few levels are
+  //independent once their position is known.
+  int base = int(a_nodes.size());
+  a_nodes.resize(base + sizes[0]);
+
+  auto writeNode = [&](int a_node, int a_position)
+  {
+    BVHNode & out = a_nodes[base + a_position];
+    for (int a = 0; a < 3; a++)
+    {
+      out.min[a] = bounds[a_node].min[a];
+      out.max[a] = bounds[a_node].max[a];
+    }
+    if (a_node >= nInterior)
+    {
+      out.offset = a_node - nInterior;
+      out.count = 1;
+    }
+    else if (isLeaf(a_node))
+    {
+      out.offset = interior[a_node].first;
+      out.count = interior[a_node].last - interior[a_node].first + 1;
+    }
+    else
+    {
+      out.offset = base + a_position + 1 + sizes[interior[a_node].left];
+      out.count = 0;
+    }
+  };
+
+  struct Task
+  {
+    int node;
+    int position;
+  };
+
+  std::vector<Task> tasks(1);
+  tasks[0].node = 0;
+  tasks[0].position = 0;
+  while (a_nThreads > 1 && tasks.size() < LBVH_SUBTREES_PER_THREAD * a_nThreads)
+  {
+    std::vector<Task> next;
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+      Task task = tasks[i];
+      if (isLeaf(task.node))
+      {
+        next.push_back(task);
+        continue;
+      }
+      writeNode(task.node, task.position);
+      Task left = {interior[task.node].left, task.position + 1};
+      Task right = {interior[task.node].right, task.position + 1 + sizes[left.node]};
+      next.push_back(left);
+      next.push_back(right);
+    }
+    if (next.size() == tasks.size())
+    {
+      break;
+    }
+    tasks.swap(next);
+  }
+
+  std::atomic<int> nextTask(0);
+  auto worker = [&]()
+  {
+    std::vector<Task> stack;
+    for (int i = nextTask++; i < int(tasks.size()); i = nextTask++)
+    {
+      stack.push_back(tasks[i]);
+      while (!stack.empty())
+      {
+        Task task = stack.back();
+        stack.pop_back();
+        writeNode(task.node, task.position);
+        if (!isLeaf(task.node))
+        {
+          Task left = {interior[task.node].left, task.position + 1};
+          Task right = {interior[task.node].right, task.position + 1 + sizes[left.node]};
+          stack.push_back(right);
+          stack.push_back(left);
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < a_nThreads && t < tasks.size(); t++)
+  {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i].join();
+  }
+
+  return base;
+}
+
+
+int LBVHBuilder::Build(std::vector<Bounds> const & a_bounds,
+                       std::vector<BVHNode> & a_nodes,
+                       std::vector<uint32_t> & a_order) const
+{
+  a_order.clear();
+  if (a_bounds.empty())
+  {
+    return -1;
+  }
+
+  unsigned nThreads = m_nThreads;
+  if (nThreads == 0)
+  {
+    nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+  }
+  unsigned maxThreads = unsigned(a_bounds.size() / LBVH_MIN_ITEMS_PER_THREAD);
+  nThreads = std::max(1u, std::min(nThreads, maxThreads));
+
+  if (m_use64BitCodes)
+  {
+    return BuildLBVH<uint64_t>(a_bounds, a_nodes, a_order, nThreads, m_maxLeafSize);
+  }
+  return BuildLBVH<uint32_t>(a_bounds, a_nodes, a_order, nThreads, m_maxLeafSize);
+}
@@ -0,0 +1,57 @@
+#ifndef LBVH_H
+#define LBVH_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "BVH.h"
+
+/*!
+ * @class LBVHBuilder
+ *
+ * @brief Linear BVH builder for scenes that have to be rebuilt every frame.
+ *
+ * Primitives are sorted along a Morton curve through their centroids with
+ * a parallel radix sort. The interior nodes of the binary radix tree over
+ * the sorted codes are then each found independently (Karras, "Maximizing
+ * Parallelism in the Construction of BVHs, Octrees, and k-d Trees", 2012),
+ * bounds are propagated bottom up, and the tree is written out in the
+ * depth first BVHNode layout. Every stage runs over all threads.
+ *
+ * Trees are worse than the SAH builder's, but building is close to linear
+ * in the primitive count.
+ */
+class LBVHBuilder
+{
+public:
+
+  LBVHBuilder() : m_nThreads(0)
+                , m_maxLeafSize(4)
+                , m_use64BitCodes(false) {}
+
+  //! 0 uses one thread per core.
+  void SetThreadCount(unsigned a_nThreads) { m_nThreads = a_nThreads; }
+
+  //! Subtrees over at most this many primitives become a single leaf.
+  void SetMaxLeafSize(int a_size) { m_maxLeafSize = (a_size > 0) ? a_size : 1; }
+
+  //! 63 bit codes (21 bits per axis) instead of 30 bit (10 bits per axis).
+  //! Needed when primitives are dense enough to share a 30 bit cell, at
+  //! twice the sorting cost.
+  void Use64BitCodes(bool a_use) { m_use64BitCodes = a_use; }
+
+  //! Appends a hierarchy over the bounds to a_nodes and returns its root.
+  //! Leaf offsets index a_order, which receives the index into a_bounds of
+  //! each primitive in leaf order.
+  int Build(std::vector<Bounds> const & a_bounds,
+            std::vector<BVHNode> & a_nodes,
+            std::vector<uint32_t> & a_order) const;
+
+private:
+
+  unsigned  m_nThreads;
+  int       m_maxLeafSize;
+  bool      m_use64BitCodes;
+};
+
+#endif
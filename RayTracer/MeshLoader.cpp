@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fstream>
+
+#include "MeshLoader.h"
+
+
+//--------------------------------------------------------------------------------
+//	@	Helpers
+//--------------------------------------------------------------------------------
+static bool ReadFile(std::string const & a_path, std::vector<char> & a_out)
+{
+  std::ifstream file(a_path.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    printf("Unable to open file %s\n", a_path.c_str());
+    return false;
+  }
+
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  //Null terminated so the text parsers can run off the end safely
+  a_out.resize(size_t(size) + 1);
+  file.read(&a_out[0], size);
+  a_out[size_t(size)] = '\0';
+  return file.good() || file.eof();
+}
+
+
+static char const * SkipSpace(char const * a_p)
+{
+  while (*a_p == ' ' || *a_p == '\t' || *a_p == '\r') a_p++;
+  return a_p;
+}
+
+
+static char const * NextLine(char const * a_p)
+{
+  while (*a_p != '\0' && *a_p != '\n') a_p++;
+  return (*a_p == '\n') ? a_p + 1 : a_p;
+}
+
+
+static void SplitLine(char const * a_p, std::vector<std::string> & a_out)
+{
+  a_out.clear();
+  for (;;)
+  {
+    a_p = SkipSpace(a_p);
+    if (*a_p == '\0' || *a_p == '\n')
+    {
+      break;
+    }
+    char const * start = a_p;
+    while (*a_p != '\0' && !isspace(static_cast<unsigned char>(*a_p))) a_p++;
+    a_out.push_back(std::string(start, a_p));
+  }
+}
+
+
+//Triangulates a convex polygon as a fan around its first vertex
+static void AddPolygon(std::vector<uint32_t> const & a_polygon, std::vector<uint32_t> & a_indices)
+{
+  for (size_t i = 2; i < a_polygon.size(); i++)
+  {
+    a_indices.push_back(a_polygon[0]);
+    a_indices.push_back(a_polygon[i - 1]);
+    a_indices.push_back(a_polygon[i]);
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	LoadOBJ()
+//--------------------------------------------------------------------------------
+bool LoadOBJ(std::string const & a_path, MeshData & a_out)
+{
+  std::vector<char> buffer;
+  if (!ReadFile(a_path, buffer))
+  {
+    return false;
+  }
+
+  a_out.positions.clear();
+  a_out.indices.clear();
+
+  std::vector<uint32_t> polygon;
+  std::string line;
+  int lineNumber = 0;
+  for (char const * next = &buffer[0]; *next != '\0'; next = NextLine(next))
+  {
+    lineNumber++;
+
+    //Parse a copy of the line, so strtof and strtol, which skip newlines,
+    //cannot read a short line's missing values from the next one
+    char const * lineEnd = next;
+    while (*lineEnd != '\0' && *lineEnd != '\n') lineEnd++;
+    line.assign(next, lineEnd);
+    char const * p = SkipSpace(line.c_str());
+
+    if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+    {
+      char * end;
+      p += 2;
+      for (int i = 0; i < 3; i++)
+      {
+        a_out.positions.push_back(strtof(p, &end));
+        if (end == p)
+        {
+          printf("%s(%d): bad vertex\n", a_path.c_str(), lineNumber);
+          return false;
+        }
+        p = end;
+      }
+    }
+    else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+    {
+      long nVertices = long(a_out.positions.size() / 3);
+      polygon.clear();
+      p = SkipSpace(p + 2);
+      while (*p != '\0')
+      {
+        //v, v/vt, v//vn or v/vt/vn. Negative indices count back from the last vertex.
+        char * end;
+        long index = strtol(p, &end, 10);
+        if (end == p)
+        {
+          break;
+        }
+        index = (index < 0) ? nVertices + index : index - 1;
+        if (index < 0 || index >= nVertices)
+        {
+          printf("%s(%d): face index out of range\n", a_path.c_str(), lineNumber);
+          return false;
+        }
+        polygon.push_back(uint32_t(index));
+
+        p = end;
+        while (*p != '\0' && !isspace(static_cast<unsigned char>(*p))) p++;
+        p = SkipSpace(p);
+      }
+      AddPolygon(polygon, a_out.indices);
+    }
+  }
+
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	LoadPLY()
+//--------------------------------------------------------------------------------
+namespace
+{
+  enum PLYFormat
+  {
+    PLY_ASCII,
+    PLY_BINARY_LE,
+    PLY_BINARY_BE
+  };
+
+  struct PLYProperty
+  {
+    std::string name;
+    int         type;       // byte size, negative for floating point
+    bool        isSigned;
+    bool        isList;
+    int         countType;  // list length type
+    bool        countSigned;
+  };
+
+  struct PLYElement
+  {
+    std::string               name;
+    unsigned                  count;
+    std::vector<PLYProperty>  properties;
+  };
+
+  //Returns 0 for an unknown type
+  int PLYType(char const * a_name, bool & a_signed)
+  {
+    struct { char const * name; int type; bool isSigned; } types[] =
+    {
+      {"char", 1, true},    {"int8", 1, true},     {"uchar", 1, false},  {"uint8", 1, false},
+      {"short", 2, true},   {"int16", 2, true},    {"ushort", 2, false}, {"uint16", 2, false},
+      {"int", 4, true},     {"int32", 4, true},    {"uint", 4, false},   {"uint32", 4, false},
+      {"float", -4, true},  {"float32", -4, true}, {"double", -8, true}, {"float64", -8, true}
+    };
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+      if (strcmp(a_name, types[i].name) == 0)
+      {
+        a_signed = types[i].isSigned;
+        return types[i].type;
+      }
+    }
+    return 0;
+  }
+
+  class PLYReader
+  {
+  public:
+
+    PLYReader(char const * a_begin, char const * a_end, PLYFormat a_format)
+      : m_p(a_begin), m_end(a_end), m_format(a_format) {}
+
+    size_t Remaining() const { return size_t(m_end - m_p); }
+
+    //The fewest bytes an item of the element can take up
+    size_t MinItemSize(PLYElement const & a_element) const
+    {
+      size_t size = 0;
+      for (size_t i = 0; i < a_element.properties.size(); i++)
+      {
+        PLYProperty const & prop = a_element.properties[i];
+        int type = prop.isList ? prop.countType : prop.type;
+        size += (m_format == PLY_ASCII) ? 1 : size_t((type < 0) ? -type : type);
+      }
+      return size;
+    }
+
+    bool Read(int a_type, bool a_signed, double & a_out)
+    {
+      if (m_format == PLY_ASCII)
+      {
+        char * end;
+        a_out = strtod(m_p, &end);
+        if (end == m_p)
+        {
+          return false;
+        }
+        m_p = end;
+        return true;
+      }
+
+      int size = (a_type < 0) ? -a_type : a_type;
+      if (m_p + size > m_end)
+      {
+        return false;
+      }
+
+      unsigned char bytes[8];
+      for (int i = 0; i < size; i++)
+      {
+        bytes[i] = static_cast<unsigned char>((m_format == PLY_BINARY_LE) ? m_p[i] : m_p[size - 1 - i]);
+      }
+      m_p += size;
+
+      //bytes is now little endian
+      switch (a_type)
+      {
+        case -4: { float v; memcpy(&v, bytes, 4); a_out = v; break; }
+        case -8: { double v; memcpy(&v, bytes, 8); a_out = v; break; }
+        case 1: a_out = a_signed ? double(int8_t(bytes[0])) : double(bytes[0]); break;
+        case 2: { uint16_t v; memcpy(&v, bytes, 2); a_out = a_signed ? double(int16_t(v)) : double(v); break; }
+        case 4: { uint32_t v; memcpy(&v, bytes, 4); a_out = a_signed ? double(int32_t(v)) : double(v); break; }
+        default: return false;
+      }
+      return true;
+    }
+
+  private:
+
+    char const *  m_p;
+    char const *  m_end;
+    PLYFormat     m_format;
+  };
+}
+
+
+bool LoadPLY(std::string const & a_path, MeshData & a_out)
+{
+  std::vector<char> buffer;
+  if (!ReadFile(a_path, buffer))
+  {
+    return false;
+  }
+
+  a_out.positions.clear();
+  a_out.indices.clear();
+
+  char const * p = &buffer[0];
+  char const * end = &buffer[0] + buffer.size() - 1;
+  if (strncmp(p, "ply", 3) != 0)
+  {
+    printf("%s: not a PLY file\n", a_path.c_str());
+    return false;
+  }
+
+  //Header
+  PLYFormat format = PLY_ASCII;
+  std::vector<PLYElement> elements;
+  std::vector<std::string> words;
+  bool headerDone = false;
+  for (p = NextLine(p); *p != '\0'; p = NextLine(p))
+  {
+    SplitLine(p, words);
+    if (words.empty())
+    {
+      continue;
+    }
+
+    if (words[0] == "end_header")
+    {
+      p = NextLine(p);
+      headerDone = true;
+      break;
+    }
+    else if (words[0] == "format" && words.size() >= 2)
+    {
+      if (words[1] == "ascii") format = PLY_ASCII;
+      else if (words[1] == "binary_little_endian") format = PLY_BINARY_LE;
+      else if (words[1] == "binary_big_endian") format = PLY_BINARY_BE;
+      else
+      {
+        printf("%s: unknown format %s\n", a_path.c_str(), words[1].c_str());
+        return false;
+      }
+    }
+    else if (words[0] == "element" && words.size() >= 3)
+    {
+      PLYElement element;
+      element.name = words[1];
+      element.count = unsigned(strtoul(words[2].c_str(), nullptr, 10));
+      elements.push_back(element);
+    }
+    else if (words[0] == "property" && words.size() >= 3 && !elements.empty())
+    {
+      //property <type> <name>
+      //property list <count type> <type> <name>
+      PLYProperty prop;
+      prop.isList = (words[1] == "list");
+      prop.countType = 0;
+      prop.countSigned = false;
+      if (prop.isList)
+      {
+        if (words.size() < 5)
+        {
+          printf("%s: bad list property\n", a_path.c_str());
+          return false;
+        }
+        prop.countType = PLYType(words[2].c_str(), prop.countSigned);
+        prop.type = PLYType(words[3].c_str(), prop.isSigned);
+        prop.name = words[4];
+      }
+      else
+      {
+        prop.type = PLYType(words[1].c_str(), prop.isSigned);
+        prop.name = words[2];
+      }
+
+      if (prop.type == 0 || (prop.isList && prop.countType == 0))
+      {
+        printf("%s: unknown property type\n", a_path.c_str());
+        return false;
+      }
+      elements.back().properties.push_back(prop);
+    }
+  }
+
+  if (!headerDone)
+  {
+    printf("%s: missing end_header\n", a_path.c_str());
+    return false;
+  }
+
+  //Body
+  PLYReader reader(p, end, format);
+  std::vector<uint32_t> polygon;
+  unsigned nVertices = 0;
+  for (size_t e = 0; e < elements.size(); e++)
+  {
+    PLYElement const & element = elements[e];
+    bool isVertex = (element.name == "vertex");
+    bool isFace = (element.name == "face");
+
+    //Checked before anything is sized from the count
+    if (uint64_t(element.count) * reader.MinItemSize(element) > reader.Remaining())
+    {
+      printf("%s: %s count is larger than the file\n", a_path.c_str(), element.name.c_str());
+      return false;
+    }
+
+    int xyz[3] = {-1, -1, -1};
+    if (isVertex)
+    {
+      for (size_t i = 0; i < element.properties.size(); i++)
+      {
+        char const * propName = element.properties[i].name.c_str();
+        if (strcmp(propName, "x") == 0) xyz[0] = int(i);
+        else if (strcmp(propName, "y") == 0) xyz[1] = int(i);
+        else if (strcmp(propName, "z") == 0) xyz[2] = int(i);
+      }
+      if (xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0)
+      {
+        printf("%s: vertex has no position\n", a_path.c_str());
+        return false;
+      }
+      nVertices = element.count;
+      a_out.positions.resize(size_t(element.count) * 3);
+    }
+
+    for (unsigned item = 0; item < element.count; item++)
+    {
+      bool faceRead = false;
+      for (size_t i = 0; i < element.properties.size(); i++)
+      {
+        PLYProperty const & prop = element.properties[i];
+        double value;
+
+        if (!prop.isList)
+        {
+          if (!reader.Read(prop.type, prop.isSigned, value))
+          {
+            printf("%s: unexpected end of file\n", a_path.c_str());
+            return false;
+          }
+          for (int c = 0; c < 3; c++)
+          {
+            if (isVertex && xyz[c] == int(i))
+            {
+              a_out.positions[size_t(item) * 3 + c] = float(value);
+            }
+          }
+          continue;
+        }
+
+        double count;
+        if (!reader.Read(prop.countType, prop.countSigned, count))
+        {
+          printf("%s: unexpected end of file\n", a_path.c_str());
+          return false;
+        }
+        if (!(count >= 0.0 && count <= double(reader.Remaining())))
+        {
+          printf("%s: bad list length\n", a_path.c_str());
+          return false;
+        }
+
+        polygon.clear();
+        for (unsigned k = 0; k < unsigned(count); k++)
+        {
+          if (!reader.Read(prop.type, prop.isSigned, value))
+          {
+            printf("%s: unexpected end of file\n", a_path.c_str());
+            return false;
+          }
+          if (isFace && !faceRead)
+          {
+            //Converting a negative value to uint32_t is undefined
+            if (!(value >= 0.0 && value < double(nVertices)))
+            {
+              printf("%s: face index out of range\n", a_path.c_str());
+              return false;
+            }
+            polygon.push_back(uint32_t(value));
+          }
+        }
+
+        if (isFace && !faceRead)
+        {
+          AddPolygon(polygon, a_out.indices);
+          faceRead = true;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	LoadMesh()
+//--------------------------------------------------------------------------------
+bool LoadMesh(std::string const & a_path, Scene & a_scene, uint32_t a_materials)
+{
+  std::string ext;
+  size_t dot = a_path.find_last_of('.');
+  if (dot != std::string::npos)
+  {
+    for (size_t i = dot + 1; i < a_path.size(); i++)
+    {
+      ext += char(tolower(static_cast<unsigned char>(a_path[i])));
+    }
+  }
+
+  MeshData mesh;
+  bool loaded = false;
+  if (ext == "obj")
+  {
+    loaded = LoadOBJ(a_path, mesh);
+  }
+  else if (ext == "ply")
+  {
+    loaded = LoadPLY(a_path, mesh);
+  }
+  else
+  {
+    printf("%s: unsupported mesh format\n", a_path.c_str());
+  }
+
+  if (!loaded)
+  {
+    return false;
+  }
+
+  unsigned nVertices = unsigned(mesh.positions.size() / 3);
+  unsigned nTriangles = unsigned(mesh.indices.size() / 3);
+  if (!a_scene.AddMesh(mesh.positions.data(), nVertices, mesh.indices.data(), nTriangles, a_materials))
+  {
+    printf("%s: mesh is empty or has bad indices\n", a_path.c_str());
+    return false;
+  }
+
+  printf("Loaded %s: %u vertices, %u triangles\n", a_path.c_str(), nVertices, nTriangles);
+  return true;
+}
@@ -0,0 +1,27 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+//! Triangle soup as read from disk: xyz per vertex, three indices per triangle.
+struct MeshData
+{
+  std::vector<float>    positions;
+  std::vector<uint32_t> indices;
+};
+
+//! Wavefront OBJ. Only 'v' and 'f' records are read; polygons are fanned into triangles.
+bool LoadOBJ(std::string const & path, MeshData &);
+
+//! Stanford PLY, ascii or binary. Reads the x, y, z vertex properties and the
+//! first list property of each face; polygons are fanned into triangles.
+bool LoadPLY(std::string const & path, MeshData &);
+
+//! Picks the loader from the file extension and adds the mesh to the scene.
+bool LoadMesh(std::string const & path, Scene &, uint32_t materials);
+
+#endif
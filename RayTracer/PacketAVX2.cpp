@@ -0,0 +1,56 @@
+#include "PacketKernel.h"
+
+#ifdef PACKET_AVX2
+
+#include <immintrin.h>
+
+//Only called once CPUID has reported AVX2. MSVC takes the intrinsics as
+//they are, GCC and clang need the target on each function that uses them.
+#if defined(__GNUC__)
+#define PACKET_TARGET __attribute__((target("avx2")))
+#else
+#define PACKET_TARGET
+#endif
+
+struct LanesAVX2
+{
+  enum { WIDTH = 8 };
+
+  __m256 v;
+
+  PACKET_TARGET static LanesAVX2 Make(__m256 a_v) { LanesAVX2 r; r.v = a_v; return r; }
+
+  PACKET_TARGET static LanesAVX2 Load(float const * a_p)          { return Make(_mm256_loadu_ps(a_p)); }
+  PACKET_TARGET static LanesAVX2 Set(float a_x)                   { return Make(_mm256_set1_ps(a_x)); }
+  PACKET_TARGET static void Store(float * a_p, LanesAVX2 a_x)      { _mm256_storeu_ps(a_p, a_x.v); }
+  PACKET_TARGET static LanesAVX2 Sub(LanesAVX2 a_x, LanesAVX2 a_y) { return Make(_mm256_sub_ps(a_x.v, a_y.v)); }
+  PACKET_TARGET static LanesAVX2 Mul(LanesAVX2 a_x, LanesAVX2 a_y) { return Make(_mm256_mul_ps(a_x.v, a_y.v)); }
+  PACKET_TARGET static LanesAVX2 Min(LanesAVX2 a_x, LanesAVX2 a_y) { return Make(_mm256_min_ps(a_x.v, a_y.v)); }
+  PACKET_TARGET static LanesAVX2 Max(LanesAVX2 a_x, LanesAVX2 a_y) { return Make(_mm256_max_ps(a_x.v, a_y.v)); }
+
+  PACKET_TARGET static uint32_t LessEqual(LanesAVX2 a_x, LanesAVX2 a_y)
+  {
+    return uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(a_x.v, a_y.v, _CMP_LE_OQ)));
+  }
+  PACKET_TARGET static uint32_t Less(LanesAVX2 a_x, LanesAVX2 a_y)
+  {
+    return uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(a_x.v, a_y.v, _CMP_LT_OQ)));
+  }
+  PACKET_TARGET static uint32_t GreaterEqual(LanesAVX2 a_x, LanesAVX2 a_y)
+  {
+    return uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(a_x.v, a_y.v, _CMP_GE_OQ)));
+  }
+
+  //The leaf callback and everything after the kernel run SSE code
+  PACKET_TARGET static void Leave() { _mm256_zeroupper(); }
+};
+
+#include "PacketKernelImpl.h"
+
+
+PACKET_TARGET void TraversePacketAVX2(PacketKernelArgs const & a_args, int a_root)
+{
+  TraversePacket<LanesAVX2>(a_args, a_root);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "PacketKernel.h"
+
+#ifdef PACKET_AVX512
+
+#include <immintrin.h>
+
+//GCC 12's _mm512_min_ps and _mm512_max_ps pass a self-initialized
+//undefined vector as the unused merge source, which -Wmaybe-uninitialized
+//reports once they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+//Only called once CPUID has reported AVX-512F, see PacketAVX2.cpp
+#if defined(__GNUC__)
+#define PACKET_TARGET __attribute__((target("avx512f")))
+#else
+#define PACKET_TARGET
+#endif
+
+struct LanesAVX512
+{
+  enum { WIDTH = 16 };
+
+  __m512 v;
+
+  PACKET_TARGET static LanesAVX512 Make(__m512 a_v) { LanesAVX512 r; r.v = a_v; return r; }
+
+  PACKET_TARGET static LanesAVX512 Load(float const * a_p)              { return Make(_mm512_loadu_ps(a_p)); }
+  PACKET_TARGET static LanesAVX512 Set(float a_x)                       { return Make(_mm512_set1_ps(a_x)); }
+  PACKET_TARGET static void Store(float * a_p, LanesAVX512 a_x)          { _mm512_storeu_ps(a_p, a_x.v); }
+  PACKET_TARGET static LanesAVX512 Sub(LanesAVX512 a_x, LanesAVX512 a_y) { return Make(_mm512_sub_ps(a_x.v, a_y.v)); }
+  PACKET_TARGET static LanesAVX512 Mul(LanesAVX512 a_x, LanesAVX512 a_y) { return Make(_mm512_mul_ps(a_x.v, a_y.v)); }
+  PACKET_TARGET static LanesAVX512 Min(LanesAVX512 a_x, LanesAVX512 a_y) { return Make(_mm512_min_ps(a_x.v, a_y.v)); }
+  PACKET_TARGET static LanesAVX512 Max(LanesAVX512 a_x, LanesAVX512 a_y) { return Make(_mm512_max_ps(a_x.v, a_y.v)); }
+
+  //Compares give a mask register directly
+  PACKET_TARGET static uint32_t LessEqual(LanesAVX512 a_x, LanesAVX512 a_y)
+  {
+    return uint32_t(_mm512_cmp_ps_mask(a_x.v, a_y.v, _CMP_LE_OQ));
+  }
+  PACKET_TARGET static uint32_t Less(LanesAVX512 a_x, LanesAVX512 a_y)
+  {
+    return uint32_t(_mm512_cmp_ps_mask(a_x.v, a_y.v, _CMP_LT_OQ));
+  }
+  PACKET_TARGET static uint32_t GreaterEqual(LanesAVX512 a_x, LanesAVX512 a_y)
+  {
+    return uint32_t(_mm512_cmp_ps_mask(a_x.v, a_y.v, _CMP_GE_OQ));
+  }
+
+  PACKET_TARGET static void Leave() { _mm256_zeroupper(); }
+};
+
+#include "PacketKernelImpl.h"
+
+
+PACKET_TARGET void TraversePacketAVX512(PacketKernelArgs const & a_args, int a_root)
+{
+  TraversePacket<LanesAVX512>(a_args, a_root);
+}
+
+#endif
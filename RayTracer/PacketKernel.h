@@ -0,0 +1,54 @@
+#ifndef PACKETKERNEL_H
+#define PACKETKERNEL_H
+
+#include <stdint.h>
+
+#include "BVH.h"
+
+//Interface between PacketTraversal and the node traversal kernels. Each
+//kernel lives in its own translation unit, PacketSSE.cpp, PacketAVX2.cpp
+//and PacketAVX512.cpp, compiled for its instruction set, and only touches
+//plain arrays so no inline function of a shared header ends up built with
+//instructions the CPU might not have.
+
+//Kernels compiled into this build. AVX-512 intrinsics need VS2017.
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PACKET_SSE
+#define PACKET_AVX2
+#if defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1910)
+#define PACKET_AVX512
+#endif
+#endif
+
+//! Largest packet of any kernel
+#define PACKET_MAX_WIDTH 16
+
+//! Called for a leaf reached by the lanes set in 'lanes'. Tests primitives
+//! [first, first + count) and lowers PacketKernelArgs::tMax of lanes that hit.
+typedef void (*PacketLeafFn)(void * context, int first, int count, uint32_t lanes);
+
+struct PacketKernelArgs
+{
+  BVHNode const * nodes;
+  float const *   origin[3];    //One float per lane, per axis
+  float const *   invDir[3];
+  float *         tMax;         //Closest hit of each lane so far
+  uint32_t        active;       //Lanes taking part
+  bool            frustum;      //Cull nodes for the whole packet first
+  PacketLeafFn    leaf;
+  void *          context;
+};
+
+typedef void (*PacketKernel)(PacketKernelArgs const &, int root);
+
+#ifdef PACKET_SSE
+void TraversePacketSSE(PacketKernelArgs const &, int root);     //4 lanes
+#endif
+#ifdef PACKET_AVX2
+void TraversePacketAVX2(PacketKernelArgs const &, int root);    //8 lanes
+#endif
+#ifdef PACKET_AVX512
+void TraversePacketAVX512(PacketKernelArgs const &, int root);  //16 lanes
+#endif
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef PACKETKERNELIMPL_H
+#define PACKETKERNELIMPL_H
+
+//Node traversal shared by the packet kernels. Included by PacketSSE.cpp,
+//PacketAVX2.cpp and PacketAVX512.cpp only, each of which defines
+//PACKET_TARGET and a lane type V before instantiating TraversePacket<V>:
+//
+//  WIDTH                       lanes per register
+//  Load(float const *)         unaligned load of WIDTH floats
+//  Set(float)                  broadcast
+//  Store(float *, V)
+//  Sub, Mul, Min, Max          per lane; Min and Max return the second
+//                              operand if either is NaN, like minps/maxps
+//  LessEqual, Less, GreaterEqual
+//                              one bit per lane
+//  Leave()                     called before leaving AVX code
+//
+//Everything here is static, so each kernel gets its own copy.
+
+#include <float.h>
+#include <math.h>
+
+#include "PacketKernel.h"
+
+#define PACKET_STACK_SIZE BVH_STACK_SIZE
+
+//Same widening as the single ray traversal, see s_slabFarScale in BVH.cpp
+static const float s_packetFarScale = 1.0f + 2.0f * 3.0f * FLT_EPSILON * 0.5f / (1.0f - 3.0f * FLT_EPSILON * 0.5f);
+
+//Bounds over the lanes of the ray origins and inverse directions. Interval
+//arithmetic on them bounds the slab distances of every ray in the packet
+//at once, so a node all of them miss costs one test (Boulos et al.,
+//"Geometric and Arithmetic Culling Methods for Entire Ray Packets", 2006).
+//Only set up if the rays agree on the sign of each direction component,
+//which fixes the slab each ray enters and leaves through and the end of
+//each interval a bound comes from.
+struct PacketFrustum
+{
+  int   nearSide[3];      //0 if rays enter through the min slab, 1 the max
+  float originMin[3];
+  float originMax[3];
+  float invDirMin[3];     //Smallest and largest magnitude, with the sign
+  float invDirMax[3];
+};
+
+
+//False if the rays do not share direction signs, or a direction is
+//parallel to an axis, where 0 * inf would turn the bounds into NaN
+PACKET_TARGET static bool InitFrustum(PacketKernelArgs const & a_args, int a_width, PacketFrustum & a_frustum)
+{
+  for (int a = 0; a < 3; a++)
+  {
+    float originMin = FLT_MAX;
+    float originMax = -FLT_MAX;
+    float invMin = FLT_MAX;
+    float invMax = 0.0f;
+    int negative = 0;
+    int positive = 0;
+    for (int lane = 0; lane < a_width; lane++)
+    {
+      if ((a_args.active & (1u << lane)) == 0)
+      {
+        continue;
+      }
+      float o = a_args.origin[a][lane];
+      float inv = a_args.invDir[a][lane];
+      float magnitude = fabsf(inv);
+      if (!(magnitude <= FLT_MAX))
+      {
+        return false;
+      }
+      if (inv < 0.0f) negative++; else positive++;
+      if (o < originMin) originMin = o;
+      if (o > originMax) originMax = o;
+      if (magnitude < invMin) invMin = magnitude;
+      if (magnitude > invMax) invMax = magnitude;
+    }
+    if (negative != 0 && positive != 0)
+    {
+      return false;
+    }
+
+    float sign = (negative != 0) ? -1.0f : 1.0f;
+    a_frustum.nearSide[a] = (negative != 0) ? 1 : 0;
+    a_frustum.originMin[a] = originMin;
+    a_frustum.originMax[a] = originMax;
+    a_frustum.invDirMin[a] = sign * invMin;
+    a_frustum.invDirMax[a] = sign * invMax;
+  }
+  return true;
+}
+
+
+//True if no ray of the packet can hit the node before a_tMax. With the
+//direction signs known, the earliest entry and latest exit on each axis
+//are one product each.
+PACKET_TARGET static bool FrustumMisses(PacketFrustum const & a_frustum, BVHNode const & a_node, float a_tMax)
+{
+  float const * bounds[2] = {a_node.min, a_node.max};
+  float tNear = -FLT_MAX;
+  float tFar = FLT_MAX;
+  for (int a = 0; a < 3; a++)
+  {
+    int nearSide = a_frustum.nearSide[a];
+    float invSmall = a_frustum.invDirMin[a];
+    float invLarge = a_frustum.invDirMax[a];
+
+    //Distances to the entry slab are closest to -inf from the origin
+    //furthest along the direction, those to the exit slab from the origin
+    //furthest behind
+    float toNear = bounds[nearSide][a] - (nearSide ? a_frustum.originMin[a] : a_frustum.originMax[a]);
+    float toFar = bounds[1 - nearSide][a] - (nearSide ? a_frustum.originMax[a] : a_frustum.originMin[a]);
+
+    //A negative distance times the direction sign grows with the magnitude
+    //of the inverse direction, a positive one shrinks
+    float entry = toNear * ((toNear * invLarge < 0.0f) ? invLarge : invSmall);
+    float exit = toFar * ((toFar * invLarge > 0.0f) ? invLarge : invSmall);
+    if (entry > tNear) tNear = entry;
+    if (exit < tFar) tFar = exit;
+  }
+  tFar *= s_packetFarScale;
+  return tNear > tFar || tFar < 0.0f || tNear >= a_tMax;
+}
+
+
+//Slab test of every lane against one node, the same as IntersectNode() in
+//BVH.cpp. Returns a bit per lane that hits and the entry distances.
+template<typename V>
+PACKET_TARGET static inline uint32_t IntersectNodeLanes(BVHNode const & a_node, V const a_origin[3], V const a_invDir[3],
+                                                        V a_tMax, V & a_tNear)
+{
+  V tNear = V::Set(-FLT_MAX);
+  V tFar = V::Set(FLT_MAX);
+  for (int a = 0; a < 3; a++)
+  {
+    V t0 = V::Mul(V::Sub(V::Set(a_node.min[a]), a_origin[a]), a_invDir[a]);
+    V t1 = V::Mul(V::Sub(V::Set(a_node.max[a]), a_origin[a]), a_invDir[a]);
+    tNear = V::Max(V::Min(t0, t1), tNear);
+    tFar = V::Min(V::Max(t0, t1), tFar);
+  }
+  tFar = V::Mul(tFar, V::Set(s_packetFarScale));
+  a_tNear = tNear;
+  return V::LessEqual(tNear, tFar) & V::GreaterEqual(tFar, V::Set(0.0f)) & V::Less(tNear, a_tMax);
+}
+
+
+//Lowest set bit of a non zero mask
+PACKET_TARGET static inline int FirstLane(uint32_t a_lanes)
+{
+  int lane = 0;
+  while ((a_lanes & (1u << lane)) == 0)
+  {
+    lane++;
+  }
+  return lane;
+}
+
+
+template<typename V>
+PACKET_TARGET static float HighestLane(float const * a_values, uint32_t a_lanes)
+{
+  float result = -FLT_MAX;
+  for (int lane = 0; lane < V::WIDTH; lane++)
+  {
+    if ((a_lanes & (1u << lane)) != 0 && a_values[lane] > result)
+    {
+      result = a_values[lane];
+    }
+  }
+  return result;
+}
+
+
+//Packet version of BVH::IntersectTree(). Each stack entry keeps the lanes
+//that reached it, and the lanes are tested again when it is popped since
+//hits found meanwhile may have ruled some out. Children are visited in the
+//order of the first lane that hits both.
+template<typename V>
+PACKET_TARGET static void TraversePacket(PacketKernelArgs const & a_args, int a_root)
+{
+  V origin[3];
+  V invDir[3];
+  for (int a = 0; a < 3; a++)
+  {
+    origin[a] = V::Load(a_args.origin[a]);
+    invDir[a] = V::Load(a_args.invDir[a]);
+  }
+
+  PacketFrustum frustum;
+  bool useFrustum = a_args.frustum && InitFrustum(a_args, V::WIDTH, frustum);
+
+  V tMax = V::Load(a_args.tMax);
+  float tMaxPacket = HighestLane<V>(a_args.tMax, a_args.active);
+
+  struct Entry
+  {
+    int       node;
+    uint32_t  lanes;
+  };
+  Entry stack[PACKET_STACK_SIZE];
+  int stackSize = 0;
+
+  int nodeIndex = a_root;
+  uint32_t lanes = 0;
+  V tNear;
+  if (!useFrustum || !FrustumMisses(frustum, a_args.nodes[a_root], tMaxPacket))
+  {
+    lanes = a_args.active & IntersectNodeLanes(a_args.nodes[a_root], origin, invDir, tMax, tNear);
+  }
+
+  while (lanes != 0)
+  {
+    BVHNode const & node = a_args.nodes[nodeIndex];
+
+    if (node.count > 0)
+    {
+      V::Leave();
+      a_args.leaf(a_args.context, node.offset, node.count, lanes);
+      tMax = V::Load(a_args.tMax);
+      tMaxPacket = HighestLane<V>(a_args.tMax, a_args.active);
+    }
+    else
+    {
+      int left = nodeIndex + 1;
+      int right = node.offset;
+      //Only read for lanes that hit, but set to the miss value so every
+      //lane is defined
+      V tNearLeft = V::Set(FLT_MAX);
+      V tNearRight = V::Set(FLT_MAX);
+      uint32_t hitLeft = 0;
+      uint32_t hitRight = 0;
+      if (!useFrustum || !FrustumMisses(frustum, a_args.nodes[left], tMaxPacket))
+      {
+        hitLeft = lanes & IntersectNodeLanes(a_args.nodes[left], origin, invDir, tMax, tNearLeft);
+      }
+      if (!useFrustum || !FrustumMisses(frustum, a_args.nodes[right], tMaxPacket))
+      {
+        hitRight = lanes & IntersectNodeLanes(a_args.nodes[right], origin, invDir, tMax, tNearRight);
+      }
+
+      if (hitLeft != 0 && hitRight != 0)
+      {
+        float nearLeft[V::WIDTH];
+        float nearRight[V::WIDTH];
+        V::Store(nearLeft, tNearLeft);
+        V::Store(nearRight, tNearRight);
+
+        //Lanes may split with none hitting both, then the first lane of
+        //each side decides
+        uint32_t both = hitLeft & hitRight;
+        int firstLeft = FirstLane((both != 0) ? both : hitLeft);
+        int firstRight = FirstLane((both != 0) ? both : hitRight);
+
+        if (nearRight[firstRight] < nearLeft[firstLeft])
+        {
+          int swapNode = left; left = right; right = swapNode;
+          uint32_t swapHit = hitLeft; hitLeft = hitRight; hitRight = swapHit;
+        }
+        if (stackSize < PACKET_STACK_SIZE)
+        {
+          stack[stackSize].node = right;
+          stack[stackSize].lanes = hitRight;
+          stackSize++;
+        }
+        nodeIndex = left;
+        lanes = hitLeft;
+        continue;
+      }
+      if (hitLeft != 0)
+      {
+        nodeIndex = left;
+        lanes = hitLeft;
+        continue;
+      }
+      if (hitRight != 0)
+      {
+        nodeIndex = right;
+        lanes = hitRight;
+        continue;
+      }
+    }
+
+    lanes = 0;
+    while (stackSize > 0 && lanes == 0)
+    {
+      stackSize--;
+      nodeIndex = stack[stackSize].node;
+      lanes = stack[stackSize].lanes & IntersectNodeLanes(a_args.nodes[nodeIndex], origin, invDir, tMax, tNear);
+    }
+  }
+
+  V::Leave();
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "PacketKernel.h"
+
+#ifdef PACKET_SSE
+
+#include <emmintrin.h>
+
+//SSE2 is the baseline of every x86 target this builds for
+#define PACKET_TARGET
+
+struct LanesSSE
+{
+  enum { WIDTH = 4 };
+
+  __m128 v;
+
+  static LanesSSE Make(__m128 a_v) { LanesSSE r; r.v = a_v; return r; }
+
+  static LanesSSE Load(float const * a_p)               { return Make(_mm_loadu_ps(a_p)); }
+  static LanesSSE Set(float a_x)                        { return Make(_mm_set1_ps(a_x)); }
+  static void Store(float * a_p, LanesSSE a_x)           { _mm_storeu_ps(a_p, a_x.v); }
+  static LanesSSE Sub(LanesSSE a_x, LanesSSE a_y)       { return Make(_mm_sub_ps(a_x.v, a_y.v)); }
+  static LanesSSE Mul(LanesSSE a_x, LanesSSE a_y)       { return Make(_mm_mul_ps(a_x.v, a_y.v)); }
+  static LanesSSE Min(LanesSSE a_x, LanesSSE a_y)       { return Make(_mm_min_ps(a_x.v, a_y.v)); }
+  static LanesSSE Max(LanesSSE a_x, LanesSSE a_y)       { return Make(_mm_max_ps(a_x.v, a_y.v)); }
+  static uint32_t LessEqual(LanesSSE a_x, LanesSSE a_y)    { return uint32_t(_mm_movemask_ps(_mm_cmple_ps(a_x.v, a_y.v))); }
+  static uint32_t Less(LanesSSE a_x, LanesSSE a_y)         { return uint32_t(_mm_movemask_ps(_mm_cmplt_ps(a_x.v, a_y.v))); }
+  static uint32_t GreaterEqual(LanesSSE a_x, LanesSSE a_y) { return uint32_t(_mm_movemask_ps(_mm_cmpge_ps(a_x.v, a_y.v))); }
+  static void Leave() {}
+};
+
+#include "PacketKernelImpl.h"
+
+
+void TraversePacketSSE(PacketKernelArgs const & a_args, int a_root)
+{
+  TraversePacket<LanesSSE>(a_args, a_root);
+}
+
+#endif
@@ -0,0 +1,322 @@
+#include "CPUFeatures.h"
+#include "PacketTraversal.h"
+
+//Rays of a packet in the layout the kernels load, plus what the primitive
+//tests need per ray
+struct PacketTraversal::Lanes
+{
+  float       origin[3][PACKET_MAX_WIDTH];
+  float       invDir[3][PACKET_MAX_WIDTH];
+  Ray         rays[PACKET_MAX_WIDTH];
+  TriangleRay triangleRays[PACKET_MAX_WIDTH];
+};
+
+//State of one traversal, handed to the leaf callback. Nested traversals of
+//meshes and instances copy it and share the hits and distances.
+struct PacketTraversal::Context
+{
+  PacketKernelArgs  args;
+  PacketKernel      kernel;
+  BVH const *       bvh;
+  Scene const *     scene;
+  Lanes const *     lanes;
+  HitInfo *         hits;
+  int               width;
+  int               mesh;
+  int               instance;   //Hits are reported against this instance if >= 0
+};
+
+
+//--------------------------------------------------------------------------------
+//	@	PacketTraversal::PacketTraversal()
+//--------------------------------------------------------------------------------
+PacketTraversal::PacketTraversal() : m_isa(ISA::SSE)
+                                   , m_kernel(nullptr)
+                                   , m_frustum(false)
+{
+  if (!SetISA(ISA::AVX512) && !SetISA(ISA::AVX2))
+  {
+    SetISA(ISA::SSE);
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	PacketTraversal::IsSupported()
+//--------------------------------------------------------------------------------
+bool PacketTraversal::IsSupported(ISA a_isa)
+{
+  CPUFeatures const & cpu = GetCPUFeatures();
+  switch (a_isa)
+  {
+#ifdef PACKET_SSE
+    case ISA::SSE:    return cpu.sse2;
+#endif
+#ifdef PACKET_AVX2
+    case ISA::AVX2:   return cpu.avx2;
+#endif
+#ifdef PACKET_AVX512
+    case ISA::AVX512: return cpu.avx512f;
+#endif
+    default: break;
+  }
+  return false;
+}
+
+
+char const * PacketTraversal::GetName(ISA a_isa)
+{
+  switch (a_isa)
+  {
+    case ISA::SSE:    return "SSE";
+    case ISA::AVX2:   return "AVX2";
+    case ISA::AVX512: return "AVX-512";
+  }
+  return "Unknown";
+}
+
+
+int PacketTraversal::GetWidth(ISA a_isa)
+{
+  switch (a_isa)
+  {
+    case ISA::SSE:    return 4;
+    case ISA::AVX2:   return 8;
+    case ISA::AVX512: return 16;
+  }
+  return 1;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	PacketTraversal::SetISA()
+//--------------------------------------------------------------------------------
+bool PacketTraversal::SetISA(ISA a_isa)
+{
+  if (!IsSupported(a_isa))
+  {
+    return false;
+  }
+
+  switch (a_isa)
+  {
+#ifdef PACKET_SSE
+    case ISA::SSE:    m_kernel = TraversePacketSSE; break;
+#endif
+#ifdef PACKET_AVX2
+    case ISA::AVX2:   m_kernel = TraversePacketAVX2; break;
+#endif
+#ifdef PACKET_AVX512
+    case ISA::AVX512: m_kernel = TraversePacketAVX512; break;
+#endif
+    default: return false;
+  }
+  m_isa = a_isa;
+  return true;
+}
+
+
+void PacketTraversal::GetShape(int & a_width, int & a_height) const
+{
+  switch (GetWidth())
+  {
+    case 4:   a_width = 2; a_height = 2; break;
+    case 8:   a_width = 4; a_height = 2; break;
+    case 16:  a_width = 4; a_height = 4; break;
+    default:  a_width = GetWidth(); a_height = 1; break;
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	PacketTraversal::SetupLanes()
+//--------------------------------------------------------------------------------
+//Lanes outside the mask repeat the first ray so every lane holds numbers the
+//kernels can work with
+void PacketTraversal::SetupLanes(Ray const * a_rays, uint32_t a_lanes, int a_width, bool a_triangles, Lanes & a_out)
+{
+  int first = 0;
+  while ((a_lanes & (1u << first)) == 0)
+  {
+    first++;
+  }
+
+  for (int lane = 0; lane < a_width; lane++)
+  {
+    Ray const & ray = a_rays[((a_lanes & (1u << lane)) != 0) ? lane : first];
+    a_out.rays[lane] = ray;
+    for (int a = 0; a < 3; a++)
+    {
+      a_out.origin[a][lane] = ray.origin[a];
+      a_out.invDir[a][lane] = 1.0f / ray.direction[a];
+    }
+    if (a_triangles && (a_lanes & (1u << lane)) != 0)
+    {
+      SetupTriangleRay(ray, a_out.triangleRays[lane]);
+    }
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	PacketTraversal::Intersect()
+//--------------------------------------------------------------------------------
+void PacketTraversal::Intersect(BVH const & a_bvh, Scene const & a_scene, RayPacket & a_packet) const
+{
+  if (a_bvh.GetRoot() < 0)
+  {
+    return;
+  }
+
+  if (m_kernel == nullptr)
+  {
+    for (int i = 0; i < a_packet.size; i++)
+    {
+      a_bvh.Intersect(a_packet.rays[i], a_scene, a_packet.hits[i]);
+    }
+    return;
+  }
+
+  int width = GetWidth();
+  bool triangles = !a_bvh.GetMeshRoots().empty();
+
+  for (int first = 0; first < a_packet.size; first += width)
+  {
+    int count = (a_packet.size - first < width) ? a_packet.size - first : width;
+    uint32_t active = (count < 32) ? (1u << count) - 1 : 0xFFFFFFFF;
+
+    Lanes lanes;
+    SetupLanes(a_packet.rays + first, active, width, triangles, lanes);
+
+    float tMax[PACKET_MAX_WIDTH];
+    for (int lane = 0; lane < width; lane++)
+    {
+      tMax[lane] = (lane < count) ? a_packet.hits[first + lane].t : 0.0f;
+    }
+
+    Context context;
+    context.kernel = m_kernel;
+    context.bvh = &a_bvh;
+    context.scene = &a_scene;
+    context.lanes = &lanes;
+    context.hits = a_packet.hits + first;
+    context.width = width;
+    context.mesh = -1;
+    context.instance = -1;
+    for (int a = 0; a < 3; a++)
+    {
+      context.args.origin[a] = lanes.origin[a];
+      context.args.invDir[a] = lanes.invDir[a];
+    }
+    context.args.nodes = &a_bvh.GetNodes()[0];
+    context.args.tMax = tMax;
+    context.args.active = active;
+    context.args.frustum = m_frustum;
+    context.args.leaf = VisitLeaf;
+    context.args.context = &context;
+
+    m_kernel(context.args, a_bvh.GetRoot());
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	PacketTraversal::VisitLeaf()
+//--------------------------------------------------------------------------------
+void PacketTraversal::VisitLeaf(void * a_context, int a_first, int a_count, uint32_t a_lanes)
+{
+  Context const & context = *static_cast<Context const *>(a_context);
+  Scene const & scene = *context.scene;
+  float * tMax = context.args.tMax;
+
+  for (int i = a_first; i < a_first + a_count; i++)
+  {
+    BVHPrimitive const & prim = context.bvh->GetPrimitives()[i];
+
+    if (prim.type == TYPE_MESH)
+    {
+      Context nested(context);
+      nested.mesh = prim.index;
+      nested.args.active = a_lanes;
+      nested.args.context = &nested;
+      context.kernel(nested.args, context.bvh->GetMeshRoots()[prim.index]);
+      continue;
+    }
+
+    if (prim.type == TYPE_INSTANCE)
+    {
+      VisitInstance(context, prim.index, a_lanes);
+      continue;
+    }
+
+    for (int lane = 0; lane < context.width; lane++)
+    {
+      if ((a_lanes & (1u << lane)) == 0)
+      {
+        continue;
+      }
+
+      HitInfo & hit = context.hits[lane];
+      if (prim.type == TYPE_TRIANGLE)
+      {
+        Mesh const & mesh = scene.GetMeshes()[context.mesh];
+        real t = IntersectTriangle(context.lanes->triangleRays[lane],
+                                   scene.GetTriangleVertex(mesh, prim.index, 0),
+                                   scene.GetTriangleVertex(mesh, prim.index, 1),
+                                   scene.GetTriangleVertex(mesh, prim.index, 2));
+        if (t < tMax[lane])
+        {
+          tMax[lane] = t;
+          hit.type = (context.instance >= 0) ? TYPE_INSTANCE : TYPE_MESH;
+          hit.t = t;
+          hit.index = (context.instance >= 0) ? context.instance : context.mesh;
+          hit.triangle = prim.index;
+        }
+        continue;
+      }
+
+      real t = IntersectPrimitive(context.lanes->rays[lane], scene, prim.type, prim.index);
+      if (t < tMax[lane])
+      {
+        tMax[lane] = t;
+        hit.type = prim.type;
+        hit.t = t;
+        hit.index = prim.index;
+        hit.triangle = -1;
+      }
+    }
+  }
+}
+
+
+//Moves each ray into the frame of the instance, where distances are the
+//same, and traverses its mesh with the rays that reached it
+void PacketTraversal::VisitInstance(Context const & a_context, int a_instance, uint32_t a_lanes)
+{
+  Instance const & instance = a_context.scene->GetInstances()[a_instance];
+
+  Ray rays[PACKET_MAX_WIDTH];
+  for (int lane = 0; lane < a_context.width; lane++)
+  {
+    if ((a_lanes & (1u << lane)) != 0)
+    {
+      rays[lane] = ToObjectSpace(instance, a_context.lanes->rays[lane]);
+    }
+  }
+
+  Lanes lanes;
+  SetupLanes(rays, a_lanes, a_context.width, true, lanes);
+
+  Context nested(a_context);
+  nested.lanes = &lanes;
+  nested.mesh = int(instance.mesh);
+  nested.instance = a_instance;
+  for (int a = 0; a < 3; a++)
+  {
+    nested.args.origin[a] = lanes.origin[a];
+    nested.args.invDir[a] = lanes.invDir[a];
+  }
+  nested.args.active = a_lanes;
+  nested.args.context = &nested;
+  a_context.kernel(nested.args, a_context.bvh->GetMeshRoots()[instance.mesh]);
+}
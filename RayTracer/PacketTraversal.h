@@ -0,0 +1,99 @@
+#ifndef PACKETTRAVERSAL_H
+#define PACKETTRAVERSAL_H
+
+#include "BVH.h"
+#include "Intersect.h"
+#include "PacketKernel.h"
+#include "scene.h"
+
+//! Rays traced together by PacketTraversal. Like the HitInfo passed to
+//! BVH::Intersect(), each hit comes in with the distance to search up to and
+//! leaves with the closest hit.
+struct RayPacket
+{
+  Ray     rays[PACKET_MAX_WIDTH];
+  HitInfo hits[PACKET_MAX_WIDTH];
+  int     size;
+};
+
+/*!
+ * @class PacketTraversal
+ *
+ * @brief Traces packets of coherent rays through a BVH, a SIMD lane per ray.
+ *
+ * Each node is tested against every ray of the packet at once: 4 rays with
+ * SSE, 8 with AVX2 and 16 with AVX-512, picked at run time from what CPUID
+ * reports. The packet goes down a subtree as long as any of its rays hit it.
+ *
+ * That only pays while the rays stay together, which camera rays through
+ * neighbouring pixels do. Rays that have bounced point every which way, so
+ * they are traced one at a time with BVH::Intersect() instead.
+ *
+ * Optionally interval arithmetic over all of its rays first culls the node
+ * for the whole packet in one scalar test. With packets no wider than a
+ * register that test costs about as much as the SIMD one it saves, so it is
+ * off unless asked for; -benchpacket times both.
+ *
+ * Primitives are tested one ray at a time with the same routines as the
+ * single ray traversal, and instances move each ray into their frame before
+ * their mesh is traversed as a packet, so the hits are those of
+ * BVH::Intersect().
+ */
+class PacketTraversal
+{
+public:
+
+  enum class ISA
+  {
+    SSE,      // 4 rays
+    AVX2,     // 8 rays
+    AVX512    // 16 rays
+  };
+
+  //! Picks the widest kernel the CPU supports.
+  PacketTraversal();
+
+  //! True if the build has the kernel and the CPU can run it.
+  static bool IsSupported(ISA);
+  static char const * GetName(ISA);
+  static int GetWidth(ISA);
+
+  //! Returns false, and keeps the current kernel, if the ISA is not supported.
+  bool SetISA(ISA);
+  ISA GetISA() const { return m_isa; }
+
+  //! False if no kernel runs on this CPU. Intersect() then traces each ray
+  //! of the packet on its own.
+  bool IsAvailable() const { return m_kernel != nullptr; }
+
+  //! Rays per packet of the current kernel.
+  int GetWidth() const { return GetWidth(m_isa); }
+
+  //! Pixels across and down covered by a packet of primary rays, as close
+  //! to square as the width allows.
+  void GetShape(int & width, int & height) const;
+
+  //! Off by default.
+  void SetFrustumCulling(bool a_on) { m_frustum = a_on; }
+  bool GetFrustumCulling() const { return m_frustum; }
+
+  //! Closest hits of up to PACKET_MAX_WIDTH rays, in packets of GetWidth().
+  void Intersect(BVH const &, Scene const &, RayPacket &) const;
+
+private:
+
+  struct Lanes;
+  struct Context;
+
+  static void SetupLanes(Ray const *, uint32_t lanes, int width, bool triangles, Lanes &);
+  static void VisitLeaf(void * context, int first, int count, uint32_t lanes);
+  static void VisitInstance(Context const &, int instance, uint32_t lanes);
+
+private:
+
+  ISA           m_isa;
+  PacketKernel  m_kernel;
+  bool          m_frustum;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef PARALLELSORT_H
+#define PARALLELSORT_H
+
+//Threading and sorting helpers shared by LBVHBuilder, which sorts
+//primitives along a Morton curve, and CPUTracer, which sorts queued rays.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+//Runs a_fn(thread, first, end) over [0, a_count) split evenly over the
+//threads. The split only depends on the thread count, so passes over the
+//same range see the same chunks.
+template<typename Fn>
+void ParallelFor(unsigned a_nThreads, size_t a_count, Fn a_fn)
+{
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < a_nThreads; t++)
+  {
+    threads.push_back(std::thread(a_fn, t, a_count * t / a_nThreads, a_count * (t + 1) / a_nThreads));
+  }
+  a_fn(0u, size_t(0), a_count / a_nThreads);
+
+  for (size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i].join();
+  }
+}
+
+
+//Spreads the low 10 bits to every third bit
+inline uint32_t ExpandBits(uint32_t a_v)
+{
+  a_v = (a_v * 0x00010001u) & 0xFF0000FFu;
+  a_v = (a_v * 0x00000101u) & 0x0F00F00Fu;
+  a_v = (a_v * 0x00000011u) & 0xC30C30C3u;
+  a_v = (a_v * 0x00000005u) & 0x49249249u;
+  return a_v;
+}
+
+
+//Spreads the low 21 bits to every third bit
+inline uint64_t ExpandBits(uint64_t a_v)
+{
+  a_v &= 0x1FFFFFull;
+  a_v = (a_v | a_v << 32) & 0x1F00000000FFFFull;
+  a_v = (a_v | a_v << 16) & 0x1F0000FF0000FFull;
+  a_v = (a_v | a_v << 8)  & 0x100F00F00F00F00Full;
+  a_v = (a_v | a_v << 4)  & 0x10C30C30C30C30C3ull;
+  a_v = (a_v | a_v << 2)  & 0x1249249249249249ull;
+  return a_v;
+}
+
+
+template<typename Key> struct MortonTraits {};
+template<> struct MortonTraits<uint32_t> { enum { bitsPerAxis = 10 }; };
+template<> struct MortonTraits<uint64_t> { enum { bitsPerAxis = 21 }; };
+
+
+//a_unit is the point scaled to [0, 1] over the bounds of the curve
+template<typename Key>
+Key MortonCode(float const a_unit[3])
+{
+  float const cells = float(1 << MortonTraits<Key>::bitsPerAxis);
+  Key code = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    float c = std::min(std::max(a_unit[i] * cells, 0.0f), cells - 1.0f);
+    code |= ExpandBits(Key(c)) << (2 - i);
+  }
+  return code;
+}
+
+
+//Sorts a_values by a_keys, 8 bits per pass. Each thread counts the digits
+//in its chunk, and scattering chunk by chunk in digit major order keeps
+//the sort stable.
+template<typename Key>
+void RadixSort(std::vector<Key> & a_keys, std::vector<uint32_t> & a_values, unsigned a_nThreads)
+{
+  size_t n = a_keys.size();
+  std::vector<Key> keys(n);
+  std::vector<uint32_t> values(n);
+  std::vector<size_t> offsets(256 * a_nThreads);
+
+  for (int shift = 0; shift < int(8 * sizeof(Key)); shift += 8)
+  {
+    std::fill(offsets.begin(), offsets.end(), 0);
+    ParallelFor(a_nThreads, n, [&](unsigned a_thread, size_t a_first, size_t a_end)
+    {
+      size_t * counts = &offsets[256 * a_thread];
+      for (size_t i = a_first; i < a_end; i++)
+      {
+        counts[(a_keys[i] >> shift) & 0xFF]++;
+      }
+    });
+
+    //A digit every key shares leaves the order as it is
+    bool skip = false;
+    size_t sum = 0;
+    for (int d = 0; d < 256; d++)
+    {
+      size_t total = 0;
+      for (unsigned t = 0; t < a_nThreads; t++)
+      {
+        size_t count = offsets[256 * t + d];
+        offsets[256 * t + d] = sum + total;
+        total += count;
+      }
+      sum += total;
+      if (total == n)
+      {
+        skip = true;
+      }
+    }
+    if (skip)
+    {
+      continue;
+    }
+
+    ParallelFor(a_nThreads, n, [&](unsigned a_thread, size_t a_first, size_t a_end)
+    {
+      size_t * next = &offsets[256 * a_thread];
+      for (size_t i = a_first; i < a_end; i++)
+      {
+        size_t dst = next[(a_keys[i] >> shift) & 0xFF]++;
+        keys[dst] = a_keys[i];
+        values[dst] = a_values[i];
+      }
+    });
+    a_keys.swap(keys);
+    a_values.swap(values);
+  }
+}
+
+#endif
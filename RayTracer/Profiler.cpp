@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+
+#include "Profiler.h"
+
+
+void Profiler::Init()
+{
+  m_epoch = std::chrono::high_resolution_clock::now();
+  m_frame = 0;
+}
+
+
+void Profiler::ShutDown()
+{
+  for (size_t i = 0; i < m_stages.size(); i++)
+  {
+    if (m_stages[i].gpu)
+    {
+      glDeleteQueries(PROFILER_QUERY_RING, m_stages[i].queries);
+    }
+  }
+  m_stages.clear();
+  m_events.clear();
+}
+
+
+double Profiler::Now() const
+{
+  std::chrono::duration<double, std::micro> dt = std::chrono::high_resolution_clock::now() - m_epoch;
+  return dt.count();
+}
+
+
+int Profiler::AddStage(std::string const & a_name, bool a_gpu)
+{
+  Stage stage;
+  stage.name = a_name;
+  stage.gpu = a_gpu;
+  stage.cpuStart = 0.0;
+  stage.nSamples = 0;
+  stage.latestFrame = 0;
+  for (int i = 0; i < PROFILER_QUERY_RING; i++)
+  {
+    stage.queries[i] = 0;
+    stage.pending[i] = false;
+    stage.issued[i] = 0.0;
+    stage.frames[i] = 0;
+  }
+
+  if (a_gpu)
+  {
+    glGenQueries(PROFILER_QUERY_RING, stage.queries);
+  }
+
+  m_stages.push_back(stage);
+  return int(m_stages.size()) - 1;
+}
+
+
+void Profiler::AddSample(int a_stage, double a_start, double a_duration, uint64_t a_frame)
+{
+  Stage & stage = m_stages[a_stage];
+  stage.history[stage.nSamples % PROFILER_HISTORY] = a_duration / 1000.0;
+  stage.nSamples++;
+  stage.latestFrame = a_frame;
+
+  if (m_capturing)
+  {
+    Event e = {a_stage, a_start, a_duration};
+    m_events.push_back(e);
+  }
+}
+
+
+void Profiler::BeginFrame()
+{
+  for (size_t s = 0; s < m_stages.size(); s++)
+  {
+    Stage & stage = m_stages[s];
+    if (!stage.gpu)
+    {
+      continue;
+    }
+
+    for (int i = 0; i < PROFILER_QUERY_RING; i++)
+    {
+      if (!stage.pending[i])
+      {
+        continue;
+      }
+
+      GLint available(0);
+      glGetQueryObjectiv(stage.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available)
+      {
+        GLuint64 elapsed(0);
+        glGetQueryObjectui64v(stage.queries[i], GL_QUERY_RESULT, &elapsed);
+        stage.pending[i] = false;
+        AddSample(int(s), stage.issued[i], double(elapsed) / 1000.0, stage.frames[i]);
+      }
+    }
+  }
+}
+
+
+void Profiler::EndFrame()
+{
+  m_frame++;
+}
+
+
+void Profiler::Begin(int a_stage)
+{
+  Stage & stage = m_stages[a_stage];
+  stage.cpuStart = Now();
+
+  if (stage.gpu)
+  {
+    //If the result from PROFILER_QUERY_RING frames ago is still not back
+    //it is dropped rather than waited on.
+    int slot = int(m_frame % PROFILER_QUERY_RING);
+    stage.pending[slot] = false;
+    stage.issued[slot] = stage.cpuStart;
+    stage.frames[slot] = m_frame;
+    glBeginQuery(GL_TIME_ELAPSED, stage.queries[slot]);
+  }
+}
+
+
+void Profiler::End(int a_stage)
+{
+  Stage & stage = m_stages[a_stage];
+
+  if (stage.gpu)
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+    stage.pending[m_frame % PROFILER_QUERY_RING] = true;
+  }
+  else
+  {
+    AddSample(a_stage, stage.cpuStart, Now() - stage.cpuStart, m_frame);
+  }
+}
+
+
+Profiler::Stats Profiler::GetStats(int a_stage) const
+{
+  Stage const & stage = m_stages[a_stage];
+
+  Stats result = {0.0, 0.0, 0.0, 0};
+  unsigned n = (stage.nSamples < PROFILER_HISTORY) ? stage.nSamples : PROFILER_HISTORY;
+  if (n == 0)
+  {
+    return result;
+  }
+
+  std::vector<double> samples(stage.history, stage.history + n);
+  std::sort(samples.begin(), samples.end());
+
+  double sum = 0.0;
+  for (unsigned i = 0; i < n; i++)
+  {
+    sum += samples[i];
+  }
+
+  result.min = samples[0];
+  result.mean = sum / double(n);
+  result.p99 = samples[(n * 99) / 100 < n ? (n * 99) / 100 : n - 1];
+  result.count = n;
+  return result;
+}
+
+
+bool Profiler::GetLatest(int a_stage, double & a_ms, uint64_t & a_frame) const
+{
+  Stage const & stage = m_stages[a_stage];
+  if (stage.nSamples == 0)
+  {
+    return false;
+  }
+
+  a_ms = stage.history[(stage.nSamples - 1) % PROFILER_HISTORY];
+  a_frame = stage.latestFrame;
+  return true;
+}
+
+
+void Profiler::PrintStats() const
+{
+  printf("%-16s %-4s %10s %10s %10s\n", "Stage", "", "min ms", "mean ms", "p99 ms");
+  for (size_t i = 0; i < m_stages.size(); i++)
+  {
+    Stats stats = GetStats(int(i));
+    printf("%-16s %-4s %10.3f %10.3f %10.3f\n",
+           m_stages[i].name.c_str(),
+           m_stages[i].gpu ? "GPU" : "CPU",
+           stats.min, stats.mean, stats.p99);
+  }
+}
+
+
+void Profiler::StartCapture()
+{
+  m_events.clear();
+  m_capturing = true;
+}
+
+
+bool Profiler::StopCapture(std::string const & a_path)
+{
+  m_capturing = false;
+
+  std::ofstream file(a_path.c_str());
+  if (!file)
+  {
+    printf("Unable to open file %s\n", a_path.c_str());
+    return false;
+  }
+
+  file << "{\"traceEvents\":[\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+  file.setf(std::ios::fixed);
+  file.precision(3);
+  for (size_t i = 0; i < m_events.size(); i++)
+  {
+    Event const & e = m_events[i];
+    Stage const & stage = m_stages[e.stage];
+    file << ",\n{\"name\":\"" << stage.name
+         << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << (stage.gpu ? 1 : 0)
+         << ",\"ts\":" << e.start
+         << ",\"dur\":" << e.duration << "}";
+  }
+  file << "\n]}\n";
+
+  printf("Wrote %u trace events to %s\n", unsigned(m_events.size()), a_path.c_str());
+  m_events.clear();
+  return file.good();
+}
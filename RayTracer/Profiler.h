@@ -0,0 +1,127 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+//Frames a GPU timer query may stay in flight before its slot is reused.
+#define PROFILER_QUERY_RING   4
+
+//Samples kept per stage for the rolling statistics.
+#define PROFILER_HISTORY      256
+
+/*!
+ * @class Profiler
+ *
+ * @brief Per frame timings for each stage of the main loop.
+ *
+ * GPU stages are measured with GL_TIME_ELAPSED queries. Each stage owns a
+ * ring of query objects and results are only read once they are available,
+ * so measuring never stalls the pipeline. CPU stages use std::chrono.
+ */
+class Profiler
+{
+public:
+
+  struct Stats
+  {
+    double min;
+    double mean;
+    double p99;
+    unsigned count;
+  };
+
+  Profiler() : m_frame(0), m_capturing(false) {}
+
+  void Init();
+  void ShutDown();
+
+  //! Returns the id used with Begin() and End().
+  int AddStage(std::string const & name, bool gpu);
+
+  //! Collects finished GPU queries. Call at the top of each frame.
+  void BeginFrame();
+  void EndFrame();
+
+  void Begin(int stage);
+  void End(int stage);
+
+  //! Rolling statistics in milliseconds.
+  Stats GetStats(int stage) const;
+
+  //! The newest sample of the stage in milliseconds, and the frame it was
+  //! measured in. GPU samples arrive a few frames late. False if the stage
+  //! has none yet.
+  bool GetLatest(int stage, double & ms, uint64_t & frame) const;
+
+  //! Frames since Init(), counted by EndFrame().
+  uint64_t GetFrame() const { return m_frame; }
+  void PrintStats() const;
+
+  //! Record every stage into a Chrome trace-event file (chrome://tracing).
+  void StartCapture();
+  bool StopCapture(std::string const & path);
+  bool IsCapturing() const { return m_capturing; }
+
+private:
+
+  struct Event
+  {
+    int     stage;
+    double  start;    // us
+    double  duration; // us
+  };
+
+  struct Stage
+  {
+    std::string name;
+    bool        gpu;
+    GLuint      queries[PROFILER_QUERY_RING];
+    bool        pending[PROFILER_QUERY_RING];
+    double      issued[PROFILER_QUERY_RING];
+    uint64_t    frames[PROFILER_QUERY_RING];
+    double      cpuStart;
+    double      history[PROFILER_HISTORY];
+    unsigned    nSamples;
+    uint64_t    latestFrame;
+  };
+
+  double Now() const;
+  void AddSample(int stage, double start, double duration, uint64_t frame);
+
+private:
+
+  std::chrono::high_resolution_clock::time_point  m_epoch;
+  std::vector<Stage>                              m_stages;
+  std::vector<Event>                              m_events;
+  uint64_t                                        m_frame;
+  bool                                            m_capturing;
+};
+
+//! Times a CPU stage for the lifetime of the object.
+class ProfileScope
+{
+public:
+
+  ProfileScope(Profiler & a_profiler, int a_stage) : m_profiler(a_profiler), m_stage(a_stage)
+  {
+    m_profiler.Begin(m_stage);
+  }
+
+  ~ProfileScope() { m_profiler.End(m_stage); }
+
+private:
+
+  ProfileScope(ProfileScope const &);
+  ProfileScope & operator=(ProfileScope const &);
+
+private:
+
+  Profiler &  m_profiler;
+  int         m_stage;
+};
+
+#endif
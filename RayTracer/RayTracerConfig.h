@@ -3,4 +3,16 @@
 
 typedef float real;
 
+//Reflection bounces traced after the primary hit, by both tracers.
+#define NUM_REFLECTIONS 3
+
+//Growth of the top level SAH cost through refitting, relative to its last
+//build, at which the BVH is rebuilt in the background.
+#define BVH_REBUILD_THRESHOLD 1.3f
+
+//Entries in a binary BVH traversal stack, on the CPU and in
+//raytracer_cs.glsl. Builders keep trees at most this many levels deep, so
+//a traversal, which pushes at most one node per level, never drops one.
+#define BVH_STACK_SIZE 64
+
 #endif
\ No newline at end of file
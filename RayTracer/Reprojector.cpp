@@ -0,0 +1,349 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <limits>
+
+#include "Reprojector.h"
+#include "Framebuffer.h"
+#include "Intersect.h"
+#include "scene.h"
+
+
+Reprojector::Reprojector()
+  : m_width(0)
+  , m_height(0)
+  , m_valid(false)
+  , m_maxAge(REPROJECT_MAX_AGE)
+  , m_refresh(REPROJECT_REFRESH)
+  , m_frame(0)
+  , m_traceCount(0)
+{
+  memset(&m_view, 0, sizeof(m_view));
+}
+
+
+void Reprojector::Resize(int a_width, int a_height)
+{
+  size_t nPixels = size_t(a_width) * size_t(a_height);
+  m_width = a_width;
+  m_height = a_height;
+  m_color.assign(nPixels * 4, 0.0f);
+  m_hits.assign(nPixels, vec4(0.0f, 0.0f, 0.0f, 0.0f));
+  m_age.assign(nPixels, 0);
+  m_trace.assign(nPixels, 1);
+  m_nextHits.assign(nPixels, vec4(0.0f, 0.0f, 0.0f, 0.0f));
+  m_nextAge.assign(nPixels, 0);
+  m_moved.resize(nPixels * 2);
+  m_splat.resize(nPixels);
+  m_depth.resize(nPixels);
+  m_valid = false;
+}
+
+
+//Every 1 / m_refresh frames, in an order scrambled over the image
+bool Reprojector::IsRefreshed(int a_x, int a_y) const
+{
+  if (m_refresh <= 0.0f)
+  {
+    return false;
+  }
+  uint32_t period = uint32_t(1.0f / m_refresh + 0.5f);
+  if (period <= 1)
+  {
+    return true;
+  }
+
+  uint32_t h = uint32_t(a_x) * 0x8da6b343u ^ uint32_t(a_y) * 0xd8163841u;
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  return (h + m_frame) % period == 0;
+}
+
+
+bool Reprojector::SetView(Camera const & a_camera, View & a_view)
+{
+  //A pixel's ray is ray00 + u * across + v * up, the same interpolation as
+  //CPUTracer::GetDirection() since the corners make a parallelogram
+  vec4 ray00, ray01, ray10, ray11, eye;
+  a_camera.GetCornerRays(ray00, ray01, ray10, ray11, eye);
+  for (int i = 0; i < 3; i++)
+  {
+    a_view.eye[i] = eye[i];
+    a_view.ray00[i] = ray00[i];
+    a_view.across[i] = ray01[i] - ray00[i];
+    a_view.up[i] = ray10[i] - ray00[i];
+  }
+
+  //Rows of the inverse are cross products of the columns over the determinant
+  float const * r = a_view.ray00;
+  float const * a = a_view.across;
+  float const * b = a_view.up;
+  float rows[3][3];
+  for (int i = 0; i < 3; i++)
+  {
+    int j = (i + 1) % 3;
+    int k = (i + 2) % 3;
+    rows[0][i] = a[j] * b[k] - a[k] * b[j];
+    rows[1][i] = b[j] * r[k] - b[k] * r[j];
+    rows[2][i] = r[j] * a[k] - r[k] * a[j];
+  }
+  float det = r[0] * rows[0][0] + r[1] * rows[0][1] + r[2] * rows[0][2];
+  if (det == 0.0f)
+  {
+    return false;
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      a_view.inverse[i][j] = rows[i][j] / det;
+    }
+  }
+  return true;
+}
+
+
+bool Reprojector::Project(View const & a_view, float const a_offset[3], float & a_distance, float & a_u, float & a_v)
+{
+  float const (*m)[3] = a_view.inverse;
+  a_distance = m[0][0] * a_offset[0] + m[0][1] * a_offset[1] + m[0][2] * a_offset[2];
+  if (!(a_distance > 0.0f))
+  {
+    return false;
+  }
+  a_u = (m[1][0] * a_offset[0] + m[1][1] * a_offset[1] + m[1][2] * a_offset[2]) / a_distance;
+  a_v = (m[2][0] * a_offset[0] + m[2][1] * a_offset[1] + m[2][2] * a_offset[2]) / a_distance;
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	Reprojector::Reproject()
+//--------------------------------------------------------------------------------
+size_t Reprojector::Reproject(Camera const & a_camera, Framebuffer & a_fb)
+{
+  m_frame++;
+  if (a_fb.Width() != m_width || a_fb.Height() != m_height)
+  {
+    Resize(a_fb.Width(), a_fb.Height());
+  }
+
+  //The view of the last frame, kept for the next whether or not this one
+  //can be carried over
+  View last = m_view;
+  bool valid = SetView(a_camera, m_view) && m_valid;
+  size_t nPixels = m_trace.size();
+  if (!valid)
+  {
+    m_valid = false;
+    m_trace.assign(nPixels, 1);
+    m_traceCount = nPixels;
+    return m_traceCount;
+  }
+
+  //Misses are further than any hit. Nothing lands on empty pixels.
+  float const empty = std::numeric_limits<float>::infinity();
+  float const xScale = float(m_width - 1);
+  float const yScale = float(m_height - 1);
+
+  //Splat the distance of every hit of the last frame into the new view,
+  //keeping where it landed
+  for (size_t i = 0; i < nPixels; i++)
+  {
+    m_splat[i] = empty;
+    m_moved[i * 2] = FLT_MAX;
+    m_moved[i * 2 + 1] = FLT_MAX;
+  }
+  for (size_t i = 0; i < nPixels; i++)
+  {
+    vec4 const & hit = m_hits[i];
+    bool miss = (hit[3] == 0.0f);
+    float offset[3];
+    for (int c = 0; c < 3; c++)
+    {
+      offset[c] = miss ? hit[c] : hit[c] - m_view.eye[c];
+    }
+
+    float distance, u, v;
+    if (!Project(m_view, offset, distance, u, v))
+    {
+      continue;
+    }
+    m_moved[i * 2] = u * xScale;
+    m_moved[i * 2 + 1] = v * yScale;
+
+    float fx = floorf(u * xScale + 0.5f);
+    float fy = floorf(v * yScale + 0.5f);
+    if (!(fx >= 0.0f && fx <= xScale && fy >= 0.0f && fy <= yScale))
+    {
+      continue;
+    }
+
+    size_t dst = size_t(fy) * m_width + size_t(fx);
+    float depth = miss ? FLT_MAX : distance;
+    if (depth < m_splat[dst])
+    {
+      m_splat[dst] = depth;
+    }
+  }
+
+  //Hits spread apart as they come closer or the view turns, leaving gaps
+  //between them. Gaps are filled from the farthest neighbour, as what
+  //shows through a gap is behind what is around it.
+  for (int y = 0; y < m_height; y++)
+  {
+    for (int x = 0; x < m_width; x++)
+    {
+      size_t i = size_t(y) * m_width + x;
+      m_depth[i] = m_splat[i];
+      if (m_splat[i] != empty)
+      {
+        continue;
+      }
+
+      float farthest = -1.0f;
+      for (int ny = y - 1; ny <= y + 1; ny++)
+      {
+        for (int nx = x - 1; nx <= x + 1; nx++)
+        {
+          if (nx < 0 || ny < 0 || nx >= m_width || ny >= m_height)
+          {
+            continue;
+          }
+          float depth = m_splat[size_t(ny) * m_width + nx];
+          if (depth != empty && depth > farthest)
+          {
+            farthest = depth;
+          }
+        }
+      }
+      if (farthest > 0.0f)
+      {
+        m_depth[i] = farthest;
+      }
+    }
+  }
+
+  //Follow each new pixel's ray out to its distance and back into the last
+  //view. Of the four pixels around where it lands, carry over the one of
+  //the same surface whose hit is now nearest the new pixel's centre.
+  float * pixels = a_fb.Data();
+  float const maxDrift = REPROJECT_MAX_DRIFT * REPROJECT_MAX_DRIFT;
+  m_traceCount = 0;
+  for (int y = 0; y < m_height; y++)
+  {
+    for (int x = 0; x < m_width; x++)
+    {
+      size_t i = size_t(y) * m_width + x;
+      float depth = m_depth[i];
+      float drift = FLT_MAX;
+      size_t src = 0;
+
+      if (depth != empty)
+      {
+        float u = (m_width > 1) ? float(x) / xScale : 0.0f;
+        float v = (m_height > 1) ? float(y) / yScale : 0.0f;
+        bool miss = (depth == FLT_MAX);
+
+        float offset[3];
+        for (int c = 0; c < 3; c++)
+        {
+          float dir = m_view.ray00[c] + m_view.across[c] * u + m_view.up[c] * v;
+          offset[c] = miss ? dir : m_view.eye[c] + dir * depth - last.eye[c];
+        }
+
+        float lastDistance, lastU, lastV;
+        if (Project(last, offset, lastDistance, lastU, lastV))
+        {
+          float fx = floorf(lastU * xScale);
+          float fy = floorf(lastV * yScale);
+          for (int n = 0; n < 4; n++)
+          {
+            float nx = fx + float(n & 1);
+            float ny = fy + float(n >> 1);
+            if (!(nx >= 0.0f && nx <= xScale && ny >= 0.0f && ny <= yScale))
+            {
+              continue;
+            }
+
+            size_t candidate = size_t(ny) * m_width + size_t(nx);
+            if (!IsSameSurface(last, m_hits[candidate], miss, lastDistance))
+            {
+              continue;
+            }
+            float dx = m_moved[candidate * 2] - float(x);
+            float dy = m_moved[candidate * 2 + 1] - float(y);
+            float candidateDrift = dx * dx + dy * dy;
+            if (candidateDrift < drift)
+            {
+              drift = candidateDrift;
+              src = candidate;
+            }
+          }
+        }
+      }
+
+      bool found = (drift <= maxDrift);
+      bool trace = !found || (m_age[src] >= m_maxAge) || IsRefreshed(x, y);
+      if (found)
+      {
+        m_nextHits[i] = m_hits[src];
+        m_nextAge[i] = uint16_t(m_age[src] + 1);
+        memcpy(&pixels[i * 4], &m_color[src * 4], 4 * sizeof(float));
+      }
+      m_trace[i] = trace ? 1 : 0;
+      m_traceCount += trace ? 1 : 0;
+    }
+  }
+
+  m_hits.swap(m_nextHits);
+  m_age.swap(m_nextAge);
+  return m_traceCount;
+}
+
+
+//A miss only matches a miss, and a hit one at about the distance expected
+bool Reprojector::IsSameSurface(View const & a_last, vec4 const & a_hit, bool a_miss, float a_distance)
+{
+  if (a_miss || a_hit[3] == 0.0f)
+  {
+    return a_miss && a_hit[3] == 0.0f;
+  }
+
+  //Only the distance is wanted, the first row of the projection
+  float const * row = a_last.inverse[0];
+  float distance = row[0] * (a_hit[0] - a_last.eye[0])
+                 + row[1] * (a_hit[1] - a_last.eye[1])
+                 + row[2] * (a_hit[2] - a_last.eye[2]);
+  return fabsf(distance - a_distance) <= REPROJECT_DEPTH_TOLERANCE * a_distance;
+}
+
+
+void Reprojector::SetHit(int a_x, int a_y, Ray const & a_ray, HitInfo const & a_hit)
+{
+  size_t i = size_t(a_y) * m_width + a_x;
+  if (a_hit.type == TYPE_NULL)
+  {
+    m_hits[i] = a_ray.direction;
+    m_hits[i][3] = 0.0f;
+  }
+  else
+  {
+    m_hits[i] = a_ray.origin + a_ray.direction * a_hit.t;
+    m_hits[i][3] = 1.0f;
+  }
+  m_age[i] = 0;
+}
+
+
+void Reprojector::Store(Framebuffer const & a_fb)
+{
+  if (a_fb.Width() != m_width || a_fb.Height() != m_height || m_color.empty())
+  {
+    return;
+  }
+  memcpy(&m_color[0], a_fb.Data(), m_color.size() * sizeof(float));
+  m_valid = true;
+}
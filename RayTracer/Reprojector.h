@@ -0,0 +1,133 @@
+#ifndef REPROJECTOR_H
+#define REPROJECTOR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "Camera.h"
+
+class Framebuffer;
+struct HitInfo;
+struct Ray;
+
+//Frames a pixel's shading is carried over before it is traced again
+#define REPROJECT_MAX_AGE   30
+
+//Share of the pixels traced again every frame, whatever their age
+#define REPROJECT_REFRESH   0.05f
+
+//How far, as a share of its distance, the hit a pixel is carried over from
+//may be from where the new view expects it
+#define REPROJECT_DEPTH_TOLERANCE 0.05f
+
+//Pixels a carried over hit may sit from the centre of the pixel it shades
+#define REPROJECT_MAX_DRIFT 1.0f
+
+/*!
+ * @class Reprojector
+ *
+ * @brief Carries the shading of the last frame over to the next, so that
+ * only pixels with nothing to carry over are traced, see
+ * CPUTracer::SetReprojector().
+ *
+ * The primary hit of every pixel is kept with its colour, as the point the
+ * pixel's ray hit at its hit distance, or as the ray's direction for a
+ * miss. Reproject() first splats the distance of each hit into the new
+ * view, nearest first, and fills the gaps the splat leaves between hits
+ * from their farthest neighbour. Each new pixel then follows its own ray
+ * out to that distance and back into the last view. Of the four pixels
+ * around where it lands, it takes the colour and hit of the one whose hit
+ * is where it expected and is now nearest its centre.
+ *
+ * Pixels that fail, being hidden or off screen in the last view, are
+ * traced. So are pixels whose hit has drifted more than
+ * REPROJECT_MAX_DRIFT from their centre, as a colour could otherwise creep
+ * across the image over the frames it is carried. So are pixels carried
+ * over for more than the age limit, and a rolling share of the rest spread
+ * over the image, so that shading which depends on the view, like
+ * reflections, catches up. Geometry the last frame did not see cannot hide
+ * what it did, so something coming in through the near plane as the
+ * camera backs up is only picked up by those two. Nothing is known about
+ * the scene, so Reset() when it changes.
+ */
+class Reprojector
+{
+public:
+
+  Reprojector();
+
+  //! Frames a pixel is carried over before it is traced again.
+  void SetMaxAge(unsigned a_frames) { m_maxAge = a_frames; }
+
+  //! Share of the pixels traced again every frame. 0 turns the refresh
+  //! off, 1 traces everything.
+  void SetRefreshFraction(float a_fraction) { m_refresh = a_fraction; }
+
+  //! Forgets the last frame, so the next is traced in full.
+  void Reset() { m_valid = false; }
+
+  //! Fills a_fb with the last frame as seen from a_camera and marks the
+  //! pixels left to trace. Returns how many are marked.
+  size_t Reproject(Camera const &, Framebuffer & fb);
+
+  bool NeedsTrace(int a_x, int a_y) const { return m_trace[a_y * m_width + a_x] != 0; }
+
+  //! Records the primary hit of a traced pixel. Safe to call from several
+  //! threads for different pixels.
+  void SetHit(int x, int y, Ray const &, HitInfo const &);
+
+  //! Keeps the finished frame to carry over to the next.
+  void Store(Framebuffer const &);
+
+  //! Pixels marked by the last Reproject().
+  size_t GetTraceCount() const { return m_traceCount; }
+  size_t GetPixelCount() const { return m_trace.size(); }
+
+private:
+
+  //The corner rays of a camera and the inverse of the first three, which
+  //takes an offset from the eye to the distance along a pixel's ray, and
+  //that times the pixel's place across and up the image
+  struct View
+  {
+    float eye[3];
+    float ray00[3];
+    float across[3];
+    float up[3];
+    float inverse[3][3];
+  };
+
+  static bool SetView(Camera const &, View &);
+
+  //False if a_offset is behind the view
+  static bool Project(View const &, float const offset[3], float & distance, float & u, float & v);
+  static bool IsSameSurface(View const & last, vec4 const & hit, bool miss, float distance);
+
+  void Resize(int width, int height);
+  bool IsRefreshed(int x, int y) const;
+
+private:
+
+  int                   m_width;
+  int                   m_height;
+  bool                  m_valid;
+  unsigned              m_maxAge;
+  float                 m_refresh;
+  uint32_t              m_frame;
+  size_t                m_traceCount;
+  View                  m_view;         //Of the last frame
+
+  std::vector<float>    m_color;        //The last frame, RGBA
+  std::vector<vec4>     m_hits;         //w is 1 for a point, 0 for the direction of a miss
+  std::vector<uint16_t> m_age;
+  std::vector<uint8_t>  m_trace;
+
+  //Reproject() gathers into these, then swaps them with the above
+  std::vector<vec4>     m_nextHits;
+  std::vector<uint16_t> m_nextAge;
+  std::vector<float>    m_moved;        //Where each hit lands in the new view, x and y in pixels
+  std::vector<float>    m_splat;
+  std::vector<float>    m_depth;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include <math.h>
+
+#include "ResolutionScaler.h"
+
+
+ResolutionScaler::ResolutionScaler()
+  : m_budget(0.0)
+  , m_fullFrameMs(0.0)
+  , m_scale(1.0f)
+  , m_nextFrame(0)
+{
+  for (int i = 0; i < SCALER_FRAME_RING; i++)
+  {
+    m_frames[i].frame = 0;
+    m_frames[i].scale = 0.0f;
+  }
+}
+
+
+void ResolutionScaler::GetSize(int a_maxWidth, int a_maxHeight, int & a_width, int & a_height) const
+{
+  float scale = GetScale();
+  a_width = int(float(a_maxWidth) * scale + 0.5f);
+  a_height = int(float(a_maxHeight) * scale + 0.5f);
+  if (a_width < 1) a_width = 1;
+  if (a_height < 1) a_height = 1;
+}
+
+
+void ResolutionScaler::AddFrame(uint64_t a_frame)
+{
+  Frame & slot = m_frames[m_nextFrame % SCALER_FRAME_RING];
+  slot.frame = a_frame;
+  slot.scale = GetScale();
+  m_nextFrame++;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	ResolutionScaler::AddTiming()
+//--------------------------------------------------------------------------------
+bool ResolutionScaler::AddTiming(uint64_t a_frame, double a_ms)
+{
+  float frameScale = 0.0f;
+  for (int i = 0; i < SCALER_FRAME_RING; i++)
+  {
+    if (m_frames[i].frame == a_frame && m_frames[i].scale > 0.0f)
+    {
+      frameScale = m_frames[i].scale;
+      m_frames[i].scale = 0.0f;
+      break;
+    }
+  }
+
+  if (frameScale == 0.0f || !IsEnabled())
+  {
+    return false;
+  }
+
+  //Tracing cost follows the number of pixels
+  double fullFrameMs = a_ms / (double(frameScale) * double(frameScale));
+  if (m_fullFrameMs == 0.0)
+  {
+    m_fullFrameMs = fullFrameMs;
+  }
+  else
+  {
+    m_fullFrameMs += (fullFrameMs - m_fullFrameMs) * SCALER_SMOOTHING;
+  }
+
+  float scale = 1.0f;
+  if (m_fullFrameMs > m_budget)
+  {
+    scale = float(sqrt(m_budget / m_fullFrameMs));
+  }
+  if (scale < SCALER_MIN_SCALE)
+  {
+    scale = SCALER_MIN_SCALE;
+  }
+
+  //Always let the scale reach the full image, or the floor
+  bool atLimit = (scale == 1.0f || scale == SCALER_MIN_SCALE);
+  if (scale == m_scale || (!atLimit && fabsf(scale - m_scale) < m_scale * SCALER_DEADBAND))
+  {
+    return false;
+  }
+
+  m_scale = scale;
+  return true;
+}
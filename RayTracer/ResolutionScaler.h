@@ -0,0 +1,82 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+#include <stdint.h>
+
+//Smallest scale of each side of the image
+#define SCALER_MIN_SCALE  0.25f
+
+//Weight of each new timing in the smoothed cost of a full frame
+#define SCALER_SMOOTHING  0.25
+
+//Scale changes smaller than this fraction are ignored, so the size does not
+//jitter between frames
+#define SCALER_DEADBAND   0.05f
+
+//Frames a timing may come back after, must cover PROFILER_QUERY_RING
+#define SCALER_FRAME_RING 8
+
+/*!
+ * @class ResolutionScaler
+ *
+ * @brief Picks the size to trace the interactive view at to hold a frame
+ * budget.
+ *
+ * Each timing is divided by the share of the full image its frame traced,
+ * giving the cost of a full frame. The smoothed cost sets the scale: the
+ * area of the image shrinks in proportion to how far over budget a full
+ * frame is. Both sides are scaled by the same factor, so the aspect ratio
+ * holds and the traced image is stretched over the window.
+ *
+ * GPU timings come back a few frames late, so frames are recorded with
+ * their scale by AddFrame() and matched up with their timing when it
+ * arrives.
+ */
+class ResolutionScaler
+{
+public:
+
+  //! How the quad pass stretches the traced image over the window.
+  enum class Filter
+  {
+    Bilinear,
+    EdgeAware   //Bilinear, with taps unlike the nearest one down-weighted
+  };
+
+  ResolutionScaler();
+
+  //! Milliseconds to trace a frame in. 0, the default, traces every
+  //! frame at full size.
+  void SetBudget(double ms) { m_budget = ms; }
+  double GetBudget() const { return m_budget; }
+  bool IsEnabled() const { return m_budget > 0.0; }
+
+  //! The fraction of each side of the full image to trace.
+  float GetScale() const { return IsEnabled() ? m_scale : 1.0f; }
+
+  //! a_maxWidth by a_maxHeight scaled by GetScale(), at least one pixel.
+  void GetSize(int maxWidth, int maxHeight, int & width, int & height) const;
+
+  //! Records that a_frame was traced at GetScale().
+  void AddFrame(uint64_t frame);
+
+  //! Feeds back the time a frame took to trace. Frames not given to
+  //! AddFrame(), or already timed, are ignored. True if the scale changed.
+  bool AddTiming(uint64_t frame, double ms);
+
+private:
+
+  struct Frame
+  {
+    uint64_t  frame;
+    float     scale;    //0 once timed
+  };
+
+  double    m_budget;
+  double    m_fullFrameMs;    //Smoothed, 0 until the first timing
+  float     m_scale;
+  Frame     m_frames[SCALER_FRAME_RING];
+  unsigned  m_nextFrame;
+};
+
+#endif
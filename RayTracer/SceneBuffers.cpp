@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "SceneBuffers.h"
+
+#define SCENE_MIN_CAPACITY 64
+
+static const GLbitfield s_mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+
+template<typename T, typename GPUType>
+static void CopyRange(qArray<T> const & a_src, DirtyRange const & a_range, uint8_t * a_dst)
+{
+  GPUType * dst = reinterpret_cast<GPUType*>(a_dst);
+  for (unsigned i = a_range.first; i < a_range.end; i++)
+  {
+    Pack(a_src[i], dst[i]);
+  }
+}
+
+
+//Vertex and index streams already have their GPU layout
+template<>
+void CopyRange<float, float>(qArray<float> const & a_src, DirtyRange const & a_range, uint8_t * a_dst)
+{
+  if (!a_range.Empty())
+  {
+    memcpy(a_dst + a_range.first * sizeof(float), a_src.data + a_range.first, (a_range.end - a_range.first) * sizeof(float));
+  }
+}
+
+
+template<>
+void CopyRange<uint32_t, uint32_t>(qArray<uint32_t> const & a_src, DirtyRange const & a_range, uint8_t * a_dst)
+{
+  if (!a_range.Empty())
+  {
+    memcpy(a_dst + a_range.first * sizeof(uint32_t), a_src.data + a_range.first, (a_range.end - a_range.first) * sizeof(uint32_t));
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneBuffers
+//--------------------------------------------------------------------------------
+SceneBuffers::SceneBuffers()
+  : m_region(0)
+  , m_alignment(1)
+{
+  for (int i = 0; i < SCENE_BUFFER_REGIONS; i++)
+  {
+    m_fences[i] = 0;
+  }
+}
+
+
+bool SceneBuffers::InitBuffer(Buffer & a_buffer, unsigned a_stride)
+{
+  a_buffer.id = 0;
+  a_buffer.capacity = 0;
+  a_buffer.stride = a_stride;
+  a_buffer.regionSize = 0;
+  a_buffer.mapped = nullptr;
+  bool reallocated(false);
+  return Reserve(a_buffer, SCENE_MIN_CAPACITY, reallocated);
+}
+
+
+void SceneBuffers::DeleteBuffer(Buffer & a_buffer)
+{
+  if (a_buffer.id != 0)
+  {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, a_buffer.id);
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDeleteBuffers(1, &a_buffer.id);
+  }
+  a_buffer.id = 0;
+  a_buffer.capacity = 0;
+  a_buffer.regionSize = 0;
+  a_buffer.mapped = nullptr;
+}
+
+
+bool SceneBuffers::Reserve(Buffer & a_buffer, unsigned a_count, bool & a_reallocated)
+{
+  a_reallocated = false;
+  if (a_count <= a_buffer.capacity && a_buffer.mapped != nullptr)
+  {
+    return true;
+  }
+
+  unsigned capacity = (a_buffer.capacity > 0) ? a_buffer.capacity : SCENE_MIN_CAPACITY;
+  while (capacity < a_count)
+  {
+    capacity *= 2;
+  }
+
+  //Deleting a buffer a dispatch in flight still reads is safe, GL keeps the
+  //storage until the dispatch is done.
+  DeleteBuffer(a_buffer);
+  a_reallocated = true;
+
+  GLsizeiptr regionSize = GLsizeiptr(capacity) * a_buffer.stride;
+  regionSize = (regionSize + m_alignment - 1) / m_alignment * m_alignment;
+  GLsizeiptr size = regionSize * SCENE_BUFFER_REGIONS;
+  glGenBuffers(1, &a_buffer.id);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, a_buffer.id);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, s_mapFlags);
+  a_buffer.mapped = static_cast<uint8_t*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, s_mapFlags));
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  if (a_buffer.mapped == nullptr)
+  {
+    //Leave the buffer empty so the next upload tries again from scratch
+    fprintf(stderr, "Failed to map scene buffer\n");
+    DeleteBuffer(a_buffer);
+    return false;
+  }
+
+  a_buffer.capacity = capacity;
+  a_buffer.regionSize = regionSize;
+  return true;
+}
+
+
+bool SceneBuffers::Init()
+{
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_alignment);
+  if (m_alignment < 1)
+  {
+    m_alignment = 1;
+  }
+  m_region = 0;
+
+  bool result = true;
+  result = InitBuffer(m_materials, sizeof(GPUMaterials)) && result;
+  result = InitBuffer(m_boxes, sizeof(GPUAABB)) && result;
+  result = InitBuffer(m_spheres, sizeof(GPUSphere)) && result;
+  result = InitBuffer(m_obbs, sizeof(GPUOBB)) && result;
+  result = InitBuffer(m_capsules, sizeof(GPUCapsule)) && result;
+  result = InitBuffer(m_cylinders, sizeof(GPUCapsule)) && result;
+  result = InitBuffer(m_tori, sizeof(GPUTorus)) && result;
+  result = InitBuffer(m_cones, sizeof(GPUCone)) && result;
+  result = InitBuffer(m_meshes, sizeof(GPUMesh)) && result;
+  result = InitBuffer(m_positions, sizeof(float)) && result;
+  result = InitBuffer(m_indices, sizeof(uint32_t)) && result;
+  result = InitBuffer(m_instances, sizeof(GPUInstance)) && result;
+  return result;
+}
+
+
+void SceneBuffers::ShutDown()
+{
+  for (int i = 0; i < SCENE_BUFFER_REGIONS; i++)
+  {
+    WaitForRegion(i);
+  }
+  DeleteBuffer(m_materials);
+  DeleteBuffer(m_boxes);
+  DeleteBuffer(m_spheres);
+  DeleteBuffer(m_obbs);
+  DeleteBuffer(m_capsules);
+  DeleteBuffer(m_cylinders);
+  DeleteBuffer(m_tori);
+  DeleteBuffer(m_cones);
+  DeleteBuffer(m_meshes);
+  DeleteBuffer(m_positions);
+  DeleteBuffer(m_indices);
+  DeleteBuffer(m_instances);
+}
+
+
+void SceneBuffers::WaitForRegion(int a_region)
+{
+  GLsync fence = m_fences[a_region];
+  if (fence == 0)
+  {
+    return;
+  }
+
+  //The mapping is coherent, so the only hazard is overwriting data a
+  //dispatch still in flight is reading.
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  while (result == GL_TIMEOUT_EXPIRED)
+  {
+    result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+  }
+  glDeleteSync(fence);
+  m_fences[a_region] = 0;
+}
+
+
+void SceneBuffers::Fence()
+{
+  if (m_fences[m_region] != 0)
+  {
+    glDeleteSync(m_fences[m_region]);
+  }
+  m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+template<typename T, typename GPUType>
+bool SceneBuffers::UploadArray(Buffer & a_buffer, qArray<T> const & a_array, DirtyRange a_range)
+{
+  bool reallocated(false);
+  if (!Reserve(a_buffer, a_array.size, reallocated))
+  {
+    return false;
+  }
+
+  for (int i = 0; i < SCENE_BUFFER_REGIONS; i++)
+  {
+    //A reallocated buffer needs all of its contents again, in every region
+    if (reallocated)
+    {
+      a_buffer.pending[i].Clear();
+      a_buffer.pending[i].Add(0, a_array.size);
+    }
+    else if (!a_range.Empty())
+    {
+      a_buffer.pending[i].Add(a_range.first, a_range.end);
+    }
+  }
+
+  //Ranges queued while the array was longer may run past its end now
+  DirtyRange & range = a_buffer.pending[m_region];
+  if (range.end > a_array.size)
+  {
+    range.end = a_array.size;
+  }
+
+  CopyRange<T, GPUType>(a_array, range, a_buffer.mapped + m_region * a_buffer.regionSize);
+  range.Clear();
+  return true;
+}
+
+
+bool SceneBuffers::Upload(Scene const & a_scene)
+{
+  if (!a_scene.IsDirty())
+  {
+    return true;
+  }
+
+  //Write the region the oldest dispatch read, which is most likely done
+  m_region = (m_region + 1) % SCENE_BUFFER_REGIONS;
+  WaitForRegion(m_region);
+
+  bool result = true;
+  result = UploadArray<Materials, GPUMaterials>(m_materials, a_scene.GetMaterials(), a_scene.DirtyMaterials()) && result;
+  result = UploadArray<AABB, GPUAABB>(m_boxes, a_scene.GetBoxes(), a_scene.DirtyBoxes()) && result;
+  result = UploadArray<Sphere, GPUSphere>(m_spheres, a_scene.GetSpheres(), a_scene.DirtySpheres()) && result;
+  result = UploadArray<OBB, GPUOBB>(m_obbs, a_scene.GetOBBs(), a_scene.DirtyOBBs()) && result;
+  result = UploadArray<Capsule, GPUCapsule>(m_capsules, a_scene.GetCapsules(), a_scene.DirtyCapsules()) && result;
+  result = UploadArray<Cylinder, GPUCapsule>(m_cylinders, a_scene.GetCylinders(), a_scene.DirtyCylinders()) && result;
+  result = UploadArray<Torus, GPUTorus>(m_tori, a_scene.GetTori(), a_scene.DirtyTori()) && result;
+  result = UploadArray<ConeSegment, GPUCone>(m_cones, a_scene.GetCones(), a_scene.DirtyCones()) && result;
+  result = UploadArray<Mesh, GPUMesh>(m_meshes, a_scene.GetMeshes(), a_scene.DirtyMeshes()) && result;
+  result = UploadArray<float, float>(m_positions, a_scene.GetPositions(), a_scene.DirtyPositions()) && result;
+  result = UploadArray<uint32_t, uint32_t>(m_indices, a_scene.GetIndices(), a_scene.DirtyIndices()) && result;
+  result = UploadArray<Instance, GPUInstance>(m_instances, a_scene.GetInstances(), a_scene.DirtyInstances()) && result;
+  return result;
+}
+
+
+bool SceneBuffers::IsMapped() const
+{
+  return m_materials.mapped && m_boxes.mapped && m_spheres.mapped && m_obbs.mapped
+      && m_capsules.mapped && m_cylinders.mapped && m_tori.mapped && m_cones.mapped
+      && m_meshes.mapped && m_positions.mapped && m_indices.mapped && m_instances.mapped;
+}
+
+
+void SceneBuffers::BindBuffer(GLuint a_binding, Buffer const & a_buffer) const
+{
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, a_binding, a_buffer.id, m_region * a_buffer.regionSize, a_buffer.regionSize);
+}
+
+
+void SceneBuffers::Bind() const
+{
+  BindBuffer(SCENE_BINDING_MATERIALS, m_materials);
+  BindBuffer(SCENE_BINDING_BOXES, m_boxes);
+  BindBuffer(SCENE_BINDING_SPHERES, m_spheres);
+  BindBuffer(SCENE_BINDING_OBBS, m_obbs);
+  BindBuffer(SCENE_BINDING_CAPSULES, m_capsules);
+  BindBuffer(SCENE_BINDING_CYLINDERS, m_cylinders);
+  BindBuffer(SCENE_BINDING_TORI, m_tori);
+  BindBuffer(SCENE_BINDING_CONES, m_cones);
+  BindBuffer(SCENE_BINDING_MESHES, m_meshes);
+  BindBuffer(SCENE_BINDING_POSITIONS, m_positions);
+  BindBuffer(SCENE_BINDING_INDICES, m_indices);
+  BindBuffer(SCENE_BINDING_INSTANCES, m_instances);
+}
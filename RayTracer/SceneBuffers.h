@@ -0,0 +1,114 @@
+#ifndef SCENEBUFFERS_H
+#define SCENEBUFFERS_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+
+#include "scene.h"
+#include "SceneLayout.h"
+
+//Copies of the scene kept on the GPU, so an upload can fill one while
+//dispatches from earlier frames still read the others
+#define SCENE_BUFFER_REGIONS 3
+
+//Shader storage binding points, must match raytracer_cs.glsl
+enum SceneBinding
+{
+  SCENE_BINDING_MATERIALS = 3,
+  SCENE_BINDING_BOXES     = 4,
+  SCENE_BINDING_SPHERES   = 5,
+  SCENE_BINDING_OBBS      = 6,
+  SCENE_BINDING_CAPSULES  = 7,
+  SCENE_BINDING_CYLINDERS = 8,
+  SCENE_BINDING_TORI      = 9,
+  SCENE_BINDING_CONES     = 10,
+  SCENE_BINDING_POSITIONS = 11,
+  SCENE_BINDING_INDICES   = 12,
+  SCENE_BINDING_MESHES    = 13,
+  SCENE_BINDING_INSTANCES = 19
+};
+
+/*!
+ * @class SceneBuffers
+ *
+ * @brief Scene arrays stored in persistently mapped shader storage buffers.
+ *
+ * Each buffer holds SCENE_BUFFER_REGIONS copies of its array. An upload
+ * moves on to the next region and only waits for the dispatches that last
+ * read that region, rather than for everything in flight. Each region tracks
+ * the elements that changed since it was last written, so only those are
+ * packed and copied into the mapping. A buffer is only reallocated when the
+ * scene outgrows it.
+ */
+class SceneBuffers
+{
+public:
+
+  SceneBuffers();
+
+  //! Returns false if a buffer could not be mapped.
+  bool Init();
+  void ShutDown();
+
+  //! Copies everything the scene has marked dirty to the GPU.
+  //! Returns false if a buffer could not be mapped, in which case the GPU
+  //! copy of the scene is incomplete.
+  bool Upload(Scene const &);
+
+  //! True if every buffer is mapped.
+  bool IsMapped() const;
+
+  //! Bind the current region of all buffers to their SceneBinding points.
+  void Bind() const;
+
+  //! Call once the last dispatch reading the buffers has been issued.
+  void Fence();
+
+private:
+
+  struct Buffer
+  {
+    GLuint      id;
+    unsigned    capacity;   //Elements per region
+    unsigned    stride;
+    GLsizeiptr  regionSize; //Bytes per region, padded to the offset alignment
+    uint8_t *   mapped;
+
+    //Elements changed since each region was last written
+    DirtyRange  pending[SCENE_BUFFER_REGIONS];
+  };
+
+  bool InitBuffer(Buffer &, unsigned stride);
+  void DeleteBuffer(Buffer &);
+
+  //! Returns false if the buffer could not be mapped. Sets a_reallocated if
+  //! the old contents were lost.
+  bool Reserve(Buffer &, unsigned count, bool & a_reallocated);
+
+  template<typename T, typename GPUType>
+  bool UploadArray(Buffer &, qArray<T> const &, DirtyRange);
+
+  void BindBuffer(GLuint binding, Buffer const &) const;
+  void WaitForRegion(int);
+
+private:
+
+  Buffer  m_materials;
+  Buffer  m_boxes;
+  Buffer  m_spheres;
+  Buffer  m_obbs;
+  Buffer  m_capsules;
+  Buffer  m_cylinders;
+  Buffer  m_tori;
+  Buffer  m_cones;
+  Buffer  m_meshes;
+  Buffer  m_positions;
+  Buffer  m_indices;
+  Buffer  m_instances;
+
+  GLsync  m_fences[SCENE_BUFFER_REGIONS];
+  int     m_region;
+  GLint   m_alignment;
+};
+
+#endif
@@ -0,0 +1,513 @@
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "BVH.h"
+#include "scene.h"
+#include "SceneFile.h"
+#include "SceneLayout.h"
+
+static char const s_magic[8] = "RTSCENE";
+
+
+//--------------------------------------------------------------------------------
+//	@	Helpers
+//--------------------------------------------------------------------------------
+static uint32_t Checksum(void const * a_data, uint64_t a_size)
+{
+  uint8_t const * bytes = static_cast<uint8_t const *>(a_data);
+  uint32_t hash = 2166136261u;
+  for (uint64_t i = 0; i < a_size; i++)
+  {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+
+//Offset rounded up to the section alignment
+static uint64_t Align(uint64_t a_offset)
+{
+  return (a_offset + SCENE_FILE_ALIGNMENT - 1) & ~uint64_t(SCENE_FILE_ALIGNMENT - 1);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::SceneFile()
+//--------------------------------------------------------------------------------
+SceneFile::SceneFile() : m_data(nullptr)
+                       , m_size(0)
+                       , m_sections(nullptr)
+                       , m_nSections(0)
+#ifdef _WIN32
+                       , m_file(INVALID_HANDLE_VALUE)
+                       , m_mapping(nullptr)
+#endif
+{
+
+}
+
+
+SceneFile::~SceneFile()
+{
+  Close();
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::Open()
+//--------------------------------------------------------------------------------
+bool SceneFile::Open(std::string const & a_path)
+{
+  Close();
+
+  if (!Map(a_path))
+  {
+    printf("Failed to map '%s'\n", a_path.c_str());
+    return false;
+  }
+
+  if (!Validate())
+  {
+    printf("'%s' is not a version %i scene file, or is damaged\n", a_path.c_str(), SCENE_FILE_VERSION);
+    Close();
+    return false;
+  }
+
+  SceneFileHeader const * header = reinterpret_cast<SceneFileHeader const *>(m_data);
+  m_sections = reinterpret_cast<SceneFileSection const *>(m_data + header->sectionTableOffset);
+  m_nSections = header->sectionCount;
+  m_checks.assign(m_nSections, CHECK_PENDING);
+  return true;
+}
+
+
+void SceneFile::Close()
+{
+  Unmap();
+  m_sections = nullptr;
+  m_nSections = 0;
+  m_checks.clear();
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::Map()
+//--------------------------------------------------------------------------------
+#ifdef _WIN32
+bool SceneFile::Map(std::string const & a_path)
+{
+  m_file = CreateFileA(a_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+  {
+    Unmap();
+    return false;
+  }
+
+  m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (m_mapping == nullptr)
+  {
+    Unmap();
+    return false;
+  }
+
+  m_data = static_cast<uint8_t const *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  m_size = uint64_t(size.QuadPart);
+  if (m_data == nullptr)
+  {
+    Unmap();
+    return false;
+  }
+  return true;
+}
+
+
+void SceneFile::Unmap()
+{
+  if (m_data != nullptr)
+  {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_mapping != nullptr)
+  {
+    CloseHandle(m_mapping);
+  }
+  if (m_file != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(m_file);
+  }
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+  m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool SceneFile::Map(std::string const & a_path)
+{
+  int fd = open(a_path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  //The mapping keeps the file open
+  void * data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+
+  m_data = static_cast<uint8_t const *>(data);
+  m_size = uint64_t(info.st_size);
+  return true;
+}
+
+
+void SceneFile::Unmap()
+{
+  if (m_data != nullptr)
+  {
+    munmap(const_cast<uint8_t *>(m_data), size_t(m_size));
+  }
+  m_data = nullptr;
+  m_size = 0;
+}
+#endif
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::Validate()
+//--------------------------------------------------------------------------------
+//		Everything Open() relies on. Sizes are compared by division so a
+//		damaged count cannot overflow past the checks.
+//--------------------------------------------------------------------------------
+bool SceneFile::Validate() const
+{
+  if (m_size < sizeof(SceneFileHeader))
+  {
+    return false;
+  }
+
+  SceneFileHeader const * header = reinterpret_cast<SceneFileHeader const *>(m_data);
+  if (memcmp(header->magic, s_magic, sizeof(s_magic)) != 0
+    || header->version != SCENE_FILE_VERSION
+    || header->fileSize != m_size)
+  {
+    return false;
+  }
+
+  uint64_t tableOffset = header->sectionTableOffset;
+  if (tableOffset % SCENE_FILE_ALIGNMENT != 0
+    || tableOffset < sizeof(SceneFileHeader)
+    || tableOffset > m_size
+    || header->sectionCount > (m_size - tableOffset) / sizeof(SceneFileSection))
+  {
+    return false;
+  }
+
+  uint64_t tableSize = uint64_t(header->sectionCount) * sizeof(SceneFileSection);
+  if (Checksum(m_data + tableOffset, tableSize) != header->tableChecksum)
+  {
+    return false;
+  }
+
+  SceneFileSection const * sections = reinterpret_cast<SceneFileSection const *>(m_data + tableOffset);
+  for (uint32_t i = 0; i < header->sectionCount; i++)
+  {
+    SceneFileSection const & section = sections[i];
+    if (section.stride == 0
+      || section.offset % SCENE_FILE_ALIGNMENT != 0
+      || section.offset < sizeof(SceneFileHeader)
+      || section.offset > tableOffset
+      || section.count > (tableOffset - section.offset) / section.stride)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+SceneFileSection const * SceneFile::FindSection(uint32_t a_type) const
+{
+  for (uint32_t i = 0; i < m_nSections; i++)
+  {
+    if (m_sections[i].type == a_type)
+    {
+      return &m_sections[i];
+    }
+  }
+  return nullptr;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::GetSection()
+//--------------------------------------------------------------------------------
+bool SceneFile::GetSection(uint32_t a_type, uint32_t a_stride, void const *& a_data, unsigned & a_count) const
+{
+  a_data = nullptr;
+  a_count = 0;
+
+  SceneFileSection const * section = FindSection(a_type);
+  if (section == nullptr)
+  {
+    return true;
+  }
+
+  if (section->stride != a_stride || section->count > 0xFFFFFFFFull)
+  {
+    return false;
+  }
+
+  Check & check = m_checks[section - m_sections];
+  if (check == CHECK_PENDING)
+  {
+    uint32_t checksum = Checksum(m_data + section->offset, section->count * section->stride);
+    check = (checksum == section->checksum) ? CHECK_PASSED : CHECK_FAILED;
+  }
+  if (check == CHECK_FAILED)
+  {
+    printf("Scene file section %u fails its checksum\n", a_type);
+    return false;
+  }
+
+  a_data = m_data + section->offset;
+  a_count = unsigned(section->count);
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::GetBVH()
+//--------------------------------------------------------------------------------
+bool SceneFile::GetBVH(BVHData & a_out) const
+{
+  SceneFileBVHInfo const * info(nullptr);
+  unsigned nInfo(0);
+  if (!Get(SCENE_SECTION_BVH_INFO, info, nInfo) || nInfo != 1)
+  {
+    return false;
+  }
+
+  a_out.root = info->root;
+  a_out.bottomNodes = info->bottomNodes;
+  a_out.bottomPrimitives = info->bottomPrimitives;
+  return Get(SCENE_SECTION_BVH_NODES, a_out.nodes, a_out.nNodes)
+    && Get(SCENE_SECTION_BVH_PRIMITIVES, a_out.primitives, a_out.nPrimitives)
+    && Get(SCENE_SECTION_BVH_MESH_ROOTS, a_out.meshRoots, a_out.nMeshRoots);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	Writing
+//--------------------------------------------------------------------------------
+namespace
+{
+  struct PendingSection
+  {
+    SceneFileSection  entry;
+    void const *      data;
+    int               packed;     //Index into the packed arrays instead, if >= 0
+  };
+
+  class SectionList
+  {
+  public:
+
+    void Add(uint32_t a_type, uint32_t a_stride, void const * a_data, size_t a_count)
+    {
+      if (a_count == 0)
+      {
+        return;
+      }
+      PendingSection section = {};
+      section.entry.type = a_type;
+      section.entry.stride = a_stride;
+      section.entry.count = a_count;
+      section.data = a_data;
+      section.packed = -1;
+      m_sections.push_back(section);
+    }
+
+    //Converts to the layout in the file and keeps the result until written
+    template<typename GPUType, typename T>
+    void AddPacked(uint32_t a_type, qArray<T> const & a_items)
+    {
+      m_packed.push_back(std::vector<uint8_t>(a_items.size * sizeof(GPUType)));
+      GPUType * out = reinterpret_cast<GPUType *>(m_packed.back().data());
+      for (unsigned i = 0; i < a_items.size; i++)
+      {
+        Pack(a_items[i], out[i]);
+      }
+      Add(a_type, sizeof(GPUType), nullptr, a_items.size);
+      if (a_items.size > 0)
+      {
+        m_sections.back().packed = int(m_packed.size() - 1);
+      }
+    }
+
+    //The arrays of the hierarchy are written from where the BVH keeps them
+    void AddBVH(BVH const & a_bvh)
+    {
+      BVHData bvh = a_bvh.GetData();
+      if (bvh.root < 0)
+      {
+        return;
+      }
+      m_bvhInfo.root = bvh.root;
+      m_bvhInfo.bottomNodes = bvh.bottomNodes;
+      m_bvhInfo.bottomPrimitives = bvh.bottomPrimitives;
+      m_bvhInfo.pad = 0;
+      Add(SCENE_SECTION_BVH_INFO, sizeof(m_bvhInfo), &m_bvhInfo, 1);
+      Add(SCENE_SECTION_BVH_NODES, sizeof(BVHNode), bvh.nodes, bvh.nNodes);
+      Add(SCENE_SECTION_BVH_PRIMITIVES, sizeof(BVHPrimitive), bvh.primitives, bvh.nPrimitives);
+      Add(SCENE_SECTION_BVH_MESH_ROOTS, sizeof(int32_t), bvh.meshRoots, bvh.nMeshRoots);
+    }
+
+    bool Write(std::ostream &);
+    bool Save(std::string const & path);
+
+  private:
+
+    std::vector<PendingSection>       m_sections;
+    std::vector<std::vector<uint8_t>> m_packed;
+    SceneFileBVHInfo                  m_bvhInfo;
+  };
+
+
+  void Pad(std::ostream & a_out, uint64_t & a_offset)
+  {
+    static char const zeros[SCENE_FILE_ALIGNMENT] = {};
+    uint64_t aligned = Align(a_offset);
+    a_out.write(zeros, std::streamsize(aligned - a_offset));
+    a_offset = aligned;
+  }
+
+
+  bool SectionList::Write(std::ostream & a_out)
+  {
+    SceneFileHeader header = {};
+    memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = SCENE_FILE_VERSION;
+    header.sectionCount = uint32_t(m_sections.size());
+
+    //The header is written again once the table is known
+    uint64_t offset = sizeof(header);
+    a_out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+
+    std::vector<SceneFileSection> table;
+    for (size_t i = 0; i < m_sections.size(); i++)
+    {
+      SceneFileSection entry = m_sections[i].entry;
+      void const * data = (m_sections[i].packed >= 0) ? &m_packed[m_sections[i].packed][0] : m_sections[i].data;
+      uint64_t size = entry.count * entry.stride;
+      Pad(a_out, offset);
+      a_out.write(static_cast<char const *>(data), std::streamsize(size));
+      entry.offset = offset;
+      entry.checksum = Checksum(data, size);
+      table.push_back(entry);
+      offset += size;
+    }
+
+    Pad(a_out, offset);
+    header.sectionTableOffset = offset;
+    if (!table.empty())
+    {
+      a_out.write(reinterpret_cast<char const *>(&table[0]), table.size() * sizeof(SceneFileSection));
+    }
+    header.fileSize = offset + table.size() * sizeof(SceneFileSection);
+    header.tableChecksum = Checksum(table.empty() ? nullptr : &table[0], table.size() * sizeof(SceneFileSection));
+
+    a_out.seekp(0);
+    a_out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    return a_out.good();
+  }
+
+
+  bool SectionList::Save(std::string const & a_path)
+  {
+    std::ofstream file(a_path.c_str(), std::ios::out | std::ios::binary);
+    if (!file)
+    {
+      printf("Failed to open '%s' for writing\n", a_path.c_str());
+      return false;
+    }
+
+    bool result = Write(file);
+    file.close();
+    if (!result || file.fail())
+    {
+      printf("Failed to write '%s'\n", a_path.c_str());
+      return false;
+    }
+    return true;
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::Write()
+//--------------------------------------------------------------------------------
+bool SceneFile::Write(std::string const & a_path, Scene const & a_scene, BVH const * a_bvh)
+{
+  SectionList sections;
+  sections.AddPacked<GPUMaterials>(SCENE_SECTION_MATERIALS, a_scene.GetMaterials());
+  sections.AddPacked<GPUAABB>(SCENE_SECTION_BOXES, a_scene.GetBoxes());
+  sections.AddPacked<GPUSphere>(SCENE_SECTION_SPHERES, a_scene.GetSpheres());
+  sections.AddPacked<GPUOBB>(SCENE_SECTION_OBBS, a_scene.GetOBBs());
+  sections.AddPacked<GPUCapsule>(SCENE_SECTION_CAPSULES, a_scene.GetCapsules());
+  sections.AddPacked<GPUCapsule>(SCENE_SECTION_CYLINDERS, a_scene.GetCylinders());
+  sections.AddPacked<GPUTorus>(SCENE_SECTION_TORI, a_scene.GetTori());
+  sections.AddPacked<GPUCone>(SCENE_SECTION_CONES, a_scene.GetCones());
+  sections.AddPacked<GPUMesh>(SCENE_SECTION_MESHES, a_scene.GetMeshes());
+  sections.AddPacked<GPUInstance>(SCENE_SECTION_INSTANCES, a_scene.GetInstances());
+  sections.Add(SCENE_SECTION_POSITIONS, sizeof(float), a_scene.GetPositions().data, a_scene.GetPositions().size);
+  sections.Add(SCENE_SECTION_INDICES, sizeof(uint32_t), a_scene.GetIndices().data, a_scene.GetIndices().size);
+
+  if (a_bvh != nullptr)
+  {
+    sections.AddBVH(*a_bvh);
+  }
+  return sections.Save(a_path);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	SceneFile::WriteBVH()
+//--------------------------------------------------------------------------------
+bool SceneFile::WriteBVH(std::string const & a_path, BVH const & a_bvh, uint64_t a_inputHash)
+{
+  SectionList sections;
+  sections.Add(SCENE_SECTION_BVH_INPUT_HASH, sizeof(a_inputHash), &a_inputHash, 1);
+  sections.AddBVH(a_bvh);
+  return sections.Save(a_path);
+}
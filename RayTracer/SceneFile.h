@@ -0,0 +1,156 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class BVH;
+class Scene;
+struct BVHData;
+
+//Bumped whenever a section layout changes. Older files are refused.
+#define SCENE_FILE_VERSION 1
+
+//Sections start on this many bytes from the start of the file
+#define SCENE_FILE_ALIGNMENT 64
+
+//! Starts the file. The section table follows the sections, so the writer
+//! only needs to know the sizes once they are written.
+struct SceneFileHeader
+{
+  char      magic[8];             //"RTSCENE"
+  uint32_t  version;
+  uint32_t  sectionCount;
+  uint64_t  fileSize;
+  uint64_t  sectionTableOffset;
+  uint32_t  tableChecksum;
+  uint32_t  pad;
+};
+
+struct SceneFileSection
+{
+  uint32_t  type;                 //SceneSection
+  uint32_t  stride;               //Bytes per element
+  uint64_t  offset;
+  uint64_t  count;
+  uint32_t  checksum;             //FNV-1a of the stride * count bytes
+  uint32_t  pad;
+};
+
+//! Element layouts are those of SceneLayout.h, float for positions,
+//! uint32_t for indices and those of BVH.h for the hierarchy.
+enum SceneSection
+{
+  SCENE_SECTION_MATERIALS = 1,
+  SCENE_SECTION_BOXES,
+  SCENE_SECTION_SPHERES,
+  SCENE_SECTION_OBBS,
+  SCENE_SECTION_CAPSULES,
+  SCENE_SECTION_CYLINDERS,
+  SCENE_SECTION_TORI,
+  SCENE_SECTION_CONES,
+  SCENE_SECTION_MESHES,
+  SCENE_SECTION_POSITIONS,
+  SCENE_SECTION_INDICES,
+  SCENE_SECTION_INSTANCES,
+  SCENE_SECTION_BVH_INFO,         //One SceneFileBVHInfo
+  SCENE_SECTION_BVH_NODES,
+  SCENE_SECTION_BVH_PRIMITIVES,
+  SCENE_SECTION_BVH_MESH_ROOTS,
+  SCENE_SECTION_BVH_INPUT_HASH    //One uint64_t, see BVHResource
+};
+
+struct SceneFileBVHInfo
+{
+  int32_t   root;
+  uint32_t  bottomNodes;
+  uint32_t  bottomPrimitives;
+  uint32_t  pad;
+};
+
+/*!
+ * @class SceneFile
+ *
+ * @brief Binary scene container, mapped into memory rather than read.
+ *
+ * A header, the sections and a table of where they are. Each section is an
+ * array in the layout it is used in, aligned to SCENE_FILE_ALIGNMENT, so
+ * loading takes no parsing: vertex positions and indices are used in place
+ * by Scene::Load(), the other arrays can go straight to glBufferData, and
+ * a hierarchy built when the file was written saves building one again.
+ *
+ * Open() only checks the header and the table, and that every section lies
+ * inside the file. The checksum of a section is checked the first time it
+ * is asked for, so sections nobody reads are never touched.
+ */
+class SceneFile
+{
+public:
+
+  SceneFile();
+  ~SceneFile();
+
+  //! Maps the file. Prints why and returns false if it is not a scene
+  //! file of this version or its table is damaged.
+  bool Open(std::string const & path);
+  void Close();
+
+  bool IsOpen() const { return m_data != nullptr; }
+
+  //! True and the elements of a section, which must be a_stride bytes each.
+  //! A missing section is empty. False if the stride is wrong or the
+  //! checksum fails.
+  bool GetSection(uint32_t type, uint32_t stride, void const *& data, unsigned & count) const;
+
+  template<typename T>
+  bool Get(uint32_t a_type, T const *& a_data, unsigned & a_count) const
+  {
+    void const * data(nullptr);
+    bool result = GetSection(a_type, sizeof(T), data, a_count);
+    a_data = static_cast<T const *>(data);
+    return result;
+  }
+
+  //! False if the file has no hierarchy or its sections are damaged. The
+  //! arrays point into the file.
+  bool GetBVH(BVHData &) const;
+
+  //! Writes the scene, and the hierarchy built over it if given.
+  static bool Write(std::string const & path, Scene const &, BVH const * = nullptr);
+
+  //! Writes only a hierarchy, with the hash of what it was built from.
+  static bool WriteBVH(std::string const & path, BVH const &, uint64_t inputHash);
+
+private:
+
+  SceneFile(SceneFile const &);
+  SceneFile & operator=(SceneFile const &);
+
+  bool Map(std::string const & path);
+  void Unmap();
+  bool Validate() const;
+  SceneFileSection const * FindSection(uint32_t type) const;
+
+private:
+
+  enum Check : uint8_t
+  {
+    CHECK_PENDING,
+    CHECK_PASSED,
+    CHECK_FAILED
+  };
+
+  uint8_t const *           m_data;
+  uint64_t                  m_size;
+  SceneFileSection const *  m_sections;
+  uint32_t                  m_nSections;
+  mutable std::vector<Check> m_checks;    //Per section, filled in by GetSection()
+
+#ifdef _WIN32
+  void *                    m_file;
+  void *                    m_mapping;
+#endif
+};
+
+#endif
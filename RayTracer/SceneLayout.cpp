@@ -0,0 +1,234 @@
+#include "SceneLayout.h"
+
+
+//--------------------------------------------------------------------------------
+//	@	Packing
+//--------------------------------------------------------------------------------
+void Pack(Materials const & a_in, GPUMaterials & a_out)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    a_out.color[i] = a_in.color[i];
+  }
+  a_out.reflectance = a_in.reflectance;
+  a_out.pad[0] = a_out.pad[1] = a_out.pad[2] = 0.0f;
+}
+
+
+void Pack(AABB const & a_in, GPUAABB & a_out)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.min[i] = a_in.min[i];
+    a_out.max[i] = a_in.max[i];
+  }
+  a_out.pad0 = 0.0f;
+  a_out.materials = a_in.materials;
+}
+
+
+void Pack(Sphere const & a_in, GPUSphere & a_out)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.center[i] = a_in.center[i];
+  }
+  a_out.radius = a_in.radius;
+  a_out.materials = a_in.materials;
+  a_out.pad[0] = a_out.pad[1] = a_out.pad[2] = 0;
+}
+
+
+void Pack(OBB const & a_in, GPUOBB & a_out)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.center[i] = a_in.center[i];
+    for (int j = 0; j < 3; j++)
+    {
+      a_out.axes[i][j] = a_in.axes[i][j];
+    }
+    a_out.axes[i][3] = a_in.extents[i];
+  }
+  a_out.materials = a_in.materials;
+}
+
+
+static void PackSegment(vec4 const & a_origin, vec4 const & a_direction, real a_radius, uint32_t a_materials, GPUCapsule & a_out)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.origin[i] = a_origin[i];
+    a_out.direction[i] = a_direction[i];
+  }
+  a_out.radius = a_radius;
+  a_out.materials = a_materials;
+}
+
+
+void Pack(Capsule const & a_in, GPUCapsule & a_out)
+{
+  PackSegment(a_in.origin, a_in.direction, a_in.radius, a_in.materials, a_out);
+}
+
+
+void Pack(Cylinder const & a_in, GPUCapsule & a_out)
+{
+  PackSegment(a_in.origin, a_in.direction, a_in.radius, a_in.materials, a_out);
+}
+
+
+void Pack(Torus const & a_in, GPUTorus & a_out)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.center[i] = a_in.center[i];
+    a_out.axis[i] = a_in.axis[i];
+  }
+  a_out.R = a_in.radius_circle;
+  a_out.r = a_in.radius_thick;
+  a_out.materials = a_in.materials;
+  a_out.pad[0] = a_out.pad[1] = a_out.pad[2] = 0;
+}
+
+
+void Pack(ConeSegment const & a_in, GPUCone & a_out)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.origin[i] = a_in.origin[i];
+    a_out.direction[i] = a_in.direction[i];
+  }
+  a_out.r0 = a_in.r0;
+  a_out.r1 = a_in.r1;
+  a_out.materials = a_in.materials;
+  a_out.pad[0] = a_out.pad[1] = a_out.pad[2] = 0;
+}
+
+
+void Pack(Mesh const & a_in, GPUMesh & a_out)
+{
+  a_out.firstVertex = a_in.firstVertex;
+  a_out.nVertices = a_in.nVertices;
+  a_out.firstIndex = a_in.firstIndex;
+  a_out.nTriangles = a_in.nTriangles;
+  a_out.materials = a_in.materials;
+}
+
+
+void Pack(Instance const & a_in, GPUInstance & a_out)
+{
+  Dg::Quaternion<real> const & q = a_in.transform.Q();
+  a_out.rotation[0] = q[1];
+  a_out.rotation[1] = q[2];
+  a_out.rotation[2] = q[3];
+  a_out.rotation[3] = q[0];
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.translation[i] = a_in.transform.V()[i];
+  }
+  a_out.scale = a_in.transform.S();
+  a_out.mesh = a_in.mesh;
+  a_out.materials = a_in.materials;
+  a_out.pad[0] = a_out.pad[1] = 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	Unpacking
+//--------------------------------------------------------------------------------
+void Unpack(GPUMaterials const & a_in, Materials & a_out)
+{
+  a_out.color.Set(a_in.color[0], a_in.color[1], a_in.color[2], a_in.color[3]);
+  a_out.reflectance = a_in.reflectance;
+}
+
+
+void Unpack(GPUAABB const & a_in, AABB & a_out)
+{
+  a_out.min.Set(a_in.min[0], a_in.min[1], a_in.min[2], 1.0f);
+  a_out.max.Set(a_in.max[0], a_in.max[1], a_in.max[2], 1.0f);
+  a_out.materials = a_in.materials;
+}
+
+
+void Unpack(GPUSphere const & a_in, Sphere & a_out)
+{
+  a_out.center.Set(a_in.center[0], a_in.center[1], a_in.center[2], 1.0f);
+  a_out.radius = a_in.radius;
+  a_out.materials = a_in.materials;
+}
+
+
+void Unpack(GPUOBB const & a_in, OBB & a_out)
+{
+  a_out.center.Set(a_in.center[0], a_in.center[1], a_in.center[2], 1.0f);
+  for (int i = 0; i < 3; i++)
+  {
+    a_out.axes[i].Set(a_in.axes[i][0], a_in.axes[i][1], a_in.axes[i][2], 0.0f);
+    a_out.extents[i] = a_in.axes[i][3];
+  }
+  a_out.materials = a_in.materials;
+}
+
+
+template<typename Segment>
+static void UnpackSegment(GPUCapsule const & a_in, Segment & a_out)
+{
+  a_out.origin.Set(a_in.origin[0], a_in.origin[1], a_in.origin[2], 1.0f);
+  a_out.direction.Set(a_in.direction[0], a_in.direction[1], a_in.direction[2], 0.0f);
+  a_out.radius = a_in.radius;
+  a_out.materials = a_in.materials;
+}
+
+
+void Unpack(GPUCapsule const & a_in, Capsule & a_out)
+{
+  UnpackSegment(a_in, a_out);
+}
+
+
+void Unpack(GPUCapsule const & a_in, Cylinder & a_out)
+{
+  UnpackSegment(a_in, a_out);
+}
+
+
+void Unpack(GPUTorus const & a_in, Torus & a_out)
+{
+  a_out.center.Set(a_in.center[0], a_in.center[1], a_in.center[2], 1.0f);
+  a_out.axis.Set(a_in.axis[0], a_in.axis[1], a_in.axis[2], 0.0f);
+  a_out.radius_circle = a_in.R;
+  a_out.radius_thick = a_in.r;
+  a_out.materials = a_in.materials;
+}
+
+
+void Unpack(GPUCone const & a_in, ConeSegment & a_out)
+{
+  a_out.origin.Set(a_in.origin[0], a_in.origin[1], a_in.origin[2], 1.0f);
+  a_out.direction.Set(a_in.direction[0], a_in.direction[1], a_in.direction[2], 0.0f);
+  a_out.r0 = a_in.r0;
+  a_out.r1 = a_in.r1;
+  a_out.materials = a_in.materials;
+}
+
+
+void Unpack(GPUMesh const & a_in, Mesh & a_out)
+{
+  a_out.firstVertex = a_in.firstVertex;
+  a_out.nVertices = a_in.nVertices;
+  a_out.firstIndex = a_in.firstIndex;
+  a_out.nTriangles = a_in.nTriangles;
+  a_out.materials = a_in.materials;
+}
+
+
+void Unpack(GPUInstance const & a_in, Instance & a_out)
+{
+  vec4 translation(a_in.translation[0], a_in.translation[1], a_in.translation[2], 0.0f);
+  Dg::Quaternion<real> rotation(a_in.rotation[3], a_in.rotation[0], a_in.rotation[1], a_in.rotation[2]);
+  a_out.transform.Set(translation, rotation, a_in.scale);
+  a_out.mesh = a_in.mesh;
+  a_out.materials = a_in.materials;
+}
@@ -0,0 +1,112 @@
+#ifndef SCENELAYOUT_H
+#define SCENELAYOUT_H
+
+#include <stdint.h>
+
+#include "scene.h"
+
+//std430 layouts of the scene structs in raytracer_cs.glsl
+struct GPUMaterials
+{
+  float     color[4];
+  float     reflectance;
+  float     pad[3];
+};
+
+struct GPUAABB
+{
+  float     min[3];
+  float     pad0;
+  float     max[3];
+  uint32_t  materials;
+};
+
+struct GPUSphere
+{
+  float     center[3];
+  float     radius;
+  uint32_t  materials;
+  uint32_t  pad[3];
+};
+
+struct GPUOBB
+{
+  float     center[3];
+  uint32_t  materials;
+  float     axes[3][4];   //xyz: axis, w: half extent
+};
+
+//Also used for cylinders
+struct GPUCapsule
+{
+  float     origin[3];
+  float     radius;
+  float     direction[3];
+  uint32_t  materials;
+};
+
+struct GPUTorus
+{
+  float     center[3];
+  float     R;
+  float     axis[3];
+  float     r;
+  uint32_t  materials;
+  uint32_t  pad[3];
+};
+
+struct GPUCone
+{
+  float     origin[3];
+  float     r0;
+  float     direction[3];
+  float     r1;
+  uint32_t  materials;
+  uint32_t  pad[3];
+};
+
+//Positions and indices are uploaded as is, as float[] and uint[]
+struct GPUMesh
+{
+  uint32_t  firstVertex;
+  uint32_t  nVertices;
+  uint32_t  firstIndex;
+  uint32_t  nTriangles;
+  uint32_t  materials;
+};
+
+//Object to world transform. The shader inverts it when a ray reaches the instance.
+struct GPUInstance
+{
+  float     rotation[4];    //Quaternion, xyzw
+  float     translation[3];
+  float     scale;
+  uint32_t  mesh;
+  uint32_t  materials;
+  uint32_t  pad[2];
+};
+
+//! Scene structs to the layouts above and back. Cylinders share GPUCapsule.
+void Pack(Materials const &, GPUMaterials &);
+void Pack(AABB const &, GPUAABB &);
+void Pack(Sphere const &, GPUSphere &);
+void Pack(OBB const &, GPUOBB &);
+void Pack(Capsule const &, GPUCapsule &);
+void Pack(Cylinder const &, GPUCapsule &);
+void Pack(Torus const &, GPUTorus &);
+void Pack(ConeSegment const &, GPUCone &);
+void Pack(Mesh const &, GPUMesh &);
+void Pack(Instance const &, GPUInstance &);
+
+void Unpack(GPUMaterials const &, Materials &);
+void Unpack(GPUAABB const &, AABB &);
+void Unpack(GPUSphere const &, Sphere &);
+void Unpack(GPUOBB const &, OBB &);
+void Unpack(GPUCapsule const &, Capsule &);
+void Unpack(GPUCapsule const &, Cylinder &);
+void Unpack(GPUTorus const &, Torus &);
+void Unpack(GPUCone const &, ConeSegment &);
+void Unpack(GPUMesh const &, Mesh &);
+void Unpack(GPUInstance const &, Instance &);
+
+#endif
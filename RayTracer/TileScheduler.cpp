@@ -0,0 +1,479 @@
+#include <stdio.h>
+#include <fstream>
+
+#include "TileScheduler.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+
+//--------------------------------------------------------------------------------
+//	@	TileDeque
+//--------------------------------------------------------------------------------
+void TileDeque::Reset(unsigned a_capacity)
+{
+  unsigned capacity = 1;
+  while (capacity < a_capacity)
+  {
+    capacity <<= 1;
+  }
+  if (capacity > m_capacity)
+  {
+    m_tiles.reset(new std::atomic<int>[capacity]);
+    m_capacity = capacity;
+  }
+  m_top.store(0, std::memory_order_relaxed);
+  m_bottom.store(0, std::memory_order_relaxed);
+}
+
+
+void TileDeque::Push(int a_tile)
+{
+  int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+  m_tiles[bottom & (m_capacity - 1)].store(a_tile, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+
+//Takes the bottom tile. Only when it is the last one can a thief want it
+//too, and then whoever moves the top first gets it.
+bool TileDeque::Pop(int & a_tile)
+{
+  int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+  m_bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = m_top.load(std::memory_order_relaxed);
+
+  if (top > bottom)
+  {
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+
+  a_tile = m_tiles[bottom & (m_capacity - 1)].load(std::memory_order_relaxed);
+  if (top < bottom)
+  {
+    return true;
+  }
+
+  bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  return won;
+}
+
+
+TileDeque::Result TileDeque::Steal(int & a_tile)
+{
+  int64_t top = m_top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t bottom = m_bottom.load(std::memory_order_acquire);
+  if (top >= bottom)
+  {
+    return EMPTY;
+  }
+
+  a_tile = m_tiles[top & (m_capacity - 1)].load(std::memory_order_relaxed);
+  if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+  {
+    return ABORT;
+  }
+  return SUCCESS;
+}
+
+
+bool TileDeque::Empty() const
+{
+  return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	Helpers
+//--------------------------------------------------------------------------------
+//Point a_d along the Hilbert curve over an a_n by a_n grid, a_n a power of two
+static void HilbertPoint(int a_n, int a_d, int & a_x, int & a_y)
+{
+  a_x = a_y = 0;
+  for (int s = 1; s < a_n; s *= 2)
+  {
+    int rx = 1 & (a_d / 2);
+    int ry = 1 & (a_d ^ rx);
+    if (ry == 0)
+    {
+      if (rx == 1)
+      {
+        a_x = s - 1 - a_x;
+        a_y = s - 1 - a_y;
+      }
+      int t = a_x;
+      a_x = a_y;
+      a_y = t;
+    }
+    a_x += s * rx;
+    a_y += s * ry;
+    a_d /= 4;
+  }
+}
+
+
+static double Milliseconds(Clock::time_point a_from)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - a_from).count();
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	TileScheduler::TileScheduler()
+//--------------------------------------------------------------------------------
+TileScheduler::TileScheduler() : m_order(Order::Hilbert)
+                               , m_nTilesX(0)
+                               , m_nTilesY(0)
+                               , m_job(nullptr)
+                               , m_frame(0)
+                               , m_nThreads(0)
+                               , m_nRunning(0)
+                               , m_quit(false)
+{
+
+}
+
+
+TileScheduler::~TileScheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+  for (size_t i = 0; i < m_workers.size(); i++)
+  {
+    m_workers[i].join();
+  }
+}
+
+
+void TileScheduler::SetOrder(Order a_order)
+{
+  if (a_order != m_order)
+  {
+    m_order = a_order;
+    m_tiles.clear();
+  }
+}
+
+
+char const * TileScheduler::GetName(Order a_order)
+{
+  switch (a_order)
+  {
+    case Order::Scanline: return "scanline";
+    case Order::Hilbert:  return "hilbert";
+    case Order::Spiral:   return "spiral";
+  }
+  return "unknown";
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	TileScheduler::UpdateOrder()
+//--------------------------------------------------------------------------------
+void TileScheduler::UpdateOrder(int a_nTilesX, int a_nTilesY)
+{
+  size_t nTiles = size_t(a_nTilesX) * size_t(a_nTilesY);
+  if (a_nTilesX == m_nTilesX && a_nTilesY == m_nTilesY && m_tiles.size() == nTiles)
+  {
+    return;
+  }
+  m_nTilesX = a_nTilesX;
+  m_nTilesY = a_nTilesY;
+  m_tiles.clear();
+  m_tiles.reserve(nTiles);
+
+  if (m_order == Order::Hilbert)
+  {
+    //The curve covers the smallest power of two square over the grid
+    int n = 1;
+    while (n < a_nTilesX || n < a_nTilesY)
+    {
+      n *= 2;
+    }
+    for (int d = 0; d < n * n; d++)
+    {
+      int x, y;
+      HilbertPoint(n, d, x, y);
+      if (x < a_nTilesX && y < a_nTilesY)
+      {
+        m_tiles.push_back(y * a_nTilesX + x);
+      }
+    }
+  }
+  else if (m_order == Order::Spiral)
+  {
+    //Legs of 1, 1, 2, 2, 3, 3... tiles, skipping those outside the grid
+    static int const dx[4] = {1, 0, -1, 0};
+    static int const dy[4] = {0, 1, 0, -1};
+    int x = (a_nTilesX - 1) / 2;
+    int y = (a_nTilesY - 1) / 2;
+    m_tiles.push_back(y * a_nTilesX + x);
+    for (int leg = 0; m_tiles.size() < nTiles; leg++)
+    {
+      for (int i = 0; i < leg / 2 + 1; i++)
+      {
+        x += dx[leg % 4];
+        y += dy[leg % 4];
+        if (x >= 0 && x < a_nTilesX && y >= 0 && y < a_nTilesY)
+        {
+          m_tiles.push_back(y * a_nTilesX + x);
+        }
+      }
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < nTiles; i++)
+    {
+      m_tiles.push_back(int(i));
+    }
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	TileScheduler::Distribute()
+//--------------------------------------------------------------------------------
+//		Done before the workers are woken, which hands them their deques
+//		through the mutex. Each run is pushed back to front so the owner
+//		pops it in order and thieves take from its far end.
+//--------------------------------------------------------------------------------
+void TileScheduler::Distribute(unsigned a_nThreads)
+{
+  while (m_deques.size() < a_nThreads)
+  {
+    m_deques.push_back(std::unique_ptr<TileDeque>(new TileDeque()));
+  }
+
+  size_t nTiles = m_tiles.size();
+  for (unsigned t = 0; t < a_nThreads; t++)
+  {
+    size_t first = nTiles * t / a_nThreads;
+    size_t end = nTiles * (t + 1) / a_nThreads;
+    TileDeque & deque = *m_deques[t];
+    deque.Reset(unsigned(end - first));
+    for (size_t i = end; i > first; i--)
+    {
+      deque.Push(m_tiles[i - 1]);
+    }
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	TileScheduler::Run()
+//--------------------------------------------------------------------------------
+void TileScheduler::Run(int a_nTilesX, int a_nTilesY, unsigned a_nThreads,
+                        std::function<void(int tile)> const & a_job)
+{
+  if (a_nTilesX <= 0 || a_nTilesY <= 0)
+  {
+    return;
+  }
+
+  size_t nTiles = size_t(a_nTilesX) * size_t(a_nTilesY);
+  unsigned nThreads = (a_nThreads > 0) ? a_nThreads : 1;
+  if (nThreads > nTiles)
+  {
+    nThreads = unsigned(nTiles);
+  }
+
+  UpdateOrder(a_nTilesX, a_nTilesY);
+  m_times.assign(nTiles, TileTime());
+  Distribute(nThreads);
+
+  //New workers wait for the frame after the one they are started in
+  while (m_workers.size() + 1 < nThreads)
+  {
+    m_workers.push_back(std::thread(&TileScheduler::WorkerLoop, this, unsigned(m_workers.size() + 1), m_frame));
+  }
+
+  m_frameStart = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_job = &a_job;
+    m_nThreads = nThreads;
+    m_nRunning = nThreads - 1;
+    m_frame++;
+  }
+  m_wake.notify_all();
+
+  Work(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_finished.wait(lock, [this]() { return m_nRunning == 0; });
+  m_job = nullptr;
+}
+
+
+void TileScheduler::WorkerLoop(unsigned a_thread, uint64_t a_frame)
+{
+  uint64_t seen = a_frame;
+  for (;;)
+  {
+    unsigned nThreads(0);
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&]() { return m_quit || m_frame != seen; });
+      if (m_quit)
+      {
+        return;
+      }
+      seen = m_frame;
+      nThreads = m_nThreads;
+    }
+
+    //Frames with fewer tiles than threads leave some workers out
+    if (a_thread < nThreads)
+    {
+      Work(a_thread);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (--m_nRunning == 0)
+      {
+        m_finished.notify_one();
+      }
+    }
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	TileScheduler::Work()
+//--------------------------------------------------------------------------------
+void TileScheduler::Work(unsigned a_thread)
+{
+  TileDeque & own = *m_deques[a_thread];
+  std::function<void(int)> const & job = *m_job;
+
+  for (;;)
+  {
+    int tile(0);
+    bool stolen = false;
+    if (!own.Pop(tile))
+    {
+      if (!Steal(a_thread, tile))
+      {
+        return;
+      }
+      stolen = true;
+    }
+
+    double start = Milliseconds(m_frameStart);
+    job(tile);
+
+    TileTime & time = m_times[tile];
+    time.start = start;
+    time.duration = Milliseconds(m_frameStart) - start;
+    time.thread = a_thread;
+    time.stolen = stolen;
+  }
+}
+
+
+//No tiles are added during a frame, so once every other deque has come up
+//empty in one pass there is nothing left. A lost race means the victim may
+//still have tiles, so it takes another pass.
+bool TileScheduler::Steal(unsigned a_thread, int & a_tile)
+{
+  for (;;)
+  {
+    bool retry = false;
+    for (unsigned i = 1; i < m_nThreads; i++)
+    {
+      TileDeque::Result result = m_deques[(a_thread + i) % m_nThreads]->Steal(a_tile);
+      if (result == TileDeque::SUCCESS)
+      {
+        return true;
+      }
+      if (result == TileDeque::ABORT)
+      {
+        retry = true;
+      }
+    }
+    if (!retry)
+    {
+      return false;
+    }
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	TileScheduler::PrintStats()
+//--------------------------------------------------------------------------------
+void TileScheduler::PrintStats() const
+{
+  std::vector<double> busy(m_nThreads, 0.0);
+  std::vector<unsigned> tiles(m_nThreads, 0);
+  std::vector<unsigned> stolen(m_nThreads, 0);
+  double frame = 0.0;
+  for (size_t i = 0; i < m_times.size(); i++)
+  {
+    TileTime const & time = m_times[i];
+    busy[time.thread] += time.duration;
+    tiles[time.thread]++;
+    stolen[time.thread] += time.stolen ? 1 : 0;
+    if (time.start + time.duration > frame)
+    {
+      frame = time.start + time.duration;
+    }
+  }
+
+  printf("%u tiles in %s order over %u threads, %.3f ms\n",
+         unsigned(m_times.size()), GetName(m_order), m_nThreads, frame);
+  printf("%-8s %10s %8s %8s\n", "Thread", "busy ms", "tiles", "stolen");
+  double total = 0.0;
+  double slowest = 0.0;
+  for (unsigned t = 0; t < m_nThreads; t++)
+  {
+    printf("%-8u %10.3f %8u %8u\n", t, busy[t], tiles[t], stolen[t]);
+    total += busy[t];
+    if (busy[t] > slowest)
+    {
+      slowest = busy[t];
+    }
+  }
+  if (total > 0.0)
+  {
+    printf("Slowest thread is %.2fx the mean\n", slowest * m_nThreads / total);
+  }
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	TileScheduler::WriteTrace()
+//--------------------------------------------------------------------------------
+bool TileScheduler::WriteTrace(std::string const & a_path) const
+{
+  std::ofstream file(a_path.c_str());
+  if (!file)
+  {
+    printf("Unable to open file %s\n", a_path.c_str());
+    return false;
+  }
+
+  file << "{\"traceEvents\":[";
+  file.setf(std::ios::fixed);
+  file.precision(3);
+  for (size_t i = 0; i < m_times.size(); i++)
+  {
+    TileTime const & time = m_times[i];
+    file << ((i == 0) ? "\n" : ",\n")
+         << "{\"name\":\"tile " << (i % m_nTilesX) << "," << (i / m_nTilesX)
+         << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << time.thread
+         << ",\"ts\":" << time.start * 1000.0
+         << ",\"dur\":" << time.duration * 1000.0
+         << ",\"args\":{\"stolen\":" << (time.stolen ? "true" : "false") << "}}";
+  }
+  file << "\n]}\n";
+
+  printf("Wrote %u tile events to %s\n", unsigned(m_times.size()), a_path.c_str());
+  return file.good();
+}
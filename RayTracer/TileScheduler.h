@@ -0,0 +1,153 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * @class TileDeque
+ *
+ * @brief Chase-Lev work stealing deque of tile indices.
+ *
+ * The owning thread pushes and pops at the bottom, any other thread steals
+ * from the top. Only a pop and a steal racing for the last tile need a
+ * compare and swap. The capacity is fixed by Reset(), which the scheduler
+ * sizes to a whole frame of tiles, so the buffer never grows.
+ */
+class TileDeque
+{
+public:
+
+  enum Result
+  {
+    SUCCESS,
+    EMPTY,
+    ABORT     //Lost a race to another thread, there may be more to steal
+  };
+
+  TileDeque() : m_capacity(0), m_top(0), m_bottom(0) {}
+
+  //! Empties the deque. Not safe while other threads use it.
+  void Reset(unsigned capacity);
+
+  //! Owner only.
+  void Push(int tile);
+  bool Pop(int & tile);
+
+  //! Any thread.
+  Result Steal(int & tile);
+  bool Empty() const;
+
+private:
+
+  TileDeque(TileDeque const &);
+  TileDeque & operator=(TileDeque const &);
+
+private:
+
+  std::unique_ptr<std::atomic<int>[]> m_tiles;
+  unsigned                            m_capacity;   //Power of two
+  std::atomic<int64_t>                m_top;
+  std::atomic<int64_t>                m_bottom;
+};
+
+
+/*!
+ * @class TileScheduler
+ *
+ * @brief Runs a job per tile of an image over a pool of threads that is
+ * kept between frames.
+ *
+ * The tiles are put in Hilbert, spiral or scanline order and the ordered
+ * list is cut into one contiguous run per thread, so each thread works
+ * through neighbouring tiles. Each run goes into that thread's TileDeque
+ * and threads that run out steal from the far end of another's run, which
+ * evens out frames where some tiles cost far more than others.
+ *
+ * When and where each tile was traced is kept for the last frame, to see
+ * how well the load was balanced: PrintStats() sums it up per thread and
+ * WriteTrace() writes it as a Chrome trace, a row per thread.
+ */
+class TileScheduler
+{
+public:
+
+  enum class Order
+  {
+    Scanline,
+    Hilbert,    //Along a Hilbert curve over the grid of tiles
+    Spiral      //Outward from the centre tile
+  };
+
+  struct TileTime
+  {
+    double    start;      //ms from the start of the frame
+    double    duration;   //ms
+    unsigned  thread;
+    bool      stolen;
+  };
+
+  TileScheduler();
+  ~TileScheduler();
+
+  void SetOrder(Order);
+  Order GetOrder() const { return m_order; }
+  static char const * GetName(Order);
+
+  //! Calls a_fn with the row major index of every tile of an nTilesX by
+  //! nTilesY grid, on a_nThreads threads counting the calling one, and
+  //! returns once all are done.
+  void Run(int nTilesX, int nTilesY, unsigned nThreads, std::function<void(int tile)> const &);
+
+  //! Of the last Run(), indexed by tile.
+  std::vector<TileTime> const & GetTileTimes() const { return m_times; }
+
+  //! Busy time, tiles and steals per thread, and the slowest thread over
+  //! the mean.
+  void PrintStats() const;
+
+  //! Chrome trace-event file of the last Run() (chrome://tracing).
+  bool WriteTrace(std::string const & path) const;
+
+private:
+
+  TileScheduler(TileScheduler const &);
+  TileScheduler & operator=(TileScheduler const &);
+
+  void UpdateOrder(int nTilesX, int nTilesY);
+  void Distribute(unsigned nThreads);
+  void WorkerLoop(unsigned thread, uint64_t frame);
+  void Work(unsigned thread);
+  bool Steal(unsigned thread, int & tile);
+
+private:
+
+  Order                                     m_order;
+  std::vector<int>                          m_tiles;        //In m_order
+  int                                       m_nTilesX;
+  int                                       m_nTilesY;
+  std::vector<std::unique_ptr<TileDeque>>   m_deques;
+  std::vector<TileTime>                     m_times;
+  std::chrono::high_resolution_clock::time_point m_frameStart;
+
+  //Pool. Workers are thread 1 and up, the caller of Run() is thread 0.
+  std::vector<std::thread>                  m_workers;
+  std::mutex                                m_mutex;
+  std::condition_variable                   m_wake;
+  std::condition_variable                   m_finished;
+  std::function<void(int)> const *          m_job;
+  uint64_t                                  m_frame;
+  unsigned                                  m_nThreads;     //Of the current Run()
+  unsigned                                  m_nRunning;     //Workers not done with it
+  bool                                      m_quit;
+};
+
+#endif
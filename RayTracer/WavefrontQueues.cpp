@@ -0,0 +1,66 @@
+#include "WavefrontQueues.h"
+
+
+//--------------------------------------------------------------------------------
+//	@	WavefrontQueues
+//--------------------------------------------------------------------------------
+static GLuint CreateBuffer(GLsizeiptr a_size)
+{
+  GLuint id(0);
+  glGenBuffers(1, &id);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, id);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, a_size, nullptr, 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return id;
+}
+
+
+static void DeleteBuffer(GLuint & a_id)
+{
+  if (a_id != 0)
+  {
+    glDeleteBuffers(1, &a_id);
+  }
+  a_id = 0;
+}
+
+
+void WavefrontQueues::Init(unsigned a_nPixels)
+{
+  ShutDown();
+  GLsizeiptr nPixels = (a_nPixels > 0) ? a_nPixels : 1;
+  m_counters = CreateBuffer(sizeof(GPUWavefrontCounters));
+  m_rays = CreateBuffer(2 * nPixels * sizeof(GPUQueuedRay));
+  m_shadows = CreateBuffer(nPixels * sizeof(GPUQueuedRay));
+  m_radiance = CreateBuffer(nPixels * 4 * sizeof(float));
+  ResetCounters();
+}
+
+
+void WavefrontQueues::ShutDown()
+{
+  DeleteBuffer(m_counters);
+  DeleteBuffer(m_rays);
+  DeleteBuffer(m_shadows);
+  DeleteBuffer(m_radiance);
+}
+
+
+void WavefrontQueues::Bind() const
+{
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WAVEFRONT_BINDING_COUNTERS, m_counters);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WAVEFRONT_BINDING_RAYS, m_rays);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WAVEFRONT_BINDING_SHADOWS, m_shadows);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WAVEFRONT_BINDING_RADIANCE, m_radiance);
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_counters);
+}
+
+
+void WavefrontQueues::ResetCounters()
+{
+  //The last frame's passes write the counters from shaders. No data clears to zero.
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counters);
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,89 @@
+#ifndef WAVEFRONTQUEUES_H
+#define WAVEFRONTQUEUES_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//Shader storage binding points of the wavefront passes, must match raytracer_cs.glsl
+enum WavefrontBinding
+{
+  WAVEFRONT_BINDING_COUNTERS  = 15,
+  WAVEFRONT_BINDING_RAYS      = 16,
+  WAVEFRONT_BINDING_SHADOWS   = 17,
+  WAVEFRONT_BINDING_RADIANCE  = 18
+};
+
+//Work group size of the one dimensional passes
+#define WAVEFRONT_GROUP_SIZE 64
+
+//std430 layouts of the queue structs in raytracer_cs.glsl
+struct GPUQueuedRay
+{
+  float     origin[3];
+  int32_t   pixel;
+  float     direction[3];
+  float     tMax;
+  float     weight[4];
+};
+
+//The first three members are a DispatchIndirectCommand
+struct GPUDispatchArgs
+{
+  uint32_t  x;
+  uint32_t  y;
+  uint32_t  z;
+  uint32_t  count;
+};
+
+struct GPUWavefrontCounters
+{
+  GPUDispatchArgs shadowDispatch;
+  GPUDispatchArgs bounceDispatch;
+  uint32_t        rayCount[2];
+  uint32_t        shadowCount;
+  uint32_t        pad;
+};
+
+/*!
+ * @class WavefrontQueues
+ *
+ * @brief GPU only buffers linking the passes of a wavefront frame.
+ *
+ * Passes append the rays they spawn to a queue with an atomic counter. A
+ * one invocation pass then writes the counts into dispatch arguments, so
+ * the next pass is launched with glDispatchComputeIndirect over exactly
+ * the rays that are alive, without a read back.
+ */
+class WavefrontQueues
+{
+public:
+
+  WavefrontQueues() : m_counters(0)
+                    , m_rays(0)
+                    , m_shadows(0)
+                    , m_radiance(0) {}
+
+  //! Room for one ray per pixel in each queue.
+  void Init(unsigned nPixels);
+  void ShutDown();
+
+  //! Bind the queues to their WavefrontBinding points, and the counters as
+  //! the dispatch indirect buffer.
+  void Bind() const;
+
+  //! Empty all queues. Call before the primary pass.
+  void ResetCounters();
+
+  static GLintptr ShadowDispatchOffset() { return offsetof(GPUWavefrontCounters, shadowDispatch); }
+  static GLintptr BounceDispatchOffset() { return offsetof(GPUWavefrontCounters, bounceDispatch); }
+
+private:
+
+  GLuint    m_counters;
+  GLuint    m_rays;
+  GLuint    m_shadows;
+  GLuint    m_radiance;
+};
+
+#endif
@@ -0,0 +1,662 @@
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+#include "DgSIMD.h"
+#include "WideBVH.h"
+
+//A wide node takes the place of at least one binary level, and its
+//children replace it on the stack, so a traversal of a tree at most
+//BVH_STACK_SIZE levels deep holds at most (width - 1) entries per level.
+#define WIDE_BVH_MAX_WIDTH    8
+#define WIDE_BVH_STACK_SIZE   (BVH_STACK_SIZE * (WIDE_BVH_MAX_WIDTH - 1))
+#define WIDE_BVH_ALIGNMENT    64
+
+static_assert(sizeof(WideNode<4>) == 64, "WideNode<4> must fill one cache line");
+static_assert(sizeof(WideNode<8>) == 128, "WideNode<8> must fill two cache lines");
+
+//Same widening as the binary traversal, see s_slabFarScale in BVH.cpp
+static const float s_slabFarScale = 1.0f + 2.0f * 3.0f * FLT_EPSILON * 0.5f / (1.0f - 3.0f * FLT_EPSILON * 0.5f);
+
+
+//--------------------------------------------------------------------------------
+//	@	Building
+//--------------------------------------------------------------------------------
+
+//Levels in the binary tree under a_root, a single leaf being one
+static int GetDepth(std::vector<BVHNode> const & a_binary, int a_root)
+{
+  struct Entry
+  {
+    int node;
+    int depth;
+  };
+  std::vector<Entry> stack(1, Entry{a_root, 1});
+  int result = 0;
+  while (!stack.empty())
+  {
+    Entry entry = stack.back();
+    stack.pop_back();
+    result = std::max(result, entry.depth);
+
+    BVHNode const & node = a_binary[entry.node];
+    if (node.count == 0)
+    {
+      stack.push_back(Entry{entry.node + 1, entry.depth + 1});
+      stack.push_back(Entry{node.offset, entry.depth + 1});
+    }
+  }
+  return result;
+}
+
+
+//2^e for the exponents a node can hold, without going through ldexpf
+static float Exp2(int a_e)
+{
+  uint32_t bits = uint32_t(a_e + 127) << 23;
+  float result;
+  memcpy(&result, &bits, sizeof(float));
+  return result;
+}
+
+
+static Bounds GetNodeBounds(BVHNode const & a_node)
+{
+  Bounds bounds;
+  for (int i = 0; i < 3; i++)
+  {
+    bounds.min[i] = a_node.min[i];
+    bounds.max[i] = a_node.max[i];
+  }
+  return bounds;
+}
+
+
+//Picks the smallest power of two step that spans the parent in 255 steps,
+//then rounds each child outwards onto that grid. Steps are checked with
+//the same float expression traversal uses, so a decoded child always
+//contains the original.
+template<int W>
+static void Quantize(WideNode<W> & a_node, Bounds const & a_parent, Bounds const a_children[], int a_nChildren)
+{
+  for (int a = 0; a < 3; a++)
+  {
+    float origin = a_parent.min[a];
+    int e = 0;
+    frexpf((a_parent.max[a] - origin) / 255.0f, &e);
+    if (e < -126) e = -126;
+    while (e < 127 && origin + 255.0f * Exp2(e) < a_parent.max[a])
+    {
+      e++;
+    }
+    float scale = Exp2(e);
+
+    a_node.origin[a] = origin;
+    a_node.exponent[a] = int8_t(e);
+    for (int c = 0; c < a_nChildren; c++)
+    {
+      float lo = floorf((a_children[c].min[a] - origin) / scale);
+      float hi = ceilf((a_children[c].max[a] - origin) / scale);
+      int qlo = (lo < 0.0f) ? 0 : (lo > 255.0f) ? 255 : int(lo);
+      int qhi = (hi < 0.0f) ? 0 : (hi > 255.0f) ? 255 : int(hi);
+      while (qlo > 0 && origin + float(qlo) * scale > a_children[c].min[a])
+      {
+        qlo--;
+      }
+      while (qhi < 255 && origin + float(qhi) * scale < a_children[c].max[a])
+      {
+        qhi++;
+      }
+      a_node.lower[a][c] = uint8_t(qlo);
+      a_node.upper[a][c] = uint8_t(qhi);
+    }
+  }
+}
+
+
+//Fills the wide node at a_wideIndex from the binary subtree at a_binaryNode
+template<int W>
+static void CollapseNode(std::vector<BVHNode> const & a_binary, int a_binaryNode,
+                         std::vector<WideNode<W>> & a_nodes, int a_wideIndex)
+{
+  int children[W];
+  int nChildren = 0;
+  BVHNode const & root = a_binary[a_binaryNode];
+  if (root.count > 0)
+  {
+    //Only a tree that is a single leaf gets here
+    children[nChildren++] = a_binaryNode;
+  }
+  else
+  {
+    children[nChildren++] = a_binaryNode + 1;
+    children[nChildren++] = root.offset;
+  }
+
+  //Open up the largest interior child until the node is full
+  while (nChildren < W)
+  {
+    int best = -1;
+    float bestArea = -1.0f;
+    for (int i = 0; i < nChildren; i++)
+    {
+      BVHNode const & child = a_binary[children[i]];
+      if (child.count > 0)
+      {
+        continue;
+      }
+      float area = GetNodeBounds(child).SurfaceArea();
+      if (area > bestArea)
+      {
+        best = i;
+        bestArea = area;
+      }
+    }
+    if (best < 0)
+    {
+      break;
+    }
+    int open = children[best];
+    children[best] = open + 1;
+    children[nChildren++] = a_binary[open].offset;
+  }
+
+  Bounds bounds[W];
+  Bounds parent;
+  parent.Empty();
+  for (int i = 0; i < nChildren; i++)
+  {
+    bounds[i] = GetNodeBounds(a_binary[children[i]]);
+    parent.Grow(bounds[i]);
+  }
+
+  WideNode<W> node;
+  memset(&node, 0, sizeof(node));
+  node.nChildren = uint8_t(nChildren);
+  Quantize(node, parent, bounds, nChildren);
+
+  //Children of a node are stored next to each other
+  for (int i = 0; i < nChildren; i++)
+  {
+    BVHNode const & child = a_binary[children[i]];
+    if (child.count > 0)
+    {
+      node.child[i] = child.offset;
+      node.count[i] = uint8_t(child.count);
+    }
+    else
+    {
+      node.child[i] = int32_t(a_nodes.size());
+      a_nodes.push_back(WideNode<W>());
+    }
+  }
+  a_nodes[a_wideIndex] = node;
+
+  for (int i = 0; i < nChildren; i++)
+  {
+    if (node.count[i] == 0)
+    {
+      CollapseNode(a_binary, children[i], a_nodes, node.child[i]);
+    }
+  }
+}
+
+
+template<int W>
+static int Collapse(std::vector<BVHNode> const & a_binary, int a_root, std::vector<WideNode<W>> & a_nodes)
+{
+  int index = int(a_nodes.size());
+  a_nodes.push_back(WideNode<W>());
+  CollapseNode(a_binary, a_root, a_nodes, index);
+  return index;
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	WideBVH
+//--------------------------------------------------------------------------------
+WideBVH::~WideBVH()
+{
+  Clear();
+}
+
+
+void WideBVH::SetWidth(int a_width)
+{
+  static_assert(WIDE_BVH_MAX_WIDTH == 8, "SetWidth() picks 4 or 8 wide nodes");
+  m_width = (a_width == 8) ? 8 : 4;
+}
+
+
+void WideBVH::Clear()
+{
+  if (m_nodes != nullptr)
+  {
+    _mm_free(m_nodes);
+  }
+  m_nodes = nullptr;
+  m_nNodes = 0;
+  m_primitives.clear();
+  m_meshRoots.clear();
+  m_root = -1;
+}
+
+
+bool WideBVH::Build(BVH const & a_bvh)
+{
+  Clear();
+
+  std::vector<BVHNode> const & binary = a_bvh.GetNodes();
+  for (size_t i = 0; i < binary.size(); i++)
+  {
+    if (binary[i].count > 255)
+    {
+      printf("WideBVH: a leaf holds %i primitives, at most 255 fit in a wide node.\n", binary[i].count);
+      return false;
+    }
+  }
+
+  //A saved tree was not necessarily built with the current depth limit
+  std::vector<int32_t> roots = a_bvh.GetMeshRoots();
+  if (a_bvh.GetRoot() >= 0)
+  {
+    roots.push_back(a_bvh.GetRoot());
+  }
+  for (size_t i = 0; i < roots.size(); i++)
+  {
+    int depth = GetDepth(binary, roots[i]);
+    if (depth > BVH_STACK_SIZE)
+    {
+      printf("WideBVH: the BVH is %i levels deep, the traversal stack holds %i.\n", depth, BVH_STACK_SIZE);
+      return false;
+    }
+  }
+
+  if (m_width == 8)
+  {
+    BuildWide<8>(a_bvh);
+  }
+  else
+  {
+    BuildWide<4>(a_bvh);
+  }
+  m_primitives = a_bvh.GetPrimitives();
+  return true;
+}
+
+
+template<int W>
+void WideBVH::BuildWide(BVH const & a_bvh)
+{
+  std::vector<BVHNode> const & binary = a_bvh.GetNodes();
+  std::vector<WideNode<W>> nodes;
+  nodes.reserve(binary.size() / (W - 1) + 1);
+
+  std::vector<int32_t> const & meshRoots = a_bvh.GetMeshRoots();
+  m_meshRoots.resize(meshRoots.size());
+  for (size_t i = 0; i < meshRoots.size(); i++)
+  {
+    m_meshRoots[i] = Collapse(binary, meshRoots[i], nodes);
+  }
+  m_root = (a_bvh.GetRoot() >= 0) ? Collapse(binary, a_bvh.GetRoot(), nodes) : -1;
+
+  if (nodes.empty())
+  {
+    return;
+  }
+  m_nNodes = nodes.size();
+  m_nodes = static_cast<uint8_t *>(_mm_malloc(m_nNodes * sizeof(WideNode<W>), WIDE_BVH_ALIGNMENT));
+  memcpy(m_nodes, &nodes[0], m_nNodes * sizeof(WideNode<W>));
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	Child tests
+//--------------------------------------------------------------------------------
+
+//Everything about the ray a node test needs, broadcast where there is SIMD
+struct WideRay
+{
+  float origin[3];
+  float invDir[3];
+#ifdef DG_SSE
+  __m128 origin4[3];
+  __m128 invDir4[3];
+#endif
+#ifdef DG_AVX
+  __m256 origin8[3];
+  __m256 invDir8[3];
+#endif
+};
+
+
+static void SetupWideRay(Ray const & a_ray, WideRay & a_out)
+{
+  for (int a = 0; a < 3; a++)
+  {
+    a_out.origin[a] = a_ray.origin[a];
+    a_out.invDir[a] = 1.0f / a_ray.direction[a];
+#ifdef DG_SSE
+    a_out.origin4[a] = _mm_set1_ps(a_out.origin[a]);
+    a_out.invDir4[a] = _mm_set1_ps(a_out.invDir[a]);
+#endif
+#ifdef DG_AVX
+    a_out.origin8[a] = _mm256_set1_ps(a_out.origin[a]);
+    a_out.invDir8[a] = _mm256_set1_ps(a_out.invDir[a]);
+#endif
+  }
+}
+
+
+//Slab test of a_nLanes children starting at a_first, one at a time.
+//Returns a bit per child hit.
+template<int W>
+static int IntersectLanesScalar(WideNode<W> const & a_node, int a_first, int a_nLanes,
+                                WideRay const & a_ray, float a_tMax, float * a_tNear)
+{
+  int mask = 0;
+  for (int c = a_first; c < a_first + a_nLanes; c++)
+  {
+    float tNear = -FLT_MAX;
+    float tFar = FLT_MAX;
+    for (int a = 0; a < 3; a++)
+    {
+      float scale = Exp2(a_node.exponent[a]);
+      float lo = a_node.origin[a] + float(a_node.lower[a][c]) * scale;
+      float hi = a_node.origin[a] + float(a_node.upper[a][c]) * scale;
+      float t0 = (lo - a_ray.origin[a]) * a_ray.invDir[a];
+      float t1 = (hi - a_ray.origin[a]) * a_ray.invDir[a];
+      if (t0 > t1) std::swap(t0, t1);
+      if (t0 > tNear) tNear = t0;
+      if (t1 < tFar) tFar = t1;
+    }
+    tFar *= s_slabFarScale;
+    a_tNear[c] = tNear;
+    if (tNear <= tFar && tFar >= 0.0f && tNear < a_tMax)
+    {
+      mask |= 1 << c;
+    }
+  }
+  return mask;
+}
+
+
+#ifdef DG_SSE
+
+//4 quantized bounds to floats
+static __m128 LoadLanes4(uint8_t const * a_bytes)
+{
+  int32_t packed;
+  memcpy(&packed, a_bytes, sizeof(packed));
+  __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+
+
+template<int W>
+static int IntersectLanesSSE(WideNode<W> const & a_node, int a_first,
+                             WideRay const & a_ray, float a_tMax, float * a_tNear)
+{
+  __m128 tNear = _mm_set1_ps(-FLT_MAX);
+  __m128 tFar = _mm_set1_ps(FLT_MAX);
+  for (int a = 0; a < 3; a++)
+  {
+    __m128 origin = _mm_set1_ps(a_node.origin[a]);
+    __m128 scale = _mm_set1_ps(Exp2(a_node.exponent[a]));
+    __m128 lo = _mm_add_ps(origin, _mm_mul_ps(LoadLanes4(&a_node.lower[a][a_first]), scale));
+    __m128 hi = _mm_add_ps(origin, _mm_mul_ps(LoadLanes4(&a_node.upper[a][a_first]), scale));
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(lo, a_ray.origin4[a]), a_ray.invDir4[a]);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(hi, a_ray.origin4[a]), a_ray.invDir4[a]);
+
+    //With NaN in either operand min and max return the second, so 0 * inf
+    //on an axis leaves the interval as it was, like the scalar test
+    tNear = _mm_max_ps(_mm_min_ps(t0, t1), tNear);
+    tFar = _mm_min_ps(_mm_max_ps(t0, t1), tFar);
+  }
+  tFar = _mm_mul_ps(tFar, _mm_set1_ps(s_slabFarScale));
+
+  __m128 hit = _mm_and_ps(_mm_cmple_ps(tNear, tFar),
+               _mm_and_ps(_mm_cmpge_ps(tFar, _mm_setzero_ps()),
+                          _mm_cmplt_ps(tNear, _mm_set1_ps(a_tMax))));
+  _mm_storeu_ps(a_tNear + a_first, tNear);
+  return _mm_movemask_ps(hit) << a_first;
+}
+
+#endif
+
+
+#ifdef DG_AVX
+
+static __m256 LoadLanes8(uint8_t const * a_bytes)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(a_bytes)), zero);
+  __m256i lanes = _mm256_insertf128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(v, zero)),
+                                          _mm_unpackhi_epi16(v, zero), 1);
+  return _mm256_cvtepi32_ps(lanes);
+}
+
+
+static int IntersectLanesAVX(WideNode<8> const & a_node, WideRay const & a_ray, float a_tMax, float * a_tNear)
+{
+  __m256 tNear = _mm256_set1_ps(-FLT_MAX);
+  __m256 tFar = _mm256_set1_ps(FLT_MAX);
+  for (int a = 0; a < 3; a++)
+  {
+    __m256 origin = _mm256_set1_ps(a_node.origin[a]);
+    __m256 scale = _mm256_set1_ps(Exp2(a_node.exponent[a]));
+    __m256 lo = _mm256_add_ps(origin, _mm256_mul_ps(LoadLanes8(a_node.lower[a]), scale));
+    __m256 hi = _mm256_add_ps(origin, _mm256_mul_ps(LoadLanes8(a_node.upper[a]), scale));
+    __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(lo, a_ray.origin8[a]), a_ray.invDir8[a]);
+    __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(hi, a_ray.origin8[a]), a_ray.invDir8[a]);
+    tNear = _mm256_max_ps(_mm256_min_ps(t0, t1), tNear);
+    tFar = _mm256_min_ps(_mm256_max_ps(t0, t1), tFar);
+  }
+  tFar = _mm256_mul_ps(tFar, _mm256_set1_ps(s_slabFarScale));
+
+  __m256 hit = _mm256_and_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ),
+               _mm256_and_ps(_mm256_cmp_ps(tFar, _mm256_setzero_ps(), _CMP_GE_OQ),
+                             _mm256_cmp_ps(tNear, _mm256_set1_ps(a_tMax), _CMP_LT_OQ)));
+  _mm256_storeu_ps(a_tNear, tNear);
+  return _mm256_movemask_ps(hit);
+}
+
+#endif
+
+
+static int IntersectChildren(WideNode<4> const & a_node, WideRay const & a_ray, float a_tMax, float a_tNear[4])
+{
+#ifdef DG_SSE
+  int mask = IntersectLanesSSE(a_node, 0, a_ray, a_tMax, a_tNear);
+#else
+  int mask = IntersectLanesScalar(a_node, 0, 4, a_ray, a_tMax, a_tNear);
+#endif
+  return mask & ((1 << a_node.nChildren) - 1);
+}
+
+
+static int IntersectChildren(WideNode<8> const & a_node, WideRay const & a_ray, float a_tMax, float a_tNear[8])
+{
+#if defined(DG_AVX)
+  int mask = IntersectLanesAVX(a_node, a_ray, a_tMax, a_tNear);
+#elif defined(DG_SSE)
+  int mask = IntersectLanesSSE(a_node, 0, a_ray, a_tMax, a_tNear);
+  if (a_node.nChildren > 4)
+  {
+    mask |= IntersectLanesSSE(a_node, 4, a_ray, a_tMax, a_tNear);
+  }
+#else
+  int mask = IntersectLanesScalar(a_node, 0, a_node.nChildren, a_ray, a_tMax, a_tNear);
+#endif
+  return mask & ((1 << a_node.nChildren) - 1);
+}
+
+
+//--------------------------------------------------------------------------------
+//	@	WideBVH::Intersect()
+//--------------------------------------------------------------------------------
+void WideBVH::Intersect(Ray const & a_ray, Scene const & a_scene, HitInfo & a_info, RayCost * a_cost) const
+{
+  if (m_root < 0)
+  {
+    return;
+  }
+
+  TriangleRay triangleRay;
+  if (!m_meshRoots.empty())
+  {
+    SetupTriangleRay(a_ray, triangleRay);
+  }
+
+  if (m_width == 8)
+  {
+    IntersectTree<8>(m_root, -1, a_ray, triangleRay, a_scene, a_info, a_cost);
+  }
+  else
+  {
+    IntersectTree<4>(m_root, -1, a_ray, triangleRay, a_scene, a_info, a_cost);
+  }
+}
+
+
+template<int W>
+void WideBVH::IntersectInstance(int a_instance, Ray const & a_ray, Scene const & a_scene, HitInfo & a_info, RayCost * a_cost) const
+{
+  Instance const & instance = a_scene.GetInstances()[a_instance];
+  Ray ray = ToObjectSpace(instance, a_ray);
+
+  TriangleRay triangleRay;
+  SetupTriangleRay(ray, triangleRay);
+
+  HitInfo hit(a_info);
+  hit.type = TYPE_NULL;
+  IntersectTree<W>(m_meshRoots[instance.mesh], int(instance.mesh), ray, triangleRay, a_scene, hit, a_cost);
+
+  if (hit.type != TYPE_NULL)
+  {
+    a_info.type = TYPE_INSTANCE;
+    a_info.t = hit.t;
+    a_info.index = a_instance;
+    a_info.triangle = hit.triangle;
+  }
+}
+
+
+template<int W>
+void WideBVH::IntersectTree(int a_root, int a_mesh,
+                            Ray const & a_ray, TriangleRay const & a_triangleRay,
+                            Scene const & a_scene, HitInfo & a_info, RayCost * a_cost) const
+{
+  WideNode<W> const * nodes = reinterpret_cast<WideNode<W> const *>(m_nodes);
+
+  WideRay ray;
+  SetupWideRay(a_ray, ray);
+
+  //Entries are wide nodes or leaves, with the distance they were hit at so
+  //anything beyond a closer hit found since is skipped
+  struct Entry
+  {
+    int32_t index;
+    int32_t count;
+    float   tNear;
+  };
+  Entry stack[WIDE_BVH_STACK_SIZE];
+  int stackSize = 0;
+  Entry root = {a_root, 0, -FLT_MAX};
+  stack[stackSize++] = root;
+
+  while (stackSize > 0)
+  {
+    Entry entry = stack[--stackSize];
+    if (entry.tNear >= a_info.t)
+    {
+      continue;
+    }
+
+    if (entry.count > 0)
+    {
+      for (int i = entry.index; i < entry.index + entry.count; i++)
+      {
+        BVHPrimitive const & prim = m_primitives[i];
+
+        if (prim.type == TYPE_MESH)
+        {
+          IntersectTree<W>(m_meshRoots[prim.index], prim.index, a_ray, a_triangleRay, a_scene, a_info, a_cost);
+          continue;
+        }
+
+        if (prim.type == TYPE_INSTANCE)
+        {
+          IntersectInstance<W>(prim.index, a_ray, a_scene, a_info, a_cost);
+          continue;
+        }
+
+        if (a_cost) a_cost->primitives++;
+
+        if (prim.type == TYPE_TRIANGLE)
+        {
+          Mesh const & mesh = a_scene.GetMeshes()[a_mesh];
+          real t = IntersectTriangle(a_triangleRay,
+                                     a_scene.GetTriangleVertex(mesh, prim.index, 0),
+                                     a_scene.GetTriangleVertex(mesh, prim.index, 1),
+                                     a_scene.GetTriangleVertex(mesh, prim.index, 2));
+          if (t < a_info.t)
+          {
+            a_info.type = TYPE_MESH;
+            a_info.t = t;
+            a_info.index = a_mesh;
+            a_info.triangle = prim.index;
+          }
+          continue;
+        }
+
+        real t = IntersectPrimitive(a_ray, a_scene, prim.type, prim.index);
+        if (t < a_info.t)
+        {
+          a_info.type = prim.type;
+          a_info.t = t;
+          a_info.index = prim.index;
+          a_info.triangle = -1;
+        }
+      }
+      continue;
+    }
+
+    WideNode<W> const & node = nodes[entry.index];
+    if (a_cost) a_cost->nodes++;
+    float tNear[W];
+    int mask = IntersectChildren(node, ray, a_info.t, tNear);
+
+    //Sort the children hit far to near, so the nearest is popped next
+    int order[W];
+    int nHits = 0;
+    for (int c = 0; c < W; c++)
+    {
+      if ((mask & (1 << c)) == 0)
+      {
+        continue;
+      }
+      int i = nHits++;
+      while (i > 0 && tNear[order[i - 1]] < tNear[c])
+      {
+        order[i] = order[i - 1];
+        i--;
+      }
+      order[i] = c;
+    }
+
+    //Build() only accepts trees shallow enough for this to hold
+    assert(stackSize + nHits <= WIDE_BVH_STACK_SIZE);
+    for (int i = 0; i < nHits; i++)
+    {
+      int c = order[i];
+      Entry child = {node.child[c], node.count[c], tNear[c]};
+      stack[stackSize++] = child;
+    }
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef WIDEBVH_H
+#define WIDEBVH_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "BVH.h"
+
+//! Node of a W-ary BVH, shared with raytracer_cs.glsl when built with
+//! WIDE_BVH. Child bounds are 8 bit offsets from 'origin' in steps of
+//! 2^exponent per axis, rounded outwards. The lanes of each axis are
+//! contiguous so a SIMD register loads one axis of every child at once.
+//! A BVH4 node is 64 bytes and a BVH8 node 128, one or two cache lines.
+template<int W>
+struct WideNode
+{
+  float     origin[3];
+  int8_t    exponent[3];
+  uint8_t   nChildren;
+  uint8_t   lower[3][W];
+  uint8_t   upper[3][W];
+  int32_t   child[W];     //Interior: wide node index. Leaf: first primitive.
+  uint8_t   count[W];     //Primitives of a leaf, 0 for interior children
+  uint8_t   pad[(W == 4) ? 4 : 24];
+};
+
+/*!
+ * @class WideBVH
+ *
+ * @brief 4 or 8 wide copy of a BVH with quantized child bounds.
+ *
+ * Built by collapsing the binary hierarchies of a BVH: starting from two
+ * children, the interior child with the largest surface area is replaced by
+ * its own children until the node is full. Leaves keep their primitive
+ * ranges, so the primitive list is the BVH's, copied as is.
+ *
+ * A node is intersected against all of its children at once, with SSE for
+ * BVH4 and AVX for BVH8 where the target has it. This trades a few more
+ * box tests per ray for far fewer nodes fetched, which pays off once the
+ * hierarchy no longer fits in cache.
+ */
+class WideBVH
+{
+public:
+
+  WideBVH() : m_width(4)
+            , m_nodes(nullptr)
+            , m_nNodes(0)
+            , m_root(-1) {}
+
+  ~WideBVH();
+
+  //! 4 or 8 children per node. Takes effect on the next Build().
+  void SetWidth(int);
+  int GetWidth() const { return m_width; }
+
+  //! Collapses every hierarchy of the BVH. Must be rebuilt whenever the BVH
+  //! changes, including refits. Fails if a leaf holds more than 255
+  //! primitives.
+  bool Build(BVH const &);
+  void Clear();
+
+  //! Closest hit against the scene the BVH was built from. Counts into
+  //! a_cost like BVH::Intersect(), a wide node as one node.
+  void Intersect(Ray const &, Scene const &, HitInfo &, RayCost * cost = nullptr) const;
+
+  //! Nodes as bytes, GetNodeSize() each, 64 byte aligned.
+  uint8_t const * GetNodes() const { return m_nodes; }
+  size_t GetNodeCount() const { return m_nNodes; }
+  size_t GetNodeSize() const { return size_t(m_width) * 16; }
+
+  std::vector<BVHPrimitive> const & GetPrimitives() const { return m_primitives; }
+  std::vector<int32_t> const & GetMeshRoots() const { return m_meshRoots; }
+
+  //! Root node of the top level, -1 if the scene is empty.
+  int GetRoot() const { return m_root; }
+
+private:
+
+  WideBVH(WideBVH const &);
+  WideBVH & operator=(WideBVH const &);
+
+  template<int W> void BuildWide(BVH const &);
+  template<int W> void IntersectTree(int root, int mesh,
+                                     Ray const &, TriangleRay const &,
+                                     Scene const &, HitInfo &, RayCost *) const;
+  template<int W> void IntersectInstance(int instance, Ray const &, Scene const &, HitInfo &, RayCost *) const;
+
+private:
+
+  int                             m_width;
+
+  //Aligned to a cache line, which std::vector does not guarantee
+  uint8_t *                       m_nodes;
+  size_t                          m_nNodes;
+  std::vector<BVHPrimitive>       m_primitives;
+  std::vector<int32_t>            m_meshRoots;
+  int                             m_root;
+};
+
+#endif
@@ -0,0 +1,418 @@
+#version 430
+
+// Linear BVH build over the top level of the scene, the compute shader
+// counterpart of LBVHBuilder. Each pass is compiled separately by defining
+// one of PASS_MORTON, PASS_HISTOGRAM, PASS_SCAN, PASS_SCATTER, PASS_EMIT,
+// PASS_BOUNDS or PASS_LAYOUT, see GPUBVHBuilder::Build() for the order.
+// Codes are 30 bit and leaves hold a single primitive, so the tree written
+// out has 2n - 1 nodes.
+
+#ifndef LBVH_GROUP_SIZE
+#define LBVH_GROUP_SIZE 256
+#endif
+
+// Digits of the radix sort, 4 bits per pass
+#define RADIX_SIZE 16u
+
+layout(local_size_x = LBVH_GROUP_SIZE) in;
+
+struct Bounds
+{
+  vec3  min;
+  float pad0;
+  vec3  max;
+  float pad1;
+};
+
+struct BVHNode
+{
+  vec3  min;
+  int   offset;
+  vec3  max;
+  int   count;
+};
+
+struct BVHPrimitive
+{
+  int   type;
+  int   index;
+};
+
+// Nodes are numbered with the n - 1 interior nodes first, then the n
+// leaves. left and right use that numbering, first and last are the range
+// of sorted primitives below the node.
+struct RadixNode
+{
+  int   left;
+  int   right;
+  int   first;
+  int   last;
+};
+
+// Output, shared with raytracer_cs.glsl
+layout(std430, binding = 1) writeonly buffer BVHNodes
+{
+  BVHNode nodes[];
+};
+
+layout(std430, binding = 2) writeonly buffer BVHPrimitives
+{
+  BVHPrimitive primitives[];
+};
+
+layout(std430, binding = 20) readonly buffer InputBounds
+{
+  Bounds inputBounds[];
+};
+
+layout(std430, binding = 21) readonly buffer InputPrimitives
+{
+  BVHPrimitive inputPrimitives[];
+};
+
+// Sort ping-pongs between the two pairs of key and value buffers
+layout(std430, binding = 22) buffer Keys
+{
+  uint keys[];
+};
+
+layout(std430, binding = 23) buffer Values
+{
+  uint values[];
+};
+
+layout(std430, binding = 24) writeonly buffer KeysOut
+{
+  uint keysOut[];
+};
+
+layout(std430, binding = 25) writeonly buffer ValuesOut
+{
+  uint valuesOut[];
+};
+
+// Digit counts of each work group, digit major
+layout(std430, binding = 26) buffer Histogram
+{
+  uint histogram[];
+};
+
+layout(std430, binding = 27) buffer Interior
+{
+  RadixNode interior[];
+};
+
+layout(std430, binding = 28) buffer Parents
+{
+  int parents[];
+};
+
+layout(std430, binding = 29) coherent buffer NodeBounds
+{
+  Bounds nodeBounds[];
+};
+
+layout(std430, binding = 30) coherent buffer Visits
+{
+  uint visits[];
+};
+
+uniform uint count;           // Primitives
+uniform vec3 centroidMin;
+uniform vec3 centroidScale;   // 1 / extent of the centroid bounds, 0 on flat axes
+uniform uint shift;           // Lowest bit of the digit being sorted
+uniform uint blockCount;      // Work groups of the histogram and scatter passes
+uniform uint firstNode;
+uniform uint firstPrimitive;
+
+// Spreads the low 10 bits to every third bit
+uint ExpandBits(uint v)
+{
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+// Length of the common prefix of the codes at i and j, -1 outside the
+// array. Equal codes are told apart by their index.
+int Delta(int i, int j)
+{
+  if (j < 0 || j >= int(count))
+  {
+    return -1;
+  }
+  uint a = keys[i];
+  uint b = keys[j];
+  if (a == b)
+  {
+    return 32 + 31 - findMSB(uint(i ^ j));
+  }
+  return 31 - findMSB(a ^ b);
+}
+
+#if defined(PASS_MORTON)
+
+void main()
+{
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= count)
+  {
+    return;
+  }
+
+  vec3 centroid = 0.5 * (inputBounds[i].min + inputBounds[i].max);
+  uvec3 cell = uvec3(clamp((centroid - centroidMin) * centroidScale * 1024.0, 0.0, 1023.0));
+  keys[i] = (ExpandBits(cell.x) << 2) | (ExpandBits(cell.y) << 1) | ExpandBits(cell.z);
+  values[i] = i;
+}
+
+#elif defined(PASS_HISTOGRAM)
+
+shared uint localCounts[RADIX_SIZE];
+
+void main()
+{
+  uint lid = gl_LocalInvocationIndex;
+  if (lid < RADIX_SIZE)
+  {
+    localCounts[lid] = 0u;
+  }
+  barrier();
+
+  uint i = gl_GlobalInvocationID.x;
+  if (i < count)
+  {
+    atomicAdd(localCounts[(keys[i] >> shift) & (RADIX_SIZE - 1)], 1u);
+  }
+  barrier();
+
+  if (lid < RADIX_SIZE)
+  {
+    histogram[lid * blockCount + gl_WorkGroupID.x] = localCounts[lid];
+  }
+}
+
+#elif defined(PASS_SCAN)
+
+// One work group. Each invocation sums a run of the histogram, the sums
+// are scanned in shared memory, then each run is rewritten as offsets.
+shared uint partial[LBVH_GROUP_SIZE];
+
+void main()
+{
+  uint lid = gl_LocalInvocationIndex;
+  uint total = RADIX_SIZE * blockCount;
+  uint perInvocation = (total + LBVH_GROUP_SIZE - 1) / LBVH_GROUP_SIZE;
+  uint first = min(lid * perInvocation, total);
+  uint last = min(first + perInvocation, total);
+
+  uint sum = 0u;
+  for (uint i = first; i < last; i++)
+  {
+    sum += histogram[i];
+  }
+  partial[lid] = sum;
+  barrier();
+
+  for (uint offset = 1u; offset < LBVH_GROUP_SIZE; offset *= 2u)
+  {
+    uint v = (lid >= offset) ? partial[lid - offset] : 0u;
+    barrier();
+    partial[lid] += v;
+    barrier();
+  }
+
+  uint running = partial[lid] - sum;
+  for (uint i = first; i < last; i++)
+  {
+    uint c = histogram[i];
+    histogram[i] = running;
+    running += c;
+  }
+}
+
+#elif defined(PASS_SCATTER)
+
+shared uint localDigits[LBVH_GROUP_SIZE];
+
+void main()
+{
+  uint lid = gl_LocalInvocationIndex;
+  uint i = gl_GlobalInvocationID.x;
+
+  // Past the end the digit matches nothing
+  uint key = 0u;
+  uint digit = RADIX_SIZE;
+  if (i < count)
+  {
+    key = keys[i];
+    digit = (key >> shift) & (RADIX_SIZE - 1);
+  }
+  localDigits[lid] = digit;
+  barrier();
+
+  if (i >= count)
+  {
+    return;
+  }
+
+  // Keys earlier in the group with the same digit go first, keeping the
+  // sort stable
+  uint rank = 0u;
+  for (uint j = 0u; j < lid; j++)
+  {
+    if (localDigits[j] == digit)
+    {
+      rank++;
+    }
+  }
+
+  uint dst = histogram[digit * blockCount + gl_WorkGroupID.x] + rank;
+  keysOut[dst] = key;
+  valuesOut[dst] = values[i];
+}
+
+#elif defined(PASS_EMIT)
+
+// Karras 2012: the range and split of each interior node follow from the
+// sorted codes alone.
+void main()
+{
+  int i = int(gl_GlobalInvocationID.x);
+  int n = int(count);
+  if (i >= n - 1)
+  {
+    return;
+  }
+
+  int d = (Delta(i, i + 1) - Delta(i, i - 1)) >= 0 ? 1 : -1;
+
+  int deltaMin = Delta(i, i - d);
+  int lengthMax = 2;
+  while (Delta(i, i + lengthMax * d) > deltaMin)
+  {
+    lengthMax *= 2;
+  }
+  int len = 0;
+  for (int t = lengthMax / 2; t >= 1; t /= 2)
+  {
+    if (Delta(i, i + (len + t) * d) > deltaMin)
+    {
+      len += t;
+    }
+  }
+  int j = i + len * d;
+
+  int deltaNode = Delta(i, j);
+  int split = 0;
+  int t = len;
+  do
+  {
+    t = (t + 1) / 2;
+    if (Delta(i, i + (split + t) * d) > deltaNode)
+    {
+      split += t;
+    }
+  } while (t > 1);
+  int gamma = i + split * d + min(d, 0);
+
+  RadixNode node;
+  node.first = min(i, j);
+  node.last = max(i, j);
+  node.left = (node.first == gamma) ? (n - 1) + gamma : gamma;
+  node.right = (node.last == gamma + 1) ? (n - 1) + gamma + 1 : gamma + 1;
+  interior[i] = node;
+
+  parents[node.left] = i;
+  parents[node.right] = i;
+  visits[i] = 0u;
+}
+
+#elif defined(PASS_BOUNDS)
+
+// Each leaf walks towards the root. The second invocation to reach a node
+// has both children and finishes it, the first stops there.
+void main()
+{
+  int k = int(gl_GlobalInvocationID.x);
+  int n = int(count);
+  if (k >= n)
+  {
+    return;
+  }
+
+  int node = (n - 1) + k;
+  nodeBounds[node] = inputBounds[values[k]];
+  memoryBarrierBuffer();
+
+  // Node 0 is the root, an interior node or the only leaf
+  while (node != 0)
+  {
+    node = parents[node];
+    if (atomicAdd(visits[node], 1u) == 0u)
+    {
+      return;
+    }
+
+    Bounds left = nodeBounds[interior[node].left];
+    Bounds right = nodeBounds[interior[node].right];
+    Bounds bounds;
+    bounds.min = min(left.min, right.min);
+    bounds.max = max(left.max, right.max);
+    bounds.pad0 = 0.0;
+    bounds.pad1 = 0.0;
+    nodeBounds[node] = bounds;
+    memoryBarrierBuffer();
+  }
+}
+
+#elif defined(PASS_LAYOUT)
+
+// With one primitive per leaf a subtree over k primitives has 2k - 1
+// nodes, so the depth first position of a node is twice the first
+// primitive below it plus the number of ancestors it is a left child of.
+void main()
+{
+  int node = int(gl_GlobalInvocationID.x);
+  int n = int(count);
+  if (node >= 2 * n - 1)
+  {
+    return;
+  }
+
+  int first = (node < n - 1) ? interior[node].first : node - (n - 1);
+  int lefts = 0;
+  for (int child = node; child != 0;)
+  {
+    int parent = parents[child];
+    if (interior[parent].left == child)
+    {
+      lefts++;
+    }
+    child = parent;
+  }
+  int position = 2 * first + lefts;
+
+  BVHNode result;
+  result.min = nodeBounds[node].min;
+  result.max = nodeBounds[node].max;
+  if (node < n - 1)
+  {
+    RadixNode r = interior[node];
+    int gamma = (r.left >= n - 1) ? r.left - (n - 1) : r.left;
+    result.offset = int(firstNode) + position + 2 * (gamma - r.first + 1);
+    result.count = 0;
+  }
+  else
+  {
+    int k = node - (n - 1);
+    result.offset = int(firstPrimitive) + k;
+    result.count = 1;
+    primitives[int(firstPrimitive) + k] = inputPrimitives[values[k]];
+  }
+  nodes[int(firstNode) + position] = result;
+}
+
+#endif
@@ -1,8 +1,612 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
 
 #include "Application.h"
+#include "BatchRender.h"
+#include "Benchmark.h"
+#include "BVH.h"
+#include "BVHResource.h"
+#include "Camera.h"
+#include "CostImage.h"
+#include "CPUTracer.h"
+#include "Framebuffer.h"
+#include "MeshLoader.h"
+#include "Reprojector.h"
+#include "ResolutionScaler.h"
+#include "scene.h"
+#include "SceneFile.h"
 
-int main()
+struct Options
 {
-  Application::GetInstance()->Run();
+  bool        cpu;
+  bool        gpuBuild;
+  bool        headless;
+  std::string output;
+  std::string batchFile;
+  int         width;
+  int         height;
+  unsigned    threads;
+  int         workGroupX;
+  int         workGroupY;
+  std::string traceFile;
+  unsigned    benchRays;
+  unsigned    benchMath;
+  unsigned    benchRNG;
+  unsigned    benchBuild;
+  unsigned    benchWide;
+  unsigned    benchPacket;
+  unsigned    benchSort;
+  unsigned    samples;
+  unsigned    reflections;
+  unsigned    instances;
+  BVH::Builder builder;
+  int         bvhWidth;
+  std::string packets;
+  bool        wavefront;
+  bool        sortRays;
+  TileScheduler::Order tileOrder;
+  int         tileSize;
+  std::string tileTrace;
+  std::string costMap;
+  double      budget;
+  bool        reproject;
+  ResolutionScaler::Filter upscale;
+  std::string sceneFile;
+  bool        bvhCache;
+  std::string convert;
+  std::vector<std::string> meshes;
+};
+
+
+static void PrintUsage()
+{
+  printf("Usage: RayTracer [-cpu] [-headless <out.ppm>] [-batch <job.txt>] [-size <w> <h>] [-threads <n>] [-workgroup <x> <y>] [-trace <file.json>] [-spp <n>] [-bounces <n>] [-bench <rays>] [-benchmath <count>] [-benchrng <count>] [-benchbuild <triangles>] [-benchwide <triangles>] [-benchpacket <triangles>] [-benchsort <triangles>] [-builder <sah|lbvh|lbvh63>] [-width <2|4|8>] [-packets <off|sse|avx2|avx512>] [-wavefront] [-sortrays] [-tiles <scanline|hilbert|spiral>] [-tilesize <n>] [-tiletrace <file.json>] [-costmap <prefix>] [-budget <ms>] [-upscale <bilinear|edge>] [-reproject] [-gpubuild] [-mesh <file>]... [-instances <n>] [-scene <file.rtscene>] [-convert <out.rtscene>] [-nobvhcache]\n");
+  printf("  -cpu       Trace on the CPU instead of the compute shader.\n");
+  printf("  -headless  Render one frame on the CPU without a window and write it to disk.\n");
+  printf("  -batch     Render the frames of a job file on the CPU without a window, see BatchRender.h.\n");
+  printf("  -size      Image size for headless renders. Default 800 600.\n");
+  printf("  -threads   Worker threads for the CPU tracer. Default is one per core.\n");
+  printf("  -spp       Samples per pixel for headless renders. Default 1.\n");
+  printf("  -bounces   Reflection bounces after the primary hit. Default %i.\n", NUM_REFLECTIONS);
+  printf("  -workgroup Compute shader work group shape. Default picks the fastest on startup.\n");
+  printf("  -trace     Write a Chrome trace-event file of every frame stage on exit.\n");
+  printf("  -bench     Time each primitive intersection routine against <rays> random rays.\n");
+  printf("  -benchmath Time the SIMD Vector4 and Matrix44 operations against the scalar template.\n");
+  printf("  -benchrng  Time the random number generators, and their scaling over threads.\n");
+  printf("  -benchbuild Compare build and trace times of the BVH builders over random triangles.\n");
+  printf("  -benchwide Compare BVH4 and BVH8 against the binary BVH over random triangles.\n");
+  printf("  -benchpacket Compare packet traversal on each instruction set against single rays.\n");
+  printf("  -benchsort Compare tracing the wavefront queues of secondary rays with and without sorting.\n");
+  printf("  -builder   BVH builder, binned SAH or linear with 30 or 63 bit Morton codes. Default sah.\n");
+  printf("  -width     Children per BVH node. 4 and 8 use quantized bounds. Default 2.\n");
+  printf("  -packets   Primary ray packets for headless renders. Default is the widest the CPU runs.\n");
+  printf("  -wavefront Trace headless renders pass by pass through ray queues, like the compute shader.\n");
+  printf("  -sortrays  Sort queued shadow and reflection rays by origin cell and direction before tracing.\n");
+  printf("  -tiles     Order the CPU tracer hands out tiles in. Default hilbert.\n");
+  printf("  -tilesize  Tile edge in pixels for the CPU tracer. Default 16.\n");
+  printf("  -tiletrace Write a Chrome trace-event file of the tiles of a headless render, and print how they were spread over threads.\n");
+  printf("  -costmap   Write heatmaps of the nodes, primitives, bounces and rays of each pixel of a headless render.\n");
+  printf("  -budget    Shrink the traced image of the window to trace each frame in about <ms> milliseconds.\n");
+  printf("  -upscale   How a shrunk image is stretched over the window. Default bilinear.\n");
+  printf("  -reproject Carry the shading of each frame over to the next on the CPU, and only trace what is new or stale.\n");
+  printf("  -gpubuild  Build the top level BVH with compute shaders instead of on the CPU.\n");
+  printf("  -mesh      Add an OBJ or PLY mesh to the scene. May be given more than once.\n");
+  printf("  -instances Scatter <n> instances of the last mesh below the scene.\n");
+  printf("  -scene     Load a binary scene file instead of the default scene.\n");
+  printf("  -convert   Write the default scene, meshes, instances and BVH to a binary scene file.\n");
+  printf("  -nobvhcache Always build the BVH instead of caching it next to the last mesh file.\n");
+}
+
+
+static bool ParseOptions(int argc, char ** argv, Options & a_opts)
+{
+  a_opts.cpu = false;
+  a_opts.gpuBuild = false;
+  a_opts.headless = false;
+  a_opts.width = 800;
+  a_opts.height = 600;
+  a_opts.threads = 0;
+  a_opts.workGroupX = 0;
+  a_opts.workGroupY = 0;
+  a_opts.benchRays = 0;
+  a_opts.benchMath = 0;
+  a_opts.benchRNG = 0;
+  a_opts.benchBuild = 0;
+  a_opts.benchWide = 0;
+  a_opts.benchPacket = 0;
+  a_opts.benchSort = 0;
+  a_opts.samples = 1;
+  a_opts.reflections = NUM_REFLECTIONS;
+  a_opts.instances = 0;
+  a_opts.builder = BVH::Builder::SAH;
+  a_opts.bvhWidth = 2;
+  a_opts.packets = "auto";
+  a_opts.wavefront = false;
+  a_opts.sortRays = false;
+  a_opts.tileOrder = TileScheduler::Order::Hilbert;
+  a_opts.tileSize = 16;
+  a_opts.bvhCache = true;
+  a_opts.budget = 0.0;
+  a_opts.reproject = false;
+  a_opts.upscale = ResolutionScaler::Filter::Bilinear;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-cpu") == 0)
+    {
+      a_opts.cpu = true;
+    }
+    else if (strcmp(argv[i], "-gpubuild") == 0)
+    {
+      a_opts.gpuBuild = true;
+    }
+    else if (strcmp(argv[i], "-wavefront") == 0)
+    {
+      a_opts.wavefront = true;
+    }
+    else if (strcmp(argv[i], "-sortrays") == 0)
+    {
+      a_opts.sortRays = true;
+    }
+    else if (strcmp(argv[i], "-reproject") == 0)
+    {
+      a_opts.reproject = true;
+    }
+    else if (strcmp(argv[i], "-tiles") == 0 && i + 1 < argc)
+    {
+      ++i;
+      if (strcmp(argv[i], "scanline") == 0)     a_opts.tileOrder = TileScheduler::Order::Scanline;
+      else if (strcmp(argv[i], "hilbert") == 0) a_opts.tileOrder = TileScheduler::Order::Hilbert;
+      else if (strcmp(argv[i], "spiral") == 0)  a_opts.tileOrder = TileScheduler::Order::Spiral;
+      else return false;
+    }
+    else if (strcmp(argv[i], "-tilesize") == 0 && i + 1 < argc)
+    {
+      a_opts.tileSize = atoi(argv[++i]);
+      if (a_opts.tileSize <= 0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-tiletrace") == 0 && i + 1 < argc)
+    {
+      a_opts.tileTrace = argv[++i];
+    }
+    else if (strcmp(argv[i], "-costmap") == 0 && i + 1 < argc)
+    {
+      a_opts.costMap = argv[++i];
+    }
+    else if (strcmp(argv[i], "-headless") == 0 && i + 1 < argc)
+    {
+      a_opts.headless = true;
+      a_opts.output = argv[++i];
+    }
+    else if (strcmp(argv[i], "-batch") == 0 && i + 1 < argc)
+    {
+      a_opts.batchFile = argv[++i];
+    }
+    else if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc)
+    {
+      a_opts.budget = atof(argv[++i]);
+      if (a_opts.budget < 0.0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-upscale") == 0 && i + 1 < argc)
+    {
+      ++i;
+      if (strcmp(argv[i], "bilinear") == 0)   a_opts.upscale = ResolutionScaler::Filter::Bilinear;
+      else if (strcmp(argv[i], "edge") == 0)  a_opts.upscale = ResolutionScaler::Filter::EdgeAware;
+      else return false;
+    }
+    else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc)
+    {
+      a_opts.width = atoi(argv[++i]);
+      a_opts.height = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+    {
+      a_opts.threads = unsigned(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "-workgroup") == 0 && i + 2 < argc)
+    {
+      a_opts.workGroupX = atoi(argv[++i]);
+      a_opts.workGroupY = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+    {
+      a_opts.traceFile = argv[++i];
+    }
+    else if (strcmp(argv[i], "-scene") == 0 && i + 1 < argc)
+    {
+      a_opts.sceneFile = argv[++i];
+    }
+    else if (strcmp(argv[i], "-nobvhcache") == 0)
+    {
+      a_opts.bvhCache = false;
+    }
+    else if (strcmp(argv[i], "-convert") == 0 && i + 1 < argc)
+    {
+      a_opts.convert = argv[++i];
+    }
+    else if (strcmp(argv[i], "-mesh") == 0 && i + 1 < argc)
+    {
+      a_opts.meshes.push_back(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-instances") == 0 && i + 1 < argc)
+    {
+      int instances = atoi(argv[++i]);
+      if (instances < 0)
+      {
+        return false;
+      }
+      a_opts.instances = unsigned(instances);
+    }
+    else if (strcmp(argv[i], "-bench") == 0 && i + 1 < argc)
+    {
+      a_opts.benchRays = unsigned(atoi(argv[++i]));
+      if (a_opts.benchRays == 0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-benchrng") == 0 && i + 1 < argc)
+    {
+      a_opts.benchRNG = unsigned(atoi(argv[++i]));
+      if (a_opts.benchRNG == 0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-benchbuild") == 0 && i + 1 < argc)
+    {
+      a_opts.benchBuild = unsigned(atoi(argv[++i]));
+      if (a_opts.benchBuild == 0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-benchwide") == 0 && i + 1 < argc)
+    {
+      a_opts.benchWide = unsigned(atoi(argv[++i]));
+      if (a_opts.benchWide == 0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-benchpacket") == 0 && i + 1 < argc)
+    {
+      a_opts.benchPacket = unsigned(atoi(argv[++i]));
+      if (a_opts.benchPacket == 0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-benchsort") == 0 && i + 1 < argc)
+    {
+      a_opts.benchSort = unsigned(atoi(argv[++i]));
+      if (a_opts.benchSort == 0)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-packets") == 0 && i + 1 < argc)
+    {
+      a_opts.packets = argv[++i];
+      if (a_opts.packets != "off" && a_opts.packets != "sse" && a_opts.packets != "avx2" && a_opts.packets != "avx512")
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-width") == 0 && i + 1 < argc)
+    {
+      a_opts.bvhWidth = atoi(argv[++i]);
+      if (a_opts.bvhWidth != 2 && a_opts.bvhWidth != 4 && a_opts.bvhWidth != 8)
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "-builder") == 0 && i + 1 < argc)
+    {
+      ++i;
+      if (strcmp(argv[i], "sah") == 0)          a_opts.builder = BVH::Builder::SAH;
+      else if (strcmp(argv[i], "lbvh") == 0)    a_opts.builder = BVH::Builder::LBVH30;
+      else if (strcmp(argv[i], "lbvh63") == 0)  a_opts.builder = BVH::Builder::LBVH63;
+      else return false;
+    }
+    else if (strcmp(argv[i], "-spp") == 0 && i + 1 < argc)
+    {
+      int samples = atoi(argv[++i]);
+      if (samples <= 0)
+      {
+        return false;
+      }
+      a_opts.samples = unsigned(samples);
+    }
+    else if (strcmp(argv[i], "-bounces") == 0 && i + 1 < argc)
+    {
+      int bounces = atoi(argv[++i]);
+      if (bounces < 0)
+      {
+        return false;
+      }
+      a_opts.reflections = unsigned(bounces);
+    }
+    else if (strcmp(argv[i], "-benchmath") == 0 && i + 1 < argc)
+    {
+      a_opts.benchMath = unsigned(atoi(argv[++i]));
+      if (a_opts.benchMath < 2)
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return (a_opts.width > 0 && a_opts.height > 0);
+}
+
+
+static bool CreateScene(Options const & a_opts, Scene & a_scene)
+{
+  a_scene.LoadDefault();
+  if (!a_opts.meshes.empty())
+  {
+    Materials grey;
+    grey.color.Set(0.8f, 0.8f, 0.8f, 1.0f);
+    uint32_t materials = a_scene.AddMaterials(grey);
+    for (size_t i = 0; i < a_opts.meshes.size(); i++)
+    {
+      if (!LoadMesh(a_opts.meshes[i], a_scene, materials))
+      {
+        return false;
+      }
+    }
+    a_scene.ScatterInstances(a_scene.GetMeshes().size - 1, a_opts.instances, materials);
+  }
+  return true;
+}
+
+
+static int ConvertScene(Options const & a_opts)
+{
+  Scene scene;
+  if (!CreateScene(a_opts, scene))
+  {
+    return 1;
+  }
+
+  BVH bvh;
+  bvh.SetBuilder(a_opts.builder);
+  bvh.Build(scene);
+
+  if (!SceneFile::Write(a_opts.convert, scene, &bvh))
+  {
+    return 1;
+  }
+  printf("Wrote %u meshes, %u instances and %u BVH nodes to %s\n",
+         scene.GetMeshes().size, scene.GetInstances().size,
+         unsigned(bvh.GetNodes().size()), a_opts.convert.c_str());
   return 0;
-}
\ No newline at end of file
+}
+
+
+//Renders one frame from the origin, or every frame of a batch job if given
+static int RenderHeadless(Options const & a_opts, BatchRender const * a_batch)
+{
+  //The scene uses the mapped file in place, so the file has to outlive it
+  SceneFile file;
+  Scene scene;
+  BVH bvh;
+  bvh.SetBuilder(a_opts.builder);
+  if (!a_opts.sceneFile.empty())
+  {
+    if (!file.Open(a_opts.sceneFile) || !scene.Load(file))
+    {
+      printf("Unable to load the scene file %s\n", a_opts.sceneFile.c_str());
+      return 1;
+    }
+    BVHData data;
+    if (!file.GetBVH(data) || !bvh.Load(scene, data))
+    {
+      bvh.Build(scene);
+    }
+  }
+  else
+  {
+    if (!CreateScene(a_opts, scene))
+    {
+      return 1;
+    }
+    if (a_opts.bvhCache && !a_opts.meshes.empty())
+    {
+      BVHResource::BuildCached(scene, a_opts.meshes.back() + ".bvh", bvh);
+    }
+    else
+    {
+      bvh.Build(scene);
+    }
+  }
+
+  WideBVH wide;
+  wide.SetWidth(a_opts.bvhWidth);
+  if (a_opts.bvhWidth > 2 && !wide.Build(bvh))
+  {
+    return 1;
+  }
+
+  CPUTracer tracer;
+  tracer.SetScene(&scene);
+  tracer.SetBVH(&bvh);
+  if (a_opts.bvhWidth > 2)
+  {
+    tracer.SetWideBVH(&wide);
+  }
+  tracer.SetThreadCount(a_opts.threads);
+  tracer.SetSamplesPerPixel(a_opts.samples);
+  tracer.SetReflectionCount(a_opts.reflections);
+  tracer.SetTileSize(a_opts.tileSize);
+  tracer.SetTileOrder(a_opts.tileOrder);
+
+  //Sorting only has queues to work on in the wavefront mode
+  tracer.SetWavefront(a_opts.wavefront || a_opts.sortRays);
+  tracer.SetRaySorting(a_opts.sortRays);
+
+  if (a_opts.packets == "off")
+  {
+    tracer.SetPacketTraversal(false);
+  }
+  else if (a_opts.packets != "auto")
+  {
+    PacketTraversal::ISA isa = PacketTraversal::ISA::SSE;
+    if (a_opts.packets == "avx2")         isa = PacketTraversal::ISA::AVX2;
+    else if (a_opts.packets == "avx512")  isa = PacketTraversal::ISA::AVX512;
+    if (!tracer.SetPacketISA(isa))
+    {
+      printf("This CPU or build has no %s packet traversal.\n", PacketTraversal::GetName(isa));
+      return 1;
+    }
+  }
+
+  //Only a camera path has a last frame to carry over
+  Reprojector reprojector;
+  if (a_batch != nullptr)
+  {
+    if (a_opts.reproject)
+    {
+      tracer.SetReprojector(&reprojector);
+    }
+    return a_batch->Run(tracer) ? 0 : 1;
+  }
+
+  Camera camera;
+  camera.SetScreen(float(a_opts.width) / float(a_opts.height), 1.0f);
+
+  Framebuffer fb;
+  fb.Resize(a_opts.width, a_opts.height);
+
+  CostImage costImage;
+  if (!a_opts.costMap.empty())
+  {
+    tracer.SetCostImage(&costImage);
+  }
+
+  tracer.Trace(camera, fb);
+
+  if (!a_opts.costMap.empty())
+  {
+    costImage.PrintStats();
+    if (!costImage.Write(a_opts.costMap))
+    {
+      return 1;
+    }
+  }
+
+  if (!a_opts.tileTrace.empty())
+  {
+    TileScheduler const & scheduler = tracer.GetTileScheduler();
+    scheduler.PrintStats();
+    scheduler.WriteTrace(a_opts.tileTrace);
+  }
+
+  return fb.WritePPM(a_opts.output) ? 0 : 1;
+}
+
+
+int main(int argc, char ** argv)
+{
+  Options opts;
+  if (!ParseOptions(argc, argv, opts))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (!opts.sceneFile.empty() && !opts.meshes.empty())
+  {
+    printf("-mesh can not be used with -scene, the scene file holds its own meshes. Add meshes to a scene file with -convert.\n");
+    return 1;
+  }
+
+  if (opts.benchRays > 0)
+  {
+    return RunPrimitiveBenchmarks(opts.benchRays);
+  }
+
+  if (opts.benchMath > 0)
+  {
+    return RunMathBenchmarks(opts.benchMath);
+  }
+
+  if (opts.benchRNG > 0)
+  {
+    return RunRNGBenchmarks(opts.benchRNG);
+  }
+
+  if (opts.benchBuild > 0)
+  {
+    return RunBuildBenchmarks(opts.benchBuild);
+  }
+
+  if (opts.benchWide > 0)
+  {
+    return RunWideBVHBenchmarks(opts.benchWide);
+  }
+
+  if (opts.benchPacket > 0)
+  {
+    return RunPacketBenchmarks(opts.benchPacket);
+  }
+
+  if (opts.benchSort > 0)
+  {
+    return RunRaySortBenchmarks(opts.benchSort);
+  }
+
+  if (!opts.convert.empty())
+  {
+    return ConvertScene(opts);
+  }
+
+  if (!opts.batchFile.empty())
+  {
+    BatchRender batch;
+    if (!batch.Load(opts.batchFile))
+    {
+      return 1;
+    }
+    return RenderHeadless(opts, &batch);
+  }
+
+  if (opts.headless)
+  {
+    return RenderHeadless(opts, nullptr);
+  }
+
+  Application::GetInstance()->SetBackend(opts.cpu ? Application::Backend::CPU : Application::Backend::GPU);
+  Application::GetInstance()->SetWorkGroupSize(opts.workGroupX, opts.workGroupY);
+  Application::GetInstance()->SetTraceFile(opts.traceFile);
+  Application::GetInstance()->SetReflectionCount(opts.reflections);
+  for (size_t i = 0; i < opts.meshes.size(); i++)
+  {
+    Application::GetInstance()->AddMeshFile(opts.meshes[i]);
+  }
+  Application::GetInstance()->SetInstanceCount(opts.instances);
+  Application::GetInstance()->SetSceneFile(opts.sceneFile);
+  Application::GetInstance()->SetBVHCache(opts.bvhCache);
+  Application::GetInstance()->SetBVHBuilder(opts.builder);
+  Application::GetInstance()->SetGPUBVHBuild(opts.gpuBuild);
+  Application::GetInstance()->SetBVHWidth(opts.bvhWidth);
+  Application::GetInstance()->SetRaySorting(opts.sortRays);
+  Application::GetInstance()->SetFrameBudget(opts.budget);
+  Application::GetInstance()->SetUpscaleFilter(opts.upscale);
+  Application::GetInstance()->SetReprojection(opts.reproject);
+  return Application::GetInstance()->Run() ? 0 : 1;
+}
@@ -9,7 +9,59 @@ out vec4 color;
 /* The texture we are going to sample */
 uniform sampler2D tex;
 
+/* Only this corner of tex was traced, see ResolutionScaler. It is stretched
+   over the window, bilinearly or, with upscaleFilter 1, edge-aware. */
+uniform ivec2 renderSize;
+uniform int upscaleFilter;
+
+/* Per pixel work of the CPU tracer, see CostImage.h. costChannel picks
+   the channel to show, or -1 to show tex. costScale and above are the
+   hottest colour. */
+uniform usampler2D costTex;
+uniform int costChannel;
+uniform float costScale;
+
+/* How quickly edge-aware taps lose weight as they differ from the nearest */
+const float EDGE_SHARPNESS = 16.0;
+
+/* Blue through green to red, as Heatmap() in CostImage.cpp */
+vec3 Heatmap(float t) {
+  return clamp(vec3(1.5) - abs(vec3(4.0 * t) - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);
+}
+
+/* The four texels around the sample, clamped to the traced corner. At full
+   size every sample lands on a texel centre and this is a copy. */
+vec4 Upscale(vec2 uv) {
+  vec2 p = uv * vec2(renderSize) - 0.5;
+  ivec2 p0 = ivec2(floor(p));
+  vec2 f = p - vec2(p0);
+  ivec2 last = renderSize - 1;
+
+  vec4 c00 = texelFetch(tex, clamp(p0, ivec2(0), last), 0);
+  vec4 c10 = texelFetch(tex, clamp(p0 + ivec2(1, 0), ivec2(0), last), 0);
+  vec4 c01 = texelFetch(tex, clamp(p0 + ivec2(0, 1), ivec2(0), last), 0);
+  vec4 c11 = texelFetch(tex, clamp(p0 + ivec2(1, 1), ivec2(0), last), 0);
+
+  vec4 w = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+  if (upscaleFilter == 1) {
+    /* Blending across an edge blurs it, so taps unlike the nearest one
+       count for less. The nearest keeps its weight, so the sum is never 0. */
+    vec4 nearest = (f.y < 0.5) ? ((f.x < 0.5) ? c00 : c10) : ((f.x < 0.5) ? c01 : c11);
+    vec4 d = vec4(distance(c00.rgb, nearest.rgb), distance(c10.rgb, nearest.rgb),
+                  distance(c01.rgb, nearest.rgb), distance(c11.rgb, nearest.rgb));
+    w *= exp(-EDGE_SHARPNESS * d * d);
+  }
+  return (c00 * w.x + c10 * w.y + c01 * w.z + c11 * w.w) / (w.x + w.y + w.z + w.w);
+}
+
 void main(void) {
-  /* Well, simply sample the texture */
-  color = texture(tex, texcoord);
+  if (costChannel >= 0) {
+    ivec2 pix = min(ivec2(texcoord * vec2(renderSize)), renderSize - 1);
+    uvec4 cost = texelFetch(costTex, pix, 0);
+    float t = min(float(cost[costChannel]) / costScale, 1.0);
+    color = vec4(Heatmap(t), 1.0);
+    return;
+  }
+
+  color = Upscale(texcoord);
 }
@@ -1,6 +1,7 @@
 #version 430 core
 
 layout(binding = 0, rgba32f) uniform image2D framebuffer;
+layout(binding = 1, rgba32f) uniform image2D accumulation;
 
 //--------------------------------------------------------------------------------------
 //  UNIFORMS
@@ -12,12 +13,60 @@ uniform vec3 ray01;
 uniform vec3 ray10;
 uniform vec3 ray11;
 
+// Progressive accumulation. sampleIndex < 0 disables it.
+uniform vec2 jitter;
+uniform int  sampleIndex;
+
+// The corner of the framebuffer traced this frame, see ResolutionScaler.
+// Primary rays and resolve only.
+uniform ivec2 renderSize;
+
 const float NO_INTERSECT = 1.0 / 0.0;
 const int TYPE_NULL = -1;
 const int TYPE_AABB = 0;
 const int TYPE_SPHERE = 1;
+const int TYPE_OBB = 2;
+const int TYPE_CAPSULE = 3;
+const int TYPE_CYLINDER = 4;
+const int TYPE_TORUS = 5;
+const int TYPE_CONE = 6;
+const int TYPE_MESH = 7;
+const int TYPE_INSTANCE = 8;
+const int TYPE_TRIANGLE = 9;  // only in the leaves of a mesh BVH
+
+const float PI = 3.14159265358979;
+
+// The application defines these to pick the work group shape at load time.
+#ifndef WORK_GROUP_SIZE_X
+#define WORK_GROUP_SIZE_X 16
+#endif
+#ifndef WORK_GROUP_SIZE_Y
+#define WORK_GROUP_SIZE_Y 8
+#endif
+
+// Reflection bounces after the primary hit, see RayTracerConfig.h.
+#ifndef NUM_REFLECTIONS
+#define NUM_REFLECTIONS 3
+#endif
+
+// Work group size of the one dimensional wavefront passes.
+#ifndef WAVEFRONT_GROUP_SIZE
+#define WAVEFRONT_GROUP_SIZE 64
+#endif
+
+// Work group size of the ray sort scan, and the digits of its radix sort,
+// see GPURaySorter.h.
+#ifndef RAYSORT_SCAN_SIZE
+#define RAYSORT_SCAN_SIZE 256
+#endif
+#define RAYSORT_RADIX_SIZE 16u
+
+// Shading, the same as CPUTracer.cpp.
+const vec3  LIGHT_DIRECTION = vec3(-0.408248, 0.408248, 0.816497);  // towards the light
+const float AMBIENT = 0.2;
+const float RAY_OFFSET = 1.0e-3;
 
-const int NUM_REFLECTIONS = 3;
+// BVH_STACK_SIZE is defined by Application, from RayTracerConfig.h
 
 //--------------------------------------------------------------------------------------
 //  MATERIALS
@@ -25,13 +74,16 @@ const int NUM_REFLECTIONS = 3;
 
 struct Materials
 {
-  vec4 color;
+  vec4  color;
+  float reflectance;  // fraction of light mirrored, the rest is diffuse
 };
 
 //--------------------------------------------------------------------------------------
 //  GEOMETRY CLASSES
 //--------------------------------------------------------------------------------------
 
+// Uploaded by SceneBuffers; keep in step with the GPU structs in SceneBuffers.h.
+
 struct AABB 
 {
   vec3 min;
@@ -41,11 +93,9 @@ struct AABB
 
 struct OBB
 {
-  vec3 v0;
-  vec3 v1;
-  vec3 v2;
-  vec3 u;
-  uint materials;
+  vec3  center;
+  uint  materials;
+  vec4  axes[3];    // xyz: axis, w: half extent
 };
 
 struct Sphere
@@ -55,38 +105,52 @@ struct Sphere
   uint materials;
 };
 
+// Also used for cylinders. direction runs from origin to the other end.
 struct Capsule
 {
-  uint materials;
   vec3  origin;
-  vec3  direction;
   float radius;
-};
-
-struct Cylinder
-{
-  uint materials;
-  vec3  origin;
   vec3  direction;
-  float radius;
+  uint  materials;
 };
 
 struct Torus
 {
-  uint materials;
   vec3  center;
-  vec3  axis;
   float R;
+  vec3  axis;
   float r;
+  uint  materials;
 };
 
 struct ConeSegment
 {
-  uint materials;
   vec3  origin;
-  vec3  direction;
   float r0;
+  vec3  direction;
   float r1;
+  uint  materials;
+};
+
+// Triangles live in the shared positions and indices streams.
+// Indices are relative to firstVertex.
+struct Mesh
+{
+  uint  firstVertex;
+  uint  nVertices;
+  uint  firstIndex;
+  uint  nTriangles;
+  uint  materials;
+};
+
+// A mesh placed by a translate, rotate and uniform scale.
+struct Instance
+{
+  vec4  rotation;     // quaternion, xyzw
+  vec3  translation;
+  float scale;
+  uint  mesh;
+  uint  materials;
 };
 
 struct HitInfo 
@@ -94,6 +158,7 @@ struct HitInfo
   int   type;
   float t;
   int   index;
+  int   triangle;   // for TYPE_MESH and TYPE_INSTANCE, the triangle within the mesh
 };
 
 struct Ray
@@ -102,32 +167,202 @@ struct Ray
   vec3 V;
 };
 
+//--------------------------------------------------------------------------------------
+//  BVH - must match BVHNode and BVHPrimitive in BVH.h
+//--------------------------------------------------------------------------------------
+
+struct BVHNode
+{
+  vec3  min;
+  int   offset;   // interior: right child, leaf: first primitive
+  vec3  max;
+  int   count;    // 0 for interior nodes
+};
+
+#ifdef WIDE_BVH
+
+// WideNode<WIDE_BVH> in WideBVH.h, read as 16 byte words. The offsets are in
+// 32 bit words: a header of 4, then the lower and upper bytes of each axis,
+// the children and their primitive counts.
+#define WIDE_LANE_WORDS   (WIDE_BVH / 4)
+#define WIDE_LOWER        4
+#define WIDE_UPPER        (WIDE_LOWER + 3 * WIDE_LANE_WORDS)
+#define WIDE_CHILD        (WIDE_UPPER + 3 * WIDE_LANE_WORDS)
+#define WIDE_COUNT        (WIDE_CHILD + WIDE_BVH)
+// Each wide level leaves at most WIDE_BVH - 1 siblings on the stack, see
+// WIDE_BVH_STACK_SIZE in WideBVH.cpp
+#define WIDE_STACK_SIZE   (BVH_STACK_SIZE * (WIDE_BVH - 1))
+
+layout(std430, binding = 1) readonly buffer BVHNodes
+{
+  uvec4 wideNodes[];    // WIDE_BVH per node
+};
+
+#else
+
+layout(std430, binding = 1) readonly buffer BVHNodes
+{
+  BVHNode nodes[];
+};
+
+#endif
+
+layout(std430, binding = 2) readonly buffer BVHPrimitives
+{
+  ivec2 primitives[];   // (type, index)
+};
+
+// The mesh hierarchies come first in nodes[], then the top level.
+layout(std430, binding = 14) readonly buffer BVHMeshRoots
+{
+  int bvhRoot;        // root of the top level
+  int meshRoots[];    // root of each mesh
+};
+
 //--------------------------------------------------------------------------------------
 //  SCENE OBJECTS
 //--------------------------------------------------------------------------------------
 
 #define MAX_SCENE_BOUNDS 100.0
-#define NUM_BOXES       2
-#define NUM_SPHERES     1
-#define NUM_MATERIALS   4
 
-const Materials MaterialsList[NUM_MATERIALS] = 
+// Bindings must match SceneBinding in SceneBuffers.h
+layout(std430, binding = 3) readonly buffer MaterialsBuffer
+{
+  Materials MaterialsList[];
+};
+
+layout(std430, binding = 4) readonly buffer BoxesBuffer
+{
+  AABB boxes[];
+};
+
+layout(std430, binding = 5) readonly buffer SpheresBuffer
+{
+  Sphere spheres[];
+};
+
+layout(std430, binding = 6) readonly buffer OBBsBuffer
+{
+  OBB obbs[];
+};
+
+layout(std430, binding = 7) readonly buffer CapsulesBuffer
+{
+  Capsule capsules[];
+};
+
+layout(std430, binding = 8) readonly buffer CylindersBuffer
+{
+  Capsule cylinders[];
+};
+
+layout(std430, binding = 9) readonly buffer ToriBuffer
+{
+  Torus tori[];
+};
+
+layout(std430, binding = 10) readonly buffer ConesBuffer
+{
+  ConeSegment cones[];
+};
+
+layout(std430, binding = 11) readonly buffer PositionsBuffer
+{
+  float positions[];  // xyz, not padded
+};
+
+layout(std430, binding = 12) readonly buffer IndicesBuffer
+{
+  uint indices[];
+};
+
+layout(std430, binding = 13) readonly buffer MeshesBuffer
+{
+  Mesh meshes[];
+};
+
+layout(std430, binding = 19) readonly buffer InstancesBuffer
+{
+  Instance instances[];
+};
+
+//--------------------------------------------------------------------------------------
+//  WAVEFRONT QUEUES - must match WavefrontQueues.h
+//--------------------------------------------------------------------------------------
+
+// A ray waiting for a later pass. Reflection rays carry the throughput of
+// the path in weight, shadow rays the light they add if nothing is hit.
+struct QueuedRay
+{
+  vec3  origin;
+  int   pixel;
+  vec3  direction;
+  float tMax;
+  vec4  weight;
+};
+
+// Laid out so glDispatchComputeIndirect can read x, y, z directly.
+struct DispatchArgs
+{
+  uint  x;
+  uint  y;
+  uint  z;
+  uint  count;
+};
+
+layout(std430, binding = 15) coherent buffer WavefrontCounters
+{
+  DispatchArgs shadowDispatch;
+  DispatchArgs bounceDispatch;
+  uint rayCount[2];     // rays appended to each half of rays[]
+  uint shadowCount;     // rays appended to shadows[]
+};
+
+// Two queues of one ray per pixel, ping-ponged between bounces.
+layout(std430, binding = 16) buffer RayQueue
+{
+  QueuedRay rays[];
+};
+
+layout(std430, binding = 17) buffer ShadowQueue
+{
+  QueuedRay shadows[];
+};
+
+// Light gathered by the current sample. A path only ever has one ray in
+// flight, so no two invocations of a pass touch the same pixel.
+layout(std430, binding = 18) buffer RadianceBuffer
+{
+  vec4 radiance[];
+};
+
+// Ray sorting, must match GPURaySorter.h. The sort passes ping-pong between
+// the two pairs of key and order buffers and leave the sorted order of a
+// queue in rayOrder[], which the shadow and bounce passes then read through.
+layout(std430, binding = 31) buffer RaySortKeys
 {
-  {vec4(1.0, 0.0, 0.0, 1.0)},
-  {vec4(1.0, 1.0, 0.0, 1.0)},
-  {vec4(1.0, 0.0, 1.0, 1.0)},
-  {vec4(0.0, 1.0, 1.0, 1.0)},
+  uint sortKeys[];
 };
 
-const AABB boxes[NUM_BOXES] = 
+layout(std430, binding = 32) buffer RayOrder
 {
-  {vec3(-2.5, 8.5, -2.5), vec3(2.5, 12.5, 2.5), 1},
-  {vec3(-3.5, -3.5, 7.5), vec3(3.5, 3.5, 13.5), 3},
+  uint rayOrder[];
 };
 
-const Sphere spheres[NUM_SPHERES] = 
+layout(std430, binding = 33) writeonly buffer RaySortKeysOut
 {
-  {vec3(9.5, 0.0, 0.0), 2.0, 2}
+  uint sortKeysOut[];
+};
+
+layout(std430, binding = 34) writeonly buffer RayOrderOut
+{
+  uint rayOrderOut[];
+};
+
+// Digit counts of each work group, digit major
+layout(std430, binding = 35) buffer RaySortHistogram
+{
+  uint sortHistogram[];
 };
 
 //--------------------------------------------------------------------------------------
@@ -194,20 +429,6 @@ float IntersectSphere(const Ray ray, const Sphere sphere)
   return IntersectSphereFromOutside(ray, sphere);
 }
 
-void IntersectSpheres(const Ray ray, inout HitInfo info) 
-{
-  for (int i = 0; i < NUM_SPHERES; i++) 
-  {
-    float t = IntersectSphere(ray, spheres[i]);
-    if (t < info.t) 
-    {
-      info.type = TYPE_SPHERE;
-      info.t = t;
-      info.index = i;
-    }
-  }
-}
-
 //--------------------------------------------------------------------------------------
 //  INTERSECTION - AABB
 //--------------------------------------------------------------------------------------
@@ -258,63 +479,1321 @@ float IntersectAABB(const Ray ray, const AABB b)
     return IntersectAABBFromOutside(ray, b);
 }
 
-void IntersectAABBs(const Ray ray, inout HitInfo info) 
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - OBB
+//--------------------------------------------------------------------------------------
+
+float IntersectOBB(const Ray ray, const OBB b)
+{
+  // Slab test in the frame of the box
+  vec3 P = ray.P - b.center;
+  mat3 axes = mat3(b.axes[0].xyz, b.axes[1].xyz, b.axes[2].xyz);
+  vec3 o = P * axes;
+  vec3 d = ray.V * axes;
+  vec3 e = vec3(b.axes[0].w, b.axes[1].w, b.axes[2].w);
+  vec3 tMin = (-e - o) / d;
+  vec3 tMax = (e - o) / d;
+  vec3 t1 = min(tMin, tMax);
+  vec3 t2 = max(tMin, tMax);
+  float tNear = max(max(t1.x, t1.y), t1.z);
+  float tFar = min(min(t2.x, t2.y), t2.z);
+
+  if (tNear > tFar || tFar <= 0.0)
+  {
+    return NO_INTERSECT;
+  }
+
+  // Origin inside the box
+  return (tNear <= 0.0) ? tFar : tNear;
+}
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - CAPSULE, CYLINDER, CONE SEGMENT
+//
+//  These work with a unit direction; the distance is scaled back to the units of the ray.
+//--------------------------------------------------------------------------------------
+
+float ToRayDistance(float t, float len)
+{
+  return (t > 0.0) ? t / len : NO_INTERSECT;
+}
+
+float IntersectCapsule(const Ray ray, const Capsule c)
+{
+  float len = length(ray.V);
+  vec3  rd = ray.V / len;
+  vec3  ba = c.direction;
+  vec3  oa = ray.P - c.origin;
+  float baba = dot(ba, ba);
+  float bard = dot(ba, rd);
+  float baoa = dot(ba, oa);
+  float rdoa = dot(rd, oa);
+  float oaoa = dot(oa, oa);
+
+  // Infinite cylinder around the segment
+  float a = baba - bard * bard;
+  float b = baba * rdoa - baoa * bard;
+  float k = baba * oaoa - baoa * baoa - c.radius * c.radius * baba;
+  float h;
+  float y;
+  if (a < 1.0e-6 * baba)
+  {
+    // Parallel to the axis only the hemisphere ahead can be hit, when within the radius
+    if (k > 0.0)
+    {
+      return NO_INTERSECT;
+    }
+    y = (bard > 0.0) ? 0.0 : baba;
+  }
+  else
+  {
+    h = b * b - a * k;
+    if (h < 0.0)
+    {
+      return NO_INTERSECT;
+    }
+
+    float t = (-b - sqrt(h)) / a;
+    y = baoa + t * bard;
+    if (y > 0.0 && y < baba)
+    {
+      return ToRayDistance(t, len);
+    }
+  }
+
+  // Hemisphere at the nearer end
+  vec3 oc = (y <= 0.0) ? oa : ray.P - (c.origin + ba);
+  b = dot(rd, oc);
+  k = dot(oc, oc) - c.radius * c.radius;
+  h = b * b - k;
+  if (h <= 0.0)
+  {
+    return NO_INTERSECT;
+  }
+  return ToRayDistance(-b - sqrt(h), len);
+}
+
+float IntersectCylinder(const Ray ray, const Capsule c)
+{
+  float len = length(ray.V);
+  vec3  rd = ray.V / len;
+  vec3  ba = c.direction;
+  vec3  oc = ray.P - c.origin;
+  float baba = dot(ba, ba);
+  float bard = dot(ba, rd);
+  float baoc = dot(ba, oc);
+
+  float k2 = baba - bard * bard;
+  float k1 = baba * dot(oc, rd) - baoc * bard;
+  float k0 = baba * dot(oc, oc) - baoc * baoc - c.radius * c.radius * baba;
+
+  // Parallel to the axis only a cap can be hit, when within the radius
+  if (k2 < 1.0e-6 * baba)
+  {
+    if (k0 > 0.0)
+    {
+      return NO_INTERSECT;
+    }
+    return ToRayDistance((((bard > 0.0) ? 0.0 : baba) - baoc) / bard, len);
+  }
+
+  float h = k1 * k1 - k2 * k0;
+  if (h < 0.0)
+  {
+    return NO_INTERSECT;
+  }
+  h = sqrt(h);
+
+  // Side
+  float t = (-k1 - h) / k2;
+  float y = baoc + t * bard;
+  if (y > 0.0 && y < baba)
+  {
+    return ToRayDistance(t, len);
+  }
+
+  // Caps
+  t = (((y < 0.0) ? 0.0 : baba) - baoc) / bard;
+  if (abs(k1 + k2 * t) < h)
+  {
+    return ToRayDistance(t, len);
+  }
+  return NO_INTERSECT;
+}
+
+float IntersectConeSegment(const Ray ray, const ConeSegment c)
 {
-  for (int i = 0; i < NUM_BOXES; i++) 
+  float len = length(ray.V);
+  vec3  rd = ray.V / len;
+  vec3  ba = c.direction;
+  vec3  oa = ray.P - c.origin;
+  vec3  ob = oa - ba;
+  float m0 = dot(ba, ba);
+  float m1 = dot(oa, ba);
+  float m2 = dot(rd, ba);
+  float m3 = dot(rd, oa);
+  float m5 = dot(oa, oa);
+  float m9 = dot(ob, ba);
+
+  // Caps
+  if (m1 < 0.0)
+  {
+    vec3 v = oa * m2 - rd * m1;
+    if (dot(v, v) < c.r0 * c.r0 * m2 * m2)
+    {
+      return ToRayDistance(-m1 / m2, len);
+    }
+  }
+  else if (m9 > 0.0)
   {
-    float t = IntersectAABB(ray, boxes[i]);
-    if (t < info.t) 
+    float t = -m9 / m2;
+    vec3 v = ob + rd * t;
+    if (dot(v, v) < c.r1 * c.r1)
     {
-      info.type = TYPE_AABB;
-      info.t = t;
-      info.index = i;
+      return ToRayDistance(t, len);
     }
   }
+
+  // Side
+  float ra = c.r0;
+  float rr = c.r0 - c.r1;
+  float hy = m0 + rr * rr;
+  float k2 = m0 * m0 - m2 * m2 * hy;
+  float k1 = m0 * m0 * m3 - m1 * m2 * hy + m0 * ra * (rr * m2);
+  float k0 = m0 * m0 * m5 - m1 * m1 * hy + m0 * ra * (rr * m1 * 2.0 - m0 * ra);
+  float h = k1 * k1 - k2 * k0;
+  if (h < 0.0)
+  {
+    return NO_INTERSECT;
+  }
+
+  float t = (-k1 - sqrt(h)) / k2;
+  float y = m1 + t * m2;
+  if (y < 0.0 || y > m0)
+  {
+    return NO_INTERSECT;
+  }
+  return ToRayDistance(t, len);
 }
 
 //--------------------------------------------------------------------------------------
-//  TRACE RAY
+//  INTERSECTION - TORUS
 //--------------------------------------------------------------------------------------
 
-vec4 trace(const Ray ray) 
+// Roots of x^2 + b x + c, avoiding cancellation between b and the root.
+int SolveQuadratic(float b, float c, out vec2 roots)
 {
-  HitInfo info;
-  info.type = TYPE_NULL;
-  info.t = MAX_SCENE_BOUNDS;
-  
-  IntersectSpheres(ray, info);
-  IntersectAABBs(ray, info);
+  float discriminant = b * b - 4.0 * c;
+  roots = vec2(0.0);
+  if (discriminant < 0.0)
+  {
+    return 0;
+  }
+  float q = -0.5 * (b + ((b < 0.0) ? -sqrt(discriminant) : sqrt(discriminant)));
+  roots = vec2(q, (q != 0.0) ? c / q : 0.0);
+  return 2;
+}
+
+// Largest real root of x^3 + a x^2 + b x + c.
+float LargestCubicRoot(float a, float b, float c)
+{
+  float Q = (a * a - 3.0 * b) / 9.0;
+  float R = (2.0 * a * a * a - 9.0 * a * b + 27.0 * c) / 54.0;
+  float Q3 = Q * Q * Q;
+
+  if (R * R < Q3)
+  {
+    float theta = acos(clamp(R / sqrt(Q3), -1.0, 1.0));
+    return -2.0 * sqrt(Q) * cos((theta + 2.0 * PI) / 3.0) - a / 3.0;
+  }
+
+  float A = -sign(R) * pow(abs(R) + sqrt(R * R - Q3), 1.0 / 3.0);
+  float B = (A != 0.0) ? Q / A : 0.0;
+  return (A + B) - a / 3.0;
+}
+
+// Smallest root of x^4 + c.x x^3 + c.y x^2 + c.z x + c.w greater than tMin, by
+// Ferrari's method. Each root is polished with Newton steps on the original
+// polynomial, which recovers most of the precision lost in single precision.
+float SmallestQuarticRoot(const vec4 c, float tMin)
+{
+  float a = c.x;
+  float aa = a * a;
+  float p = c.y - 3.0 * aa / 8.0;
+  float q = c.z - a * c.y / 2.0 + aa * a / 8.0;
+  float r = c.w - a * c.z / 4.0 + aa * c.y / 16.0 - 3.0 * aa * aa / 256.0;
+
+  vec4 roots = vec4(0.0);
+  int n = 0;
+  float m = LargestCubicRoot(p, p * p / 4.0 - r, -q * q / 8.0);
+
+  if (m <= 1.0e-6)
+  {
+    // Biquadratic
+    vec2 z;
+    if (SolveQuadratic(p, r, z) == 2)
+    {
+      if (z.x >= 0.0) { roots.x = sqrt(z.x); roots.y = -roots.x; n = 2; }
+      if (z.y >= 0.0) { roots[n] = sqrt(z.y); roots[n + 1] = -roots[n]; n += 2; }
+    }
+  }
+  else
+  {
+    float s = sqrt(2.0 * m);
+    float u = q / (2.0 * s);
+    vec2 z;
+    if (SolveQuadratic(s, p / 2.0 + m - u, z) == 2) { roots.xy = z; n = 2; }
+    if (SolveQuadratic(-s, p / 2.0 + m + u, z) == 2) { roots[n] = z.x; roots[n + 1] = z.y; n += 2; }
+  }
 
-  if (info.type == TYPE_AABB)
+  float result = NO_INTERSECT;
+  for (int i = 0; i < n; i++)
   {
-    return MaterialsList[boxes[info.index].materials].color;
+    float x = roots[i] - a / 4.0;
+    for (int k = 0; k < 2; k++)
+    {
+      float f = (((x + a) * x + c.y) * x + c.z) * x + c.w;
+      float df = ((4.0 * x + 3.0 * a) * x + 2.0 * c.y) * x + c.z;
+      if (df != 0.0)
+      {
+        x -= f / df;
+      }
+    }
+    if (x > tMin && x < result)
+    {
+      result = x;
+    }
   }
-  else if (info.type == TYPE_SPHERE)
+  return result;
+}
+
+float IntersectTorus(const Ray ray, const Torus torus)
+{
+  float len = length(ray.V);
+  vec3  d = ray.V / len;
+  vec3  o = ray.P - torus.center;
+
+  // Reject against the bounding sphere, then start from where the ray enters
+  // it. Keeping the origin close to the torus keeps the quartic well scaled.
+  float bound = torus.R + torus.r;
+  float od = dot(o, d);
+  float h = od * od - (dot(o, o) - bound * bound);
+  if (h <= 0.0 || -od + sqrt(h) <= 0.0)
   {
-    return MaterialsList[spheres[info.index].materials].color;
+    return NO_INTERSECT;
   }
+  float t0 = max(-od - sqrt(h), 0.0);
+  o += t0 * d;
+
+  // (|p|^2 + R^2 - r^2)^2 = 4 R^2 (|p|^2 - (p.axis)^2), p = o + t d
+  od = dot(o, d);
+  float oo = dot(o, o);
+  float oa = dot(o, torus.axis);
+  float da = dot(d, torus.axis);
+  float k = oo + torus.R * torus.R - torus.r * torus.r;
+  float R4 = 4.0 * torus.R * torus.R;
+  vec4 coeffs = vec4(4.0 * od,
+                     4.0 * od * od + 2.0 * k - R4 * (1.0 - da * da),
+                     4.0 * od * k - 2.0 * R4 * (od - oa * da),
+                     k * k - R4 * (oo - oa * oa));
 
-  return vec4(0.0, 0.0, 0.0, 1.0);
+  float t = SmallestQuarticRoot(coeffs, -t0);
+  if (t == NO_INTERSECT)
+  {
+    return NO_INTERSECT;
+  }
+  return (t + t0) / len;
 }
 
 //--------------------------------------------------------------------------------------
-//  MAIN
+//  INTERSECTION - TRIANGLE
+//
+//  Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection", 2013.
 //--------------------------------------------------------------------------------------
 
-layout (local_size_x = 16, local_size_y = 8) in;
-void main(void) 
+struct TriangleRay
 {
-  ivec2 pix = ivec2(gl_GlobalInvocationID.xy);
-  ivec2 size = imageSize(framebuffer);
-  if (pix.x >= size.x || pix.y >= size.y) 
+  ivec3 k;    // kx, ky, kz
+  vec3  S;    // Sx, Sy, Sz
+  vec3  P;
+};
+
+TriangleRay SetupTriangleRay(const Ray ray)
+{
+  // Shear and scale space so the ray runs down +z from the origin
+  vec3 a = abs(ray.V);
+  int kz = (a.x > a.y) ? ((a.x > a.z) ? 0 : 2) : ((a.y > a.z) ? 1 : 2);
+  int kx = (kz + 1) % 3;
+  int ky = (kx + 1) % 3;
+
+  // Keep the winding of the sheared triangle
+  if (ray.V[kz] < 0.0)
   {
-    return;
+    int temp = kx;
+    kx = ky;
+    ky = temp;
   }
-  vec2 pos = vec2(pix) / vec2(size.x - 1, size.y - 1);
-  vec3 dir = mix(mix(ray00, ray01, pos.x), mix(ray10, ray11, pos.x), pos.y);
-  Ray ray;
-  ray.P = eye;
-  ray.V = dir;
-  vec4 color = trace(ray);
-  imageStore(framebuffer, pix, color);
+
+  TriangleRay result;
+  result.k = ivec3(kx, ky, kz);
+  result.S = vec3(ray.V[kx] / ray.V[kz], ray.V[ky] / ray.V[kz], 1.0 / ray.V[kz]);
+  result.P = ray.P;
+  return result;
+}
+
+vec3 GetVertex(const Mesh mesh, uint triangle, int corner)
+{
+  uint i = 3u * (mesh.firstVertex + indices[mesh.firstIndex + 3u * triangle + uint(corner)]);
+  return vec3(positions[i], positions[i + 1u], positions[i + 2u]);
 }
+
+float IntersectTriangle(const TriangleRay ray, vec3 v0, vec3 v1, vec3 v2)
+{
+  int kx = ray.k.x;
+  int ky = ray.k.y;
+  int kz = ray.k.z;
+
+  vec3 A = v0 - ray.P;
+  vec3 B = v1 - ray.P;
+  vec3 C = v2 - ray.P;
+
+  float Ax = A[kx] - ray.S.x * A[kz];
+  float Ay = A[ky] - ray.S.y * A[kz];
+  float Bx = B[kx] - ray.S.x * B[kz];
+  float By = B[ky] - ray.S.y * B[kz];
+  float Cx = C[kx] - ray.S.x * C[kz];
+  float Cy = C[ky] - ray.S.y * C[kz];
+
+  // Scaled barycentrics
+  float U = Cx * By - Cy * Bx;
+  float V = Ax * Cy - Ay * Cx;
+  float W = Bx * Ay - By * Ax;
+
+  // The ray passes through an edge. Recompute in double precision so the edge
+  // is owned by exactly one of the triangles sharing it.
+  if (U == 0.0 || V == 0.0 || W == 0.0)
+  {
+    U = float(double(Cx) * double(By) - double(Cy) * double(Bx));
+    V = float(double(Ax) * double(Cy) - double(Ay) * double(Cx));
+    W = float(double(Bx) * double(Ay) - double(By) * double(Ax));
+  }
+
+  if ((U < 0.0 || V < 0.0 || W < 0.0) && (U > 0.0 || V > 0.0 || W > 0.0))
+  {
+    return NO_INTERSECT;
+  }
+
+  float det = U + V + W;
+  if (det == 0.0)
+  {
+    return NO_INTERSECT;
+  }
+
+  float T = ray.S.z * (U * A[kz] + V * B[kz] + W * C[kz]);
+
+  // Hit must be in front of the origin, either winding
+  if ((det < 0.0) ? (T >= 0.0) : (T <= 0.0))
+  {
+    return NO_INTERSECT;
+  }
+  return T / det;
+}
+
+//--------------------------------------------------------------------------------------
+//  NORMALS
+//--------------------------------------------------------------------------------------
+
+// Normal of a capped primitive about the segment from origin to origin + direction.
+// slope is the change in radius over the length of the segment.
+vec3 CappedNormal(vec3 origin, vec3 direction, float r0, float slope, vec3 point)
+{
+  float len = length(direction);
+  vec3  axis = direction / len;
+  vec3  P = point - origin;
+  float h = dot(P, axis);
+  vec3  radial = P - axis * h;
+  float radialLength = length(radial);
+  float radius = r0 + slope * (h / len);
+
+  float sideDistance = abs(radialLength - radius);
+  float capDistance = (h < 0.5 * len) ? abs(h) : abs(len - h);
+  if (capDistance < sideDistance)
+  {
+    return (h < 0.5 * len) ? -axis : axis;
+  }
+  return normalize((radial / radialLength) * len - axis * slope);
+}
+
+vec3 RotateByQuaternion(vec4 q, vec3 v)
+{
+  return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Inverse of the instance transform, the same as ToObjectSpace in Intersect.cpp.
+// The ray parameter means the same distance in both frames.
+Ray ToObjectSpace(const Instance inst, const Ray ray)
+{
+  vec4 toObject = vec4(-inst.rotation.xyz, inst.rotation.w);
+  Ray result;
+  result.P = RotateByQuaternion(toObject, ray.P - inst.translation) / inst.scale;
+  result.V = RotateByQuaternion(toObject, ray.V) / inst.scale;
+  return result;
+}
+
+// Outward unit normal at a point on the surface of the primitive that was hit.
+// Mesh normals follow the counter clockwise winding of the triangle.
+vec3 GetNormal(const HitInfo info, vec3 point)
+{
+  int type = info.type;
+  int index = info.index;
+  if (type == TYPE_AABB)
+  {
+    vec3 halfSize = 0.5 * (boxes[index].max - boxes[index].min);
+    vec3 p = (point - (boxes[index].min + halfSize)) / halfSize;
+    vec3 a = abs(p);
+    vec3 n = (a.x > a.y && a.x > a.z) ? vec3(1.0, 0.0, 0.0) : ((a.y > a.z) ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0));
+    return n * sign(dot(n, p));
+  }
+  else if (type == TYPE_SPHERE)
+  {
+    return normalize(point - spheres[index].center);
+  }
+  else if (type == TYPE_OBB)
+  {
+    OBB b = obbs[index];
+    vec3 P = point - b.center;
+    vec3 p = vec3(dot(P, b.axes[0].xyz) / b.axes[0].w,
+                  dot(P, b.axes[1].xyz) / b.axes[1].w,
+                  dot(P, b.axes[2].xyz) / b.axes[2].w);
+    vec3 a = abs(p);
+    int i = (a.x > a.y && a.x > a.z) ? 0 : ((a.y > a.z) ? 1 : 2);
+    return b.axes[i].xyz * sign(p[i]);
+  }
+  else if (type == TYPE_CAPSULE)
+  {
+    Capsule c = capsules[index];
+    float h = clamp(dot(point - c.origin, c.direction) / dot(c.direction, c.direction), 0.0, 1.0);
+    return normalize(point - (c.origin + c.direction * h));
+  }
+  else if (type == TYPE_CYLINDER)
+  {
+    Capsule c = cylinders[index];
+    return CappedNormal(c.origin, c.direction, c.radius, 0.0, point);
+  }
+  else if (type == TYPE_TORUS)
+  {
+    // Gradient of (|p|^2 + R^2 - r^2)^2 - 4 R^2 (|p|^2 - (p.axis)^2)
+    Torus t = tori[index];
+    vec3 P = point - t.center;
+    float R2 = t.R * t.R;
+    return normalize(P * (dot(P, P) - R2 - t.r * t.r) + t.axis * (2.0 * R2 * dot(P, t.axis)));
+  }
+  else if (type == TYPE_CONE)
+  {
+    ConeSegment c = cones[index];
+    return CappedNormal(c.origin, c.direction, c.r0, c.r1 - c.r0, point);
+  }
+  else if (type == TYPE_MESH)
+  {
+    Mesh mesh = meshes[index];
+    vec3 v0 = GetVertex(mesh, uint(info.triangle), 0);
+    vec3 v1 = GetVertex(mesh, uint(info.triangle), 1);
+    vec3 v2 = GetVertex(mesh, uint(info.triangle), 2);
+    return normalize(cross(v1 - v0, v2 - v0));
+  }
+  else if (type == TYPE_INSTANCE)
+  {
+    // Scaling is uniform, so only the rotation changes the normal
+    Instance inst = instances[index];
+    Mesh mesh = meshes[inst.mesh];
+    vec3 v0 = GetVertex(mesh, uint(info.triangle), 0);
+    vec3 v1 = GetVertex(mesh, uint(info.triangle), 1);
+    vec3 v2 = GetVertex(mesh, uint(info.triangle), 2);
+    return RotateByQuaternion(inst.rotation, normalize(cross(v1 - v0, v2 - v0)));
+  }
+  return vec3(0.0, 0.0, 1.0);
+}
+
+uint GetMaterials(int type, int index)
+{
+  if (type == TYPE_AABB)          return boxes[index].materials;
+  else if (type == TYPE_SPHERE)   return spheres[index].materials;
+  else if (type == TYPE_OBB)      return obbs[index].materials;
+  else if (type == TYPE_CAPSULE)  return capsules[index].materials;
+  else if (type == TYPE_CYLINDER) return cylinders[index].materials;
+  else if (type == TYPE_TORUS)    return tori[index].materials;
+  else if (type == TYPE_CONE)     return cones[index].materials;
+  else if (type == TYPE_INSTANCE) return instances[index].materials;
+  return meshes[index].materials;
+}
+
+//--------------------------------------------------------------------------------------
+//  INTERSECTION - BVH
+//--------------------------------------------------------------------------------------
+
+#ifdef WIDE_BVH
+
+// Decodes the quantized bounds of every child and slab tests them 4 at a
+// time. Returns a bit per child hit.
+uint IntersectWideNode(int nodeIndex, const Ray ray, const vec3 invDir, float tMax,
+                       out int child[WIDE_BVH], out int count[WIDE_BVH], out float tNear[WIDE_BVH])
+{
+  uint words[4 * WIDE_BVH];
+  for (int i = 0; i < WIDE_BVH; i++)
+  {
+    uvec4 q = wideNodes[nodeIndex * WIDE_BVH + i];
+    words[4 * i + 0] = q.x;
+    words[4 * i + 1] = q.y;
+    words[4 * i + 2] = q.z;
+    words[4 * i + 3] = q.w;
+  }
+
+  vec3 origin = uintBitsToFloat(uvec3(words[0], words[1], words[2]));
+  int header = int(words[3]);
+  ivec3 exponent = ivec3(bitfieldExtract(header, 0, 8),
+                         bitfieldExtract(header, 8, 8),
+                         bitfieldExtract(header, 16, 8));
+  vec3 scale = ldexp(vec3(1.0), exponent);
+  int nChildren = int(bitfieldExtract(words[3], 24, 8));
+
+  const uvec4 shifts = uvec4(0u, 8u, 16u, 24u);
+  uint mask = 0u;
+  for (int group = 0; group < WIDE_LANE_WORDS; group++)
+  {
+    vec4 loX = vec4((uvec4(words[WIDE_LOWER + group]) >> shifts) & 0xFFu);
+    vec4 loY = vec4((uvec4(words[WIDE_LOWER + WIDE_LANE_WORDS + group]) >> shifts) & 0xFFu);
+    vec4 loZ = vec4((uvec4(words[WIDE_LOWER + 2 * WIDE_LANE_WORDS + group]) >> shifts) & 0xFFu);
+    vec4 hiX = vec4((uvec4(words[WIDE_UPPER + group]) >> shifts) & 0xFFu);
+    vec4 hiY = vec4((uvec4(words[WIDE_UPPER + WIDE_LANE_WORDS + group]) >> shifts) & 0xFFu);
+    vec4 hiZ = vec4((uvec4(words[WIDE_UPPER + 2 * WIDE_LANE_WORDS + group]) >> shifts) & 0xFFu);
+
+    vec4 t0X = (origin.x + loX * scale.x - ray.P.x) * invDir.x;
+    vec4 t1X = (origin.x + hiX * scale.x - ray.P.x) * invDir.x;
+    vec4 t0Y = (origin.y + loY * scale.y - ray.P.y) * invDir.y;
+    vec4 t1Y = (origin.y + hiY * scale.y - ray.P.y) * invDir.y;
+    vec4 t0Z = (origin.z + loZ * scale.z - ray.P.z) * invDir.z;
+    vec4 t1Z = (origin.z + hiZ * scale.z - ray.P.z) * invDir.z;
+    vec4 tMin = max(max(min(t0X, t1X), min(t0Y, t1Y)), min(t0Z, t1Z));
+    vec4 tFar = min(min(max(t0X, t1X), max(t0Y, t1Y)), max(t0Z, t1Z)) * 1.0000003576;
+
+    uvec4 counts = (uvec4(words[WIDE_COUNT + group]) >> shifts) & 0xFFu;
+    for (int j = 0; j < 4; j++)
+    {
+      int c = 4 * group + j;
+      child[c] = int(words[WIDE_CHILD + c]);
+      count[c] = int(counts[j]);
+      tNear[c] = tMin[j];
+      if (c < nChildren && tMin[j] <= tFar[j] && tFar[j] >= 0.0 && tMin[j] < tMax)
+      {
+        mask |= 1u << uint(c);
+      }
+    }
+  }
+  return mask;
+}
+
+// Same traversal as IntersectBVH, over the triangles of one mesh.
+// GLSL has no recursion, so the top level calls this as a separate function.
+void IntersectMeshBVH(const Ray ray, const vec3 invDir, int meshIndex, inout HitInfo info)
+{
+  Mesh mesh = meshes[meshIndex];
+  TriangleRay triRay = SetupTriangleRay(ray);
+
+  // (wide node, 0) or (first triangle, count), and the distance it was hit at
+  ivec2 stack[WIDE_STACK_SIZE];
+  float stackT[WIDE_STACK_SIZE];
+  stack[0] = ivec2(meshRoots[meshIndex], 0);
+  stackT[0] = -MAX_SCENE_BOUNDS;
+  int stackSize = 1;
+
+  while (stackSize > 0)
+  {
+    stackSize--;
+    ivec2 entry = stack[stackSize];
+    if (stackT[stackSize] >= info.t)
+    {
+      continue;
+    }
+
+    if (entry.y > 0)
+    {
+      for (int i = entry.x; i < entry.x + entry.y; i++)
+      {
+        uint triangle = uint(primitives[i].y);
+        float t = IntersectTriangle(triRay,
+                                    GetVertex(mesh, triangle, 0),
+                                    GetVertex(mesh, triangle, 1),
+                                    GetVertex(mesh, triangle, 2));
+        if (t < info.t)
+        {
+          info.type = TYPE_MESH;
+          info.t = t;
+          info.index = meshIndex;
+          info.triangle = int(triangle);
+        }
+      }
+      continue;
+    }
+
+    int child[WIDE_BVH];
+    int count[WIDE_BVH];
+    float tNear[WIDE_BVH];
+    uint mask = IntersectWideNode(entry.x, ray, invDir, info.t, child, count, tNear);
+
+    // Push the children hit far to near, so the nearest is visited next
+    while (mask != 0u)
+    {
+      int far = -1;
+      for (int c = 0; c < WIDE_BVH; c++)
+      {
+        if ((mask & (1u << uint(c))) != 0u && (far < 0 || tNear[c] >= tNear[far]))
+        {
+          far = c;
+        }
+      }
+      mask &= ~(1u << uint(far));
+      if (stackSize < WIDE_STACK_SIZE)
+      {
+        stack[stackSize] = ivec2(child[far], count[far]);
+        stackT[stackSize] = tNear[far];
+        stackSize++;
+      }
+    }
+  }
+}
+
+#else
+
+bool IntersectNode(const BVHNode node, const Ray ray, const vec3 invDir, float tMax, out float tNear)
+{
+  vec3 t0 = (node.min - ray.P) * invDir;
+  vec3 t1 = (node.max - ray.P) * invDir;
+  vec3 tMin = min(t0, t1);
+  vec3 tMaxs = max(t0, t1);
+  tNear = max(max(tMin.x, tMin.y), tMin.z);
+  // Widened by 2 gamma(3) so rounding never culls a ray through a vertex on
+  // the boundary of a node. Must match s_slabFarScale in BVH.cpp.
+  float tFar = min(min(tMaxs.x, tMaxs.y), tMaxs.z) * 1.0000003576;
+  return tNear <= tFar && tFar >= 0.0 && tNear < tMax;
+}
+
+// Same traversal as IntersectBVH, over the triangles of one mesh.
+// GLSL has no recursion, so the top level calls this as a separate function.
+void IntersectMeshBVH(const Ray ray, const vec3 invDir, int meshIndex, inout HitInfo info)
+{
+  int root = meshRoots[meshIndex];
+  float tNear;
+  if (!IntersectNode(nodes[root], ray, invDir, info.t, tNear))
+  {
+    return;
+  }
+
+  Mesh mesh = meshes[meshIndex];
+  TriangleRay triRay = SetupTriangleRay(ray);
+
+  int stack[BVH_STACK_SIZE];
+  int stackSize = 0;
+  int nodeIndex = root;
+
+  while (true)
+  {
+    BVHNode node = nodes[nodeIndex];
+
+    if (node.count > 0)
+    {
+      for (int i = node.offset; i < node.offset + node.count; i++)
+      {
+        uint triangle = uint(primitives[i].y);
+        float t = IntersectTriangle(triRay,
+                                    GetVertex(mesh, triangle, 0),
+                                    GetVertex(mesh, triangle, 1),
+                                    GetVertex(mesh, triangle, 2));
+        if (t < info.t)
+        {
+          info.type = TYPE_MESH;
+          info.t = t;
+          info.index = meshIndex;
+          info.triangle = int(triangle);
+        }
+      }
+    }
+    else
+    {
+      // Visit the nearer child first
+      int left = nodeIndex + 1;
+      int right = node.offset;
+      float tLeft, tRight;
+      bool hitLeft = IntersectNode(nodes[left], ray, invDir, info.t, tLeft);
+      bool hitRight = IntersectNode(nodes[right], ray, invDir, info.t, tRight);
+
+      if (hitLeft && hitRight)
+      {
+        if (tRight < tLeft)
+        {
+          int temp = left;
+          left = right;
+          right = temp;
+        }
+        if (stackSize < BVH_STACK_SIZE)
+        {
+          stack[stackSize++] = right;
+        }
+        nodeIndex = left;
+        continue;
+      }
+      if (hitLeft)
+      {
+        nodeIndex = left;
+        continue;
+      }
+      if (hitRight)
+      {
+        nodeIndex = right;
+        continue;
+      }
+    }
+
+    if (stackSize == 0)
+    {
+      break;
+    }
+    nodeIndex = stack[--stackSize];
+  }
+}
+
+#endif
+
+void IntersectPrimitive(const Ray ray, const vec3 invDir, const ivec2 prim, inout HitInfo info)
+{
+  if (prim.x == TYPE_MESH)
+  {
+    IntersectMeshBVH(ray, invDir, prim.y, info);
+    return;
+  }
+
+  if (prim.x == TYPE_INSTANCE)
+  {
+    // Trace the shared mesh hierarchy in the frame of the instance
+    Instance inst = instances[prim.y];
+    Ray objectRay = ToObjectSpace(inst, ray);
+    HitInfo hit = info;
+    hit.type = TYPE_NULL;
+    IntersectMeshBVH(objectRay, 1.0 / objectRay.V, int(inst.mesh), hit);
+    if (hit.type != TYPE_NULL)
+    {
+      info.type = TYPE_INSTANCE;
+      info.t = hit.t;
+      info.index = prim.y;
+      info.triangle = hit.triangle;
+    }
+    return;
+  }
+
+  float t = NO_INTERSECT;
+  if (prim.x == TYPE_AABB)
+  {
+    t = IntersectAABB(ray, boxes[prim.y]);
+  }
+  else if (prim.x == TYPE_SPHERE)
+  {
+    t = IntersectSphere(ray, spheres[prim.y]);
+  }
+  else if (prim.x == TYPE_OBB)
+  {
+    t = IntersectOBB(ray, obbs[prim.y]);
+  }
+  else if (prim.x == TYPE_CAPSULE)
+  {
+    t = IntersectCapsule(ray, capsules[prim.y]);
+  }
+  else if (prim.x == TYPE_CYLINDER)
+  {
+    t = IntersectCylinder(ray, cylinders[prim.y]);
+  }
+  else if (prim.x == TYPE_TORUS)
+  {
+    t = IntersectTorus(ray, tori[prim.y]);
+  }
+  else if (prim.x == TYPE_CONE)
+  {
+    t = IntersectConeSegment(ray, cones[prim.y]);
+  }
+
+  if (t < info.t)
+  {
+    info.type = prim.x;
+    info.t = t;
+    info.index = prim.y;
+    info.triangle = -1;
+  }
+}
+
+#ifdef WIDE_BVH
+
+void IntersectBVH(const Ray ray, inout HitInfo info)
+{
+  vec3 invDir = 1.0 / ray.V;
+
+  ivec2 stack[WIDE_STACK_SIZE];
+  float stackT[WIDE_STACK_SIZE];
+  stack[0] = ivec2(bvhRoot, 0);
+  stackT[0] = -MAX_SCENE_BOUNDS;
+  int stackSize = 1;
+
+  while (stackSize > 0)
+  {
+    stackSize--;
+    ivec2 entry = stack[stackSize];
+    if (stackT[stackSize] >= info.t)
+    {
+      continue;
+    }
+
+    if (entry.y > 0)
+    {
+      for (int i = entry.x; i < entry.x + entry.y; i++)
+      {
+        IntersectPrimitive(ray, invDir, primitives[i], info);
+      }
+      continue;
+    }
+
+    int child[WIDE_BVH];
+    int count[WIDE_BVH];
+    float tNear[WIDE_BVH];
+    uint mask = IntersectWideNode(entry.x, ray, invDir, info.t, child, count, tNear);
+
+    while (mask != 0u)
+    {
+      int far = -1;
+      for (int c = 0; c < WIDE_BVH; c++)
+      {
+        if ((mask & (1u << uint(c))) != 0u && (far < 0 || tNear[c] >= tNear[far]))
+        {
+          far = c;
+        }
+      }
+      mask &= ~(1u << uint(far));
+      if (stackSize < WIDE_STACK_SIZE)
+      {
+        stack[stackSize] = ivec2(child[far], count[far]);
+        stackT[stackSize] = tNear[far];
+        stackSize++;
+      }
+    }
+  }
+}
+
+#else
+
+void IntersectBVH(const Ray ray, inout HitInfo info)
+{
+  vec3 invDir = 1.0 / ray.V;
+  float tNear;
+  if (!IntersectNode(nodes[bvhRoot], ray, invDir, info.t, tNear))
+  {
+    return;
+  }
+
+  int stack[BVH_STACK_SIZE];
+  int stackSize = 0;
+  int nodeIndex = bvhRoot;
+
+  while (true)
+  {
+    BVHNode node = nodes[nodeIndex];
+
+    if (node.count > 0)
+    {
+      for (int i = node.offset; i < node.offset + node.count; i++)
+      {
+        IntersectPrimitive(ray, invDir, primitives[i], info);
+      }
+    }
+    else
+    {
+      // Visit the nearer child first
+      int left = nodeIndex + 1;
+      int right = node.offset;
+      float tLeft, tRight;
+      bool hitLeft = IntersectNode(nodes[left], ray, invDir, info.t, tLeft);
+      bool hitRight = IntersectNode(nodes[right], ray, invDir, info.t, tRight);
+
+      if (hitLeft && hitRight)
+      {
+        if (tRight < tLeft)
+        {
+          int temp = left;
+          left = right;
+          right = temp;
+        }
+        if (stackSize < BVH_STACK_SIZE)
+        {
+          stack[stackSize++] = right;
+        }
+        nodeIndex = left;
+        continue;
+      }
+      if (hitLeft)
+      {
+        nodeIndex = left;
+        continue;
+      }
+      if (hitRight)
+      {
+        nodeIndex = right;
+        continue;
+      }
+    }
+
+    if (stackSize == 0)
+    {
+      break;
+    }
+    nodeIndex = stack[--stackSize];
+  }
+}
+
+#endif
+
+//--------------------------------------------------------------------------------------
+//  TRACE RAY
+//--------------------------------------------------------------------------------------
+
+HitInfo trace(const Ray ray, float tMax) 
+{
+  HitInfo info;
+  info.type = TYPE_NULL;
+  info.t = tMax;
+  info.index = -1;
+  info.triangle = -1;
+  
+  IntersectBVH(ray, info);
+  return info;
+}
+
+// Adds the ambient term of a hit to the pixel and queues the shadow ray for
+// the direct term and, if the surface reflects, the next bounce.
+void shade(const Ray ray, const HitInfo info, int pixel, vec3 weight, bool queueReflection, int queueOut)
+{
+  Materials mat = MaterialsList[GetMaterials(info.type, info.index)];
+  vec3 point = ray.P + info.t * ray.V;
+  vec3 normal = GetNormal(info, point);
+  if (dot(normal, ray.V) > 0.0)
+  {
+    normal = -normal;
+  }
+  vec3 origin = point + RAY_OFFSET * normal;
+  vec3 diffuse = weight * mat.color.rgb * (1.0 - mat.reflectance);
+
+  radiance[pixel].rgb += AMBIENT * diffuse;
+
+  float nDotL = dot(normal, LIGHT_DIRECTION);
+  if (nDotL > 0.0)
+  {
+    uint slot = atomicAdd(shadowCount, 1u);
+    shadows[slot] = QueuedRay(origin, pixel, LIGHT_DIRECTION, MAX_SCENE_BOUNDS,
+                              vec4((1.0 - AMBIENT) * nDotL * diffuse, 0.0));
+  }
+
+  if (queueReflection && mat.reflectance > 0.0)
+  {
+    uint slot = atomicAdd(rayCount[queueOut], 1u);
+    rays[queueOut * (rays.length() / 2) + slot] = QueuedRay(origin, pixel, reflect(ray.V, normal), MAX_SCENE_BOUNDS,
+                                                            vec4(weight * mat.reflectance, 0.0));
+  }
+}
+
+//--------------------------------------------------------------------------------------
+//  MAIN
+//--------------------------------------------------------------------------------------
+
+// One program is built per pass from this file. A frame is a primary pass,
+// then for each bounce: PASS_PREPARE, PASS_SHADOW and PASS_BOUNCE, and last
+// PASS_RESOLVE. The queue passes are dispatched indirectly with one
+// invocation per live ray. With sorting on, the PASS_SORT_* passes order
+// each queue before it is traced, see GPURaySorter::Sort().
+
+uniform int bounce;   // PASS_PREPARE, PASS_BOUNCE: the queue being drained is rays[bounce & 1]
+
+uniform int  sortedQueue;   // PASS_SHADOW, PASS_BOUNCE: read the queue in the order of rayOrder[]
+uniform int  sortQueue;     // PASS_SORT_*: 0 sorts shadows[], 1 rays[bounce & 1]
+uniform vec3 sortMin;
+uniform vec3 sortScale;     // 1 / extent of the scene bounds, 0 on flat axes
+uniform uint sortShift;     // Lowest bit of the digit being sorted
+
+// Rays in the queue being sorted, and the work groups it was dispatched with
+uint SortCount()
+{
+  return (sortQueue == 0) ? shadowDispatch.count : bounceDispatch.count;
+}
+
+uint SortBlockCount()
+{
+  return (sortQueue == 0) ? shadowDispatch.x : bounceDispatch.x;
+}
+
+// Spreads the low 10 bits to every third bit
+uint ExpandBits(uint v)
+{
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+#if defined(PASS_PREPARE)
+
+// Turns the counts appended by the previous pass into dispatch sizes and
+// empties the queues for the next one.
+layout (local_size_x = 1) in;
+void main(void)
+{
+  const uint groupSize = uint(WAVEFRONT_GROUP_SIZE);
+
+  uint nShadows = shadowCount;
+  shadowDispatch = DispatchArgs((nShadows + groupSize - 1u) / groupSize, 1u, 1u, nShadows);
+  shadowCount = 0;
+
+  int queueIn = bounce & 1;
+  uint nRays = rayCount[queueIn];
+  bounceDispatch = DispatchArgs((nRays + groupSize - 1u) / groupSize, 1u, 1u, nRays);
+  rayCount[queueIn] = 0;
+}
+
+#elif defined(PASS_SHADOW)
+
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+void main(void)
+{
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= shadowDispatch.count)
+  {
+    return;
+  }
+
+  QueuedRay q = shadows[(sortedQueue != 0) ? rayOrder[i] : i];
+  Ray ray;
+  ray.P = q.origin;
+  ray.V = q.direction;
+
+  // Directional light, anything in the way blocks it
+  if (trace(ray, q.tMax).type == TYPE_NULL)
+  {
+    radiance[q.pixel].rgb += q.weight.rgb;
+  }
+}
+
+#elif defined(PASS_BOUNCE)
+
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+void main(void)
+{
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= bounceDispatch.count)
+  {
+    return;
+  }
+
+  int queueIn = bounce & 1;
+  QueuedRay q = rays[queueIn * (rays.length() / 2) + ((sortedQueue != 0) ? rayOrder[i] : i)];
+  Ray ray;
+  ray.P = q.origin;
+  ray.V = q.direction;
+
+  HitInfo info = trace(ray, q.tMax);
+  if (info.type != TYPE_NULL)
+  {
+    shade(ray, info, q.pixel, q.weight.rgb, bounce + 1 < NUM_REFLECTIONS, 1 - queueIn);
+  }
+}
+
+#elif defined(PASS_SORT_KEYS)
+
+// Direction octant in bits 27 to 29, above a 27 bit Morton code of the
+// origin's cell in a 512^3 grid over the scene, so rays leaving the same
+// region the same way end up next to each other. Same key as CPUTracer.
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+void main(void)
+{
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= SortCount())
+  {
+    return;
+  }
+
+  QueuedRay q = (sortQueue == 0) ? shadows[i] : rays[(bounce & 1) * (rays.length() / 2) + i];
+  uvec3 cell = uvec3(clamp((q.origin - sortMin) * sortScale * 512.0, 0.0, 511.0));
+  uint octant = ((q.direction.x < 0.0) ? 1u : 0u) | ((q.direction.y < 0.0) ? 2u : 0u) | ((q.direction.z < 0.0) ? 4u : 0u);
+  sortKeys[i] = (octant << 27) | (ExpandBits(cell.x) << 2) | (ExpandBits(cell.y) << 1) | ExpandBits(cell.z);
+  rayOrder[i] = i;
+}
+
+#elif defined(PASS_SORT_HISTOGRAM)
+
+shared uint localCounts[RAYSORT_RADIX_SIZE];
+
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+void main(void)
+{
+  uint lid = gl_LocalInvocationIndex;
+  if (lid < RAYSORT_RADIX_SIZE)
+  {
+    localCounts[lid] = 0u;
+  }
+  barrier();
+
+  uint i = gl_GlobalInvocationID.x;
+  if (i < SortCount())
+  {
+    atomicAdd(localCounts[(sortKeys[i] >> sortShift) & (RAYSORT_RADIX_SIZE - 1u)], 1u);
+  }
+  barrier();
+
+  if (lid < RAYSORT_RADIX_SIZE)
+  {
+    sortHistogram[lid * SortBlockCount() + gl_WorkGroupID.x] = localCounts[lid];
+  }
+}
+
+#elif defined(PASS_SORT_SCAN)
+
+// One work group. Each invocation sums a run of the histogram, the sums
+// are scanned in shared memory, then each run is rewritten as offsets.
+shared uint partial[RAYSORT_SCAN_SIZE];
+
+layout (local_size_x = RAYSORT_SCAN_SIZE) in;
+void main(void)
+{
+  uint lid = gl_LocalInvocationIndex;
+  uint total = RAYSORT_RADIX_SIZE * SortBlockCount();
+  uint perInvocation = (total + RAYSORT_SCAN_SIZE - 1u) / RAYSORT_SCAN_SIZE;
+  uint first = min(lid * perInvocation, total);
+  uint last = min(first + perInvocation, total);
+
+  uint sum = 0u;
+  for (uint i = first; i < last; i++)
+  {
+    sum += sortHistogram[i];
+  }
+  partial[lid] = sum;
+  barrier();
+
+  for (uint offset = 1u; offset < RAYSORT_SCAN_SIZE; offset *= 2u)
+  {
+    uint v = (lid >= offset) ? partial[lid - offset] : 0u;
+    barrier();
+    partial[lid] += v;
+    barrier();
+  }
+
+  uint running = partial[lid] - sum;
+  for (uint i = first; i < last; i++)
+  {
+    uint c = sortHistogram[i];
+    sortHistogram[i] = running;
+    running += c;
+  }
+}
+
+#elif defined(PASS_SORT_SCATTER)
+
+shared uint localDigits[WAVEFRONT_GROUP_SIZE];
+
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+void main(void)
+{
+  uint lid = gl_LocalInvocationIndex;
+  uint i = gl_GlobalInvocationID.x;
+  bool live = i < SortCount();
+
+  // Past the end the digit matches nothing
+  uint key = 0u;
+  uint digit = RAYSORT_RADIX_SIZE;
+  if (live)
+  {
+    key = sortKeys[i];
+    digit = (key >> sortShift) & (RAYSORT_RADIX_SIZE - 1u);
+  }
+  localDigits[lid] = digit;
+  barrier();
+
+  if (!live)
+  {
+    return;
+  }
+
+  // Keys earlier in the group with the same digit go first, keeping the
+  // sort stable
+  uint rank = 0u;
+  for (uint j = 0u; j < lid; j++)
+  {
+    if (localDigits[j] == digit)
+    {
+      rank++;
+    }
+  }
+
+  uint dst = sortHistogram[digit * SortBlockCount() + gl_WorkGroupID.x] + rank;
+  sortKeysOut[dst] = key;
+  rayOrderOut[dst] = rayOrder[i];
+}
+
+#elif defined(PASS_RESOLVE)
+
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+void main(void)
+{
+  ivec2 size = renderSize;
+  int pixel = int(gl_GlobalInvocationID.x);
+  if (pixel >= size.x * size.y)
+  {
+    return;
+  }
+  ivec2 pix = ivec2(pixel % size.x, pixel / size.x);
+  vec4 color = vec4(radiance[pixel].rgb, 1.0);
+
+  if (sampleIndex > 0)
+  {
+    // Running mean over all samples since the view last changed
+    vec4 mean = imageLoad(accumulation, pix);
+    color = mean + (color - mean) / float(sampleIndex + 1);
+  }
+  if (sampleIndex >= 0)
+  {
+    imageStore(accumulation, pix, color);
+  }
+
+  imageStore(framebuffer, pix, color);
+}
+
+#else
+
+// Primary rays, one invocation per pixel
+layout (local_size_x = WORK_GROUP_SIZE_X, local_size_y = WORK_GROUP_SIZE_Y) in;
+void main(void) 
+{
+  ivec2 pix = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = renderSize;
+  if (pix.x >= size.x || pix.y >= size.y) 
+  {
+    return;
+  }
+  vec2 pos = (vec2(pix) + jitter) / vec2(size.x - 1, size.y - 1);
+  vec3 dir = mix(mix(ray00, ray01, pos.x), mix(ray10, ray11, pos.x), pos.y);
+  Ray ray;
+  ray.P = eye;
+  ray.V = dir;
+
+  int pixel = pix.y * size.x + pix.x;
+  radiance[pixel] = vec4(0.0);
+
+  HitInfo info = trace(ray, MAX_SCENE_BOUNDS);
+  if (info.type != TYPE_NULL)
+  {
+    shade(ray, info, pixel, vec3(1.0), NUM_REFLECTIONS > 0, 0);
+  }
+}
+
+#endif
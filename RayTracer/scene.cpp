@@ -0,0 +1,389 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "scene.h"
+#include "SceneFile.h"
+#include "SceneLayout.h"
+#include "DgRNG.h"
+
+
+uint32_t Scene::AddMaterials(Materials const & a_materials)
+{
+  m_materials.PushBack(a_materials);
+  m_dirtyMaterials.Add(m_materials.size - 1, m_materials.size);
+  return m_materials.size - 1;
+}
+
+
+template<typename T>
+void Scene::Add(qArray<T> & a_array, DirtyRange & a_dirty, T const & a_item)
+{
+  a_array.PushBack(a_item);
+  a_dirty.Add(a_array.size - 1, a_array.size);
+  m_geometryChanged = true;
+}
+
+
+template<typename T>
+void Scene::Set(qArray<T> & a_array, DirtyRange & a_dirty, unsigned a_index, T const & a_item)
+{
+  if (a_index < a_array.size)
+  {
+    a_array[a_index] = a_item;
+    a_dirty.Add(a_index, a_index + 1);
+    m_geometryChanged = true;
+  }
+}
+
+
+void Scene::AddBox(AABB const & a_box)                  { Add(m_boxes, m_dirtyBoxes, a_box); }
+void Scene::AddSphere(Sphere const & a_sphere)          { Add(m_spheres, m_dirtySpheres, a_sphere); }
+void Scene::AddOBB(OBB const & a_obb)                   { Add(m_obbs, m_dirtyOBBs, a_obb); }
+void Scene::AddCapsule(Capsule const & a_capsule)       { Add(m_capsules, m_dirtyCapsules, a_capsule); }
+void Scene::AddCylinder(Cylinder const & a_cylinder)    { Add(m_cylinders, m_dirtyCylinders, a_cylinder); }
+void Scene::AddTorus(Torus const & a_torus)             { Add(m_tori, m_dirtyTori, a_torus); }
+void Scene::AddCone(ConeSegment const & a_cone)         { Add(m_cones, m_dirtyCones, a_cone); }
+
+
+bool Scene::AddMesh(float const * a_positions, unsigned a_nVertices,
+                    uint32_t const * a_indices, unsigned a_nTriangles,
+                    uint32_t a_materials)
+{
+  if (a_nVertices == 0 || a_nTriangles == 0)
+  {
+    return false;
+  }
+
+  for (unsigned i = 0; i < 3 * a_nTriangles; i++)
+  {
+    if (a_indices[i] >= a_nVertices)
+    {
+      return false;
+    }
+  }
+
+  Mesh mesh;
+  mesh.firstVertex = m_positions.size / 3;
+  mesh.nVertices = a_nVertices;
+  mesh.firstIndex = m_indices.size;
+  mesh.nTriangles = a_nTriangles;
+  mesh.materials = a_materials;
+
+  unsigned nFloats = m_positions.size;
+  m_positions.Resize(nFloats + 3 * a_nVertices);
+  memcpy(m_positions.data + nFloats, a_positions, 3 * a_nVertices * sizeof(float));
+  m_dirtyPositions.Add(nFloats, m_positions.size);
+
+  unsigned nIndices = m_indices.size;
+  m_indices.Resize(nIndices + 3 * a_nTriangles);
+  memcpy(m_indices.data + nIndices, a_indices, 3 * a_nTriangles * sizeof(uint32_t));
+  m_dirtyIndices.Add(nIndices, m_indices.size);
+
+  Add(m_meshes, m_dirtyMeshes, mesh);
+  return true;
+}
+
+
+bool Scene::AddInstance(Instance const & a_instance)
+{
+  if (a_instance.mesh >= m_meshes.size)
+  {
+    return false;
+  }
+
+  m_instances.PushBack(a_instance);
+  m_dirtyInstances.Add(m_instances.size - 1, m_instances.size);
+  m_instancesChanged = true;
+  return true;
+}
+
+
+void Scene::SetMaterials(unsigned a_index, Materials const & a_materials)
+{
+  if (a_index < m_materials.size)
+  {
+    m_materials[a_index] = a_materials;
+    m_dirtyMaterials.Add(a_index, a_index + 1);
+  }
+}
+
+
+void Scene::SetBox(unsigned a_index, AABB const & a_box)                  { Set(m_boxes, m_dirtyBoxes, a_index, a_box); }
+void Scene::SetSphere(unsigned a_index, Sphere const & a_sphere)          { Set(m_spheres, m_dirtySpheres, a_index, a_sphere); }
+void Scene::SetOBB(unsigned a_index, OBB const & a_obb)                   { Set(m_obbs, m_dirtyOBBs, a_index, a_obb); }
+void Scene::SetCapsule(unsigned a_index, Capsule const & a_capsule)       { Set(m_capsules, m_dirtyCapsules, a_index, a_capsule); }
+void Scene::SetCylinder(unsigned a_index, Cylinder const & a_cylinder)    { Set(m_cylinders, m_dirtyCylinders, a_index, a_cylinder); }
+void Scene::SetTorus(unsigned a_index, Torus const & a_torus)             { Set(m_tori, m_dirtyTori, a_index, a_torus); }
+void Scene::SetCone(unsigned a_index, ConeSegment const & a_cone)         { Set(m_cones, m_dirtyCones, a_index, a_cone); }
+
+
+void Scene::SetInstance(unsigned a_index, Instance const & a_instance)
+{
+  if (a_index < m_instances.size && a_instance.mesh < m_meshes.size)
+  {
+    m_instances[a_index] = a_instance;
+    m_dirtyInstances.Add(a_index, a_index + 1);
+    m_instancesChanged = true;
+  }
+}
+
+
+bool Scene::IsDirty() const
+{
+  return m_geometryChanged
+    || m_instancesChanged
+    || !m_dirtyMaterials.Empty()
+    || !m_dirtyBoxes.Empty()
+    || !m_dirtySpheres.Empty()
+    || !m_dirtyOBBs.Empty()
+    || !m_dirtyCapsules.Empty()
+    || !m_dirtyCylinders.Empty()
+    || !m_dirtyTori.Empty()
+    || !m_dirtyCones.Empty()
+    || !m_dirtyMeshes.Empty()
+    || !m_dirtyPositions.Empty()
+    || !m_dirtyIndices.Empty()
+    || !m_dirtyInstances.Empty();
+}
+
+
+void Scene::ClearDirty()
+{
+  m_dirtyMaterials.Clear();
+  m_dirtyBoxes.Clear();
+  m_dirtySpheres.Clear();
+  m_dirtyOBBs.Clear();
+  m_dirtyCapsules.Clear();
+  m_dirtyCylinders.Clear();
+  m_dirtyTori.Clear();
+  m_dirtyCones.Clear();
+  m_dirtyMeshes.Clear();
+  m_dirtyPositions.Clear();
+  m_dirtyIndices.Clear();
+  m_dirtyInstances.Clear();
+  m_geometryChanged = false;
+  m_instancesChanged = false;
+}
+
+
+void Scene::Clear()
+{
+  m_materials.Resize(0);
+  m_boxes.Resize(0);
+  m_spheres.Resize(0);
+  m_obbs.Resize(0);
+  m_capsules.Resize(0);
+  m_cylinders.Resize(0);
+  m_tori.Resize(0);
+  m_cones.Resize(0);
+  m_meshes.Resize(0);
+  m_positions.Resize(0);
+  m_indices.Resize(0);
+  m_instances.Resize(0);
+  ClearDirty();
+  m_geometryChanged = true;
+}
+
+
+//Fills a_array from the section in the layout of GPUType. False if the
+//section is damaged.
+template<typename GPUType, typename T>
+static bool UnpackSection(SceneFile const & a_file, uint32_t a_section, qArray<T> & a_array, DirtyRange & a_dirty)
+{
+  GPUType const * items(nullptr);
+  unsigned count(0);
+  if (!a_file.Get(a_section, items, count))
+  {
+    return false;
+  }
+
+  a_array.Resize(count);
+  for (unsigned i = 0; i < count; i++)
+  {
+    Unpack(items[i], a_array[i]);
+  }
+  a_dirty.Add(0, count);
+  return true;
+}
+
+
+bool Scene::Load(SceneFile const & a_file)
+{
+  Clear();
+
+  float const * positions(nullptr);
+  uint32_t const * indices(nullptr);
+  unsigned nPositions(0), nIndices(0);
+  bool loaded = UnpackSection<GPUMaterials>(a_file, SCENE_SECTION_MATERIALS, m_materials, m_dirtyMaterials)
+    && UnpackSection<GPUAABB>(a_file, SCENE_SECTION_BOXES, m_boxes, m_dirtyBoxes)
+    && UnpackSection<GPUSphere>(a_file, SCENE_SECTION_SPHERES, m_spheres, m_dirtySpheres)
+    && UnpackSection<GPUOBB>(a_file, SCENE_SECTION_OBBS, m_obbs, m_dirtyOBBs)
+    && UnpackSection<GPUCapsule>(a_file, SCENE_SECTION_CAPSULES, m_capsules, m_dirtyCapsules)
+    && UnpackSection<GPUCapsule>(a_file, SCENE_SECTION_CYLINDERS, m_cylinders, m_dirtyCylinders)
+    && UnpackSection<GPUTorus>(a_file, SCENE_SECTION_TORI, m_tori, m_dirtyTori)
+    && UnpackSection<GPUCone>(a_file, SCENE_SECTION_CONES, m_cones, m_dirtyCones)
+    && UnpackSection<GPUMesh>(a_file, SCENE_SECTION_MESHES, m_meshes, m_dirtyMeshes)
+    && UnpackSection<GPUInstance>(a_file, SCENE_SECTION_INSTANCES, m_instances, m_dirtyInstances)
+    && a_file.Get(SCENE_SECTION_POSITIONS, positions, nPositions)
+    && a_file.Get(SCENE_SECTION_INDICES, indices, nIndices);
+
+  //Check what AddMesh() and AddInstance() would have, with 64 bit sums so
+  //a damaged count cannot wrap around
+  uint64_t nVertices = nPositions / 3;
+  for (unsigned m = 0; loaded && m < m_meshes.size; m++)
+  {
+    Mesh const & mesh = m_meshes[m];
+    loaded = mesh.nVertices > 0 && mesh.nTriangles > 0
+      && uint64_t(mesh.firstVertex) + mesh.nVertices <= nVertices
+      && uint64_t(mesh.firstIndex) + 3 * uint64_t(mesh.nTriangles) <= nIndices;
+    for (unsigned i = 0; loaded && i < 3 * mesh.nTriangles; i++)
+    {
+      loaded = indices[mesh.firstIndex + i] < mesh.nVertices;
+    }
+  }
+  for (unsigned i = 0; loaded && i < m_instances.size; i++)
+  {
+    loaded = m_instances[i].mesh < m_meshes.size;
+  }
+
+  if (!loaded)
+  {
+    printf("The scene file is damaged\n");
+    Clear();
+    return false;
+  }
+
+  m_positions.Borrow(positions, nPositions);
+  m_indices.Borrow(indices, nIndices);
+  m_dirtyPositions.Add(0, nPositions);
+  m_dirtyIndices.Add(0, nIndices);
+  m_geometryChanged = true;
+  m_instancesChanged = true;
+  return true;
+}
+
+
+void Scene::LoadDefault()
+{
+  Clear();
+
+  Materials mat;
+  mat.color.Set(1.0f, 0.0f, 0.0f, 1.0f); AddMaterials(mat);
+  mat.color.Set(1.0f, 1.0f, 0.0f, 1.0f); AddMaterials(mat);
+  mat.reflectance = 0.5f;
+  mat.color.Set(1.0f, 0.0f, 1.0f, 1.0f); AddMaterials(mat);
+  mat.reflectance = 0.25f;
+  mat.color.Set(0.0f, 1.0f, 1.0f, 1.0f); AddMaterials(mat);
+
+  AABB box;
+  box.min.Set(-2.5f, 8.5f, -2.5f, 1.0f);
+  box.max.Set(2.5f, 12.5f, 2.5f, 1.0f);
+  box.materials = 1;
+  AddBox(box);
+
+  box.min.Set(-3.5f, -3.5f, 7.5f, 1.0f);
+  box.max.Set(3.5f, 3.5f, 13.5f, 1.0f);
+  box.materials = 3;
+  AddBox(box);
+
+  Sphere sphere;
+  sphere.center.Set(9.5f, 0.0f, 0.0f, 1.0f);
+  sphere.radius = 2.0f;
+  sphere.materials = 2;
+  AddSphere(sphere);
+
+  OBB obb;
+  obb.center.Set(16.0f, 0.0f, 6.0f, 1.0f);
+  obb.axes[0].Set(0.7071068f, 0.7071068f, 0.0f, 0.0f);
+  obb.axes[1].Set(-0.7071068f, 0.7071068f, 0.0f, 0.0f);
+  obb.axes[2].Set(0.0f, 0.0f, 1.0f, 0.0f);
+  obb.extents[0] = 1.5f;
+  obb.extents[1] = 1.5f;
+  obb.extents[2] = 1.0f;
+  obb.materials = 0;
+  AddOBB(obb);
+
+  Capsule capsule;
+  capsule.origin.Set(12.0f, -4.0f, -6.0f, 1.0f);
+  capsule.direction.Set(0.0f, 8.0f, 0.0f, 0.0f);
+  capsule.radius = 0.75f;
+  capsule.materials = 3;
+  AddCapsule(capsule);
+
+  Cylinder cylinder;
+  cylinder.origin.Set(14.0f, 7.0f, -3.0f, 1.0f);
+  cylinder.direction.Set(0.0f, 0.0f, 4.0f, 0.0f);
+  cylinder.radius = 1.0f;
+  cylinder.materials = 0;
+  AddCylinder(cylinder);
+
+  Torus torus;
+  torus.center.Set(12.0f, -5.5f, 0.0f, 1.0f);
+  torus.axis.Set(1.0f, 0.0f, 0.0f, 0.0f);
+  torus.radius_circle = 1.5f;
+  torus.radius_thick = 0.4f;
+  torus.materials = 2;
+  AddTorus(torus);
+
+  ConeSegment cone;
+  cone.origin.Set(12.0f, -5.5f, 3.0f, 1.0f);
+  cone.direction.Set(0.0f, 0.0f, 2.5f, 0.0f);
+  cone.r0 = 1.25f;
+  cone.r1 = 0.5f;
+  cone.materials = 1;
+  AddCone(cone);
+}
+
+
+void Scene::ScatterInstances(uint32_t a_mesh, unsigned a_count, uint32_t a_materials)
+{
+  if (a_mesh >= m_meshes.size || a_count == 0)
+  {
+    return;
+  }
+
+  Mesh const & mesh = m_meshes[a_mesh];
+  float const * positions = m_positions.data + 3 * mesh.firstVertex;
+  float lower[3] = {positions[0], positions[1], positions[2]};
+  float upper[3] = {positions[0], positions[1], positions[2]};
+  for (unsigned v = 1; v < mesh.nVertices; v++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      if (positions[3 * v + i] < lower[i]) lower[i] = positions[3 * v + i];
+      if (positions[3 * v + i] > upper[i]) upper[i] = positions[3 * v + i];
+    }
+  }
+  float size = 0.0f;
+  for (int i = 0; i < 3; i++)
+  {
+    if (upper[i] - lower[i] > size) size = upper[i] - lower[i];
+  }
+
+  //Rays end at MAX_SCENE_BOUNDS, so keep the square well inside it
+  float const side = 80.0f;
+  float const ground = -8.0f;
+  unsigned perRow = unsigned(ceil(sqrt(double(a_count))));
+  float spacing = side / float(perRow);
+  float scale = (size > 0.0f) ? 0.8f * spacing / size : 1.0f;
+
+  Dg::RNG_PCG32 rng(a_count, a_mesh);
+  vec4 up(0.0f, 0.0f, 1.0f, 0.0f);
+
+  Instance instance;
+  instance.mesh = a_mesh;
+  instance.materials = a_materials;
+  m_instances.Reserve(m_instances.size + a_count);
+  for (unsigned i = 0; i < a_count; i++)
+  {
+    //Sit the bottom of the mesh on the ground plane
+    vec4 position(5.0f + spacing * (float(i % perRow) + 0.5f),
+                  spacing * (float(i / perRow) + 0.5f) - 0.5f * side,
+                  ground - lower[2] * scale,
+                  0.0f);
+    Dg::Quaternion<real> rotation(up, rng.GetUniform(0.0f, 2.0f * Dg::PI_f));
+    instance.transform.Set(position, rotation, scale);
+    AddInstance(instance);
+  }
+}
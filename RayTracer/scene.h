@@ -3,11 +3,15 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <type_traits>
 
 #include "RayTracerConfig.h"
 #include "VQS.h"
 //#include "BasisR3.h"
 
+class SceneFile;
+
 typedef Dg::VQS<real>     vqs;
 typedef Dg::Vector4<real> vec4;
 
@@ -18,39 +22,88 @@ struct IntersectionData
 
 struct Materials
 {
-  uint32_t color;
+  Materials() : reflectance(0.0f) {}
+
+  vec4 color;
+  real reflectance;   //Fraction of light mirrored, the rest is diffuse
+};
+
+struct AABB
+{
+  vec4 min;
+  vec4 max;
+  uint32_t materials;
 };
 
 struct Sphere
 {
   vec4 center;
   real radius;
-  Materials materials;
+  uint32_t materials;
 };
 
 struct OBB
 {
   vec4 center;
-  //BasisR3 basis;
-  real x, y, z;
-  Materials materials;
+  vec4 axes[3];     //Orthonormal
+  real extents[3];  //Half lengths along each axis
+  uint32_t materials;
+};
+
+struct Capsule
+{
+  vec4 origin;
+  vec4 direction;   //From the origin to the other end of the segment
+  real radius;
+  uint32_t materials;
+};
+
+//! Capped at both ends
+struct Cylinder
+{
+  vec4 origin;
+  vec4 direction;   //From the origin to the other cap
+  real radius;
+  uint32_t materials;
 };
 
 struct Torus
 {
   vec4 center;
-  vec4 axis;
+  vec4 axis;        //Unit
   real radius_circle;
   real radius_thick;
-  Materials materials;
+  uint32_t materials;
+};
+
+//! Capped cone frustum, radius r0 at the origin and r1 at origin + direction.
+struct ConeSegment
+{
+  vec4 origin;
+  vec4 direction;
+  real r0;
+  real r1;
+  uint32_t materials;
 };
 
+//! Indexed triangle mesh. Vertices and indices live in the scene's shared
+//! position and index streams. Indices are relative to firstVertex.
 struct Mesh
 {
-  vec4 * vertices;
-  int nVertices;
-  int * facets[3];
-  Materials materials;
+  uint32_t firstVertex;
+  uint32_t nVertices;
+  uint32_t firstIndex;
+  uint32_t nTriangles;
+  uint32_t materials;
+};
+
+//! Copy of a mesh placed by a translate, rotate and uniform scale. All
+//! instances of a mesh share its triangles and its BVH.
+struct Instance
+{
+  vqs       transform;    //Object to world
+  uint32_t  mesh;
+  uint32_t  materials;
 };
 
 struct Ray
@@ -62,45 +115,254 @@ struct Ray
 template<typename T>
 class qArray
 {
+  static_assert(std::is_trivially_copyable<T>::value, "qArray grows with realloc and memcpy.");
+
 public:
 
-  qArray() : size(0), data(nullptr) {}
+  qArray() : size(0), capacity(0), data(nullptr), owned(true) {}
 
-  ~qArray() { free(data); }
+  ~qArray() { if (owned) free(data); }
 
-  void Resize(unsigned a_size) 
+  //! Grows the capacity geometrically so repeated growth, such as adding
+  //! meshes one at a time, does not reallocate every time.
+  void Resize(unsigned a_size)
   {
-    size = a_size;
-
     if (a_size == 0)
     {
-      free(data);
+      if (owned) free(data);
       data = nullptr;
+      capacity = 0;
+      owned = true;
     }
-    else
+    else if (a_size > capacity)
+    {
+      Reserve((a_size > capacity * 2) ? a_size : capacity * 2);
+    }
+
+    //Set after Reserve(), which copies only the elements that exist
+    size = a_size;
+  }
+
+  void Reserve(unsigned a_capacity)
+  {
+    if (a_capacity > capacity)
+    {
+      capacity = a_capacity;
+      if (owned)
+      {
+        data = static_cast<T*>(realloc(data, capacity * sizeof(T)));
+      }
+      else
+      {
+        T * copy = static_cast<T*>(malloc(capacity * sizeof(T)));
+        memcpy(copy, data, size * sizeof(T));
+        data = copy;
+        owned = true;
+      }
+    }
+  }
+
+  //! Uses memory someone else owns, such as a mapped SceneFile, instead of
+  //! a copy. The array copies it out the first time it grows and must not
+  //! be written to before then.
+  void Borrow(T const * a_data, unsigned a_size)
+  {
+    Resize(0);
+    data = const_cast<T*>(a_data);
+    size = a_size;
+    capacity = a_size;
+    owned = false;
+  }
+
+  void PushBack(T const & a_item)
+  {
+    if (size == capacity)
     {
-      data = realloc(data, size * sizeof(T));
+      Reserve((capacity == 0) ? 16 : capacity * 2);
     }
+    data[size++] = a_item;
   }
 
+  T & operator[](unsigned i) { return data[i]; }
+  T const & operator[](unsigned i) const { return data[i]; }
+
+private:
+
+  qArray(qArray const &);
+  qArray & operator=(qArray const &);
+
 public:
 
   unsigned size;
+  unsigned capacity;
   T * data;
+  bool owned;       //False while Borrow()ed
 
 };
 
 
+//! Range of array elements modified since the last upload.
+struct DirtyRange
+{
+  DirtyRange() : first(0), end(0) {}
+
+  bool Empty() const { return first >= end; }
+  void Clear() { first = end = 0; }
+  void Add(unsigned a_first, unsigned a_end)
+  {
+    if (Empty())
+    {
+      first = a_first;
+      end = a_end;
+    }
+    else
+    {
+      if (a_first < first) first = a_first;
+      if (a_end > end) end = a_end;
+    }
+  }
+
+  unsigned first;
+  unsigned end;
+};
+
+
 class Scene
 {
 public:
 
+  Scene() : m_geometryChanged(false), m_instancesChanged(false) {}
+
+  //! Fills the scene with a small test scene.
+  void LoadDefault();
+
+  //! Scatters copies of a mesh over a square below the test scene, each
+  //! scaled to its cell and turned about z by a random angle.
+  void ScatterInstances(uint32_t mesh, unsigned count, uint32_t materials);
+
+  //! Replaces the scene with the one in a scene file. Vertex positions and
+  //! indices are used in place, so the file has to stay open as long as the
+  //! scene. Returns false, leaving the scene empty, if a section the scene
+  //! needs is damaged or refers outside another.
+  bool Load(SceneFile const &);
+
+  //! Removes all objects and materials.
+  void Clear();
+
+  qArray<Materials> const & GetMaterials() const { return m_materials; }
+  qArray<AABB> const & GetBoxes() const { return m_boxes; }
+  qArray<Sphere> const & GetSpheres() const { return m_spheres; }
+  qArray<OBB> const & GetOBBs() const { return m_obbs; }
+  qArray<Capsule> const & GetCapsules() const { return m_capsules; }
+  qArray<Cylinder> const & GetCylinders() const { return m_cylinders; }
+  qArray<Torus> const & GetTori() const { return m_tori; }
+  qArray<ConeSegment> const & GetCones() const { return m_cones; }
+  qArray<Mesh> const & GetMeshes() const { return m_meshes; }
+  qArray<Instance> const & GetInstances() const { return m_instances; }
+
+  //! Tightly packed xyz positions of every mesh vertex.
+  qArray<float> const & GetPositions() const { return m_positions; }
+  qArray<uint32_t> const & GetIndices() const { return m_indices; }
+
+  //! Position of one corner of a mesh triangle.
+  float const * GetTriangleVertex(Mesh const & a_mesh, unsigned a_triangle, int a_corner) const
+  {
+    return &m_positions[3 * (a_mesh.firstVertex + m_indices[a_mesh.firstIndex + 3 * a_triangle + a_corner])];
+  }
+
+  uint32_t AddMaterials(Materials const &);
+  void AddBox(AABB const &);
+  void AddSphere(Sphere const &);
+  void AddOBB(OBB const &);
+  void AddCapsule(Capsule const &);
+  void AddCylinder(Cylinder const &);
+  void AddTorus(Torus const &);
+  void AddCone(ConeSegment const &);
+
+  //! Copies a mesh into the scene. Indices are relative to the first
+  //! position. Returns false if the mesh is empty or an index is out of range.
+  bool AddMesh(float const * positions, unsigned nVertices,
+               uint32_t const * indices, unsigned nTriangles,
+               uint32_t materials);
+
+  //! Returns false if the instance refers to a mesh that does not exist.
+  bool AddInstance(Instance const &);
+
+  void SetMaterials(unsigned index, Materials const &);
+  void SetBox(unsigned index, AABB const &);
+  void SetSphere(unsigned index, Sphere const &);
+  void SetOBB(unsigned index, OBB const &);
+  void SetCapsule(unsigned index, Capsule const &);
+  void SetCylinder(unsigned index, Cylinder const &);
+  void SetTorus(unsigned index, Torus const &);
+  void SetCone(unsigned index, ConeSegment const &);
+  void SetInstance(unsigned index, Instance const &);
+
+  //! Elements changed since ClearDirty().
+  DirtyRange const & DirtyMaterials() const { return m_dirtyMaterials; }
+  DirtyRange const & DirtyBoxes() const { return m_dirtyBoxes; }
+  DirtyRange const & DirtySpheres() const { return m_dirtySpheres; }
+  DirtyRange const & DirtyOBBs() const { return m_dirtyOBBs; }
+  DirtyRange const & DirtyCapsules() const { return m_dirtyCapsules; }
+  DirtyRange const & DirtyCylinders() const { return m_dirtyCylinders; }
+  DirtyRange const & DirtyTori() const { return m_dirtyTori; }
+  DirtyRange const & DirtyCones() const { return m_dirtyCones; }
+  DirtyRange const & DirtyMeshes() const { return m_dirtyMeshes; }
+  DirtyRange const & DirtyPositions() const { return m_dirtyPositions; }
+  DirtyRange const & DirtyIndices() const { return m_dirtyIndices; }
+  DirtyRange const & DirtyInstances() const { return m_dirtyInstances; }
+
+  bool IsDirty() const;
+
+  //! True if any object moved, or objects were added or removed.
+  bool GeometryChanged() const { return m_geometryChanged; }
+
+  //! True if instances were added or moved. Only the top level of the
+  //! hierarchy has to be rebuilt for these.
+  bool InstancesChanged() const { return m_instancesChanged; }
+
+  void ClearDirty();
+
 private:
 
+  template<typename T>
+  void Add(qArray<T> &, DirtyRange &, T const &);
+
+  template<typename T>
+  void Set(qArray<T> &, DirtyRange &, unsigned index, T const &);
+
+private:
+
+  qArray<Materials> m_materials;
+  qArray<AABB> m_boxes;
   qArray<Sphere> m_spheres;
+  qArray<OBB> m_obbs;
+  qArray<Capsule> m_capsules;
+  qArray<Cylinder> m_cylinders;
+  qArray<Torus> m_tori;
+  qArray<ConeSegment> m_cones;
+  qArray<Mesh> m_meshes;
+  qArray<float> m_positions;
+  qArray<uint32_t> m_indices;
+  qArray<Instance> m_instances;
+
+  DirtyRange m_dirtyMaterials;
+  DirtyRange m_dirtyBoxes;
+  DirtyRange m_dirtySpheres;
+  DirtyRange m_dirtyOBBs;
+  DirtyRange m_dirtyCapsules;
+  DirtyRange m_dirtyCylinders;
+  DirtyRange m_dirtyTori;
+  DirtyRange m_dirtyCones;
+  DirtyRange m_dirtyMeshes;
+  DirtyRange m_dirtyPositions;
+  DirtyRange m_dirtyIndices;
+  DirtyRange m_dirtyInstances;
+  bool m_geometryChanged;
+  bool m_instancesChanged;
 
   vqs m_camera;
 
 };
 
-#endif
\ No newline at end of file
+#endif